@@ -0,0 +1,164 @@
+#include "AllocationTracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace
+{
+    // Constant initialized, usable from operator new before anything else runs.
+    struct ThreadCounters
+    {
+        uint64_t Count;
+        uint64_t Bytes;
+        uint64_t FreeCount;
+    };
+
+    thread_local ThreadCounters t_counters = {};
+
+    std::atomic<uint64_t> g_allocationCount{ 0 };
+    std::atomic<uint64_t> g_allocationBytes{ 0 };
+    std::atomic<uint64_t> g_freeCount{ 0 };
+
+    void RecordAllocation(size_t size)
+    {
+        t_counters.Count++;
+        t_counters.Bytes += size;
+        g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+        g_allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    void RecordFree()
+    {
+        t_counters.FreeCount++;
+        g_freeCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void* AlignedMalloc(size_t size, size_t alignment)
+    {
+#ifdef _WIN32
+        return _aligned_malloc(size, alignment);
+#else
+        // aligned_alloc wants a size multiple of the alignment.
+        return std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+    }
+
+    void AlignedFree(void* memory)
+    {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        free(memory);
+#endif
+    }
+
+    // Calls the new handler until the allocation succeeds, null without one.
+    // alignment 0 takes the default alignment of malloc.
+    void* Allocate(size_t size, size_t alignment)
+    {
+        RecordAllocation(size);
+        if (size == 0)
+        {
+            size = 1;
+        }
+        for (;;)
+        {
+            void* memory = (alignment == 0) ? malloc(size) : AlignedMalloc(size, alignment);
+            if (memory != nullptr)
+            {
+                return memory;
+            }
+            std::new_handler handler = std::get_new_handler();
+            if (handler == nullptr)
+            {
+                return nullptr;
+            }
+            handler();
+        }
+    }
+
+    void* AllocateOrThrow(size_t size, size_t alignment)
+    {
+        void* memory = Allocate(size, alignment);
+        if (memory == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+
+    void* AllocateNoThrow(size_t size, size_t alignment) noexcept
+    {
+        try
+        {
+            return Allocate(size, alignment);
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+    }
+
+    void Free(void* memory)
+    {
+        if (memory != nullptr)
+        {
+            RecordFree();
+            free(memory);
+        }
+    }
+
+    void FreeAligned(void* memory)
+    {
+        if (memory != nullptr)
+        {
+            RecordFree();
+            AlignedFree(memory);
+        }
+    }
+}
+
+AllocationStats GlobalAllocationStats()
+{
+    AllocationStats stats;
+    stats.Count = g_allocationCount.load(std::memory_order_relaxed);
+    stats.Bytes = g_allocationBytes.load(std::memory_order_relaxed);
+    stats.FreeCount = g_freeCount.load(std::memory_order_relaxed);
+    return stats;
+}
+
+AllocationStats ThreadAllocationStats()
+{
+    AllocationStats stats;
+    stats.Count = t_counters.Count;
+    stats.Bytes = t_counters.Bytes;
+    stats.FreeCount = t_counters.FreeCount;
+    return stats;
+}
+
+// Replacements of the global allocation functions. The aligned forms always
+// go through the aligned allocator, their deletes free with it.
+void* operator new(size_t size) { return AllocateOrThrow(size, 0); }
+void* operator new[](size_t size) { return AllocateOrThrow(size, 0); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return AllocateNoThrow(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return AllocateNoThrow(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return AllocateOrThrow(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return AllocateOrThrow(size, (size_t)alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return AllocateNoThrow(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return AllocateNoThrow(size, (size_t)alignment); }
+
+void operator delete(void* memory) noexcept { Free(memory); }
+void operator delete[](void* memory) noexcept { Free(memory); }
+void operator delete(void* memory, size_t) noexcept { Free(memory); }
+void operator delete[](void* memory, size_t) noexcept { Free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { Free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { Free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(memory); }
\ No newline at end of file
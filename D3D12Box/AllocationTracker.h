@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// Heap traffic counted by the replaced global operator new and delete.
+// The counters are kept per thread and for the whole process; nothing is
+// recorded about the blocks themselves, so the overhead is a few increments.
+struct AllocationStats
+{
+    uint64_t Count = 0;
+    uint64_t Bytes = 0;
+    uint64_t FreeCount = 0;
+};
+
+inline AllocationStats operator-(const AllocationStats& a, const AllocationStats& b)
+{
+    AllocationStats difference;
+    difference.Count = a.Count - b.Count;
+    difference.Bytes = a.Bytes - b.Bytes;
+    difference.FreeCount = a.FreeCount - b.FreeCount;
+    return difference;
+}
+
+// Every thread since the process started.
+AllocationStats GlobalAllocationStats();
+// The calling thread since it started.
+AllocationStats ThreadAllocationStats();
+
+// Counts the allocations the calling thread makes while it is alive. Jobs
+// the thread hands to the workers are not included.
+class AllocationScope
+{
+public:
+    AllocationScope() : m_start(ThreadAllocationStats()) {}
+    AllocationScope(const AllocationScope& rhs) = delete;
+    AllocationScope& operator=(const AllocationScope& rhs) = delete;
+
+    AllocationStats Stats()const { return ThreadAllocationStats() - m_start; }
+
+private:
+    AllocationStats m_start;
+};
+
+// Adapter counting what the containers using it allocate, the memory comes
+// from upstream. Tells one container's traffic apart from the rest.
+class TrackingResource : public std::pmr::memory_resource
+{
+public:
+    explicit TrackingResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) :
+        m_upstream(upstream)
+    {}
+
+    const AllocationStats& Stats()const { return m_stats; }
+    // Bytes allocated and not freed yet.
+    uint64_t LiveBytes()const { return m_liveBytes; }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        void* memory = m_upstream->allocate(bytes, alignment);
+        m_stats.Count++;
+        m_stats.Bytes += bytes;
+        m_liveBytes += bytes;
+        return memory;
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override
+    {
+        m_upstream->deallocate(p, bytes, alignment);
+        m_stats.FreeCount++;
+        m_liveBytes -= bytes;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override
+    {
+        return this == &other;
+    }
+
+private:
+    std::pmr::memory_resource* m_upstream;
+    AllocationStats m_stats;
+    uint64_t m_liveBytes = 0;
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Blocking FIFO with a fixed capacity, used to hand work between two threads.
+// Push waits while the queue is full and Pop while it is empty. Close wakes
+// up both sides, after it Push fails and Pop fails once the queue is drained.
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) :
+        m_items(capacity)
+    {
+    }
+    BoundedQueue(const BoundedQueue& rhs) = delete;
+    BoundedQueue& operator=(const BoundedQueue& rhs) = delete;
+
+    bool Push(const T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this]() { return m_closed || m_count < m_items.size(); });
+        if (m_closed)
+        {
+            return false;
+        }
+        m_items[(m_head + m_count) % m_items.size()] = item;
+        m_count++;
+        lock.unlock();
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this]() { return m_closed || m_count > 0; });
+        if (m_count == 0)
+        {
+            return false;
+        }
+        item = m_items[m_head];
+        m_head = (m_head + 1) % m_items.size();
+        m_count--;
+        lock.unlock();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+    size_t Capacity()const { return m_items.size(); }
+
+private:
+    // Ring buffer, never reallocated after construction.
+    std::vector<T> m_items;
+    size_t m_head = 0;
+    size_t m_count = 0;
+    bool m_closed = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+};
\ No newline at end of file
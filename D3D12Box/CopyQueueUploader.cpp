@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include "CopyQueueUploader.h"
+
+CopyQueueUploader::CopyQueueUploader(ID3D12Device* device, FenceEventPool* eventPool) :
+    m_device(device)
+{
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_copyQueue)));
+
+    m_fence = std::make_unique<D3D12TimelineFence>(device, eventPool);
+}
+
+CopyQueueUploader::~CopyQueueUploader()
+{
+    // The staging buffers have to outlive the copies reading them.
+    Flush();
+}
+
+ComPtr<ID3D12Resource> CopyQueueUploader::CreateBuffer(const void* data, UINT64 byteSize)
+{
+    return CreateBuffer(byteSize, [data, byteSize](void* destination) { memcpy(destination, data, (size_t)byteSize); });
+}
+
+ComPtr<ID3D12Resource> CopyQueueUploader::CreateBuffer(UINT64 byteSize, const std::function<void(void* destination)>& fill,
+    UINT64* fenceValue)
+{
+    ComPtr<ID3D12Resource> defaultBuffer;
+    ThrowIfFailed(m_device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(&defaultBuffer)));
+
+    ComPtr<ID3D12Resource> stagingBuffer;
+    ThrowIfFailed(m_device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&stagingBuffer)));
+
+    // We do not intend to read from this resource on the CPU.
+    BYTE* mappedData = nullptr;
+    CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(stagingBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mappedData)));
+    fill(mappedData);
+    stagingBuffer->Unmap(0, nullptr);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_batchOpen)
+    {
+        OpenBatch();
+    }
+    m_commandList->CopyBufferRegion(defaultBuffer.Get(), 0, stagingBuffer.Get(), 0, byteSize);
+    m_openBatch.StagingBuffers.push_back(stagingBuffer);
+    // The open batch is signaled with the value after the last one.
+    if (fenceValue != nullptr)
+    {
+        *fenceValue = m_fence->LastSignaledValue() + 1;
+    }
+    return defaultBuffer;
+}
+
+UINT64 CopyQueueUploader::Submit()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_batchOpen)
+    {
+        return m_fence->LastSignaledValue();
+    }
+
+    ThrowIfFailed(m_commandList->Close());
+    ID3D12CommandList* cmdLists[] = { m_commandList.Get() };
+    m_copyQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
+
+    m_openBatch.FenceValue = m_fence->Signal(m_copyQueue.Get());
+    m_submittedBatches.push_back(std::move(m_openBatch));
+    m_openBatch = Batch();
+    m_batchOpen = false;
+    return m_submittedBatches.back().FenceValue;
+}
+
+void CopyQueueUploader::GpuWait(ID3D12CommandQueue* queue, UINT64 fenceValue)
+{
+    m_fence->GpuWait(queue, fenceValue);
+}
+
+void CopyQueueUploader::Retire()
+{
+    UINT64 completedValue = m_fence->CompletedValue();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_submittedBatches.empty() && m_submittedBatches.front().FenceValue <= completedValue)
+    {
+        m_freeAllocators.push_back(m_submittedBatches.front().Allocator);
+        m_submittedBatches.pop_front();
+    }
+}
+
+void CopyQueueUploader::Flush()
+{
+    m_fence->Wait(m_fence->LastSignaledValue());
+    Retire();
+}
+
+void CopyQueueUploader::OpenBatch()
+{
+    if (m_freeAllocators.empty())
+    {
+        ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&m_openBatch.Allocator)));
+    }
+    else
+    {
+        m_openBatch.Allocator = m_freeAllocators.back();
+        m_freeAllocators.pop_back();
+        ThrowIfFailed(m_openBatch.Allocator->Reset());
+    }
+
+    if (m_commandList == nullptr)
+    {
+        ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY,
+            m_openBatch.Allocator.Get(), nullptr, IID_PPV_ARGS(&m_commandList)));
+    }
+    else
+    {
+        ThrowIfFailed(m_commandList->Reset(m_openBatch.Allocator.Get(), nullptr));
+    }
+    m_batchOpen = true;
+}
\ No newline at end of file
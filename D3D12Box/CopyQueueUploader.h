@@ -0,0 +1,74 @@
+#pragma once
+#include "stdafx.h"
+#include "D3DAppUtil.h"
+#include "D3D12TimelineFence.h"
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Uploads buffers through a dedicated copy queue so the direct queue keeps
+// rendering meanwhile. Copies are recorded into a batch, Submit executes the
+// batch and returns the copy fence value signaled when it is done. Other
+// queues wait for that value on the GPU, the CPU never has to block.
+//
+// The destination buffers are created in the common state: the copy queue
+// promotes them to copy dest and they decay back to common once the batch
+// completes, so the direct queue can read them as vertex or index buffers
+// without a barrier.
+class CopyQueueUploader
+{
+public:
+    CopyQueueUploader(ID3D12Device* device, FenceEventPool* eventPool);
+    CopyQueueUploader(const CopyQueueUploader& rhs) = delete;
+    CopyQueueUploader& operator=(const CopyQueueUploader& rhs) = delete;
+    ~CopyQueueUploader();
+
+    // Creates a default heap buffer and records the copy of data into it.
+    // data is copied to a staging buffer before returning.
+    ComPtr<ID3D12Resource> CreateBuffer(const void* data, UINT64 byteSize);
+    // Same, fill writes the byteSize bytes into the staging buffer itself, e.g.
+    // decoding them there. The staging memory is write-combined, fill should
+    // write it in order and never read it. fenceValue, if not null, receives
+    // the copy fence value the copy completes with, taken with the copy
+    // recorded: a Submit from another thread may come in between two calls.
+    ComPtr<ID3D12Resource> CreateBuffer(UINT64 byteSize, const std::function<void(void* destination)>& fill,
+        UINT64* fenceValue = nullptr);
+
+    // Executes the recorded copies. Returns the fence value they complete
+    // with, the last submitted value if nothing was recorded.
+    UINT64 Submit();
+
+    // Makes queue wait on the GPU for the copies up to fenceValue.
+    void GpuWait(ID3D12CommandQueue* queue, UINT64 fenceValue);
+
+    UINT64 CompletedValue() { return m_fence->CompletedValue(); }
+
+    // Frees the staging buffers of the completed batches and recycles their
+    // allocators, never blocks.
+    void Retire();
+
+    // Waits for every submitted batch.
+    void Flush();
+
+private:
+    struct Batch
+    {
+        ComPtr<ID3D12CommandAllocator> Allocator;
+        std::vector<ComPtr<ID3D12Resource>> StagingBuffers;
+        UINT64 FenceValue = 0;
+    };
+
+    void OpenBatch();
+
+    ComPtr<ID3D12Device> m_device;
+    ComPtr<ID3D12CommandQueue> m_copyQueue;
+    ComPtr<ID3D12GraphicsCommandList> m_commandList;
+    std::unique_ptr<D3D12TimelineFence> m_fence;
+
+    // Uploads can be recorded from any thread.
+    std::mutex m_mutex;
+    Batch m_openBatch;
+    bool m_batchOpen = false;
+    std::deque<Batch> m_submittedBatches;
+    std::vector<ComPtr<ID3D12CommandAllocator>> m_freeAllocators;
+};
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+// CPU reference of the culling compute pass in cull.hlsl. The visibility
+// test performs the same float operations in the same order as the shader,
+// so both sides agree on every instance. Only the order of the commands
+// inside a run differs: the GPU appends them in whatever order the threads
+// finish, the reference keeps the input order.
+//
+// The functions are templates over the plane, vector, instance and command
+// types, laid out like XMFLOAT4, XMFLOAT3, CullInstance and IndirectCommand,
+// so the reference builds and is tested without the Windows headers.
+// ExtractFrustumPlanes in D3DAppUtil.h builds the planes.
+
+// Tests a world space AABB against the planes (a, b, c, d), pointing inwards.
+// A box touching a plane is inside.
+template<typename Plane, typename Vector>
+bool IsInsideFrustum(const Plane planes[6], const Vector& center, const Vector& extents)
+{
+    // Keep these expressions in sync with IsInsideFrustum in cull.hlsl.
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        const Plane& plane = planes[i];
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float radius = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+        if (distance + radius < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copies the commands of the visible instances to the start of their run in
+// culledCommands and counts them in runCounts, which has to be zeroed by the caller.
+template<typename Plane, typename Instance, typename Command>
+void CullIndirectCommands(
+    const Plane planes[6],
+    const Instance* instances,
+    const Command* commands,
+    uint32_t commandCount,
+    Command* culledCommands,
+    uint32_t* runCounts)
+{
+    for (uint32_t i = 0; i < commandCount; i++)
+    {
+        const Instance& instance = instances[i];
+        if (IsInsideFrustum(planes, instance.Center, instance.Extents))
+        {
+            uint32_t slot = runCounts[instance.RunIndex]++;
+            culledCommands[instance.RunFirstCommand + slot] = commands[i];
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "stdafx.h"
+#include "D3D12RenderGraph.h"
+#include <cassert>
+
+namespace
+{
+    D3D12_RESOURCE_FLAGS ToResourceFlags(ResourceAccess usage)
+    {
+        D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE;
+        if (HasAccess(usage, ResourceAccess::RenderTarget))
+        {
+            flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+        }
+        if (HasAccess(usage, ResourceAccess::DepthWrite | ResourceAccess::DepthRead))
+        {
+            flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+        }
+        if (HasAccess(usage, ResourceAccess::UnorderedAccess))
+        {
+            flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+        }
+        return flags;
+    }
+
+    D3D12_RESOURCE_DESC ToResourceDesc(const TransientTextureDesc& desc, ResourceAccess usage)
+    {
+        return CD3DX12_RESOURCE_DESC::Tex2D((DXGI_FORMAT)desc.Format, desc.Width, desc.Height,
+            1, 1, 1, 0, ToResourceFlags(usage));
+    }
+}
+
+D3D12_RESOURCE_STATES ToResourceStates(ResourceAccess access)
+{
+    static const std::pair<ResourceAccess, D3D12_RESOURCE_STATES> accessStates[] =
+    {
+        { ResourceAccess::RenderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET },
+        { ResourceAccess::DepthWrite, D3D12_RESOURCE_STATE_DEPTH_WRITE },
+        { ResourceAccess::DepthRead, D3D12_RESOURCE_STATE_DEPTH_READ },
+        { ResourceAccess::ShaderRead, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE },
+        { ResourceAccess::UnorderedAccess, D3D12_RESOURCE_STATE_UNORDERED_ACCESS },
+        { ResourceAccess::CopySource, D3D12_RESOURCE_STATE_COPY_SOURCE },
+        { ResourceAccess::CopyDest, D3D12_RESOURCE_STATE_COPY_DEST },
+        { ResourceAccess::IndirectArgument, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT },
+        { ResourceAccess::Present, D3D12_RESOURCE_STATE_PRESENT }
+    };
+
+    // None maps to the common state.
+    D3D12_RESOURCE_STATES states = D3D12_RESOURCE_STATE_COMMON;
+    for (const auto& accessState : accessStates)
+    {
+        if (HasAccess(access, accessState.first))
+        {
+            states |= accessState.second;
+        }
+    }
+    return states;
+}
+
+ID3D12Resource* RenderPassContext::Resource(RenderGraphResource resource)const
+{
+    return m_graph->Resource(resource);
+}
+
+void RenderPassContext::InsertCommandLists(ID3D12CommandList* const* commandLists, UINT count)
+{
+    m_commandList = m_graph->InsertCommandLists(m_commandList, commandLists, count);
+}
+
+D3D12RenderGraph::D3D12RenderGraph(ID3D12Device* device, ResourceStateTracker* states) :
+    m_device(device),
+    m_states(states)
+{
+}
+
+D3D12RenderGraph::~D3D12RenderGraph()
+{
+    ReleaseTransients();
+}
+
+RenderGraphPass D3D12RenderGraph::AddPass(const std::string& name, PassFunction function)
+{
+    RenderGraphPass pass = m_graph.AddPass(name);
+    m_passFunctions.resize(pass + 1);
+    m_passFunctions[pass] = std::move(function);
+    return pass;
+}
+
+void D3D12RenderGraph::Compile()
+{
+    ReleaseTransients();
+    m_graph.Compile([this](const TransientTextureDesc& desc, ResourceAccess usage)
+    {
+        D3D12_RESOURCE_DESC resourceDesc = ToResourceDesc(desc, usage);
+        D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, &resourceDesc);
+        MemoryRequirements requirements;
+        requirements.Size = info.SizeInBytes;
+        requirements.Alignment = info.Alignment;
+        return requirements;
+    });
+
+    const D3D12_HEAP_FLAGS heapFlags[] =
+    {
+        D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES
+    };
+    for (UINT type = 0; type < (UINT)TransientHeapType::Count; type++)
+    {
+        UINT64 size = m_graph.HeapSize((TransientHeapType)type);
+        if (size > 0)
+        {
+            CD3DX12_HEAP_DESC heapDesc(size, D3D12_HEAP_TYPE_DEFAULT,
+                D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, heapFlags[type]);
+            ThrowIfFailed(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_heaps[type])));
+        }
+    }
+
+    // The placed textures are created once and reused every frame, in the
+    // state the frame leaves them in.
+    m_transientResources.resize(m_graph.ResourceCount());
+    m_d3dResources.resize(m_graph.ResourceCount(), nullptr);
+    for (RenderGraphResource resource = 0; resource < m_graph.ResourceCount(); resource++)
+    {
+        const TransientAllocation& allocation = m_graph.Allocation(resource);
+        if (m_graph.IsImported(resource) || allocation.FirstUse == RenderGraphInvalidIndex)
+        {
+            continue;
+        }
+        D3D12_RESOURCE_DESC resourceDesc = ToResourceDesc(m_graph.TextureDesc(resource), m_graph.CombinedAccess(resource));
+        D3D12_RESOURCE_STATES initialState = ToResourceStates(m_graph.InitialAccess(resource));
+        ThrowIfFailed(m_device->CreatePlacedResource(
+            m_heaps[(UINT)allocation.HeapType].Get(),
+            allocation.Offset,
+            &resourceDesc,
+            initialState,
+            nullptr,
+            IID_PPV_ARGS(&m_transientResources[resource])));
+        m_d3dResources[resource] = m_transientResources[resource].Get();
+        m_states->Register(m_d3dResources[resource], initialState);
+    }
+}
+
+void D3D12RenderGraph::SetImportedResource(RenderGraphResource resource, ID3D12Resource* d3dResource)
+{
+    assert(m_graph.IsImported(resource));
+    if (m_d3dResources.size() <= resource)
+    {
+        m_d3dResources.resize(resource + 1, nullptr);
+    }
+    m_d3dResources[resource] = d3dResource;
+}
+
+void D3D12RenderGraph::Execute(const CommandListSource& nextCommandList, std::vector<ID3D12CommandList*>& submitLists)
+{
+    m_nextCommandList = &nextCommandList;
+    m_submitLists = &submitLists;
+
+    ID3D12GraphicsCommandList* commandList = nextCommandList();
+    for (const CompiledPass& compiled : m_graph.ExecutionOrder())
+    {
+        IssueBarriers(compiled.Barriers, commandList);
+        RenderPassContext context(this, commandList);
+        m_passFunctions[compiled.Pass](context);
+        commandList = context.m_commandList;
+    }
+    IssueBarriers(m_graph.FinalBarriers(), commandList);
+    ThrowIfFailed(commandList->Close());
+    submitLists.push_back(commandList);
+
+    m_nextCommandList = nullptr;
+    m_submitLists = nullptr;
+}
+
+UINT64 D3D12RenderGraph::TransientMemorySize()const
+{
+    UINT64 size = 0;
+    for (UINT type = 0; type < (UINT)TransientHeapType::Count; type++)
+    {
+        size += m_graph.HeapSize((TransientHeapType)type);
+    }
+    return size;
+}
+
+void D3D12RenderGraph::ReleaseTransients()
+{
+    for (auto& resource : m_transientResources)
+    {
+        if (resource)
+        {
+            m_states->Unregister(resource.Get());
+        }
+    }
+    m_transientResources.clear();
+    for (auto& heap : m_heaps)
+    {
+        heap = nullptr;
+    }
+}
+
+void D3D12RenderGraph::IssueBarriers(const std::vector<RenderGraphBarrier>& barriers, ID3D12GraphicsCommandList* commandList)
+{
+    for (const RenderGraphBarrier& barrier : barriers)
+    {
+        ID3D12Resource* resource = m_d3dResources[barrier.Resource];
+        switch (barrier.Type)
+        {
+        case RenderGraphBarrierType::Aliasing:
+            m_states->AliasingBarrier((barrier.AliasedResource == RenderGraphInvalidIndex) ?
+                nullptr : m_d3dResources[barrier.AliasedResource], resource);
+            break;
+        case RenderGraphBarrierType::Uav:
+            m_states->UavBarrier(resource);
+            break;
+        case RenderGraphBarrierType::Transition:
+            // The tracker knows the actual state of the imported resources and
+            // drops the transitions they do not need.
+            if (barrier.Split == BarrierSplit::Begin)
+            {
+                m_states->BeginTransition(resource, ToResourceStates(barrier.After));
+            }
+            else if (barrier.Split == BarrierSplit::End)
+            {
+                m_states->EndTransition(resource);
+            }
+            else
+            {
+                m_states->Transition(resource, ToResourceStates(barrier.After));
+            }
+            break;
+        }
+    }
+    m_states->Flush(commandList);
+}
+
+ID3D12GraphicsCommandList* D3D12RenderGraph::InsertCommandLists(ID3D12GraphicsCommandList* commandList,
+    ID3D12CommandList* const* commandLists, UINT count)
+{
+    ThrowIfFailed(commandList->Close());
+    m_submitLists->push_back(commandList);
+    m_submitLists->insert(m_submitLists->end(), commandLists, commandLists + count);
+    return (*m_nextCommandList)();
+}
\ No newline at end of file
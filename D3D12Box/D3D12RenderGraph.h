@@ -0,0 +1,89 @@
+#pragma once
+#include "stdafx.h"
+#include "D3DAppUtil.h"
+#include "RenderGraph.h"
+#include "ResourceStateTracker.h"
+
+class D3D12RenderGraph;
+
+// Given to the function of a pass while it records.
+class RenderPassContext
+{
+public:
+    ID3D12GraphicsCommandList* CommandList()const { return m_commandList; }
+    ID3D12Resource* Resource(RenderGraphResource resource)const;
+
+    // Closes the command list of the pass and submits lists right after it,
+    // the rest of the frame goes to a new command list. Lets a pass record
+    // its commands on several threads.
+    void InsertCommandLists(ID3D12CommandList* const* commandLists, UINT count);
+
+private:
+    friend class D3D12RenderGraph;
+
+    RenderPassContext(D3D12RenderGraph* graph, ID3D12GraphicsCommandList* commandList) :
+        m_graph(graph),
+        m_commandList(commandList)
+    {}
+
+    D3D12RenderGraph* m_graph;
+    ID3D12GraphicsCommandList* m_commandList;
+};
+
+// Executes a RenderGraph with D3D12: creates the transient heaps and
+// textures, and records the passes with the barriers the compiler placed.
+// The barriers go through the state tracker, which has to know the imported
+// resources, so the states stay right for the code recording outside the graph.
+class D3D12RenderGraph
+{
+public:
+    typedef std::function<void(RenderPassContext& context)> PassFunction;
+    // Returns a command list ready to record into.
+    typedef std::function<ID3D12GraphicsCommandList*()> CommandListSource;
+
+    D3D12RenderGraph(ID3D12Device* device, ResourceStateTracker* states);
+    D3D12RenderGraph(const D3D12RenderGraph& rhs) = delete;
+    D3D12RenderGraph& operator=(const D3D12RenderGraph& rhs) = delete;
+    ~D3D12RenderGraph();
+
+    // Resources and accesses are declared on the graph.
+    RenderGraph& Graph() { return m_graph; }
+    RenderGraphPass AddPass(const std::string& name, PassFunction function);
+
+    // Compiles the graph, then creates the heaps and the transient textures.
+    void Compile();
+
+    // Resource the imported handle stands for in the next executions.
+    void SetImportedResource(RenderGraphResource resource, ID3D12Resource* d3dResource);
+
+    // Records the passes that were not culled. The command lists to execute
+    // are appended to submitLists in order, closed.
+    void Execute(const CommandListSource& nextCommandList, std::vector<ID3D12CommandList*>& submitLists);
+
+    ID3D12Resource* Resource(RenderGraphResource resource)const { return m_d3dResources[resource]; }
+
+    UINT64 TransientMemorySize()const;
+
+private:
+    friend class RenderPassContext;
+
+    void ReleaseTransients();
+    void IssueBarriers(const std::vector<RenderGraphBarrier>& barriers, ID3D12GraphicsCommandList* commandList);
+    ID3D12GraphicsCommandList* InsertCommandLists(ID3D12GraphicsCommandList* commandList,
+        ID3D12CommandList* const* commandLists, UINT count);
+
+    ID3D12Device* m_device;
+    ResourceStateTracker* m_states;
+    RenderGraph m_graph;
+    std::vector<PassFunction> m_passFunctions;
+
+    ComPtr<ID3D12Heap> m_heaps[(UINT)TransientHeapType::Count];
+    std::vector<ComPtr<ID3D12Resource>> m_transientResources;
+    std::vector<ID3D12Resource*> m_d3dResources;
+
+    // Valid during Execute.
+    const CommandListSource* m_nextCommandList = nullptr;
+    std::vector<ID3D12CommandList*>* m_submitLists = nullptr;
+};
+
+D3D12_RESOURCE_STATES ToResourceStates(ResourceAccess access);
\ No newline at end of file
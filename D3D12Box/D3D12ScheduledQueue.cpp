@@ -0,0 +1,20 @@
+#include "stdafx.h"
+#include "D3D12ScheduledQueue.h"
+#include <cassert>
+
+D3D12ScheduledQueue::D3D12ScheduledQueue(ID3D12CommandQueue* queue, D3D12TimelineFence* fence) :
+    m_queue(queue),
+    m_fence(fence)
+{
+}
+
+void D3D12ScheduledQueue::WaitOn(ITimelineFence* fence, uint64_t value)
+{
+    assert(dynamic_cast<D3D12TimelineFence*>(fence) != nullptr && "Fences of different kinds");
+    static_cast<D3D12TimelineFence*>(fence)->GpuWait(m_queue.Get(), value);
+}
+
+uint64_t D3D12ScheduledQueue::Signal()
+{
+    return m_fence->Signal(m_queue.Get());
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+#include "stdafx.h"
+#include "D3D12TimelineFence.h"
+#include "QueueScheduler.h"
+
+// IScheduledQueue over a command queue and a D3D12TimelineFence it signals.
+// The fences it waits on have to be D3D12TimelineFences too.
+class D3D12ScheduledQueue : public IScheduledQueue
+{
+public:
+    D3D12ScheduledQueue(ID3D12CommandQueue* queue, D3D12TimelineFence* fence);
+
+    virtual ITimelineFence* Fence()override { return m_fence; }
+    virtual void WaitOn(ITimelineFence* fence, uint64_t value)override;
+    virtual uint64_t Signal()override;
+
+    ID3D12CommandQueue* Get()const { return m_queue.Get(); }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_queue;
+    D3D12TimelineFence* m_fence;
+};
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "stdafx.h"
+#include "D3D12TimelineFence.h"
+#include <cassert>
+
+FenceEventPool::~FenceEventPool()
+{
+    for (HANDLE event : m_freeEvents)
+    {
+        CloseHandle(event);
+    }
+}
+
+HANDLE FenceEventPool::Acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_freeEvents.empty())
+        {
+            HANDLE event = m_freeEvents.back();
+            m_freeEvents.pop_back();
+            return event;
+        }
+    }
+
+    HANDLE event = CreateEvent(nullptr, false, false, nullptr);
+    if (event == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+    return event;
+}
+
+void FenceEventPool::Release(HANDLE event)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_freeEvents.push_back(event);
+}
+
+D3D12TimelineFence::D3D12TimelineFence(ID3D12Device* device, FenceEventPool* eventPool, UINT64 initialValue) :
+    m_eventPool(eventPool),
+    m_lastSignaledValue(initialValue)
+{
+    ThrowIfFailed(device->CreateFence(initialValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+}
+
+uint64_t D3D12TimelineFence::CompletedValue()
+{
+    return m_fence->GetCompletedValue();
+}
+
+UINT64 D3D12TimelineFence::Signal(ID3D12CommandQueue* queue)
+{
+    UINT64 value = m_lastSignaledValue.fetch_add(1, std::memory_order_acq_rel) + 1;
+    ThrowIfFailed(queue->Signal(m_fence.Get(), value));
+    return value;
+}
+
+void D3D12TimelineFence::GpuWait(ID3D12CommandQueue* queue, UINT64 value)
+{
+    ThrowIfFailed(queue->Wait(m_fence.Get(), value));
+}
+
+void D3D12TimelineFence::Flush(ID3D12CommandQueue* queue)
+{
+    Wait(Signal(queue), FenceWaitPolicy::Block);
+}
+
+bool D3D12TimelineFence::BlockUntilAny(const FenceValue* values, size_t count, uint32_t timeoutMs)
+{
+    // The event is set by whichever fence reaches its value first. An event
+    // coming back from the pool may still be armed by an older wait that
+    // timed out, the caller checks the fences again after a wake up.
+    HANDLE event = m_eventPool->Acquire();
+    for (size_t i = 0; i < count; i++)
+    {
+        assert(dynamic_cast<D3D12TimelineFence*>(values[i].Fence) != nullptr && "Fences of different kinds");
+        ID3D12Fence* fence = static_cast<D3D12TimelineFence*>(values[i].Fence)->m_fence.Get();
+        ThrowIfFailed(fence->SetEventOnCompletion(values[i].Value, event));
+    }
+    DWORD result = WaitForSingleObject(event, timeoutMs == FenceWaitInfinite ? INFINITE : timeoutMs);
+    m_eventPool->Release(event);
+    return result == WAIT_OBJECT_0;
+}
\ No newline at end of file
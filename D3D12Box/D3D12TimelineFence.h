@@ -0,0 +1,53 @@
+#pragma once
+#include "stdafx.h"
+#include "D3DAppUtil.h"
+#include "TimelineFence.h"
+
+// Cache of auto-reset Win32 events used to block on fences, so waiting does
+// not create and close an event every time. Safe to use from several threads.
+class FenceEventPool
+{
+public:
+    FenceEventPool() = default;
+    FenceEventPool(const FenceEventPool& rhs) = delete;
+    FenceEventPool& operator=(const FenceEventPool& rhs) = delete;
+    ~FenceEventPool();
+
+    HANDLE Acquire();
+    void Release(HANDLE event);
+
+private:
+    std::mutex m_mutex;
+    std::vector<HANDLE> m_freeEvents;
+};
+
+// ITimelineFence over an ID3D12Fence signaled by command queues.
+class D3D12TimelineFence : public ITimelineFence
+{
+public:
+    D3D12TimelineFence(ID3D12Device* device, FenceEventPool* eventPool, UINT64 initialValue = 0);
+    D3D12TimelineFence(const D3D12TimelineFence& rhs) = delete;
+    D3D12TimelineFence& operator=(const D3D12TimelineFence& rhs) = delete;
+
+    virtual uint64_t CompletedValue()override;
+
+    // Schedules the signal of the next value on the queue and returns that value.
+    UINT64 Signal(ID3D12CommandQueue* queue);
+
+    // Makes the queue wait on the GPU until the value is reached, the CPU does not block.
+    void GpuWait(ID3D12CommandQueue* queue, UINT64 value);
+
+    // Signals the next value on the queue and waits for it.
+    void Flush(ID3D12CommandQueue* queue);
+
+    UINT64 LastSignaledValue()const { return m_lastSignaledValue.load(std::memory_order_acquire); }
+    ID3D12Fence* Get()const { return m_fence.Get(); }
+
+protected:
+    virtual bool BlockUntilAny(const FenceValue* values, size_t count, uint32_t timeoutMs)override;
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+    FenceEventPool* m_eventPool;
+    std::atomic<UINT64> m_lastSignaledValue;
+};
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "Win32Application.h"
 #include "UploadBuffer.h"
 #include "GeometryGenerator.h"
+#include "Hash.h"
+#include <algorithm>
+#include <thread>
 using namespace Microsoft::WRL;
 using namespace DirectX;
 D3DAppBase::D3DAppBase(UINT width, UINT height, std::wstring name, UINT frameCount /* = 2 */):
@@ -20,10 +23,13 @@ D3DAppBase::D3DAppBase(UINT width, UINT height, std::wstring name, UINT frameCou
     m_assetsPath = assetsPath;
     m_gameTimer = std::make_unique<GameTimer>();
     m_aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+    // The main thread is a worker too.
+    m_workerThreadCount = (std::max)(1u, std::thread::hardware_concurrency()) - 1;
 }
 
 D3DAppBase::~D3DAppBase()
 {
+    StopSimulationThread();
     m_gameTimer.release();
 }
 
@@ -42,6 +48,132 @@ void D3DAppBase::ParseCommandLineArgs(_In_reads_(argc) WCHAR* argv[], int argc)
             m_useWarpDevice = true;
             m_title = m_title + L"(WAPR)";
         }
+        else if (_wcsnicmp(argv[i], L"-sortbench", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/sortbench", wcslen(argv[i])) == 0)
+        {
+            m_runSortBenchmark = true;
+        }
+        else if (_wcsnicmp(argv[i], L"-direct", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/direct", wcslen(argv[i])) == 0)
+        {
+            m_drawPath = DrawPath::Direct;
+        }
+        else if (_wcsnicmp(argv[i], L"-indirect", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/indirect", wcslen(argv[i])) == 0)
+        {
+            m_drawPath = DrawPath::Indirect;
+        }
+        else if (_wcsnicmp(argv[i], L"-gpucull", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/gpucull", wcslen(argv[i])) == 0)
+        {
+            // Culling on the GPU writes indirect arguments.
+            m_drawPath = DrawPath::Indirect;
+            m_useGpuCulling = true;
+        }
+        else if (_wcsnicmp(argv[i], L"-asynccompute", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/asynccompute", wcslen(argv[i])) == 0)
+        {
+            // Culling is the compute work, it runs on the compute queue.
+            m_drawPath = DrawPath::Indirect;
+            m_useGpuCulling = true;
+            m_useAsyncCompute = true;
+        }
+        else if (_wcsnicmp(argv[i], L"-singlethread", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/singlethread", wcslen(argv[i])) == 0)
+        {
+            m_workerThreadCount = 0;
+        }
+        else if (_wcsnicmp(argv[i], L"-pipelined", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/pipelined", wcslen(argv[i])) == 0)
+        {
+            m_pipelined = true;
+        }
+        else if ((_wcsnicmp(argv[i], L"-framesinflight", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/framesinflight", wcslen(argv[i])) == 0) && i + 1 < argc)
+        {
+            // Number of frame resources, the most frames the pacer lets in flight.
+            m_numberFrameResources = (std::max)(1, _wtoi(argv[++i]));
+        }
+        else if ((_wcsnicmp(argv[i], L"-latency", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/latency", wcslen(argv[i])) == 0) && i + 1 < argc)
+        {
+            // Latency target in milliseconds.
+            m_pacingPolicy = PacingPolicy::Latency;
+            m_latencyTargetMs = _wtof(argv[++i]);
+        }
+        else if ((_wcsnicmp(argv[i], L"-fpscap", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/fpscap", wcslen(argv[i])) == 0) && i + 1 < argc)
+        {
+            double fps = _wtof(argv[++i]);
+            m_frameTimeTargetMs = fps > 0.0 ? 1000.0 / fps : 0.0;
+        }
+        else if (_wcsnicmp(argv[i], L"-blockingwait", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/blockingwait", wcslen(argv[i])) == 0)
+        {
+            // Sleep right away on frame fences instead of spinning first.
+            m_fenceWaitPolicy = FenceWaitPolicy::Block;
+        }
+        else if (_wcsnicmp(argv[i], L"-fixedpacing", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/fixedpacing", wcslen(argv[i])) == 0)
+        {
+            m_adaptivePacing = false;
+        }
+        else if (_wcsnicmp(argv[i], L"-nopsocache", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/nopsocache", wcslen(argv[i])) == 0)
+        {
+            // Compile every pipeline state, neither read nor write the cache file.
+            m_usePipelineStateFile = false;
+        }
+        else if (_wcsnicmp(argv[i], L"-hotreload", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/hotreload", wcslen(argv[i])) == 0)
+        {
+            // Rebuild the pipeline states of the shaders edited while running.
+            // The folder of the executable is watched, not the project: edit
+            // the shaders there, or build the project to copy them over.
+            m_hotReload = true;
+        }
+        else if (_wcsnicmp(argv[i], L"-noalloc", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/noalloc", wcslen(argv[i])) == 0)
+        {
+            // Assert when a frame allocates from the heap once warmed up.
+            m_checkFrameAllocations = true;
+        }
+        else if (_wcsnicmp(argv[i], L"-noshadercache", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/noshadercache", wcslen(argv[i])) == 0)
+        {
+            // Compile every shader, neither read nor write the shader archive.
+            m_useShaderCache = false;
+        }
+        else if (_wcsnicmp(argv[i], L"-bakemeshes", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/bakemeshes", wcslen(argv[i])) == 0)
+        {
+            // Regenerate the shapes and rewrite the mesh file even if it is current.
+            m_bakeMeshes = true;
+        }
+        else if (_wcsnicmp(argv[i], L"-streaming", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/streaming", wcslen(argv[i])) == 0)
+        {
+            // Read the mesh file in the background, the scene draws as the geometry arrives.
+            m_streamMeshes = true;
+        }
+        else if ((_wcsnicmp(argv[i], L"-cpugeometry", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/cpugeometry", wcslen(argv[i])) == 0) && i + 1 < argc)
+        {
+            // What the geometries keep in system memory: none, compressed or mapped.
+            i++;
+            if (_wcsicmp(argv[i], L"none") == 0)
+            {
+                m_geometryResidency = GeometryResidency::None;
+            }
+            else if (_wcsicmp(argv[i], L"compressed") == 0)
+            {
+                m_geometryResidency = GeometryResidency::Compressed;
+            }
+            else if (_wcsicmp(argv[i], L"mapped") == 0)
+            {
+                m_geometryResidency = GeometryResidency::MappedView;
+            }
+        }
     }
 }
 
@@ -86,12 +218,23 @@ void D3DAppBase::CalculateFrameStats()
         float fps = (float)frameCnt;
         float mspf = 1000.0f / fps;
 
-        std::wstring fpsStr = std::to_wstring(fps);
-        std::wstring mspfStr = std::to_wstring(mspf);
+        ScratchScope scratch;
+        std::pmr::wstring windowText(D3DAppBase::m_title.c_str(), scratch.Resource());
+        WCHAR statsText[160];
+        swprintf_s(statsText, L"  fps: %f  mspf: %f", fps, mspf);
+        windowText += statsText;
 
-        std::wstring windowText = D3DAppBase::m_title +
-            L"  fps: " + fpsStr +
-            L"  mspf: " + mspfStr;
+        if (m_framePacer)
+        {
+            FramePacingStats stats = m_framePacer->Stats();
+            swprintf_s(statsText, L"  in flight: %u  cpu wait: %.2f ms  gpu latency: %.2f ms  sleep: %.2f ms",
+                stats.FramesInFlight, stats.CpuWaitMs, stats.GpuLatencyMs, stats.SleepMs);
+            windowText += statsText;
+        }
+
+        swprintf_s(statsText, L"  frame arena: %.1f KB  allocations: %llu",
+            m_frameArenaPeak.load() / 1024.0, (unsigned long long)m_frameAllocations.Count);
+        windowText += statsText;
 
         SetWindowText(Win32Application::GetHwnd(), windowText.c_str());
 
@@ -198,6 +341,12 @@ void D3DAppBase::CreateCommandQueue()
     queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
     queueDesc.Type = m_commandListType;
     ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_commandQueue)));
+
+    if (m_useAsyncCompute)
+    {
+        queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+        ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_computeQueue)));
+    }
 }
 
 void D3DAppBase::CreateCommandAllocator()
@@ -244,11 +393,16 @@ void D3DAppBase::CreateSwapChain()
 }
 void D3DAppBase::CreateFenceObjects()
 {
-    ThrowIfFailed(m_device->CreateFence(m_currentFenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
-    m_fenceEvent = CreateEvent(nullptr, false, false, nullptr);
-    if (m_fenceEvent == nullptr)
+    m_fence = std::make_unique<D3D12TimelineFence>(m_device.Get(), &m_fenceEventPool);
+
+    // Every queue signals its own fence, the scheduler pairs them with waits.
+    m_scheduledGraphicsQueue = std::make_unique<D3D12ScheduledQueue>(m_commandQueue.Get(), m_fence.get());
+    m_graphicsQueueId = m_queueScheduler.AddQueue(m_scheduledGraphicsQueue.get());
+    if (m_useAsyncCompute)
     {
-        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+        m_computeFence = std::make_unique<D3D12TimelineFence>(m_device.Get(), &m_fenceEventPool);
+        m_scheduledComputeQueue = std::make_unique<D3D12ScheduledQueue>(m_computeQueue.Get(), m_computeFence.get());
+        m_computeQueueId = m_queueScheduler.AddQueue(m_scheduledComputeQueue.get());
     }
 }
 
@@ -311,12 +465,14 @@ void D3DAppBase::CreateRtvAndDsvDescriptorHeaps()
     m_device->CreateDepthStencilView(m_depthStencilBuffer.Get(), &dsvDesc, m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
 
     // Transition the resource from its initial state to be used as a depth buffer.
-    m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_depthStencilBuffer.Get(),
-        D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+    m_resourceStates.Register(m_depthStencilBuffer.Get(), D3D12_RESOURCE_STATE_COMMON);
+    m_resourceStates.Transition(m_depthStencilBuffer.Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    m_resourceStates.Flush(m_commandList.Get());
     ThrowIfFailed(m_commandList->Close());
 
     ID3D12CommandList* cmdLists[] = { m_commandList.Get() };
     m_commandQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
+    m_resourceStates.OnCommandListsExecuted();
 
     FlushCommandQueue();
 }
@@ -332,6 +488,7 @@ void D3DAppBase::CreateRenderTargetViews()
     {
         ThrowIfFailed(m_swapChain->GetBuffer(n, IID_PPV_ARGS(&m_renderTargets[n])));
         m_device->CreateRenderTargetView(m_renderTargets[n].Get(), nullptr, rtvHandle);
+        m_resourceStates.Register(m_renderTargets[n].Get(), D3D12_RESOURCE_STATE_PRESENT);
         rtvHandle.Offset(1, m_rtvDescriptorSize);
     }
 }
@@ -339,17 +496,19 @@ void D3DAppBase::CreateRenderTargetViews()
 void D3DAppBase::BuildRootSignature()
 {
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[2] = {};
+    CD3DX12_ROOT_PARAMETER slotRootParameter[4] = {};
 
-    // Create a single descriptor table of CBVs.
-    CD3DX12_DESCRIPTOR_RANGE cbvTable1;
-    cbvTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);
-    slotRootParameter[0].InitAsDescriptorTable(1, &cbvTable1);
+    // Object constants are bound as a root CBV so the command signature can change them.
+    slotRootParameter[0].InitAsConstantBufferView(0);
 
     CD3DX12_DESCRIPTOR_RANGE cbvTable2;
     cbvTable2.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 1);
     slotRootParameter[1].InitAsDescriptorTable(1, &cbvTable2);
 
+    // Instance data for the instanced draws, and the offset of the batch in it.
+    slotRootParameter[2].InitAsShaderResourceView(0);
+    slotRootParameter[3].InitAsConstants(1, 2);
+
     CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(_countof(slotRootParameter),
         slotRootParameter,0,nullptr,
         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
@@ -367,169 +526,337 @@ void D3DAppBase::BuildRootSignature()
         ::OutputDebugStringA((char*)error->GetBufferPointer());
     }
     ThrowIfFailed(m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_rootSignature)));
+    m_pipelineStateCache->RegisterRootSignature(m_rootSignature.Get(), signature->GetBufferPointer(), signature->GetBufferSize());
+}
+
+void D3DAppBase::BuildCullingRootSignature()
+{
+    CD3DX12_ROOT_PARAMETER slotRootParameter[6] = {};
+    slotRootParameter[0].InitAsConstants(1, 0);
+    slotRootParameter[1].InitAsConstantBufferView(1);
+    slotRootParameter[2].InitAsShaderResourceView(0);
+    slotRootParameter[3].InitAsShaderResourceView(1);
+    slotRootParameter[4].InitAsUnorderedAccessView(0);
+    slotRootParameter[5].InitAsUnorderedAccessView(1);
+
+    CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(_countof(slotRootParameter),
+        slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+    ComPtr<ID3DBlob> signature;
+    ComPtr<ID3DBlob> error;
+    ThrowIfFailed(D3D12SerializeRootSignature(
+        &rootSignatureDesc,
+        D3D_ROOT_SIGNATURE_VERSION_1,
+        &signature,
+        &error
+    ));
+    if (error != nullptr)
+    {
+        ::OutputDebugStringA((char*)error->GetBufferPointer());
+    }
+    ThrowIfFailed(m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_cullingRootSignature)));
+    m_pipelineStateCache->RegisterRootSignature(m_cullingRootSignature.Get(), signature->GetBufferPointer(), signature->GetBufferSize());
+}
+
+void D3DAppBase::BuildCommandSignature()
+{
+    // Each indirect command sets the object constant buffer then draws.
+    D3D12_INDIRECT_ARGUMENT_DESC argumentDescs[2] = {};
+    argumentDescs[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW;
+    argumentDescs[0].ConstantBufferView.RootParameterIndex = 0;
+    argumentDescs[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+    D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc = {};
+    commandSignatureDesc.pArgumentDescs = argumentDescs;
+    commandSignatureDesc.NumArgumentDescs = _countof(argumentDescs);
+    commandSignatureDesc.ByteStride = sizeof(IndirectCommand);
+
+    ThrowIfFailed(m_device->CreateCommandSignature(&commandSignatureDesc, m_rootSignature.Get(), IID_PPV_ARGS(&m_commandSignature)));
 }
 
 void D3DAppBase::BuildShader()
 {
 #if defined(_DEBUG)
     // Enable better shader debugging with the graphics debugging tools.
-    UINT compileTags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+    m_shaderCompileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #else
-    UINT compileTags = 0;
+    m_shaderCompileFlags = 0;
 #endif
-    ThrowIfFailed(D3DCompileFromFile(GetAssetsFullPath(L"shader.hlsl").c_str(), nullptr, nullptr, "VS", "vs_5_1", compileTags, 0, &m_shaders["standardVS"], nullptr));
-    ThrowIfFailed(D3DCompileFromFile(GetAssetsFullPath(L"shader.hlsl").c_str(), nullptr, nullptr, "PS", "ps_5_1", compileTags, 0, &m_shaders["opaquePS"], nullptr));
+    // The shaders include PassConstants.hlsli from the assets folder.
+    m_shaderCache = std::make_unique<ShaderCache>(&m_shaderCompiler, &m_shaderFileSystem,
+        m_useShaderCache ? WideToUtf8(GetAssetsFullPath(L"ShaderCache.bin")) : std::string());
+
+    // The shaders are compiled by the jobs that build the pipeline states.
+    if (m_hotReload)
+    {
+        m_shaderWatcher = std::make_unique<FileWatcher>(WideToUtf8(m_assetsPath));
+        std::wstring message = L"Hot reload: watching the shaders in " + m_assetsPath +
+            L", project edits apply once the build copies them there\n";
+        ::OutputDebugString(message.c_str());
+    }
 }
 
-void D3DAppBase::BuildPSO()
+ComPtr<ID3DBlob> D3DAppBase::LoadShader(LPCWSTR fileName, const char* entryPoint, const char* target, UINT compileFlags,
+    ShaderFeature features, std::vector<std::string>* files)
 {
-    // Define the vertex input layout.
-    D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+    ShaderCompileRequest request;
+    request.SourcePath = WideToUtf8(GetAssetsFullPath(fileName));
+    request.EntryPoint = entryPoint;
+    request.Target = target;
+    request.Defines = GetShaderFeatureDefines(features);
+    request.Flags = compileFlags;
+
+    // The source is listed before the compilation, a shader that does not
+    // compile is rebuilt once it is fixed.
+    std::vector<std::string> dependencies;
+    if (files != nullptr)
     {
-        {"POSITION",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
-        {"COLOR",0,DXGI_FORMAT_R32G32B32A32_FLOAT,0,12,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0}
-    };
+        files->push_back(NormalizePath(request.SourcePath));
+    }
+    ShaderBytecode bytecode = m_shaderCache->GetShader(request, files != nullptr ? &dependencies : nullptr);
+    for (const std::string& dependency : dependencies)
+    {
+        files->push_back(NormalizePath(dependency));
+    }
 
-    // Describe and create the graphics pipeline state object (PSO).
-    D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-    psoDesc.InputLayout = { inputElementDescs,_countof(inputElementDescs) };
-    psoDesc.pRootSignature = m_rootSignature.Get();
-    psoDesc.VS = CD3DX12_SHADER_BYTECODE(m_shaders["standardVS"].Get());
-    psoDesc.PS = CD3DX12_SHADER_BYTECODE(m_shaders["opaquePS"].Get());
-    psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-    psoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;// For easily debug.
-    psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-    psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-    psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
-    psoDesc.SampleMask = UINT_MAX;
-    psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-    psoDesc.NumRenderTargets = 1;
-    psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-    psoDesc.SampleDesc.Count = 1;
-    psoDesc.DSVFormat = m_depthBufferFormat;
-    ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineState)));
+    // Copied out, the cache bytecode does not outlive the next Save.
+    ComPtr<ID3DBlob> blob;
+    ThrowIfFailed(D3DCreateBlob(bytecode.Size, &blob));
+    memcpy(blob->GetBufferPointer(), bytecode.Data, bytecode.Size);
+    return blob;
 }
 
-void D3DAppBase::BuildGeometry()
+namespace
 {
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData box = geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3);
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
-    GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-    GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
-
-    // We are concatenating all the geometry into a big vertex/index buffer.
-    // So define the regions in the buffer each submesh covers.
+    // Bump when the generated shapes change, the baked mesh file is rebuilt.
+    const uint32_t ShapeMeshVersion = 1;
 
-    // Cache the vertex offsets to each object in the concatenated vertex buffer.
-    UINT boxVertexOffset = 0;
-    UINT gridVertexOffset = (UINT)box.Vertices.size();
-    UINT sphereVertexOffset = (UINT)grid.Vertices.size() + gridVertexOffset;
-    UINT cylinderVertexOffset = (UINT)sphere.Vertices.size() + sphereVertexOffset;
-
-    // Cache the index offsets for each object in the concatenated index buffer.
-    UINT boxIndexOffset = 0;
-    UINT gridIndexOffset = (UINT)box.Indices32.size();
-    UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-    UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
-
-    // Define the SubmeshGeometry that cover different
-    // regions of the vertex/index buffers.
-
-    SubmeshGeometry boxSubmesh;
-    boxSubmesh.IndexCount = (UINT)box.Indices32.size();
-    boxSubmesh.StartIndexLocation = boxIndexOffset;
-    boxSubmesh.BaseVertexLocation = boxVertexOffset;
+    uint64_t ShapeMeshSourceKey()
+    {
+        Hasher hasher;
+        hasher.AddValue(ShapeMeshVersion);
+        hasher.AddValue((uint32_t)sizeof(Vertex));
+        return hasher.Value();
+    }
 
-    SubmeshGeometry gridSubmesh;
-    gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
-    gridSubmesh.StartIndexLocation = gridIndexOffset;
-    gridSubmesh.BaseVertexLocation = gridVertexOffset;
+    // The shapes concatenated into one vertex/index buffer, as the mesh file stores them.
+    MeshFileData GenerateShapeMeshes()
+    {
+        GeometryGenerator geoGen;
+        GeometryGenerator::MeshData box = geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3);
+        GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
+        GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
+        GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
+
+        const char* names[] = { "box", "grid", "sphere", "cylinder" };
+        const GeometryGenerator::MeshData* meshes[] = { &box, &grid, &sphere, &cylinder };
+
+        MeshFileData data;
+        data.SourceKey = ShapeMeshSourceKey();
+        data.VertexStride = sizeof(Vertex);
+        data.IndexSize = sizeof(std::uint16_t);
+        data.VertexEncoding = MeshVertexEncoding::QuantizedPositionColor;
+        data.IndexEncoding = MeshIndexEncoding::Compressed;
+        static_assert(sizeof(Vertex) == sizeof(PositionColorVertex), "The vertices are quantized as PositionColorVertex");
+
+        // Define the regions in the buffers each submesh covers.
+        UINT vertexOffset = 0;
+        UINT indexOffset = 0;
+        for (size_t i = 0; i < _countof(meshes); i++)
+        {
+            const GeometryGenerator::MeshData& mesh = *meshes[i];
+            BoundingBox bounds;
+            BoundingBox::CreateFromPoints(bounds, mesh.Vertices.size(),
+                &mesh.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+
+            MeshFileData::Submesh submesh;
+            submesh.Name = names[i];
+            memcpy(submesh.Center, &bounds.Center, sizeof(submesh.Center));
+            memcpy(submesh.Extents, &bounds.Extents, sizeof(submesh.Extents));
+            MeshFileLod lod = {};
+            lod.StartIndex = indexOffset;
+            lod.IndexCount = (UINT)mesh.Indices32.size();
+            lod.BaseVertex = (INT)vertexOffset;
+            submesh.Lods.push_back(lod);
+            data.Submeshes.push_back(submesh);
+
+            vertexOffset += (UINT)mesh.Vertices.size();
+            indexOffset += (UINT)mesh.Indices32.size();
+        }
 
-    SubmeshGeometry sphereSubmesh;
-    sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
-    sphereSubmesh.StartIndexLocation = sphereIndexOffset;
-    sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
+        // Extract the vertex elements we are interested in and pack the
+        // vertices of all the meshes into one vertex buffer.
+        std::vector<Vertex> vertices(vertexOffset);
+        UINT k = 0;
+        for (size_t i = 0; i < box.Vertices.size(); i++,k++)
+        {
+            vertices[k].position = box.Vertices[i].Position;
+            vertices[k].color = XMFLOAT4(DirectX::Colors::DarkGreen);
+        }
+        for (size_t i = 0; i < grid.Vertices.size(); i++,k++)
+        {
+            vertices[k].position = grid.Vertices[i].Position;
+            vertices[k].color = XMFLOAT4(DirectX::Colors::ForestGreen);
+        }
+        for (size_t i = 0; i < sphere.Vertices.size(); i++,k++)
+        {
+            vertices[k].position = sphere.Vertices[i].Position;
+            vertices[k].color = XMFLOAT4(DirectX::Colors::SteelBlue);
+        }
 
-    SubmeshGeometry cylinderSubmesh;
-    cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
-    cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
-    cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
+        std::vector<std::uint16_t> indices;
+        for (const GeometryGenerator::MeshData* mesh : meshes)
+        {
+            indices.insert(indices.end(), std::begin(mesh->GetIndices16()), std::end(mesh->GetIndices16()));
+        }
 
-    // Extract the vertex elements we are interested in and pack the 
-    // vertices of all the meshes into one vertex buffer.
+        const uint8_t* vertexBytes = reinterpret_cast<const uint8_t*>(vertices.data());
+        const uint8_t* indexBytes = reinterpret_cast<const uint8_t*>(indices.data());
+        data.Vertices.assign(vertexBytes, vertexBytes + vertices.size() * sizeof(Vertex));
+        data.Indices.assign(indexBytes, indexBytes + indices.size() * sizeof(std::uint16_t));
+        return data;
+    }
+}
 
-    auto totalVertexCount =
-        box.Vertices.size() +
-        grid.Vertices.size() +
-        sphere.Vertices.size() +
-        cylinder.Vertices.size();
+void D3DAppBase::BuildGeometry()
+{
+    // The shapes are baked into a mesh file once, later runs map it and
+    // upload from the mapping without generating anything.
+    const std::string meshPath = WideToUtf8(GetAssetsFullPath(L"Shapes.mesh"));
+    const uint64_t sourceKey = ShapeMeshSourceKey();
 
-    std::vector<Vertex> vertices(totalVertexCount);
-    UINT k = 0;
-    for (size_t i = 0; i < box.Vertices.size(); i++,k++)
-    {
-        vertices[k].position = box.Vertices[i].Position;
-        vertices[k].color = XMFLOAT4(DirectX::Colors::DarkGreen);
-    }
-    for (size_t i = 0; i < grid.Vertices.size(); i++,k++)
+    if (m_streamMeshes)
     {
-        vertices[k].position = grid.Vertices[i].Position;
-        vertices[k].color = XMFLOAT4(DirectX::Colors::ForestGreen);
+        // Only a missing file is baked here, a stale one fails to stream and
+        // is reported. The probe is closed before the file is replaced.
+        bool missing = false;
+        {
+            MappedFile probe;
+            missing = !probe.Open(meshPath);
+        }
+        if (m_bakeMeshes || missing)
+        {
+            std::vector<uint8_t> bakedMeshes = SerializeMeshFile(GenerateShapeMeshes());
+            MappedFile::Write(meshPath, bakedMeshes.data(), bakedMeshes.size());
+        }
+
+        // The placeholder has the submeshes of the file without buffers, the
+        // items are built against it and skipped until the geometry arrives.
+        auto placeholder = std::make_unique<MeshGeometry>();
+        placeholder->name = "shapeGeo";
+        placeholder->UploadFenceValue = MeshStreamer::NotLoaded;
+        // Conservative bounds until the file is read, the grid is the largest.
+        const BoundingBox shapeBounds(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(10.0f, 1.5f, 15.0f));
+        for (StringId submeshName : { "box"_id, "grid"_id, "sphere"_id, "cylinder"_id })
+        {
+            SubmeshGeometry submesh;
+            submesh.Id = m_nextMeshId++;
+            submesh.Bounds = shapeBounds;
+            placeholder->DrawArgs[submeshName] = submesh;
+        }
+        m_meshStreamer->Request(meshPath, sourceKey, m_geometryResidency, placeholder.get(), shapeBounds);
+        m_geometries[InternString(placeholder->name)] = std::move(placeholder);
+        return;
     }
-    for (size_t i = 0; i < sphere.Vertices.size(); i++,k++)
+
+    auto meshFile = std::make_shared<MeshFile>();
+    std::vector<uint8_t> bakedMeshes;
+    if (m_bakeMeshes || !meshFile->Open(meshPath, sourceKey))
     {
-        vertices[k].position = sphere.Vertices[i].Position;
-        vertices[k].color = XMFLOAT4(DirectX::Colors::SteelBlue);
+        bakedMeshes = SerializeMeshFile(GenerateShapeMeshes());
+        if (!MappedFile::Write(meshPath, bakedMeshes.data(), bakedMeshes.size()) ||
+            !meshFile->Open(meshPath, sourceKey))
+        {
+            // The assets folder may be read-only, use the baked bytes as they are.
+            if (!meshFile->Load(bakedMeshes.data(), bakedMeshes.size(), sourceKey))
+            {
+                assert(false && "Baked mesh file does not validate");
+            }
+        }
     }
 
-    std::vector<std::uint16_t> indices;
-    indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-    indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-    indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-    indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
-
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
-
-    m_geometry = std::make_unique<MeshGeometry>();
+    // The uploader decodes into its staging buffers before returning, the
+    // mapping is only kept for a MappedView CPU copy. Baked bytes held in
+    // memory cannot be viewed, they go when this returns.
+    std::shared_ptr<const MeshFile> mapping = meshFile->IsMapped() ? meshFile : nullptr;
+    m_geometry = CreateMeshGeometry(m_copyUploader.get(), *meshFile, m_geometryResidency, mapping);
     m_geometry->name = "shapeGeo";
-    ThrowIfFailed(D3DCreateBlob(vbByteSize, &m_geometry->VertexBufferCPU));
-    CopyMemory(m_geometry->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-    ThrowIfFailed(D3DCreateBlob(ibByteSize, &m_geometry->IndexBufferCPU));
-    CopyMemory(m_geometry->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-    m_geometry->VertexBufferGPU = CreateDefaultBuffer(m_device.Get(), 
-        m_commandList.Get(), vertices.data(), vbByteSize
-        , m_geometry->VertexBufferUploader);
+    for (auto& entry : m_geometry->DrawArgs)
+    {
+        entry.second.Id = m_nextMeshId++;
+    }
 
-    m_geometry->IndexBufferGPU = CreateDefaultBuffer(m_device.Get(),
-        m_commandList.Get(), indices.data(), ibByteSize, m_geometry->IndexBufferUploader);
+    m_geometries[InternString(m_geometry->name)] = std::move(m_geometry);
+    ReportGeometryResidency();
+}
 
-    m_geometry->VertexByteStride = sizeof(Vertex);
-    m_geometry->VertexBufferByteSize = vbByteSize;
+void D3DAppBase::InstallStreamedMeshes()
+{
+    m_meshStreamer->Update(m_eyePos, m_streamedMeshes);
+    for (MeshStreamer::LoadedMesh& mesh : m_streamedMeshes)
+    {
+        MeshGeometry* placeholder = mesh.Placeholder;
+        if (mesh.Geometry == nullptr)
+        {
+            char message[256];
+            sprintf_s(message, "%s failed to stream, its items are not drawn. Run with -bakemeshes to rebake it.\n",
+                placeholder->name.c_str());
+            ::OutputDebugStringA(message);
+            continue;
+        }
 
-    m_geometry->IndexFormat = DXGI_FORMAT_R16_UINT;
-    m_geometry->IndexBufferByteSize = ibByteSize;
+        // The items and the draw packets keep the mesh Ids of the placeholder.
+        for (auto& entry : mesh.Geometry->DrawArgs)
+        {
+            const SubmeshGeometry* previous = placeholder->DrawArgs.Find(entry.first);
+            entry.second.Id = (previous != nullptr) ? previous->Id : m_nextMeshId++;
+        }
+        // Items are not drawn before the copy fence reaches UploadFenceValue,
+        // the render thread has not touched the placeholder.
+        *placeholder = std::move(*mesh.Geometry);
 
-    m_geometry->DrawArgs["box"] = boxSubmesh;
-    m_geometry->DrawArgs["grid"] = gridSubmesh;
-    m_geometry->DrawArgs["sphere"] = sphereSubmesh;
-    m_geometry->DrawArgs["cylinder"] = cylinderSubmesh;
+        for (RenderItem* ri : m_opaqueItems)
+        {
+            if (ri->Geo != placeholder)
+            {
+                continue;
+            }
+            const SubmeshGeometry& submesh = placeholder->DrawArgs.At(ri->Submesh);
+            ri->IndexCount = submesh.IndexCount;
+            ri->StartIndexLocation = submesh.StartIndexLocation;
+            ri->BaseVertexLocation = submesh.BaseVertexLocation;
+            ri->MeshId = submesh.Id;
+            submesh.Bounds.Transform(ri->Bounds, ri->World);
+            ri->NumFramesDirty = m_numberFrameResources;
+        }
+        ReportGeometryResidency();
+    }
+}
 
-    m_geometries[m_geometry->name] = std::move(m_geometry);
+void D3DAppBase::ReportGeometryResidency()const
+{
+    size_t totalResident = 0;
+    size_t totalSource = 0;
+    char message[256];
+    for (const auto& entry : m_geometries)
+    {
+        const GeometryCpuCopy& cpuCopy = entry.second->CpuCopy;
+        totalResident += cpuCopy.ResidentBytes();
+        totalSource += cpuCopy.SourceBytes();
+        sprintf_s(message, "%s CPU copy: %s, %.1f KB of %.1f KB resident\n", entry.second->name.c_str(),
+            GeometryResidencyName(cpuCopy.Residency()), cpuCopy.ResidentBytes() / 1024.0, cpuCopy.SourceBytes() / 1024.0);
+        ::OutputDebugStringA(message);
+    }
+    sprintf_s(message, "Geometry CPU copies save %.1f KB of system memory\n", (totalSource - totalResident) / 1024.0);
+    ::OutputDebugStringA(message);
 }
 
 void D3DAppBase::BuildConstantDescriptorHeaps()
 {
-    UINT objCount = (UINT)m_opaqueItems.size();
-    // Need a CBV descriptor for each object for each frame resource.
-    // +1 for the perPass CBV for each frame resource.
-    UINT numDescriptors = (objCount + 1) * m_numberFrameResources;
-
-    // Save an offset to the start of the pass CBVs. There are the last 3 descriptors.
-    m_passCbvOffset = objCount * m_numberFrameResources;
+    // Object constants are bound as root CBVs, only the perPass CBV
+    // of each frame resource needs a descriptor.
+    UINT numDescriptors = m_numberFrameResources;
+    m_passCbvOffset = 0;
 
     D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc;
     cbvHeapDesc.NumDescriptors = numDescriptors;
@@ -541,35 +868,9 @@ void D3DAppBase::BuildConstantDescriptorHeaps()
 
 void D3DAppBase::BuildConstantBufferViews()
 {
-    UINT objectConstantBufferSize = CalculateConstantBufferByteSize(sizeof(ObjectConstants));
-    UINT objCount = (UINT)m_opaqueItems.size();
-
-    // Need a CBV descriptor for each object for each frame resource.
-    for (unsigned int frameIndex = 0; frameIndex < m_numberFrameResources; ++frameIndex)
-    {
-        ComPtr<ID3D12Resource> objectCB = m_frameResources[frameIndex]->m_objectConstantBuffer->Resource();
-        for (unsigned int i=0;i<objCount;++i)
-        {
-            D3D12_GPU_VIRTUAL_ADDRESS cbAddress = objectCB->GetGPUVirtualAddress();
-
-            // Offset to the ith object constant buffer in the buffer.
-            cbAddress += i * objectConstantBufferSize;
-
-            // Offset to the object cbv in the descriptor heap.
-            int heapIndex = frameIndex * objCount + i;
-            auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_cbvHeap->GetCPUDescriptorHandleForHeapStart());
-            handle.Offset(heapIndex, m_cbvSrvUavDescriptorSize);
-
-            D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
-            cbvDesc.BufferLocation = cbAddress;
-            cbvDesc.SizeInBytes = objectConstantBufferSize;
-            m_device->CreateConstantBufferView(&cbvDesc, handle);
-        }
-    }
-
     UINT passCBByteSize = CalculateConstantBufferByteSize(sizeof(PassConstants));
 
-    // Last three descriptors are the pass CBVs for each frame resource.
+    // One pass CBV for each frame resource.
     for (unsigned int frameIndex = 0; frameIndex < m_numberFrameResources; frameIndex++)
     {
         ComPtr<ID3D12Resource> passCB = m_frameResources[frameIndex]->m_passConstantBuffer->Resource();
@@ -595,16 +896,34 @@ void D3DAppBase::BuildPSOs()
         {"POSITION",0,DXGI_FORMAT_R32G32B32_FLOAT,0,0,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0},
         {"COLOR",0,DXGI_FORMAT_R32G32B32A32_FLOAT,0,12,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0}
     };
-    D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueDesc;
 
-    // PSO for opaque objects.
+    // Opaque permutations. The ones the last run used are built right away,
+    // the others when a render item first needs them.
+    m_opaquePermutations = std::make_unique<PermutationCache<ID3D12PipelineState>>(m_jobSystem.get(),
+        [this](ShaderFeature features, std::vector<std::string>& files) { return BuildOpaquePipelineState(features, files); },
+        &m_rootSignaturesBuilt);
+    if (m_usePipelineStateFile)
+    {
+        m_opaquePermutations->Prewarm(LoadShaderPermutationList(WideToUtf8(GetAssetsFullPath(L"ShaderPermutations.txt"))));
+    }
+
+    // PSO for the culling pass.
+    m_cullingPermutations = std::make_unique<PermutationCache<ID3D12PipelineState>>(m_jobSystem.get(),
+        [this](ShaderFeature, std::vector<std::string>& files) { return BuildCullingPipelineState(files); },
+        &m_rootSignaturesBuilt);
+    if (m_useGpuCulling)
+    {
+        m_cullingPermutations->Prewarm({ ShaderFeature::None });
+    }
+}
+
+D3D12_GRAPHICS_PIPELINE_STATE_DESC D3DAppBase::GetOpaquePipelineStateDesc()const
+{
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueDesc;
     ZeroMemory(&opaqueDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
     opaqueDesc.InputLayout = { m_inputLayout.data(),(UINT)m_inputLayout.size() };
     opaqueDesc.pRootSignature = m_rootSignature.Get();
-    opaqueDesc.VS = CD3DX12_SHADER_BYTECODE(m_shaders["standardVS"].Get());
-    opaqueDesc.PS = CD3DX12_SHADER_BYTECODE(m_shaders["opaquePS"].Get());
     opaqueDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-    opaqueDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
     opaqueDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
     opaqueDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
     opaqueDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
@@ -615,89 +934,505 @@ void D3DAppBase::BuildPSOs()
     opaqueDesc.SampleDesc.Count = m_4xMsaaState ? 4 : 1;
     opaqueDesc.SampleDesc.Quality = m_4xMsaaState ? (m_4xMsaaQuality - 1) : 0;
     opaqueDesc.DSVFormat = m_depthBufferFormat;
-    ThrowIfFailed(m_device->CreateGraphicsPipelineState(&opaqueDesc, IID_PPV_ARGS(&m_pipelineStateObjects["opaque"])));
+    return opaqueDesc;
+}
 
-    // PSO for opaque wireframe objects.
-    D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueWireframePsoDesc = opaqueDesc;
-    opaqueWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
-    ThrowIfFailed(m_device->CreateGraphicsPipelineState(&opaqueWireframePsoDesc, IID_PPV_ARGS(&m_pipelineStateObjects["opaque_wireframe"])));
+ID3D12PipelineState* D3DAppBase::BuildOpaquePipelineState(ShaderFeature features, std::vector<std::string>& files)
+{
+    // Each stage only gets the defines it reads, permutations that differ in
+    // the other stage share its bytecode.
+    ComPtr<ID3DBlob> vertexShader = LoadShader(L"shader.hlsl", "VS", "vs_5_1", m_shaderCompileFlags,
+        features & ShaderFeature::Instancing, &files);
+    ComPtr<ID3DBlob> pixelShader = LoadShader(L"shader.hlsl", "PS", "ps_5_1", m_shaderCompileFlags,
+        features & ShaderFeature::AlphaTest, &files);
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueDesc = GetOpaquePipelineStateDesc();
+    opaqueDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
+    opaqueDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
+    if (HasFeature(features, ShaderFeature::Wireframe))
+    {
+        opaqueDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+    }
+    return m_pipelineStateCache->GetGraphicsPipelineState(opaqueDesc);
+}
+
+ID3D12PipelineState* D3DAppBase::BuildCullingPipelineState(std::vector<std::string>& files)
+{
+    ComPtr<ID3DBlob> computeShader = LoadShader(L"cull.hlsl", "CS", "cs_5_1", m_shaderCompileFlags,
+        ShaderFeature::None, &files);
+    D3D12_COMPUTE_PIPELINE_STATE_DESC cullingDesc = {};
+    cullingDesc.pRootSignature = m_cullingRootSignature.Get();
+    cullingDesc.CS = CD3DX12_SHADER_BYTECODE(computeShader.Get());
+    return m_pipelineStateCache->GetComputePipelineState(cullingDesc);
+}
+
+void D3DAppBase::StartAssetBuild()
+{
+    m_assetBuildPending = true;
+    m_jobSystem->Run([this]() { BuildRootSignature(); }, &m_rootSignaturesBuilt);
+    m_jobSystem->Run([this]() { BuildCullingRootSignature(); }, &m_rootSignaturesBuilt);
+    BuildShader();
+    BuildPSOs();
+}
+
+void D3DAppBase::UpdatePipelineStates()
+{
+    if (m_shaderWatcher != nullptr)
+    {
+        for (const std::string& file : m_shaderWatcher->TakeChangedFiles())
+        {
+            UINT rebuildCount = m_opaquePermutations->RebuildUsing(file) + m_cullingPermutations->RebuildUsing(file);
+            if (rebuildCount > 0)
+            {
+                char message[512];
+                sprintf_s(message, "%s changed, rebuilding %u pipeline states\n", file.c_str(), rebuildCount);
+                ::OutputDebugStringA(message);
+            }
+        }
+    }
+
+    // Only the variant of the draw path is requested, the other one is never
+    // built. The snapshots copy the tables, the render thread keeps using
+    // the pipeline states its frame was built with.
+    for (UINT i = 0; i < (UINT)m_pipelineStateFeatures.size(); i++)
+    {
+        if (m_drawPath == DrawPath::Instanced)
+        {
+            m_instancedPipelineStateTable[i] = RequestPipelineState(*m_opaquePermutations, m_pipelineStateFeatures[i] | ShaderFeature::Instancing);
+        }
+        else
+        {
+            m_pipelineStateTable[i] = RequestPipelineState(*m_opaquePermutations, m_pipelineStateFeatures[i]);
+        }
+    }
+    if (m_useGpuCulling)
+    {
+        m_cullingPipelineState = RequestPipelineState(*m_cullingPermutations, ShaderFeature::None);
+    }
+
+    // The caches are saved when the builds in flight are done, a permutation
+    // requested or rebuilt later saves them again.
+    if (m_opaquePermutations->IsBuilding() || m_cullingPermutations->IsBuilding())
+    {
+        m_assetBuildPending = true;
+    }
+    else if (m_assetBuildPending)
+    {
+        m_assetBuildPending = false;
+        SaveAssetCaches();
+    }
+}
+
+ID3D12PipelineState* D3DAppBase::RequestPipelineState(PermutationCache<ID3D12PipelineState>& permutations, ShaderFeature features)
+{
+    if (!m_hotReload)
+    {
+        return permutations.Request(features);
+    }
+    try
+    {
+        return permutations.Request(features);
+    }
+    catch (const std::exception& e)
+    {
+        // A shader being edited may not compile, the last pipeline state
+        // that did is kept until the next change.
+        ::OutputDebugStringA(e.what());
+        ::OutputDebugStringA("\n");
+        return permutations.Request(features);
+    }
+}
+
+bool D3DAppBase::IsPipelineStateReady(UINT pipelineStateIndex)const
+{
+    if (m_drawPath == DrawPath::Instanced)
+    {
+        return m_instancedPipelineStateTable[pipelineStateIndex] != nullptr;
+    }
+    return m_pipelineStateTable[pipelineStateIndex] != nullptr;
+}
+
+void D3DAppBase::FinishAssetBuild()
+{
+    if (m_opaquePermutations == nullptr)
+    {
+        // The initialization did not get as far as the builds.
+        return;
+    }
+    m_shaderWatcher.reset();
+
+    // Every build is waited for before a failure is reported, no job may
+    // outlive the caches. With hot reload the failures were reported already.
+    std::exception_ptr failure;
+    for (PermutationCache<ID3D12PipelineState>* permutations : { m_opaquePermutations.get(), m_cullingPermutations.get() })
+    {
+        try
+        {
+            permutations->WaitAll();
+        }
+        catch (...)
+        {
+            if (!failure)
+            {
+                failure = std::current_exception();
+            }
+        }
+    }
+    if (failure && !m_hotReload)
+    {
+        std::rethrow_exception(failure);
+    }
+    SaveAssetCaches();
+}
+
+void D3DAppBase::SaveAssetCaches()
+{
+    // Keep what was compiled for the next launch.
+    m_shaderCache->Save();
+    m_pipelineStateCache->Save();
+
+    // The next run prewarms what this one drew.
+    std::vector<ShaderFeature> requested = m_opaquePermutations->RequestedPermutations();
+    if (m_usePipelineStateFile && !requested.empty())
+    {
+        SaveShaderPermutationList(WideToUtf8(GetAssetsFullPath(L"ShaderPermutations.txt")), requested);
+    }
+
+    WCHAR message[128];
+    swprintf_s(message, L"Pipeline states: %u compiled, %u loaded from the cache, %u duplicates\n",
+        m_pipelineStateCache->CompiledCount(), m_pipelineStateCache->LoadedCount(), m_pipelineStateCache->DuplicateCount());
+    ::OutputDebugString(message);
+}
+
+void D3DAppBase::CheckFrameAllocations(const AllocationStats& renderThreadAllocations)
+{
+    AllocationStats total = GlobalAllocationStats();
+    m_frameAllocations = total - m_frameAllocationStart;
+    m_frameAllocationStart = total;
+
+    // Pipeline state builds and cache saves allocate, and so do the first
+    // frames while the containers and arenas grow. Edited shaders rebuild
+    // at any time, streamed geometry arrives at any time.
+    if (m_hotReload || m_opaquePermutations->IsBuilding() || m_cullingPermutations->IsBuilding() ||
+        (m_meshStreamer != nullptr && m_meshStreamer->PendingCount() > 0))
+    {
+        m_steadyFrameCount = 0;
+        return;
+    }
+    m_steadyFrameCount++;
+    if (!m_checkFrameAllocations || m_steadyFrameCount <= m_allocationWarmupFrames || m_frameAllocations.Count == 0)
+    {
+        return;
+    }
+
+    char message[256];
+    sprintf_s(message, "Frame %llu allocated %llu times (%llu bytes), %llu times on the render thread\n",
+        (unsigned long long)m_renderSnapshot->FrameNumber, (unsigned long long)m_frameAllocations.Count,
+        (unsigned long long)m_frameAllocations.Bytes, (unsigned long long)renderThreadAllocations.Count);
+    ::OutputDebugStringA(message);
+    assert(false && "Heap allocation on the steady state frame path");
+}
+
+UINT D3DAppBase::GetPipelineStateIndex(ShaderFeature features)
+{
+    auto it = m_pipelineStateIndices.find((uint32_t)features);
+    if (it != m_pipelineStateIndices.end())
+    {
+        return it->second;
+    }
+
+    // UpdatePipelineStates requests the permutation and fills the entries once it is built.
+    UINT index = (UINT)m_pipelineStateTable.size();
+    m_pipelineStateTable.push_back(nullptr);
+    m_instancedPipelineStateTable.push_back(nullptr);
+    m_pipelineStateFeatures.push_back(features);
+    m_pipelineStateIndices[(uint32_t)features] = index;
+    return index;
 }
 
 void D3DAppBase::BuildRenderItems()
 {
     unsigned int constantBufferIndex = 0;
     const D3D12_PRIMITIVE_TOPOLOGY primitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+    // Drawn in wireframe for easy debugging.
+    const UINT opaquePipelineStateIndex = GetPipelineStateIndex(ShaderFeature::Wireframe);
+
+    MeshGeometry* shapeGeo = m_geometries.At("shapeGeo"_id).get();
+    const SubmeshGeometry& boxSubmesh = shapeGeo->DrawArgs.At("box"_id);
+    const SubmeshGeometry& gridSubmesh = shapeGeo->DrawArgs.At("grid"_id);
+    const SubmeshGeometry& cylinderSubmesh = shapeGeo->DrawArgs.At("cylinder"_id);
+    const SubmeshGeometry& sphereSubmesh = shapeGeo->DrawArgs.At("sphere"_id);
 
     std::unique_ptr<RenderItem> boxRenderItem = std::make_unique<RenderItem>();
     boxRenderItem->World = XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(0.0f, 0.5f, 0.0f);
     boxRenderItem->ObjectConstantBufferIndex = constantBufferIndex;// First item in constant buffer.
     constantBufferIndex++;
-    boxRenderItem->Geo = m_geometries["shapeGeo"].get();
+    boxRenderItem->Geo = shapeGeo;
+    boxRenderItem->Submesh = "box"_id;
     boxRenderItem->PrimitiveType = primitiveType;
-    boxRenderItem->IndexCount = m_geometries["shapeGeo"]->DrawArgs["box"].IndexCount;
-    boxRenderItem->StartIndexLocation = m_geometries["shapeGeo"]->DrawArgs["box"].StartIndexLocation;
-    boxRenderItem->BaseVertexLocation = m_geometries["shapeGeo"]->DrawArgs["box"].BaseVertexLocation;
+    boxRenderItem->IndexCount = boxSubmesh.IndexCount;
+    boxRenderItem->StartIndexLocation = boxSubmesh.StartIndexLocation;
+    boxRenderItem->BaseVertexLocation = boxSubmesh.BaseVertexLocation;
+    boxRenderItem->PipelineStateIndex = opaquePipelineStateIndex;
+    boxRenderItem->MeshId = boxSubmesh.Id;
+    boxSubmesh.Bounds.Transform(boxRenderItem->Bounds, boxRenderItem->World);
     m_allItems.push_back(std::move(boxRenderItem));
 
     std::unique_ptr<RenderItem> gridRenderItem = std::make_unique<RenderItem>();
     gridRenderItem->World = XMMatrixIdentity();
     gridRenderItem->ObjectConstantBufferIndex = constantBufferIndex++;
-    gridRenderItem->Geo = m_geometries["shapeGeo"].get();
+    gridRenderItem->Geo = shapeGeo;
+    gridRenderItem->Submesh = "grid"_id;
     gridRenderItem->PrimitiveType = primitiveType;
-    gridRenderItem->IndexCount = gridRenderItem->Geo->DrawArgs["grid"].IndexCount;
-    gridRenderItem->StartIndexLocation = gridRenderItem->Geo->DrawArgs["grid"].StartIndexLocation;
-    gridRenderItem->BaseVertexLocation = gridRenderItem->Geo->DrawArgs["grid"].BaseVertexLocation;
+    gridRenderItem->IndexCount = gridSubmesh.IndexCount;
+    gridRenderItem->StartIndexLocation = gridSubmesh.StartIndexLocation;
+    gridRenderItem->BaseVertexLocation = gridSubmesh.BaseVertexLocation;
+    gridRenderItem->PipelineStateIndex = opaquePipelineStateIndex;
+    gridRenderItem->MeshId = gridSubmesh.Id;
+    gridSubmesh.Bounds.Transform(gridRenderItem->Bounds, gridRenderItem->World);
     m_allItems.push_back(std::move(gridRenderItem));
 
     std::unique_ptr<RenderItem> cylinderItem = std::make_unique<RenderItem>();
     cylinderItem->World = XMMatrixTranslation(-5.0f, 1.5f, -10.0f);
     cylinderItem->ObjectConstantBufferIndex = constantBufferIndex++;
-    cylinderItem->Geo = m_geometries["shapeGeo"].get();
+    cylinderItem->Geo = shapeGeo;
+    cylinderItem->Submesh = "cylinder"_id;
     cylinderItem->PrimitiveType = primitiveType;
-    cylinderItem->IndexCount = cylinderItem->Geo->DrawArgs["cylinder"].IndexCount;
-    cylinderItem->StartIndexLocation = cylinderItem->Geo->DrawArgs["cylinder"].StartIndexLocation;
-    cylinderItem->BaseVertexLocation = cylinderItem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+    cylinderItem->IndexCount = cylinderSubmesh.IndexCount;
+    cylinderItem->StartIndexLocation = cylinderSubmesh.StartIndexLocation;
+    cylinderItem->BaseVertexLocation = cylinderSubmesh.BaseVertexLocation;
+    cylinderItem->PipelineStateIndex = opaquePipelineStateIndex;
+    cylinderItem->MeshId = cylinderSubmesh.Id;
+    cylinderSubmesh.Bounds.Transform(cylinderItem->Bounds, cylinderItem->World);
     m_allItems.push_back(std::move(cylinderItem));
 
     std::unique_ptr<RenderItem> sphereItem = std::make_unique<RenderItem>();
     sphereItem->World = XMMatrixTranslation(-5.0f, 3.5f, -10.0f);
     sphereItem->ObjectConstantBufferIndex = constantBufferIndex++;
     sphereItem->PrimitiveType = primitiveType;
-    sphereItem->Geo = m_geometries["shapeGeo"].get();
-    sphereItem->IndexCount = sphereItem->Geo->DrawArgs["sphere"].IndexCount;
-    sphereItem->StartIndexLocation = sphereItem->Geo->DrawArgs["sphere"].StartIndexLocation;
-    sphereItem->BaseVertexLocation = sphereItem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+    sphereItem->Geo = shapeGeo;
+    sphereItem->Submesh = "sphere"_id;
+    sphereItem->IndexCount = sphereSubmesh.IndexCount;
+    sphereItem->StartIndexLocation = sphereSubmesh.StartIndexLocation;
+    sphereItem->BaseVertexLocation = sphereSubmesh.BaseVertexLocation;
+    sphereItem->PipelineStateIndex = opaquePipelineStateIndex;
+    sphereItem->MeshId = sphereSubmesh.Id;
+    sphereSubmesh.Bounds.Transform(sphereItem->Bounds, sphereItem->World);
     m_allItems.push_back(std::move(sphereItem));
 
     for (auto& e:m_allItems)
     {
+        // Every frame resource needs the object constants, -framesinflight sets how many there are.
+        e->NumFramesDirty = m_numberFrameResources;
         m_opaqueItems.push_back(e.get());
     }
 }
 
-void D3DAppBase::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& renderItems)
+void D3DAppBase::BuildDrawPackets(JobCounter* passConstantsReady)
+{
+    // Geometry still being copied is not drawn this frame.
+    m_uploadFenceCompleted = m_copyUploader->CompletedValue();
+
+    // Nothing is drawn before the culling pipeline state exists.
+    if (m_useGpuCulling && m_cullingPipelineState == nullptr)
+    {
+        m_drawPackets.clear();
+        return;
+    }
+
+    // Culling needs the frustum planes of the pass constants. Every item
+    // gets a packet slot, culled items leave a null Item.
+    m_drawPackets.resize(m_opaqueItems.size());
+    JobCounter packetsBuilt;
+    JobSystem::RangeFunction buildPackets = [this](UINT begin, UINT end)
+    {
+        BuildDrawPacketRange(begin, end);
+    };
+    m_jobSystem->ParallelFor((UINT)m_opaqueItems.size(), m_itemsPerJob, buildPackets, &packetsBuilt, passConstantsReady);
+    m_jobSystem->Wait(&packetsBuilt);
+
+    m_drawPackets.erase(
+        std::remove_if(m_drawPackets.begin(), m_drawPackets.end(), [](const DrawPacket& packet) { return packet.Item == nullptr; }),
+        m_drawPackets.end());
+    RadixSortDrawPackets(m_drawPackets, m_drawPacketScratch);
+}
+
+void D3DAppBase::BuildDrawPacketRange(UINT begin, UINT end)
+{
+    for (UINT i = begin; i < end; i++)
+    {
+        RenderItem* ri = m_opaqueItems[i];
+        DrawPacket& packet = m_drawPackets[i];
+        packet.Item = nullptr;
+
+        if (ri->Geo->UploadFenceValue > m_uploadFenceCompleted)
+        {
+            continue;
+        }
+
+        // Neither is an item whose pipeline state is still being built.
+        if (!IsPipelineStateReady(ri->PipelineStateIndex))
+        {
+            continue;
+        }
+
+        // With GPU culling every item is submitted and the culling pass rejects them.
+        if (!m_useGpuCulling &&
+            !IsInsideFrustum(m_mainPassCB.FrustumPlanes, ri->Bounds.Center, ri->Bounds.Extents))
+        {
+            continue;
+        }
+
+        // Depth of the object origin in view space.
+        XMVECTOR originV = XMVector3TransformCoord(ri->World.r[3], m_view);
+
+        packet.SortKey = BuildSortKey(ri->Layer, ri->PipelineStateIndex, ri->MeshId, XMVectorGetZ(originV));
+        packet.Item = ri;
+    }
+}
+
+void D3DAppBase::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<DrawPacket>& drawPackets, UINT begin, UINT end)
 {
     UINT objectCBByteSize = CalculateConstantBufferByteSize(sizeof(ObjectConstants));
+    D3D12_GPU_VIRTUAL_ADDRESS objectCBAddress = m_renderSnapshot->Resource->m_objectConstantBuffer->Resource()->GetGPUVirtualAddress();
 
-    ID3D12Resource* objectCB = m_currentFrameResource->m_objectConstantBuffer->Resource();
+    // The packets are sorted by state, only issue the state that changes between draws.
+    ID3D12PipelineState* currentPipelineState = nullptr;
+    MeshGeometry* currentGeo = nullptr;
+    D3D12_PRIMITIVE_TOPOLOGY currentPrimitiveType = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
 
     // For each render item...
-    for (unsigned int i = 0; i < renderItems.size(); i++)
+    for (UINT i = begin; i < end; i++)
     {
-        auto ri = renderItems[i];
+        auto ri = drawPackets[i].Item;
+        ID3D12PipelineState* pipelineState = m_renderSnapshot->PipelineStates[ri->PipelineStateIndex];
+        if (pipelineState != currentPipelineState)
+        {
+            cmdList->SetPipelineState(pipelineState);
+            currentPipelineState = pipelineState;
+        }
+        if (ri->Geo != currentGeo)
+        {
+            cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+            cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+            currentGeo = ri->Geo;
+        }
+        if (ri->PrimitiveType != currentPrimitiveType)
+        {
+            cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+            currentPrimitiveType = ri->PrimitiveType;
+        }
+
+        // Offset to the constants of this object in the buffer of this frame resource.
+        cmdList->SetGraphicsRootConstantBufferView(0, objectCBAddress + (UINT64)ri->ObjectConstantBufferIndex * objectCBByteSize);
+
+        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+    }
+}
+
+void D3DAppBase::DrawInstanceBatches(ID3D12GraphicsCommandList* cmdList, const std::vector<InstanceBatch>& batches, UINT begin, UINT end)
+{
+    ID3D12PipelineState* currentPipelineState = nullptr;
+    MeshGeometry* currentGeo = nullptr;
+    D3D12_PRIMITIVE_TOPOLOGY currentPrimitiveType = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
+    cmdList->SetGraphicsRootShaderResourceView(2,
+        m_renderSnapshot->Resource->m_instanceBuffer->Resource()->GetGPUVirtualAddress());
+
+    for (UINT i = begin; i < end; i++)
+    {
+        const InstanceBatch& batch = batches[i];
+        auto ri = batch.Item;
+        ID3D12PipelineState* pipelineState = m_renderSnapshot->InstancedPipelineStates[batch.PipelineStateIndex];
+        assert(pipelineState != nullptr && "Pipeline state has no instanced variant");
+        if (pipelineState != currentPipelineState)
+        {
+            cmdList->SetPipelineState(pipelineState);
+            currentPipelineState = pipelineState;
+        }
+        if (ri->Geo != currentGeo)
+        {
+            cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+            cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+            currentGeo = ri->Geo;
+        }
+        if (ri->PrimitiveType != currentPrimitiveType)
+        {
+            cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+            currentPrimitiveType = ri->PrimitiveType;
+        }
+
+        // SV_InstanceID restarts from zero for every draw, pass the offset of the batch.
+        cmdList->SetGraphicsRoot32BitConstant(3, batch.StartInstance, 0);
+        cmdList->DrawIndexedInstanced(ri->IndexCount, batch.InstanceCount, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+    }
+}
+
+void D3DAppBase::DrawIndirectRuns(ID3D12GraphicsCommandList* cmdList, const std::vector<IndirectDrawRun>& runs, UINT begin, UINT end)
+{
+    FrameResource* frameResource = m_renderSnapshot->Resource;
+    ID3D12Resource* argumentBuffer = frameResource->m_indirectArgumentBuffer->Resource();
+    ID3D12Resource* countBuffer = nullptr;
+    if (m_useGpuCulling)
+    {
+        argumentBuffer = frameResource->m_culledArgumentBuffer.Get();
+        countBuffer = frameResource->m_culledCountBuffer.Get();
+    }
+
+    for (UINT runIndex = begin; runIndex < end; runIndex++)
+    {
+        const IndirectDrawRun& run = runs[runIndex];
+        // Runs already differ in one of these states, no need to filter redundant calls.
+        auto ri = run.Item;
+        cmdList->SetPipelineState(m_renderSnapshot->PipelineStates[run.PipelineStateIndex]);
         cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
         cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
         cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
-        // Offset to the CBV in the descriptor heap for this object and for this frame resource.
-        UINT cbvIndex = m_currentFrameResourceIndex * (UINT)m_opaqueItems.size() + ri->ObjectConstantBufferIndex;
-        auto cbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_cbvHeap->GetGPUDescriptorHandleForHeapStart());
-        cbvHandle.Offset(cbvIndex, m_cbvSrvUavDescriptorSize);
+        cmdList->ExecuteIndirect(
+            m_commandSignature.Get(),
+            run.CommandCount,
+            argumentBuffer,
+            (UINT64)run.FirstCommand * sizeof(IndirectCommand),
+            countBuffer, (UINT64)runIndex * sizeof(UINT));
+    }
+}
 
-        cmdList->SetGraphicsRootDescriptorTable(0, cbvHandle);
+void D3DAppBase::ResetCullCounts(ID3D12GraphicsCommandList* cmdList)
+{
+    // Restart every run from zero visible commands.
+    UINT commandCount = (UINT)m_renderSnapshot->DrawPackets.size();
+    if (commandCount == 0)
+    {
+        return;
+    }
+    cmdList->CopyBufferRegion(m_renderSnapshot->Resource->m_culledCountBuffer.Get(), 0,
+        m_cullCountReset->Resource(), 0, (UINT64)commandCount * sizeof(UINT));
+}
 
-        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+void D3DAppBase::DispatchCulling(ID3D12GraphicsCommandList* cmdList)
+{
+    FrameResource* frameResource = m_renderSnapshot->Resource;
+    UINT commandCount = (UINT)m_renderSnapshot->DrawPackets.size();
+    ID3D12Resource* culledArguments = frameResource->m_culledArgumentBuffer.Get();
+    ID3D12Resource* culledCounts = frameResource->m_culledCountBuffer.Get();
+    if (commandCount == 0)
+    {
+        // Also the case until the culling pipeline state is built.
+        return;
     }
+
+    cmdList->SetPipelineState(m_renderSnapshot->CullingPipelineState);
+    cmdList->SetComputeRootSignature(m_cullingRootSignature.Get());
+    cmdList->SetComputeRoot32BitConstant(0, commandCount, 0);
+    cmdList->SetComputeRootConstantBufferView(1, frameResource->m_passConstantBuffer->Resource()->GetGPUVirtualAddress());
+    cmdList->SetComputeRootShaderResourceView(2, frameResource->m_cullInstanceBuffer->Resource()->GetGPUVirtualAddress());
+    cmdList->SetComputeRootShaderResourceView(3, frameResource->m_indirectArgumentBuffer->Resource()->GetGPUVirtualAddress());
+    cmdList->SetComputeRootUnorderedAccessView(4, culledArguments->GetGPUVirtualAddress());
+    cmdList->SetComputeRootUnorderedAccessView(5, culledCounts->GetGPUVirtualAddress());
+
+    const UINT threadGroupSize = 64;
+    cmdList->Dispatch((commandCount + threadGroupSize - 1) / threadGroupSize, 1, 1);
 }
 
 void D3DAppBase::UpdateCamera()
@@ -717,23 +1452,65 @@ void D3DAppBase::UpdateCamera()
 
 void D3DAppBase::OnInit()
 {
+    m_jobSystem = std::make_unique<JobSystem>(m_workerThreadCount);
+    // The window title is built in the scratch arena of this thread, it is
+    // created now rather than during a frame.
+    ThreadScratchArena();
     InitializePipeline();
+    m_copyUploader = std::make_unique<CopyQueueUploader>(m_device.Get(), &m_fenceEventPool);
+    if (m_streamMeshes)
+    {
+        // Two reads in flight keep the disk busy while the workers decode.
+        m_meshStreamer = std::make_unique<MeshStreamer>(m_jobSystem.get(), m_copyUploader.get(), 2, 4);
+    }
+    m_pipelineStateCache = std::make_unique<PipelineStateCache>(m_device.Get(), m_adapter.Get(),
+        m_usePipelineStateFile ? GetAssetsFullPath(L"PipelineStateCache.bin") : std::wstring());
     ThrowIfFailed(m_commandList->Reset(m_directCommandAllocator.Get(), nullptr));
-    //m_proj = XMMatrixPerspectiveFovLH(0.25f * XM_PI, m_aspectRatio, 1.0f, 1000.0f);
+    // Culling extracts the frustum from the projection, it has to be valid.
+    m_proj = XMMatrixPerspectiveFovLH(0.25f * XM_PI, m_aspectRatio, 1.0f, 1000.0f);
     CreateRenderTargetViews();
-    BuildRootSignature();
-    BuildShader();
+    StartAssetBuild();
     BuildGeometry();
     BuildRenderItems();
     BuildFrameResources();
     BuildConstantDescriptorHeaps();
     BuildConstantBufferViews();
-    BuildPSOs();
+    BuildRenderGraph();
+    // The frames bind the root signatures from the start, only the pipeline
+    // states may arrive later.
+    m_jobSystem->Wait(&m_rootSignaturesBuilt);
+    BuildCommandSignature();
     m_commandList->Close();
     ID3D12CommandList* cmdLists[] = { m_commandList.Get() };
     m_commandQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
 
-    FlushCommandQueue();
+    // No flush: the direct queue waits for the geometry copies on the GPU,
+    // so the first frames can use the geometry right away.
+    UINT64 uploadFenceValue = m_copyUploader->Submit();
+    m_copyUploader->GpuWait(m_commandQueue.Get(), uploadFenceValue);
+    m_uploadFenceWaited = uploadFenceValue;
+    for (auto& geometry : m_geometries)
+    {
+        // Placeholders of streamed geometry wait for their own upload.
+        if (geometry.second->UploadFenceValue != MeshStreamer::NotLoaded)
+        {
+            geometry.second->UploadFenceValue = 0;
+        }
+    }
+
+    if (m_runSortBenchmark)
+    {
+        DrawPacketSortTimings timings = BenchmarkDrawPacketSort(100000);
+        WCHAR message[128];
+        swprintf_s(message, L"Sorting 100000 draw packets: radix sort %.3f ms, std::sort %.3f ms\n",
+            timings.RadixSortMs, timings.StdSortMs);
+        ::OutputDebugString(message);
+    }
+
+    if (m_pipelined)
+    {
+        StartSimulationThread();
+    }
 }
 
 void D3DAppBase::CreateCommandObjects()
@@ -748,85 +1525,232 @@ void D3DAppBase::PopulateCommandList()
     // Command list allocators can only be reset when the associated 
     // command lists have finished execution on the GPU; apps should use 
     // fences to determine GPU execution progress.
-    ComPtr<ID3D12CommandAllocator> commandAllocator = m_currentFrameResource->m_commandAllocator;
+    FrameResource* frameResource = m_renderSnapshot->Resource;
+    ComPtr<ID3D12CommandAllocator> commandAllocator = frameResource->m_commandAllocator;
 
     // Reuse the memory associated with command recording.
     ThrowIfFailed(commandAllocator->Reset());
 
-    // However, when ExecuteCommandList() is called on a particular command 
-    // list, that command list can then be reset at any time and must be before 
-    // re-recording.
-    ThrowIfFailed(m_commandList->Reset(commandAllocator.Get(),m_pipelineStateObjects["opaque"].Get()));
+    if (m_useAsyncCompute && m_useGpuCulling)
+    {
+        RecordAsyncCulling();
+    }
+
+    m_renderGraph->SetImportedResource(m_backBufferResource, m_renderTargets[m_currentBackBuffer].Get());
+    if (m_useGpuCulling)
+    {
+        m_renderGraph->SetImportedResource(m_culledArgumentResource, frameResource->m_culledArgumentBuffer.Get());
+        m_renderGraph->SetImportedResource(m_culledCountResource, frameResource->m_culledCountBuffer.Get());
+    }
+
+    // The passes before the draws go to the main command list, the ones after
+    // them to the post command list.
+    ID3D12GraphicsCommandList* commandLists[] = { m_commandList.Get(), frameResource->m_postCommandList.Get() };
+    ID3D12CommandAllocator* commandAllocators[] = { commandAllocator.Get(), frameResource->m_postCommandAllocator.Get() };
+    UINT nextCommandList = 0;
+    D3D12RenderGraph::CommandListSource commandListSource = [&]()
+    {
+        assert(nextCommandList < _countof(commandLists));
+        ID3D12GraphicsCommandList* commandList = commandLists[nextCommandList];
+        if (nextCommandList > 0)
+        {
+            ThrowIfFailed(commandAllocators[nextCommandList]->Reset());
+        }
+        // However, when ExecuteCommandList() is called on a particular command 
+        // list, that command list can then be reset at any time and must be before 
+        // re-recording.
+        ThrowIfFailed(commandList->Reset(commandAllocators[nextCommandList], nullptr));
+        nextCommandList++;
+        return commandList;
+    };
+
+    // Submission order: culling and clears, the draw chunks in order, then
+    // the transition to present.
+    m_submitCommandLists.clear();
+    m_renderGraph->Execute(commandListSource, m_submitCommandLists);
+}
+
+void D3DAppBase::RecordDrawChunks(RenderPassContext& context)
+{
+    // Split the draws in chunks and record each chunk into its own command list.
+    FrameResource* frameResource = m_renderSnapshot->Resource;
+    UINT drawCount = GetDrawUnitCount();
+    UINT chunkCount = (drawCount + m_minDrawsPerChunk - 1) / m_minDrawsPerChunk;
+    chunkCount = (std::max)(1u, (std::min)(chunkCount, m_jobSystem->WorkerCount()));
+    frameResource->EnsureWorkerCommandLists(m_device.Get(), chunkCount);
+
+    JobCounter chunksRecorded;
+    for (UINT chunk = 0; chunk < chunkCount; chunk++)
+    {
+        UINT begin = drawCount * chunk / chunkCount;
+        UINT end = drawCount * (chunk + 1) / chunkCount;
+        m_jobSystem->Run([this, chunk, begin, end]()
+        {
+            RecordDrawChunk(chunk, begin, end);
+        }, &chunksRecorded);
+    }
+    // Records chunks on this thread too, rethrows the exceptions of the jobs.
+    m_jobSystem->Wait(&chunksRecorded);
+
+    std::pmr::vector<ID3D12CommandList*> chunkCommandLists(&frameResource->m_frameArena);
+    chunkCommandLists.reserve(chunkCount);
+    for (UINT chunk = 0; chunk < chunkCount; chunk++)
+    {
+        chunkCommandLists.push_back(frameResource->m_workerCommandLists[chunk].Get());
+    }
+    context.InsertCommandLists(chunkCommandLists.data(), chunkCount);
+}
+
+void D3DAppBase::BuildRenderGraph()
+{
+    m_renderGraph = std::make_unique<D3D12RenderGraph>(m_device.Get(), &m_resourceStates);
+    RenderGraph& graph = m_renderGraph->Graph();
+
+    // The culling outputs decay to the common state between frames.
+    m_backBufferResource = graph.ImportResource("BackBuffer", ResourceAccess::Present, ResourceAccess::Present);
+    m_depthStencilResource = graph.ImportResource("DepthStencil", ResourceAccess::DepthWrite, ResourceAccess::DepthWrite);
+    m_renderGraph->SetImportedResource(m_depthStencilResource, m_depthStencilBuffer.Get());
+    if (m_useGpuCulling)
+    {
+        m_culledArgumentResource = graph.ImportResource("CulledArguments", ResourceAccess::None, ResourceAccess::IndirectArgument);
+        m_culledCountResource = graph.ImportResource("CulledCounts", ResourceAccess::None, ResourceAccess::IndirectArgument);
+    }
+
+    // With async compute the culling is recorded outside the graph, into
+    // the compute command list.
+    if (m_useGpuCulling && !m_useAsyncCompute)
+    {
+        RenderGraphPass resetCounts = m_renderGraph->AddPass("ResetCullCounts", [this](RenderPassContext& context)
+        {
+            ResetCullCounts(context.CommandList());
+        });
+        graph.Overwrite(resetCounts, m_culledCountResource, ResourceAccess::CopyDest);
+
+        RenderGraphPass cull = m_renderGraph->AddPass("Cull", [this](RenderPassContext& context)
+        {
+            DispatchCulling(context.CommandList());
+        });
+        graph.Write(cull, m_culledCountResource, ResourceAccess::UnorderedAccess);
+        graph.Overwrite(cull, m_culledArgumentResource, ResourceAccess::UnorderedAccess);
+    }
+
+    RenderGraphPass clear = m_renderGraph->AddPass("Clear", [this](RenderPassContext& context)
+    {
+        CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_currentBackBuffer, m_rtvDescriptorSize);
+        context.CommandList()->ClearRenderTargetView(rtvHandle, Colors::SteelBlue, 0, nullptr);
+        context.CommandList()->ClearDepthStencilView(m_dsvHeap->GetCPUDescriptorHandleForHeapStart(),
+            D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+    });
+    graph.Overwrite(clear, m_backBufferResource, ResourceAccess::RenderTarget);
+    graph.Overwrite(clear, m_depthStencilResource, ResourceAccess::DepthWrite);
+
+    RenderGraphPass opaque = m_renderGraph->AddPass("Opaque", [this](RenderPassContext& context)
+    {
+        RecordDrawChunks(context);
+    });
+    graph.Write(opaque, m_backBufferResource, ResourceAccess::RenderTarget);
+    graph.Write(opaque, m_depthStencilResource, ResourceAccess::DepthWrite);
+    if (m_useGpuCulling)
+    {
+        graph.Read(opaque, m_culledArgumentResource, ResourceAccess::IndirectArgument);
+        graph.Read(opaque, m_culledCountResource, ResourceAccess::IndirectArgument);
+    }
 
+    m_renderGraph->Compile();
+}
+
+void D3DAppBase::RecordAsyncCulling()
+{
+    FrameResource* frameResource = m_renderSnapshot->Resource;
+    frameResource->EnsureComputeCommandList(m_device.Get());
+    ID3D12GraphicsCommandList* computeList = frameResource->m_computeCommandList.Get();
+    ThrowIfFailed(frameResource->m_computeCommandAllocator->Reset());
+    ThrowIfFailed(computeList->Reset(frameResource->m_computeCommandAllocator.Get(), nullptr));
+    m_resourceStates.Transition(frameResource->m_culledCountBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+    m_resourceStates.Flush(computeList);
+    ResetCullCounts(computeList);
+    m_resourceStates.Transition(frameResource->m_culledCountBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    m_resourceStates.Transition(frameResource->m_culledArgumentBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    m_resourceStates.Flush(computeList);
+    DispatchCulling(computeList);
+    m_resourceStates.Transition(frameResource->m_culledArgumentBuffer.Get(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+    m_resourceStates.Transition(frameResource->m_culledCountBuffer.Get(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+    m_resourceStates.Flush(computeList);
+    ThrowIfFailed(computeList->Close());
+}
+
+UINT D3DAppBase::GetDrawUnitCount()
+{
+    if (m_drawPath == DrawPath::Instanced)
+    {
+        return (UINT)m_renderSnapshot->Batches.size();
+    }
+    else if (m_drawPath == DrawPath::Indirect)
+    {
+        return (UINT)m_renderSnapshot->Runs.size();
+    }
+    return (UINT)m_renderSnapshot->DrawPackets.size();
+}
 
-    // Set necessary state.
-    m_commandList->RSSetViewports(1, &m_viewport);
-    m_commandList->RSSetScissorRects(1, &m_scissorRect);
+void D3DAppBase::RecordDrawChunk(UINT chunk, UINT begin, UINT end)
+{
+    FrameResource* frameResource = m_renderSnapshot->Resource;
+    ID3D12CommandAllocator* allocator = frameResource->m_workerCommandAllocators[chunk].Get();
+    ID3D12GraphicsCommandList* cmdList = frameResource->m_workerCommandLists[chunk].Get();
+    ThrowIfFailed(allocator->Reset());
+    ThrowIfFailed(cmdList->Reset(allocator, nullptr));
 
-    // Indicate that the back buffer will be used as a render target.
-    m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
-        m_renderTargets[m_currentBackBuffer].Get(),
-        D3D12_RESOURCE_STATE_PRESENT,
-        D3D12_RESOURCE_STATE_RENDER_TARGET));
+    // Command lists do not inherit state, every chunk sets it up again.
+    cmdList->RSSetViewports(1, &m_viewport);
+    cmdList->RSSetScissorRects(1, &m_scissorRect);
 
     CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_currentBackBuffer, m_rtvDescriptorSize);
-    
+    D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = m_dsvHeap->GetCPUDescriptorHandleForHeapStart();
+    cmdList->OMSetRenderTargets(1, &rtvHandle, true, &dsvHandle);
 
-    // Record commands.
-    m_commandList->ClearRenderTargetView(rtvHandle, Colors::SteelBlue, 0, nullptr);
-    m_commandList->ClearDepthStencilView(m_dsvHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
-    m_commandList->OMSetRenderTargets(1, &rtvHandle, true, &m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
-    
     ID3D12DescriptorHeap* descriptorHeaps[] = { m_cbvHeap.Get() };
-    m_commandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-    m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+    cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+    cmdList->SetGraphicsRootSignature(m_rootSignature.Get());
 
-    unsigned int passCbvIndex = m_passCbvOffset + m_currentFrameResourceIndex;
+    unsigned int passCbvIndex = m_passCbvOffset + m_renderSnapshot->FrameResourceIndex;
     auto passCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_cbvHeap->GetGPUDescriptorHandleForHeapStart());
     passCbvHandle.Offset(passCbvIndex, m_cbvSrvUavDescriptorSize);
-    m_commandList->SetGraphicsRootDescriptorTable(1, passCbvHandle);
-    
-    DrawRenderItems(m_commandList.Get(), m_opaqueItems);
+    cmdList->SetGraphicsRootDescriptorTable(1, passCbvHandle);
 
-    // Indicate a state transition on the resource usage.
-    m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_currentBackBuffer].Get(),
-        D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
-    ThrowIfFailed(m_commandList->Close());
+    if (m_drawPath == DrawPath::Instanced)
+    {
+        DrawInstanceBatches(cmdList, m_renderSnapshot->Batches, begin, end);
+    }
+    else if (m_drawPath == DrawPath::Indirect)
+    {
+        DrawIndirectRuns(cmdList, m_renderSnapshot->Runs, begin, end);
+    }
+    else
+    {
+        DrawRenderItems(cmdList, m_renderSnapshot->DrawPackets, begin, end);
+    }
+
+    ThrowIfFailed(cmdList->Close());
 }
 
 void D3DAppBase::WaitForPreviousFrame()
 {
-    const UINT64 fence = m_currentFenceValue;
-    ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), fence));
-    m_currentFenceValue++;
-
-    if (m_fence->GetCompletedValue() < fence)
-    {
-        ThrowIfFailed(m_fence->SetEventOnCompletion(fence, m_fenceEvent));
-        WaitForSingleObject(m_fenceEvent, INFINITE);
-    }
+    m_fence->Flush(m_commandQueue.Get());
     m_currentBackBuffer = m_swapChain->GetCurrentBackBufferIndex();
 }
 
 void D3DAppBase::WaitForGPU()
 {
-    // Schedule a Signal command in the queue.
-    m_currentFenceValue++;
-    ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), m_currentFenceValue));
-
-    // Wait until the fence has been processed.
-    if (m_fence->GetCompletedValue() < m_currentFenceValue)
-    {
-        ThrowIfFailed(m_fence->SetEventOnCompletion(m_currentFenceValue, m_fenceEvent));
-        WaitForSingleObjectEx(m_fenceEvent, INFINITE, false);
-    }
+    m_fence->Flush(m_commandQueue.Get());
 }
 
 void D3DAppBase::MoveToNextFrame()
 {
-    m_currentFrameResource->m_fenceValue = ++m_currentFenceValue;
     // Schedule a Signal command in the queue.
-    ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), m_currentFenceValue));
+    UINT64 fenceValue = m_fence->Signal(m_commandQueue.Get());
+    m_renderSnapshot->Resource->m_fenceValue = fenceValue;
+    m_framePacer->OnFrameSubmitted(m_renderSnapshot->FrameNumber, fenceValue);
+    m_framePacer->OnFenceCompleted(m_fence->CompletedValue());
 
     // Update the frame index.
     m_currentBackBuffer = m_swapChain->GetCurrentBackBufferIndex();
@@ -834,34 +1758,42 @@ void D3DAppBase::MoveToNextFrame()
 
 void D3DAppBase::FlushCommandQueue()
 {
-    // Advance the fence value to mark commands up to this fence point.
-    m_currentFenceValue++;
-
-    // Add an instruction to the command queue to set a new fence point.
-    // Because we are on the GPU timeline, the new fence point won't be set 
-    // until the GPU finishes processing all the commands prior to this signal().
-    ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), m_currentFenceValue));
-
-    // Wait until the GPU has completed commands up to this fence point.
-    if (m_fence->GetCompletedValue() < m_currentFenceValue)
-    {
-        ThrowIfFailed(m_fence->SetEventOnCompletion(m_currentFenceValue, m_fenceEvent));
-        WaitForSingleObject(m_fenceEvent, INFINITE);
-    }
+    // The signal is set once the GPU finishes all the commands submitted
+    // before it, waiting for it drains the queue.
+    m_fence->Flush(m_commandQueue.Get());
 }
 
 void D3DAppBase::BuildFrameResources()
 {
     for (UINT i=0;i<m_numberFrameResources;i++)
     {
-        m_frameResources.push_back(std::make_unique<FrameResource>(m_device.Get(), 1, (UINT)m_allItems.size()));
+        m_frameResources.push_back(std::make_unique<FrameResource>(m_device.Get(), 1, (UINT)m_allItems.size(), (UINT)m_allItems.size()));
+    }
+    m_frameSnapshots.resize(m_numberFrameResources);
+    for (auto& frameResource : m_frameResources)
+    {
+        m_resourceStates.Register(frameResource->m_culledArgumentBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        m_resourceStates.Register(frameResource->m_culledCountBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+    }
+
+    m_framePacer = std::make_unique<FramePacer>(m_numberFrameResources);
+    m_framePacer->SetPolicy(m_pacingPolicy);
+    m_framePacer->SetLatencyTarget(m_latencyTargetMs);
+    m_framePacer->SetFrameTimeTarget(m_frameTimeTargetMs);
+    m_framePacer->SetAdaptive(m_adaptivePacing);
+
+    // Copied over the culled count buffer to restart the runs from zero every frame.
+    m_cullCountReset = std::make_unique<UploadBuffer<UINT>>(m_device.Get(), (UINT)m_allItems.size(), false);
+    for (UINT i = 0; i < (UINT)m_allItems.size(); i++)
+    {
+        m_cullCountReset->CopyData(i, 0);
     }
 }
 
-void D3DAppBase::UpdateObjectConstantBuffers()
+void D3DAppBase::UpdateObjectConstantBuffers(UINT begin, UINT end)
 {
     UploadBuffer<ObjectConstants>* currentObjectConstantBuffer = m_currentFrameResource->m_objectConstantBuffer.get();
-    for (UINT i = 0; i < m_allItems.size(); i++)
+    for (UINT i = begin; i < end; i++)
     {
         if (m_allItems[i]->NumFramesDirty > 0)
         {
@@ -896,48 +1828,237 @@ void D3DAppBase::UpdateMainPassConstantBuffer(std::unique_ptr<GameTimer>& gt)
     m_mainPassCB.farZ = 1000.0f;
     m_mainPassCB.TotalTime = gt->TotalTime();
     m_mainPassCB.DeltaTime = gt->DeltaTime();
+    ExtractFrustumPlanes(viewProj, m_mainPassCB.FrustumPlanes);
 
     m_currentFrameResource->m_passConstantBuffer->CopyData(0, m_mainPassCB);
 }
 
-void D3DAppBase::OnUpdate()
+UINT64 D3DAppBase::PaceFrame()
+{
+    UINT64 frame = m_framePacer->BeginFrame();
+
+    // The pacer may keep fewer frames in flight than there are frame resources,
+    // the GPU has to be done with the current frame resource in any case.
+    UINT64 fenceValue = (std::max)(m_framePacer->FenceToWaitFor(frame), m_currentFrameResource->m_fenceValue);
+
+    FramePacer::Clock::time_point waitStart = FramePacer::Clock::now();
+    m_fence->Wait(fenceValue, m_fenceWaitPolicy);
+    std::chrono::duration<double, std::milli> waitTime = FramePacer::Clock::now() - waitStart;
+
+    m_framePacer->OnFenceCompleted(m_fence->CompletedValue());
+    m_currentFrameResource->m_frameArena.Reset();
+    m_frameArenaPeak = m_currentFrameResource->m_frameArena.LastPeak();
+    std::chrono::duration<double, std::milli> sleepTime = m_framePacer->EndWait(frame, waitTime);
+    if (sleepTime.count() > 0.0)
+    {
+        std::this_thread::sleep_for(sleepTime);
+    }
+    return frame;
+}
+
+void D3DAppBase::SimulateFrame(std::unique_ptr<GameTimer>& gt, FrameSnapshot& snapshot)
 {
+    UpdatePipelineStates();
     UpdateCamera();
+    if (m_meshStreamer != nullptr)
+    {
+        InstallStreamedMeshes();
+    }
+
+    // The object constants, the pass constants and the draw packets are
+    // built by jobs. Culling in BuildDrawPackets waits for the pass constants.
+    JobCounter objectConstantsUpdated;
+    JobSystem::RangeFunction updateObjects = [this](UINT begin, UINT end)
+    {
+        UpdateObjectConstantBuffers(begin, end);
+    };
+    m_jobSystem->ParallelFor((UINT)m_allItems.size(), m_itemsPerJob, updateObjects, &objectConstantsUpdated);
+
+    JobCounter passConstantsUpdated;
+    m_jobSystem->Run([this, &gt]() { UpdateMainPassConstantBuffer(gt); }, &passConstantsUpdated);
+
+    BuildDrawPackets(&passConstantsUpdated);
+    m_jobSystem->Wait(&passConstantsUpdated);
+    m_jobSystem->Wait(&objectConstantsUpdated);
+
+    if (m_drawPath == DrawPath::Instanced)
+    {
+        m_instanceBatcher.Build(m_drawPackets, m_currentFrameResource->m_instanceBuffer.get());
+        snapshot.Batches = m_instanceBatcher.Batches();
+    }
+    else if (m_drawPath == DrawPath::Indirect)
+    {
+        m_indirectCommandBuilder.Build(m_drawPackets,
+            m_currentFrameResource->m_objectConstantBuffer->Resource()->GetGPUVirtualAddress(),
+            m_currentFrameResource->m_indirectArgumentBuffer->Elements(),
+            m_useGpuCulling ? m_currentFrameResource->m_cullInstanceBuffer->Elements() : nullptr);
+        snapshot.Runs = m_indirectCommandBuilder.Runs();
+    }
+    snapshot.PipelineStates = m_pipelineStateTable;
+    snapshot.InstancedPipelineStates = m_instancedPipelineStateTable;
+    snapshot.CullingPipelineState = m_cullingPipelineState;
+    snapshot.DrawPackets = m_drawPackets;
+    snapshot.UploadFenceValue = m_uploadFenceCompleted;
+    snapshot.FrameNumber = m_simulatedFrame;
+    snapshot.FrameResourceIndex = m_currentFrameResourceIndex;
+    snapshot.Resource = m_currentFrameResource;
+}
+
+void D3DAppBase::StartSimulationThread()
+{
+    // Every frame resource starts free. The queue of snapshots is shorter so
+    // the simulation runs at most m_maxQueuedSnapshots frames ahead of the
+    // frame being recorded.
+    m_freeFrameResources = std::make_unique<BoundedQueue<UINT>>(m_numberFrameResources);
+    for (UINT i = 0; i < m_numberFrameResources; i++)
+    {
+        m_freeFrameResources->Push(i);
+    }
+    m_snapshotQueue = std::make_unique<BoundedQueue<const FrameSnapshot*>>(m_maxQueuedSnapshots);
+
+    m_simulationTimer = std::make_unique<GameTimer>();
+    m_simulationThread = std::thread(&D3DAppBase::SimulationThreadMain, this);
+}
+
+void D3DAppBase::StopSimulationThread()
+{
+    if (!m_simulationThread.joinable())
+    {
+        return;
+    }
+    m_freeFrameResources->Close();
+    m_snapshotQueue->Close();
+    m_framePacer->Close();
+    m_simulationThread.join();
+}
+
+void D3DAppBase::SimulationThreadMain()
+{
+    try
+    {
+        m_simulationTimer->Reset();
+
+        // The simulation thread owns a frame resource from the moment the render
+        // thread gives it back until its snapshot is queued.
+        UINT frameResourceIndex = 0;
+        while (m_freeFrameResources->Pop(frameResourceIndex))
+        {
+            m_simulationTimer->Tick();
+            m_currentFrameResourceIndex = frameResourceIndex;
+            m_currentFrameResource = m_frameResources[frameResourceIndex].get();
+            m_simulatedFrame = PaceFrame();
+
+            FrameSnapshot& snapshot = m_frameSnapshots[frameResourceIndex];
+            SimulateFrame(m_simulationTimer, snapshot);
+            if (!m_snapshotQueue->Push(&snapshot))
+            {
+                break;
+            }
+        }
+    }
+    catch (...)
+    {
+        // Rethrown by the render thread when it runs out of snapshots.
+        m_simulationException = std::current_exception();
+        m_snapshotQueue->Close();
+    }
+}
+
+void D3DAppBase::OnUpdate()
+{
+    if (m_pipelined)
+    {
+        // The simulation thread updates the frames, OnRender consumes them.
+        return;
+    }
 
     // Cycle through the circular frame resource array.
     m_currentFrameResourceIndex = (m_currentFrameResourceIndex + 1) % m_numberFrameResources;
     m_currentFrameResource = m_frameResources[m_currentFrameResourceIndex].get();
+    m_simulatedFrame = PaceFrame();
 
-    // Has the GPU finished processing the commands of the current frame resource?
-    // If not, wait until the GPU has completed commands up to this fence point.
-    if (m_currentFrameResource->m_fenceValue != 0 && 
-        m_fence->GetCompletedValue() < m_currentFrameResource->m_fenceValue)
-    {
-        HANDLE eventHandle = CreateEvent(nullptr, false, false, nullptr);
-        ThrowIfFailed(m_fence->SetEventOnCompletion(m_currentFrameResource->m_fenceValue, eventHandle));
-        WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
-    }
-    UpdateObjectConstantBuffers();
-    UpdateMainPassConstantBuffer(m_gameTimer);
+    FrameSnapshot& snapshot = m_frameSnapshots[m_currentFrameResourceIndex];
+    SimulateFrame(m_gameTimer, snapshot);
+    m_renderSnapshot = &snapshot;
 }
 
 void D3DAppBase::OnRender()
 {
+    AllocationScope renderAllocations;
+
+    if (m_pipelined)
+    {
+        // Record frame N while the simulation thread works on frame N+1.
+        if (!m_snapshotQueue->Pop(m_renderSnapshot))
+        {
+            // Closed by a failed simulation, or by StopSimulationThread on shutdown.
+            if (m_simulationException != nullptr)
+            {
+                std::rethrow_exception(m_simulationException);
+            }
+            return;
+        }
+    }
+
+    // Start the copies recorded since the last frame and release the finished ones.
+    m_copyUploader->Submit();
+    m_copyUploader->Retire();
+
     // Record all the commands we need to render the scene into the command list.
     PopulateCommandList();
 
-    // Execute the command list.
-    ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
-    m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    // The copies of the geometry drawn this frame are complete, the wait
+    // only orders the queues and does not stall the GPU.
+    if (m_renderSnapshot->UploadFenceValue > m_uploadFenceWaited)
+    {
+        m_copyUploader->GpuWait(m_commandQueue.Get(), m_renderSnapshot->UploadFenceValue);
+        m_uploadFenceWaited = m_renderSnapshot->UploadFenceValue;
+    }
+
+    if (m_useAsyncCompute && m_useGpuCulling)
+    {
+        // Culling overlaps the end of the previous frame and the clears of this
+        // one on the graphics queue, only the draws wait for it.
+        ID3D12CommandList* computeLists[] = { m_renderSnapshot->Resource->m_computeCommandList.Get() };
+        QueueTicket cullingDone = m_queueScheduler.Submit(m_computeQueueId, [this, &computeLists]()
+        {
+            m_computeQueue->ExecuteCommandLists(_countof(computeLists), computeLists);
+        });
+        m_queueScheduler.Submit(m_graphicsQueueId, [this]()
+        {
+            m_commandQueue->ExecuteCommandLists(1, m_submitCommandLists.data());
+        });
+        m_queueScheduler.Submit(m_graphicsQueueId, [this]()
+        {
+            m_commandQueue->ExecuteCommandLists((UINT)m_submitCommandLists.size() - 1, m_submitCommandLists.data() + 1);
+        }, { cullingDone });
+    }
+    else
+    {
+        // Execute the command lists of all the chunks at once.
+        m_commandQueue->ExecuteCommandLists((UINT)m_submitCommandLists.size(), m_submitCommandLists.data());
+    }
+    m_resourceStates.OnCommandListsExecuted();
 
     ThrowIfFailed(m_swapChain->Present(0,0));
 
     MoveToNextFrame();
+
+    if (m_pipelined)
+    {
+        // The fence value is set, the simulation thread can wait on it and reuse the resource.
+        m_freeFrameResources->Push(m_renderSnapshot->FrameResourceIndex);
+    }
+
+    CheckFrameAllocations(renderAllocations.Stats());
 }
 
 void D3DAppBase::OnDestroy()
 {
+    StopSimulationThread();
+    // The decode jobs upload through the copy queue.
+    m_meshStreamer.reset();
+    // The build jobs use the caches, they cannot outlive them.
+    FinishAssetBuild();
     WaitForGPU();
-    CloseHandle(m_fenceEvent);
 }
\ No newline at end of file
@@ -10,12 +10,43 @@
 #include "UploadBuffer.h"
 #include "FrameResource.h"
 #include "RenderItem.h"
+#include "DrawPacket.h"
+#include "InstanceBatcher.h"
+#include "IndirectCommandBuilder.h"
+#include "Culling.h"
+#include "JobSystem.h"
+#include "BoundedQueue.h"
+#include "FrameSnapshot.h"
+#include "FramePacer.h"
+#include "D3D12TimelineFence.h"
+#include "CopyQueueUploader.h"
+#include "D3D12ScheduledQueue.h"
+#include "ResourceStateTracker.h"
+#include "D3D12RenderGraph.h"
+#include "PipelineStateCache.h"
+#include "D3DShaderCompiler.h"
+#include "PermutationCache.h"
+#include "FileWatcher.h"
+#include "AllocationTracker.h"
+#include "MeshFile.h"
+#include "MeshStreamer.h"
 
 
 
 using Microsoft::WRL::ComPtr;
 
 
+// How the sorted draw packets are submitted.
+enum class DrawPath
+{
+    // One DrawIndexedInstanced and one CBV per render item.
+    Direct,
+    // Items sharing pipeline state and mesh become one instanced draw.
+    Instanced,
+    // The CPU fills an argument buffer, draws are issued with ExecuteIndirect.
+    Indirect
+};
+
 class D3DAppBase
 {
 public:
@@ -59,19 +90,76 @@ protected:
     void PopulateCommandList();
     void WaitForPreviousFrame();
     void BuildRootSignature();
+    void BuildCullingRootSignature();
+    void BuildCommandSignature();
     void BuildShader();
-    void BuildPSO();
+    // Compiles an entry point of an asset through the shader cache, with
+    // the defines of the shader features. files, if not null, receives the
+    // normalized paths of the source and its includes.
+    ComPtr<ID3DBlob> LoadShader(LPCWSTR fileName, const char* entryPoint, const char* target, UINT compileFlags,
+        ShaderFeature features = ShaderFeature::None, std::vector<std::string>* files = nullptr);
     void BuildPSOs();
+    // Without the shaders, they depend on the permutation.
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC GetOpaquePipelineStateDesc()const;
+    // Compile the shaders of a permutation and create its pipeline state, run by jobs.
+    ID3D12PipelineState* BuildOpaquePipelineState(ShaderFeature features, std::vector<std::string>& files);
+    ID3D12PipelineState* BuildCullingPipelineState(std::vector<std::string>& files);
+    // Root signatures, shaders and pipeline states are jobs, the geometry is
+    // built on this thread meanwhile.
+    void StartAssetBuild();
+    // Rebuilds the pipeline states of the shader files changed since the last
+    // frame and moves the ones built since into the tables.
+    void UpdatePipelineStates();
+    // With hot reload a failed build is reported and the frame goes on.
+    ID3D12PipelineState* RequestPipelineState(PermutationCache<ID3D12PipelineState>& permutations, ShaderFeature features);
+    bool IsPipelineStateReady(UINT pipelineStateIndex)const;
+    // Waits for the jobs still building assets, then saves them.
+    void FinishAssetBuild();
+    // Saves the shader and pipeline state caches and the permutations
+    // requested so far, each time the builds in flight are done.
+    void SaveAssetCaches();
+    // Called at the end of OnRender with the allocations of the render thread.
+    void CheckFrameAllocations(const AllocationStats& renderThreadAllocations);
     void BuildGeometry();
+    // Moves the geometries streamed in since the last frame into their
+    // placeholders and points the items drawing them at the real submeshes.
+    void InstallStreamedMeshes();
+    // Logs what each geometry keeps in system memory and what its policy saves.
+    void ReportGeometryResidency()const;
     void BuildConstantDescriptorHeaps();
     void BuildConstantBufferViews();
     void BuildRenderItems();
     void WaitForGPU();
     void MoveToNextFrame();
     void BuildFrameResources();
-    void UpdateObjectConstantBuffers();
+    void UpdateObjectConstantBuffers(UINT begin, UINT end);
     void UpdateMainPassConstantBuffer(std::unique_ptr<GameTimer>& gt);
-    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& renderItems);
+    // Waits as long as the frame pacer asks before the current frame resource
+    // is written, returns the number of the new frame.
+    UINT64 PaceFrame();
+    // Updates the current frame resource and fills the snapshot recorded from it.
+    void SimulateFrame(std::unique_ptr<GameTimer>& gt, FrameSnapshot& snapshot);
+    void StartSimulationThread();
+    void StopSimulationThread();
+    void SimulationThreadMain();
+    void BuildDrawPackets(JobCounter* passConstantsReady);
+    void BuildDrawPacketRange(UINT begin, UINT end);
+    // Draw the elements [begin, end) of the lists built for the frame.
+    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<DrawPacket>& drawPackets, UINT begin, UINT end);
+    void DrawInstanceBatches(ID3D12GraphicsCommandList* cmdList, const std::vector<InstanceBatch>& batches, UINT begin, UINT end);
+    void DrawIndirectRuns(ID3D12GraphicsCommandList* cmdList, const std::vector<IndirectDrawRun>& runs, UINT begin, UINT end);
+    UINT GetDrawUnitCount();
+    void RecordDrawChunk(UINT chunk, UINT begin, UINT end);
+    void ResetCullCounts(ID3D12GraphicsCommandList* cmdList);
+    void DispatchCulling(ID3D12GraphicsCommandList* cmdList);
+    // Declares the passes of the frame, once the flags are known.
+    void BuildRenderGraph();
+    // Records the draws of the opaque pass on several threads.
+    void RecordDrawChunks(RenderPassContext& context);
+    // Records the culling pass into the compute command list of the frame.
+    void RecordAsyncCulling();
+    // Index of the opaque permutation in the pipeline state tables.
+    UINT GetPipelineStateIndex(ShaderFeature features);
     void UpdateCamera();
     void FlushCommandQueue();
     // Helper function.
@@ -84,9 +172,11 @@ protected:
     ComPtr<ID3D12CommandAllocator>  m_directCommandAllocator;
     ComPtr<ID3D12CommandQueue>  m_commandQueue;
     ComPtr<ID3D12GraphicsCommandList>   m_commandList;
-    ComPtr<ID3D12PipelineState> m_pipelineState;
 
     ComPtr<ID3D12RootSignature> m_rootSignature;
+    ComPtr<ID3D12CommandSignature> m_commandSignature;
+    ComPtr<ID3D12RootSignature> m_cullingRootSignature;
+    std::unique_ptr<UploadBuffer<UINT>> m_cullCountReset;
 
     ComPtr<IDXGISwapChain3> m_swapChain;
     std::vector<ComPtr<ID3D12Resource>> m_renderTargets;
@@ -95,6 +185,19 @@ protected:
 
     ComPtr<ID3D12Resource>  m_depthStencilBuffer;
 
+    // Declared after the device and the resources they track, destroyed
+    // before them. States of the resources whose state changes while
+    // rendering, used by the render thread to record the barriers.
+    ResourceStateTracker m_resourceStates;
+
+    // Passes of the frame. The imported handles are bound to the resources
+    // of the current back buffer and frame resource every frame.
+    std::unique_ptr<D3D12RenderGraph> m_renderGraph;
+    RenderGraphResource m_backBufferResource = RenderGraphInvalidIndex;
+    RenderGraphResource m_depthStencilResource = RenderGraphInvalidIndex;
+    RenderGraphResource m_culledArgumentResource = RenderGraphInvalidIndex;
+    RenderGraphResource m_culledCountResource = RenderGraphInvalidIndex;
+
     std::unique_ptr<MeshGeometry>   m_geometry = nullptr;
 
     ComPtr<ID3D12DescriptorHeap>    m_rtvHeap;
@@ -109,11 +212,75 @@ protected:
     UINT m_cbvSrvUavDescriptorSize = 0;
 
     // Synchronization objects.
-    ComPtr<ID3D12Fence> m_fence;
-    UINT64 m_currentFenceValue = 0;
-    HANDLE m_fenceEvent;
+    FenceEventPool m_fenceEventPool;
+    std::unique_ptr<D3D12TimelineFence> m_fence;
+    FenceWaitPolicy m_fenceWaitPolicy = FenceWaitPolicy::SpinThenBlock;
+
+    // Geometry uploads. m_uploadFenceCompleted is the copy fence value seen
+    // by the simulation of the frame, m_uploadFenceWaited the highest value
+    // the direct queue waited for.
+    std::unique_ptr<CopyQueueUploader> m_copyUploader;
+    UINT64 m_uploadFenceCompleted = 0;
+    UINT64 m_uploadFenceWaited = 0;
+
+    // With -asynccompute the culling runs on a compute queue. The scheduler
+    // turns the dependencies between the queues into fence waits.
+    bool m_useAsyncCompute = false;
+    ComPtr<ID3D12CommandQueue> m_computeQueue;
+    std::unique_ptr<D3D12TimelineFence> m_computeFence;
+    QueueScheduler m_queueScheduler;
+    std::unique_ptr<D3D12ScheduledQueue> m_scheduledGraphicsQueue;
+    std::unique_ptr<D3D12ScheduledQueue> m_scheduledComputeQueue;
+    QueueId m_graphicsQueueId = 0;
+    QueueId m_computeQueueId = 0;
 
     bool m_useWarpDevice = false;
+    bool m_runSortBenchmark = false;
+    DrawPath m_drawPath = DrawPath::Instanced;
+    bool m_useGpuCulling = false;
+
+    // Update, culling and recording run as jobs on the worker threads
+    // and the main thread. Draw recording is split in at most one chunk
+    // per worker, with at least m_minDrawsPerChunk draws in each chunk.
+    std::unique_ptr<JobSystem> m_jobSystem;
+    UINT m_workerThreadCount = 0;
+    UINT m_itemsPerJob = 256;
+    UINT m_minDrawsPerChunk = 64;
+
+    // In pipelined mode a simulation thread builds frame N+1 while the main
+    // thread records and submits frame N. Frame resources travel from the
+    // render thread to the simulation thread through m_freeFrameResources,
+    // the snapshots built from them travel back through m_snapshotQueue.
+    bool m_pipelined = false;
+    UINT m_maxQueuedSnapshots = 1;
+    std::thread m_simulationThread;
+    std::unique_ptr<GameTimer> m_simulationTimer;
+    std::unique_ptr<BoundedQueue<UINT>> m_freeFrameResources;
+    std::unique_ptr<BoundedQueue<const FrameSnapshot*>> m_snapshotQueue;
+    std::exception_ptr m_simulationException;
+    UINT64 m_simulatedFrame = 0;
+
+    // Limits the frames in flight and measures the waits on the GPU.
+    // The settings come from the command line.
+    std::unique_ptr<FramePacer> m_framePacer;
+    PacingPolicy m_pacingPolicy = PacingPolicy::Throughput;
+    double m_latencyTargetMs = 50.0;
+    double m_frameTimeTargetMs = 0.0;
+    bool m_adaptivePacing = true;
+
+    // Peak use of the frame arena by the last frame that was reset, shown
+    // with the frame stats.
+    std::atomic<size_t> m_frameArenaPeak{ 0 };
+
+    // Heap allocations of the last frame rendered, every thread included.
+    // With m_checkFrameAllocations a frame allocating once the build is done
+    // and m_allocationWarmupFrames have passed asserts.
+    AllocationStats m_frameAllocations;
+    AllocationStats m_frameAllocationStart;
+    UINT m_steadyFrameCount = 0;
+    UINT m_allocationWarmupFrames = 16;
+    bool m_checkFrameAllocations = false;
+
     UINT m_width;
     UINT m_height;
     float m_aspectRatio;
@@ -134,6 +301,10 @@ protected:
     std::vector<std::unique_ptr<FrameResource>> m_frameResources;
     FrameResource* m_currentFrameResource = nullptr;
     UINT m_currentFrameResourceIndex = 0;
+    // One snapshot per frame resource, m_renderSnapshot is the one being recorded.
+    std::vector<FrameSnapshot> m_frameSnapshots;
+    const FrameSnapshot* m_renderSnapshot = nullptr;
+    std::vector<ID3D12CommandList*> m_submitCommandLists;
 
 
     PassConstants m_mainPassCB;
@@ -142,7 +313,7 @@ protected:
 private:
     std::wstring m_assetsPath;
     std::wstring m_title;
-    const UINT  m_numberFrameResources = 3;
+    UINT  m_numberFrameResources = 3;
 
     float m_theta = 1.5f * DirectX::XM_PI;
     float m_phi = DirectX::XM_PIDIV4;
@@ -150,11 +321,64 @@ private:
 
     XMFLOAT3 m_eyePos = XMFLOAT3(0.0f, 0.0f, 0.0f);
 
-    std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> m_geometries;
+    FlatHashMap<std::unique_ptr<MeshGeometry>> m_geometries;
+    // The shapes are read from Shapes.mesh, baked again when it is stale or with -bakemeshes.
+    bool m_bakeMeshes = false;
+    // CPU copy policy of the geometries built, the mapping of the mesh file by default.
+    GeometryResidency m_geometryResidency = GeometryResidency::MappedView;
+    // With -streaming the mesh file is read in the background, the items are
+    // skipped until their geometry arrives.
+    bool m_streamMeshes = false;
+    std::unique_ptr<MeshStreamer> m_meshStreamer;
+    std::vector<MeshStreamer::LoadedMesh> m_streamedMeshes;
     std::vector<D3D12_INPUT_ELEMENT_DESC> m_inputLayout;
-    std::unordered_map<std::string, ComPtr<ID3DBlob>>    m_shaders;
-    std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> m_pipelineStateObjects;
+    // Bytecode archive next to the executable, a hit skips the compiler.
+    DiskShaderFileSystem m_shaderFileSystem;
+    D3DShaderCompiler m_shaderCompiler;
+    std::unique_ptr<ShaderCache> m_shaderCache;
+    bool m_useShaderCache = true;
+    // Pipeline states are created through the cache, the names only select them.
+    std::unique_ptr<PipelineStateCache> m_pipelineStateCache;
+    bool m_usePipelineStateFile = true;
+
+    // The startup build jobs wait for the root signatures.
+    JobCounter m_rootSignaturesBuilt;
+    bool m_assetBuildPending = false;
+    UINT m_shaderCompileFlags = 0;
+
+    // Opaque pipeline states, one per permutation used by the render items,
+    // compiled on first use or prewarmed from the list of the last run.
+    std::unique_ptr<PermutationCache<ID3D12PipelineState>> m_opaquePermutations;
+    // The culling shader has no features, its single permutation goes through
+    // a cache of its own for the lazy build and the reload.
+    std::unique_ptr<PermutationCache<ID3D12PipelineState>> m_cullingPermutations;
+    // Null until the culling pipeline state is built, frames draw nothing
+    // with GPU culling before that.
+    ID3D12PipelineState* m_cullingPipelineState = nullptr;
+
+    // With -hotreload the assets folder is watched, the pipeline states of
+    // the shaders edited are rebuilt in the background and replace the old
+    // ones between two frames. The assets folder is the output folder, the
+    // build copies the project shaders into it.
+    bool m_hotReload = false;
+    std::unique_ptr<FileWatcher> m_shaderWatcher;
 
     std::vector<std::unique_ptr<RenderItem>> m_allItems;
     std::vector<RenderItem*> m_opaqueItems;
+
+    // Pipeline states addressed by the index stored in the draw packet sort key,
+    // copied into every snapshot. An entry is null until its pipeline state
+    // is built, its items are skipped.
+    std::vector<ID3D12PipelineState*> m_pipelineStateTable;
+    // Instanced variants at the same indices.
+    std::vector<ID3D12PipelineState*> m_instancedPipelineStateTable;
+    std::vector<ShaderFeature> m_pipelineStateFeatures;
+    std::unordered_map<uint32_t, UINT> m_pipelineStateIndices;
+    UINT m_nextMeshId = 0;
+
+    // Rebuilt and sorted every frame.
+    std::vector<DrawPacket> m_drawPackets;
+    std::vector<DrawPacket> m_drawPacketScratch;
+    InstanceBatcher m_instanceBatcher;
+    IndirectCommandBuilder m_indirectCommandBuilder;
 };
\ No newline at end of file
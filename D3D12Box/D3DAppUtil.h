@@ -8,6 +8,8 @@
 #include <stdexcept>
 #include <comdef.h>
 #include <DirectXCollision.h>
+#include "FlatHashMap.h"
+#include "GeometryResidency.h"
 
 struct Vertex
 {
@@ -20,6 +22,32 @@ struct ObjectConstants
     DirectX::XMMATRIX World = DirectX::XMMatrixIdentity();
 };
 
+// Per-instance data read by the instanced vertex shader.
+struct InstanceData
+{
+    DirectX::XMFLOAT4X4 World;
+};
+
+// One command of the indirect argument buffer, laid out as described by the
+// command signature: the object constant buffer root CBV, then the draw.
+struct IndirectCommand
+{
+    D3D12_GPU_VIRTUAL_ADDRESS ObjectConstantBuffer;
+    D3D12_DRAW_INDEXED_ARGUMENTS DrawArguments;
+};
+static_assert(sizeof(IndirectCommand) % 4 == 0, "Indirect command stride has to be 4 byte aligned.");
+
+// Input of the culling pass for one indirect command, matches cull.hlsl.
+struct CullInstance
+{
+    // World space AABB.
+    DirectX::XMFLOAT3 Center;
+    // Run of the command, visible commands are compacted inside their run.
+    UINT RunIndex;
+    DirectX::XMFLOAT3 Extents;
+    UINT RunFirstCommand;
+};
+
 struct PassConstants
 {
     DirectX::XMMATRIX View = DirectX::XMMatrixIdentity();
@@ -36,6 +64,7 @@ struct PassConstants
     float farZ = 0.0f;
     float TotalTime = 0.0f;
     float DeltaTime = 0.0f;
+    DirectX::XMFLOAT4 FrustumPlanes[6] = {};
 };
 
 using Microsoft::WRL::ComPtr;
@@ -91,8 +120,30 @@ inline UINT CalculateConstantBufferByteSize(UINT byteSize)
     return (byteSize + (D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1)) & ~(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1);
 }
 
+// Frustum planes (a, b, c, d) of a row-vector view-projection matrix, pointing
+// inwards and not normalized: left, right, bottom, top, near, far. Culling.h
+// tests boxes against them.
+inline void ExtractFrustumPlanes(DirectX::FXMMATRIX viewProj, DirectX::XMFLOAT4 planes[6])
+{
+    using namespace DirectX;
+    // With row vectors, clip = v * M, so the planes come from the columns of M.
+    XMMATRIX columns = XMMatrixTranspose(viewProj);
+
+    XMStoreFloat4(&planes[0], XMVectorAdd(columns.r[3], columns.r[0]));
+    XMStoreFloat4(&planes[1], XMVectorSubtract(columns.r[3], columns.r[0]));
+    XMStoreFloat4(&planes[2], XMVectorAdd(columns.r[3], columns.r[1]));
+    XMStoreFloat4(&planes[3], XMVectorSubtract(columns.r[3], columns.r[1]));
+
+    // Direct3D clip space depth goes from 0 to w.
+    XMStoreFloat4(&planes[4], columns.r[2]);
+    XMStoreFloat4(&planes[5], XMVectorSubtract(columns.r[3], columns.r[2]));
+}
+
 struct SubmeshGeometry
 {
+    // Unique across all geometries, items drawing the same submesh share it.
+    UINT Id = 0;
+
     UINT IndexCount = 0;
     UINT StartIndexLocation = 0;
     INT BaseVertexLocation = 0;
@@ -102,13 +153,13 @@ struct SubmeshGeometry
 
 struct MeshGeometry
 {
-    // Give it a name so we can look it up by name.
+    // Registered in the geometry map under the interned name.
     std::string name;
 
-    // System memory copies.  Use Blobs because the vertex/index format can be generic.
-    // It is up to the client to cast appropriately.
-    ComPtr<ID3DBlob>    VertexBufferCPU = nullptr;
-    ComPtr<ID3DBlob>    IndexBufferCPU = nullptr;
+    // System memory copy of the vertices and indices, kept as the geometry's
+    // residency policy asks. The format is generic, it is up to the client to
+    // interpret the bytes.
+    GeometryCpuCopy CpuCopy;
 
     ComPtr<ID3D12Resource>  VertexBufferGPU = nullptr;
     ComPtr<ID3D12Resource>  IndexBufferGPU = nullptr;
@@ -116,6 +167,10 @@ struct MeshGeometry
     ComPtr<ID3D12Resource>  VertexBufferUploader = nullptr;
     ComPtr<ID3D12Resource>  IndexBufferUploader = nullptr;
 
+    // Copy queue fence value the GPU buffers are filled at, 0 once the
+    // direct queue is known to see them.
+    UINT64 UploadFenceValue = 0;
+
     // Data about the buffers.
     UINT VertexByteStride = 0;
     UINT VertexBufferByteSize = 0;
@@ -124,8 +179,8 @@ struct MeshGeometry
 
     // A mesh geometry may store multiple geometries in one vertex/index buffer.
     // Use this container to define the Submesh geometries so we can draw
-    // the Submeshes individually.
-    std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
+    // the Submeshes individually. Keyed by the submesh name, e.g. "box"_id.
+    FlatHashMap<SubmeshGeometry> DrawArgs;
 
     D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
     {
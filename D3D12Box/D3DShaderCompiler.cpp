@@ -0,0 +1,109 @@
+#include "stdafx.h"
+#include "D3DShaderCompiler.h"
+#include "D3DAppUtil.h"
+#include <algorithm>
+#include <memory>
+
+namespace
+{
+    std::string DirectoryOf(const std::string& path)
+    {
+        size_t slash = path.find_last_of("\\/");
+        return (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // Reads the includes through the file system and records them.
+    class IncludeHandler : public ID3DInclude
+    {
+    public:
+        IncludeHandler(IShaderFileSystem& fileSystem, const std::string& sourcePath, std::vector<std::string>& dependencies) :
+            m_fileSystem(fileSystem),
+            m_sourceDirectory(DirectoryOf(sourcePath)),
+            m_dependencies(dependencies)
+        {}
+
+        HRESULT __stdcall Open(D3D_INCLUDE_TYPE includeType, LPCSTR fileName, LPCVOID parentData, LPCVOID* data, UINT* bytes) override
+        {
+            std::string directory = m_sourceDirectory;
+            if (includeType == D3D_INCLUDE_LOCAL && parentData != nullptr)
+            {
+                auto parent = m_paths.find(parentData);
+                if (parent != m_paths.end())
+                {
+                    directory = DirectoryOf(parent->second);
+                }
+            }
+
+            std::string path = directory + fileName;
+            std::unique_ptr<std::string> contents = std::make_unique<std::string>();
+            if (!m_fileSystem.ReadFile(path, *contents))
+            {
+                return E_FAIL;
+            }
+            if (std::find(m_dependencies.begin(), m_dependencies.end(), path) == m_dependencies.end())
+            {
+                m_dependencies.push_back(path);
+            }
+            *data = contents->data();
+            *bytes = (UINT)contents->size();
+            m_paths[*data] = path;
+            m_contents.push_back(std::move(contents));
+            return S_OK;
+        }
+
+        HRESULT __stdcall Close(LPCVOID data) override
+        {
+            // The contents are released with the handler.
+            return S_OK;
+        }
+
+    private:
+        IShaderFileSystem& m_fileSystem;
+        std::string m_sourceDirectory;
+        std::vector<std::string>& m_dependencies;
+        std::unordered_map<LPCVOID, std::string> m_paths;
+        std::vector<std::unique_ptr<std::string>> m_contents;
+    };
+}
+
+std::string WideToUtf8(const std::wstring& text)
+{
+    int length = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), nullptr, 0, nullptr, nullptr);
+    std::string utf8(length, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), &utf8[0], length, nullptr, nullptr);
+    return utf8;
+}
+
+std::string D3DShaderCompiler::Identifier()const
+{
+    return "d3dcompiler_" + std::to_string(D3D_COMPILER_VERSION);
+}
+
+bool D3DShaderCompiler::Compile(const ShaderCompileRequest& request, const std::string& source,
+    IShaderFileSystem& fileSystem, ShaderCompileResult& result)
+{
+    std::vector<D3D_SHADER_MACRO> macros;
+    for (const auto& define : request.Defines)
+    {
+        macros.push_back({ define.first.c_str(), define.second.c_str() });
+    }
+    macros.push_back({ nullptr, nullptr });
+
+    IncludeHandler include(fileSystem, request.SourcePath, result.Dependencies);
+    ComPtr<ID3DBlob> bytecode;
+    ComPtr<ID3DBlob> errors;
+    HRESULT hr = D3DCompile(source.data(), source.size(), request.SourcePath.c_str(), macros.data(), &include,
+        request.EntryPoint.c_str(), request.Target.c_str(), request.Flags, 0, &bytecode, &errors);
+    if (errors != nullptr)
+    {
+        result.Errors.assign(static_cast<const char*>(errors->GetBufferPointer()), errors->GetBufferSize());
+        ::OutputDebugStringA(result.Errors.c_str());
+    }
+    if (FAILED(hr))
+    {
+        return false;
+    }
+    const uint8_t* data = static_cast<const uint8_t*>(bytecode->GetBufferPointer());
+    result.Bytecode.assign(data, data + bytecode->GetBufferSize());
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include "stdafx.h"
+#include "ShaderCache.h"
+
+// Compiles HLSL with the FXC compiler (d3dcompiler_47). Quoted includes are
+// resolved relative to the including file, angle bracket ones relative to
+// the source.
+class D3DShaderCompiler : public IShaderCompiler
+{
+public:
+    std::string Identifier()const override;
+    bool Compile(const ShaderCompileRequest& request, const std::string& source,
+        IShaderFileSystem& fileSystem, ShaderCompileResult& result) override;
+};
+
+std::string WideToUtf8(const std::wstring& text);
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class RenderItem;
+
+// Render layers are drawn in ascending order.
+enum class RenderLayer : uint32_t
+{
+    Opaque = 0,
+    Count
+};
+
+// A draw packet is a render item paired with the 64-bit key it is sorted by.
+// Sorting the packets by key groups draws by render layer, then pipeline state,
+// then mesh, and orders them by depth inside each group.
+//
+//  63..60  render layer
+//  59..48  pipeline state index
+//  47..32  mesh id
+//  31..0   view space depth
+struct DrawPacket
+{
+    uint64_t SortKey = 0;
+    RenderItem* Item = nullptr;
+};
+
+uint64_t BuildSortKey(RenderLayer layer, uint32_t pipelineStateIndex, uint32_t meshId, float viewDepth);
+
+// LSD radix sort of the packets by SortKey, one 8-bit digit per pass.
+// Passes whose digit is the same for every key are skipped.
+// scratch is used as the ping-pong buffer and keeps its capacity between calls.
+void RadixSortDrawPackets(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch);
+
+struct DrawPacketSortTimings
+{
+    double RadixSortMs = 0.0;
+    double StdSortMs = 0.0;
+};
+
+// Sorts packetCount random keys with RadixSortDrawPackets and with std::sort.
+DrawPacketSortTimings BenchmarkDrawPacketSort(uint32_t packetCount);
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "stdafx.h"
+#include "FileWatcher.h"
+#include <algorithm>
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    std::wstring Utf8ToWide(const std::string& text)
+    {
+        int length = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), (int)text.size(), nullptr, 0);
+        std::wstring wide(length, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, text.c_str(), (int)text.size(), &wide[0], length);
+        return wide;
+    }
+
+    std::string WideToUtf8(const wchar_t* text, int size)
+    {
+        int length = WideCharToMultiByte(CP_UTF8, 0, text, size, nullptr, 0, nullptr, nullptr);
+        std::string utf8(length, '\0');
+        WideCharToMultiByte(CP_UTF8, 0, text, size, &utf8[0], length, nullptr, nullptr);
+        return utf8;
+    }
+#else
+    // How long the thread sleeps before it checks whether it has to quit.
+    const int PollTimeoutMs = 100;
+#endif
+}
+
+std::string NormalizePath(const std::string& path)
+{
+    std::string normalized = path;
+    std::replace(normalized.begin(), normalized.end(), '\\', '/');
+#ifdef _WIN32
+    // Only ASCII is folded, enough for the asset names.
+    std::transform(normalized.begin(), normalized.end(), normalized.begin(),
+        [](char c) { return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c; });
+#endif
+    return normalized;
+}
+
+FileWatcher::FileWatcher(const std::string& directory) :
+    m_directory(NormalizePath(directory))
+{
+    if (!m_directory.empty() && m_directory.back() != '/')
+    {
+        m_directory += '/';
+    }
+
+#ifdef _WIN32
+    HANDLE directoryHandle = CreateFileW(Utf8ToWide(directory).c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (directoryHandle == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+    m_directoryHandle = directoryHandle;
+    m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+#else
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0)
+    {
+        return;
+    }
+    // Editors either write the file or write a new one and rename it over.
+    if (inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        close(m_inotify);
+        m_inotify = -1;
+        return;
+    }
+#endif
+    m_thread = std::thread(&FileWatcher::WatchThreadMain, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+    m_quit.store(true, std::memory_order_release);
+#ifdef _WIN32
+    if (m_stopEvent != nullptr)
+    {
+        SetEvent(m_stopEvent);
+    }
+#endif
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+#ifdef _WIN32
+    if (m_stopEvent != nullptr)
+    {
+        CloseHandle(m_stopEvent);
+    }
+    if (m_directoryHandle != nullptr)
+    {
+        CloseHandle(m_directoryHandle);
+    }
+#else
+    if (m_inotify >= 0)
+    {
+        close(m_inotify);
+    }
+#endif
+}
+
+std::vector<std::string> FileWatcher::TakeChangedFiles()
+{
+    std::vector<std::string> changedFiles;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::swap(changedFiles, m_changedFiles);
+    return changedFiles;
+}
+
+void FileWatcher::AddChangedFile(const std::string& name)
+{
+    // A save usually reports several events, the file is listed once.
+    std::string path = NormalizePath(m_directory + name);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (std::find(m_changedFiles.begin(), m_changedFiles.end(), path) == m_changedFiles.end())
+    {
+        m_changedFiles.push_back(path);
+    }
+}
+
+#ifdef _WIN32
+void FileWatcher::WatchThreadMain()
+{
+    HANDLE changeEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    // DWORD aligned as ReadDirectoryChangesW requires.
+    std::vector<DWORD> buffer(16 * 1024);
+
+    while (!m_quit.load(std::memory_order_acquire))
+    {
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = changeEvent;
+        ResetEvent(changeEvent);
+        if (!ReadDirectoryChangesW(m_directoryHandle, buffer.data(), (DWORD)(buffer.size() * sizeof(DWORD)), FALSE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, nullptr, &overlapped, nullptr))
+        {
+            break;
+        }
+
+        HANDLE events[] = { changeEvent, m_stopEvent };
+        if (WaitForMultipleObjects(_countof(events), events, FALSE, INFINITE) != WAIT_OBJECT_0)
+        {
+            CancelIo(m_directoryHandle);
+            WaitForSingleObject(changeEvent, INFINITE);
+            break;
+        }
+
+        DWORD size = 0;
+        if (!GetOverlappedResult(m_directoryHandle, &overlapped, &size, FALSE) || size == 0)
+        {
+            // The buffer overflowed, the changes are lost until the next ones.
+            continue;
+        }
+
+        const BYTE* record = reinterpret_cast<const BYTE*>(buffer.data());
+        for (;;)
+        {
+            const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(record);
+            if (info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_ADDED ||
+                info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+            {
+                AddChangedFile(WideToUtf8(info->FileName, (int)(info->FileNameLength / sizeof(WCHAR))));
+            }
+            if (info->NextEntryOffset == 0)
+            {
+                break;
+            }
+            record += info->NextEntryOffset;
+        }
+    }
+    CloseHandle(changeEvent);
+}
+#else
+void FileWatcher::WatchThreadMain()
+{
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (!m_quit.load(std::memory_order_acquire))
+    {
+        pollfd descriptor = {};
+        descriptor.fd = m_inotify;
+        descriptor.events = POLLIN;
+        if (poll(&descriptor, 1, PollTimeoutMs) <= 0)
+        {
+            continue;
+        }
+
+        ssize_t size = read(m_inotify, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < size;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            if (event->len > 0 && (event->mask & IN_ISDIR) == 0)
+            {
+                AddChangedFile(event->name);
+            }
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Same path spelled the same way: '/' separators, and lower case on Windows
+// where paths are case insensitive. UTF-8.
+std::string NormalizePath(const std::string& path);
+
+// Watches the files of a directory, not its subdirectories, from a thread
+// that sleeps until the system reports a change: ReadDirectoryChangesW on
+// Windows, inotify elsewhere. Paths are UTF-8.
+class FileWatcher
+{
+public:
+    explicit FileWatcher(const std::string& directory);
+    FileWatcher(const FileWatcher& rhs) = delete;
+    FileWatcher& operator=(const FileWatcher& rhs) = delete;
+    ~FileWatcher();
+
+    // False if the directory cannot be watched.
+    bool IsWatching()const { return m_thread.joinable(); }
+
+    // Normalized paths of the files written, created or renamed into the
+    // directory since the last call, each once. Thread safe.
+    std::vector<std::string> TakeChangedFiles();
+
+private:
+    void WatchThreadMain();
+    void AddChangedFile(const std::string& name);
+
+    std::string m_directory;
+    std::thread m_thread;
+    std::atomic<bool> m_quit{ false };
+
+    std::mutex m_mutex;
+    std::vector<std::string> m_changedFiles;
+
+#ifdef _WIN32
+    void* m_directoryHandle = nullptr;
+    void* m_stopEvent = nullptr;
+#else
+    int m_inotify = -1;
+#endif
+};
\ No newline at end of file
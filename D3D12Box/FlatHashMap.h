@@ -0,0 +1,139 @@
+#pragma once
+#include "StringId.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Registry keyed by StringId. Values are stored contiguously in insertion
+// order, an open addressing table with linear probing maps the ids to them.
+// Ids are already hashes, so their low bits pick the slot directly.
+//
+// Pointers to the values are invalidated when an insertion grows the map.
+// Entries are never removed: the registries only fill at load time.
+template<typename T>
+class FlatHashMap
+{
+public:
+    typedef std::pair<StringId, T> Entry;
+    typedef typename std::vector<Entry>::iterator Iterator;
+    typedef typename std::vector<Entry>::const_iterator ConstIterator;
+
+    // Null if the id is missing.
+    T* Find(StringId key)
+    {
+        if (m_slots.empty())
+        {
+            return nullptr;
+        }
+        uint32_t entry = m_slots[FindSlot(key)].Entry;
+        if (entry == InvalidEntry)
+        {
+            return nullptr;
+        }
+        return &m_entries[entry].second;
+    }
+
+    const T* Find(StringId key)const
+    {
+        return const_cast<FlatHashMap*>(this)->Find(key);
+    }
+
+    bool Contains(StringId key)const { return Find(key) != nullptr; }
+
+    // The id has to be in the map.
+    T& At(StringId key)
+    {
+        T* value = Find(key);
+        assert(value != nullptr && "StringId missing from the map.");
+        return *value;
+    }
+
+    const T& At(StringId key)const
+    {
+        return const_cast<FlatHashMap*>(this)->At(key);
+    }
+
+    // Inserts a default value if the id is missing.
+    T& operator[](StringId key)
+    {
+        assert(key.IsValid());
+        if ((m_entries.size() + 1) * 2 > m_slots.size())
+        {
+            Rehash((std::max)(m_slots.size() * 2, (size_t)16));
+        }
+        Slot& slot = m_slots[FindSlot(key)];
+        if (slot.Entry == InvalidEntry)
+        {
+            slot.Key = key.Value();
+            slot.Entry = (uint32_t)m_entries.size();
+            m_entries.emplace_back(key, T());
+        }
+        return m_entries[slot.Entry].second;
+    }
+
+    void Reserve(size_t count)
+    {
+        m_entries.reserve(count);
+        size_t slotCount = 16;
+        while (slotCount < count * 2)
+        {
+            slotCount *= 2;
+        }
+        if (slotCount > m_slots.size())
+        {
+            Rehash(slotCount);
+        }
+    }
+
+    void Clear()
+    {
+        m_entries.clear();
+        m_slots.clear();
+    }
+
+    size_t Size()const { return m_entries.size(); }
+    bool Empty()const { return m_entries.empty(); }
+
+    Iterator begin() { return m_entries.begin(); }
+    Iterator end() { return m_entries.end(); }
+    ConstIterator begin()const { return m_entries.begin(); }
+    ConstIterator end()const { return m_entries.end(); }
+
+private:
+    static const uint32_t InvalidEntry = UINT32_MAX;
+
+    struct Slot
+    {
+        uint64_t Key = 0;
+        uint32_t Entry = InvalidEntry;
+    };
+
+    // Slot holding the id, or the empty slot it would go to.
+    size_t FindSlot(StringId key)const
+    {
+        size_t mask = m_slots.size() - 1;
+        size_t index = (size_t)key.Value() & mask;
+        while (m_slots[index].Entry != InvalidEntry && m_slots[index].Key != key.Value())
+        {
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    // slotCount is a power of two.
+    void Rehash(size_t slotCount)
+    {
+        m_slots.assign(slotCount, Slot());
+        for (uint32_t i = 0; i < (uint32_t)m_entries.size(); i++)
+        {
+            Slot& slot = m_slots[FindSlot(m_entries[i].first)];
+            slot.Key = m_entries[i].first.Value();
+            slot.Entry = i;
+        }
+    }
+
+    std::vector<Entry> m_entries;
+    std::vector<Slot> m_slots;
+};
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace
+{
+    const size_t BlockAlignment = alignof(std::max_align_t);
+
+    // Sized for the few containers a function builds.
+    const size_t ScratchArenaCapacity = 16 * 1024;
+
+    std::pmr::memory_resource* Upstream()
+    {
+        return std::pmr::new_delete_resource();
+    }
+}
+
+FrameArena::FrameArena(size_t capacity) :
+    m_capacity(capacity)
+{
+    if (m_capacity > 0)
+    {
+        m_block = static_cast<unsigned char*>(Upstream()->allocate(m_capacity, BlockAlignment));
+    }
+}
+
+FrameArena::~FrameArena()
+{
+    FreeOverflows(0);
+    if (m_block != nullptr)
+    {
+        Upstream()->deallocate(m_block, m_capacity, BlockAlignment);
+    }
+}
+
+FrameArena::Marker FrameArena::Mark()const
+{
+    Marker marker;
+    marker.Offset = m_offset;
+    marker.OverflowCount = m_overflows.size();
+    return marker;
+}
+
+void FrameArena::Rewind(const Marker& marker)
+{
+    if (marker.Offset == 0 && marker.OverflowCount == 0)
+    {
+        Reset();
+        return;
+    }
+    assert(marker.Offset <= m_offset && marker.OverflowCount <= m_overflows.size());
+    FreeOverflows(marker.OverflowCount);
+    m_offset = marker.Offset;
+}
+
+void FrameArena::Reset()
+{
+    m_lastPeak = m_peak;
+    m_peak = 0;
+    bool overflowed = !m_overflows.empty();
+    FreeOverflows(0);
+    m_offset = 0;
+
+    // The block grows past the peak, the padding of the aligned allocations
+    // may differ once they are in it.
+    if (overflowed)
+    {
+        size_t capacity = (std::max)(m_capacity * 2, m_lastPeak + m_lastPeak / 4);
+        if (m_block != nullptr)
+        {
+            Upstream()->deallocate(m_block, m_capacity, BlockAlignment);
+        }
+        m_block = static_cast<unsigned char*>(Upstream()->allocate(capacity, BlockAlignment));
+        m_capacity = capacity;
+    }
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+    uintptr_t begin = reinterpret_cast<uintptr_t>(m_block);
+    uintptr_t aligned = (begin + m_offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    size_t offset = (size_t)(aligned - begin);
+
+    void* memory = nullptr;
+    if (m_block != nullptr && offset + bytes <= m_capacity)
+    {
+        m_offset = offset + bytes;
+        memory = m_block + offset;
+    }
+    else
+    {
+        memory = Upstream()->allocate(bytes, alignment);
+        Overflow overflow;
+        overflow.Memory = memory;
+        overflow.Size = bytes;
+        overflow.Alignment = alignment;
+        m_overflows.push_back(overflow);
+        m_overflowBytes += bytes;
+        m_totalOverflowCount++;
+    }
+    m_peak = (std::max)(m_peak, Used());
+    return memory;
+}
+
+void FrameArena::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+    // Freed by Rewind or Reset.
+    (void)p;
+    (void)bytes;
+    (void)alignment;
+}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource& other)const noexcept
+{
+    return this == &other;
+}
+
+void FrameArena::FreeOverflows(size_t count)
+{
+    while (m_overflows.size() > count)
+    {
+        const Overflow& overflow = m_overflows.back();
+        Upstream()->deallocate(overflow.Memory, overflow.Size, overflow.Alignment);
+        m_overflowBytes -= overflow.Size;
+        m_overflows.pop_back();
+    }
+}
+
+FrameArena& ThreadScratchArena()
+{
+    thread_local FrameArena arena(ScratchArenaCapacity);
+    return arena;
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Linear allocator for memory that lives at most one frame. Allocating bumps
+// an offset, deallocating does nothing and Reset frees everything at once.
+// Containers use it through std::pmr, e.g. std::pmr::vector<T> list(&arena).
+//
+// An allocation that does not fit in the block falls back to the heap. The
+// next Reset grows the block to the peak usage, so the following frames fit
+// in it and stop allocating. Not thread safe: a frame arena belongs to the
+// thread owning its frame, jobs use the scratch arena of their thread.
+class FrameArena : public std::pmr::memory_resource
+{
+public:
+    // Position of the arena, the allocations made after it can be freed together.
+    struct Marker
+    {
+        size_t Offset = 0;
+        size_t OverflowCount = 0;
+    };
+
+    explicit FrameArena(size_t capacity = 64 * 1024);
+    FrameArena(const FrameArena& rhs) = delete;
+    FrameArena& operator=(const FrameArena& rhs) = delete;
+    ~FrameArena();
+
+    Marker Mark()const;
+    // Frees what was allocated after marker. Rewinding to an empty marker is a Reset.
+    void Rewind(const Marker& marker);
+    // Frees everything, the frame is done with the memory.
+    void Reset();
+
+    size_t Capacity()const { return m_capacity; }
+    // Bytes in use, the heap fallbacks included.
+    size_t Used()const { return m_offset + m_overflowBytes; }
+    // Highest usage between the last two resets.
+    size_t LastPeak()const { return m_lastPeak; }
+    // Allocations that fell back to the heap since the arena was created.
+    size_t OverflowCount()const { return m_totalOverflowCount; }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override;
+
+private:
+    struct Overflow
+    {
+        void* Memory;
+        size_t Size;
+        size_t Alignment;
+    };
+
+    void FreeOverflows(size_t count);
+
+    unsigned char* m_block = nullptr;
+    size_t m_capacity = 0;
+    size_t m_offset = 0;
+
+    std::vector<Overflow> m_overflows;
+    size_t m_overflowBytes = 0;
+    size_t m_totalOverflowCount = 0;
+
+    size_t m_peak = 0;
+    size_t m_lastPeak = 0;
+};
+
+// Scratch arena of the calling thread, for containers that do not outlive
+// the function creating them. Use it through a ScratchScope.
+FrameArena& ThreadScratchArena();
+
+// Rewinds the scratch arena of the thread when it goes out of scope. Scopes
+// nest, the outermost one resets the arena.
+class ScratchScope
+{
+public:
+    ScratchScope() :
+        m_arena(ThreadScratchArena()),
+        m_marker(m_arena.Mark())
+    {}
+    ScratchScope(const ScratchScope& rhs) = delete;
+    ScratchScope& operator=(const ScratchScope& rhs) = delete;
+    ~ScratchScope() { m_arena.Rewind(m_marker); }
+
+    std::pmr::memory_resource* Resource()const { return &m_arena; }
+
+private:
+    FrameArena& m_arena;
+    FrameArena::Marker m_marker;
+};
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "FramePacer.h"
+#include <algorithm>
+
+namespace
+{
+    // Weight of the newest sample in the moving averages.
+    const double AverageWeight = 0.1;
+
+    void Accumulate(double& average, double sample)
+    {
+        average += (sample - average) * AverageWeight;
+    }
+}
+
+FramePacer::FramePacer(uint32_t maxFramesInFlight, NowFunction now) :
+    m_maxFramesInFlight((std::max)(maxFramesInFlight, 1u)),
+    m_now(std::move(now)),
+    m_framesInFlight((std::max)(maxFramesInFlight, 1u)),
+    m_history(2 * (std::max)(maxFramesInFlight, 1u) + 2),
+    m_lastFrameStart(m_now())
+{
+    m_stats.FramesInFlight = m_framesInFlight;
+}
+
+void FramePacer::SetPolicy(PacingPolicy policy)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_policy = policy;
+}
+
+void FramePacer::SetLatencyTarget(double milliseconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_latencyTargetMs = milliseconds;
+}
+
+void FramePacer::SetFrameTimeTarget(double milliseconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_frameTimeTargetMs = milliseconds;
+}
+
+void FramePacer::SetFramesInFlight(uint32_t framesInFlight)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_framesInFlight = (std::min)((std::max)(framesInFlight, 1u), m_maxFramesInFlight);
+    m_stats.FramesInFlight = m_framesInFlight;
+    m_framesSinceAdapt = 0;
+}
+
+void FramePacer::SetAdaptive(bool adaptive)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_adaptive = adaptive;
+}
+
+uint64_t FramePacer::BeginFrame()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_nextFrame++;
+}
+
+uint64_t FramePacer::FenceToWaitFor(uint64_t frame)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (frame < m_framesInFlight)
+    {
+        return 0;
+    }
+
+    // The depth is read once, a concurrent change applies from the next frame.
+    uint64_t previousFrame = frame - m_framesInFlight;
+    m_submitted.wait(lock, [this, previousFrame]()
+    {
+        return m_closed || Record(previousFrame).Frame == previousFrame;
+    });
+    return m_closed ? 0 : Record(previousFrame).FenceValue;
+}
+
+std::chrono::duration<double, std::milli> FramePacer::EndWait(uint64_t frame, std::chrono::duration<double, std::milli> waitTime)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Clock::time_point now = m_now();
+    Accumulate(m_stats.CpuWaitMs, waitTime.count());
+
+    // The frame limiter spaces the starts of the frames by the frame time target.
+    std::chrono::duration<double, std::milli> sleepTime(0.0);
+    std::chrono::duration<double, std::milli> sinceLastFrame = now - m_lastFrameStart;
+    if (m_frameTimeTargetMs > 0.0 && frame > 0)
+    {
+        sleepTime = std::chrono::duration<double, std::milli>(
+            (std::max)(0.0, m_frameTimeTargetMs - sinceLastFrame.count()));
+    }
+    Accumulate(m_stats.SleepMs, sleepTime.count());
+    if (frame > 0)
+    {
+        Accumulate(m_stats.FrameMs, sinceLastFrame.count() + sleepTime.count());
+    }
+    m_lastFrameStart = now + std::chrono::duration_cast<Clock::duration>(sleepTime);
+
+    if (m_adaptive && ++m_framesSinceAdapt >= m_adaptInterval)
+    {
+        Adapt();
+        m_framesSinceAdapt = 0;
+    }
+    return sleepTime;
+}
+
+void FramePacer::OnFrameSubmitted(uint64_t frame, uint64_t fenceValue)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        FrameRecord& record = Record(frame);
+        record.Frame = frame;
+        record.FenceValue = fenceValue;
+        record.SubmitTime = m_now();
+        record.Completed = false;
+    }
+    m_submitted.notify_all();
+}
+
+void FramePacer::OnFenceCompleted(uint64_t completedFenceValue)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Clock::time_point now = m_now();
+
+    // The completion is only seen when the fence is read, so the latency is
+    // an upper bound with the resolution of the calls.
+    for (FrameRecord& record : m_history)
+    {
+        if (record.Frame != UINT64_MAX && !record.Completed && record.FenceValue <= completedFenceValue)
+        {
+            record.Completed = true;
+            Accumulate(m_stats.GpuLatencyMs, std::chrono::duration<double, std::milli>(now - record.SubmitTime).count());
+        }
+    }
+}
+
+void FramePacer::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_submitted.notify_all();
+}
+
+FramePacingStats FramePacer::Stats()const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void FramePacer::Adapt()
+{
+    // The CPU is stalled by the GPU for a noticeable part of the frame.
+    bool cpuStalled = m_stats.CpuWaitMs > 0.1 * m_stats.FrameMs;
+
+    if (m_policy == PacingPolicy::Latency)
+    {
+        // Fewer frames queued ahead shortens the time a frame waits on the GPU.
+        if (m_stats.GpuLatencyMs > m_latencyTargetMs && m_framesInFlight > 1)
+        {
+            m_framesInFlight--;
+        }
+        else if (m_stats.GpuLatencyMs < 0.5 * m_latencyTargetMs && cpuStalled &&
+            m_framesInFlight < m_maxFramesInFlight)
+        {
+            // Enough latency budget left to buy back some throughput.
+            m_framesInFlight++;
+        }
+    }
+    else
+    {
+        if (m_frameTimeTargetMs <= 0.0)
+        {
+            // No target, as fast as possible.
+            m_framesInFlight = m_maxFramesInFlight;
+        }
+        else if (m_stats.FrameMs > 1.05 * m_frameTimeTargetMs && cpuStalled &&
+            m_framesInFlight < m_maxFramesInFlight)
+        {
+            m_framesInFlight++;
+        }
+        else if (m_stats.SleepMs > 0.1 * m_frameTimeTargetMs && !cpuStalled && m_framesInFlight > 1)
+        {
+            // The target is met with time to spare, give the extra depth back as latency.
+            m_framesInFlight--;
+        }
+    }
+    m_stats.FramesInFlight = m_framesInFlight;
+}
\ No newline at end of file
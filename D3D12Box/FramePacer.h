@@ -0,0 +1,114 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// What the frame pacer optimizes for.
+enum class PacingPolicy
+{
+    // Keep the submit to GPU completion time of a frame under the latency target.
+    Latency,
+    // Keep the frame time under the frame time target with as few frames in flight as possible.
+    Throughput
+};
+
+// Averages over the last frames, in milliseconds.
+struct FramePacingStats
+{
+    // CPU time spent blocked on the GPU before a frame could start.
+    double CpuWaitMs = 0.0;
+    // From the submission of a frame to the moment its fence was seen completed.
+    double GpuLatencyMs = 0.0;
+    // Between the starts of two consecutive frames.
+    double FrameMs = 0.0;
+    // Slept by the frame limiter before a frame.
+    double SleepMs = 0.0;
+    uint32_t FramesInFlight = 0;
+};
+
+// Decides how many frames the CPU may run ahead of the GPU. Before frame N is
+// built, frame N - FramesInFlight has to be complete on the GPU; the frame
+// resources limit the depth to maxFramesInFlight. The pacer only does the
+// bookkeeping, the caller waits on the fence it returns and reports the fence
+// values it observes. Frames may be started and submitted on different threads.
+class FramePacer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<Clock::time_point()> NowFunction;
+
+    // now reads the time, tests pass a simulated clock.
+    explicit FramePacer(uint32_t maxFramesInFlight, NowFunction now = Clock::now);
+    FramePacer(const FramePacer& rhs) = delete;
+    FramePacer& operator=(const FramePacer& rhs) = delete;
+
+    void SetPolicy(PacingPolicy policy);
+    // Used by the Latency policy.
+    void SetLatencyTarget(double milliseconds);
+    // Frames start at most this often, 0 disables the limiter. Also the target of the Throughput policy.
+    void SetFrameTimeTarget(double milliseconds);
+    // Fixes the depth, clamped to [1, maxFramesInFlight]. Adaptation continues from there if enabled.
+    void SetFramesInFlight(uint32_t framesInFlight);
+    void SetAdaptive(bool adaptive);
+
+    // Starts a new frame and returns its number.
+    uint64_t BeginFrame();
+
+    // Fence value the GPU has to reach before the frame can start, 0 if none.
+    // Blocks until that frame has been submitted, which matters when another
+    // thread submits the frames. Returns 0 if the pacer was closed meanwhile.
+    uint64_t FenceToWaitFor(uint64_t frame);
+
+    // Records the CPU wait of the frame, adapts the depth and returns how long
+    // the caller should sleep before building the frame.
+    std::chrono::duration<double, std::milli> EndWait(uint64_t frame, std::chrono::duration<double, std::milli> waitTime);
+
+    void OnFrameSubmitted(uint64_t frame, uint64_t fenceValue);
+
+    // Stamps the completion time of the frames whose fence value is reached.
+    void OnFenceCompleted(uint64_t completedFenceValue);
+
+    // Wakes up the threads blocked in FenceToWaitFor for good.
+    void Close();
+
+    uint32_t MaxFramesInFlight()const { return m_maxFramesInFlight; }
+    FramePacingStats Stats()const;
+
+private:
+    struct FrameRecord
+    {
+        uint64_t Frame = UINT64_MAX;
+        uint64_t FenceValue = 0;
+        Clock::time_point SubmitTime;
+        bool Completed = false;
+    };
+
+    FrameRecord& Record(uint64_t frame) { return m_history[frame % m_history.size()]; }
+    void Adapt();
+
+    const uint32_t m_maxFramesInFlight;
+    const NowFunction m_now;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_submitted;
+    bool m_closed = false;
+
+    PacingPolicy m_policy = PacingPolicy::Throughput;
+    bool m_adaptive = true;
+    double m_latencyTargetMs = 50.0;
+    double m_frameTimeTargetMs = 0.0;
+    uint32_t m_framesInFlight;
+
+    // Ring of the last frames, large enough for every frame in flight.
+    std::vector<FrameRecord> m_history;
+    uint64_t m_nextFrame = 0;
+    Clock::time_point m_lastFrameStart;
+
+    // Exponential moving averages, the depth changes at most every m_adaptInterval frames.
+    FramePacingStats m_stats;
+    uint32_t m_framesSinceAdapt = 0;
+    const uint32_t m_adaptInterval = 30;
+};
\ No newline at end of file
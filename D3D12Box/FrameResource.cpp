@@ -1,14 +1,71 @@
 #include "stdafx.h"
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT instanceCount)
 {
     ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator)));
+    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_postCommandAllocator)));
+    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_postCommandAllocator.Get(), nullptr, IID_PPV_ARGS(&m_postCommandList)));
+    ThrowIfFailed(m_postCommandList->Close());
     m_passConstantBuffer = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
     m_objectConstantBuffer = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+    m_instanceBuffer = std::make_unique<UploadBuffer<InstanceData>>(device, instanceCount, false);
+    m_indirectArgumentBuffer = std::make_unique<UploadBuffer<IndirectCommand>>(device, objectCount, false);
+    m_cullInstanceBuffer = std::make_unique<UploadBuffer<CullInstance>>(device, objectCount, false);
+
+    CD3DX12_HEAP_PROPERTIES defaultHeap(D3D12_HEAP_TYPE_DEFAULT);
+    CD3DX12_RESOURCE_DESC argumentBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(
+        (UINT64)objectCount * sizeof(IndirectCommand), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &defaultHeap,
+        D3D12_HEAP_FLAG_NONE,
+        &argumentBufferDesc,
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+        nullptr,
+        IID_PPV_ARGS(&m_culledArgumentBuffer)));
+
+    // There are at most as many runs as objects.
+    CD3DX12_RESOURCE_DESC countBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(
+        (UINT64)objectCount * sizeof(UINT), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &defaultHeap,
+        D3D12_HEAP_FLAG_NONE,
+        &countBufferDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&m_culledCountBuffer)));
 }
 
 FrameResource::~FrameResource()
 {
 
+}
+
+void FrameResource::EnsureWorkerCommandLists(ID3D12Device* device, UINT count)
+{
+    while (m_workerCommandLists.size() < count)
+    {
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList;
+        ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator)));
+        ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator.Get(), nullptr, IID_PPV_ARGS(&commandList)));
+
+        // Command lists are created in the recording state, close it until it is used.
+        ThrowIfFailed(commandList->Close());
+
+        m_workerCommandAllocators.push_back(allocator);
+        m_workerCommandLists.push_back(commandList);
+    }
+}
+
+void FrameResource::EnsureComputeCommandList(ID3D12Device* device)
+{
+    if (m_computeCommandList != nullptr)
+    {
+        return;
+    }
+    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS(&m_computeCommandAllocator)));
+    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE,
+        m_computeCommandAllocator.Get(), nullptr, IID_PPV_ARGS(&m_computeCommandList)));
+    ThrowIfFailed(m_computeCommandList->Close());
 }
\ No newline at end of file
@@ -1,23 +1,56 @@
 #pragma once
 #include "stdafx.h"
 #include "UploadBuffer.h"
+#include "FrameArena.h"
 class FrameResource
 {
 public:
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT instanceCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
 
+    // Grows the pool of worker command lists to at least count.
+    void EnsureWorkerCommandLists(ID3D12Device* device, UINT count);
+
+    // Creates the compute command list the first time it is needed.
+    void EnsureComputeCommandList(ID3D12Device* device);
+
     // Before GPU handled all commands tied with the command allocator,
     // Cannot be reset.
     // Every frame should has its own command allocator.
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator>  m_commandAllocator;
+
+    // Draws are recorded by several threads, each one into its own
+    // allocator and command list. The post command list closes the frame.
+    std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>>     m_workerCommandAllocators;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>>  m_workerCommandLists;
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator>      m_postCommandAllocator;
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>   m_postCommandList;
+
+    // Work submitted to the async compute queue.
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator>      m_computeCommandAllocator;
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>   m_computeCommandList;
     
     // Before GPU had executed all commands refer to the constant buffer, cannot update this.
     // Every frame should has its own constant buffer.
     std::unique_ptr<UploadBuffer<PassConstants>>    m_passConstantBuffer = nullptr;
     std::unique_ptr<UploadBuffer<ObjectConstants>>  m_objectConstantBuffer = nullptr;
 
-    UINT m_fenceValue = 0;
+    // World matrices of the instanced draws, read through SV_InstanceID.
+    std::unique_ptr<UploadBuffer<InstanceData>>     m_instanceBuffer = nullptr;
+
+    // Arguments consumed by ExecuteIndirect, one command per visible object.
+    std::unique_ptr<UploadBuffer<IndirectCommand>>  m_indirectArgumentBuffer = nullptr;
+
+    // GPU culling reads the instances, writes the visible commands of each run
+    // to the culled argument buffer and their number to the count buffer.
+    std::unique_ptr<UploadBuffer<CullInstance>>     m_cullInstanceBuffer = nullptr;
+    Microsoft::WRL::ComPtr<ID3D12Resource>          m_culledArgumentBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource>          m_culledCountBuffer;
+
+    // Transient CPU memory of the frame, reset once the GPU reaches m_fenceValue.
+    FrameArena m_frameArena;
+
+    UINT64 m_fenceValue = 0;
 };
\ No newline at end of file
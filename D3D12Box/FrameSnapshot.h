@@ -0,0 +1,31 @@
+#pragma once
+#include "stdafx.h"
+#include "DrawPacket.h"
+#include "InstanceBatcher.h"
+#include "IndirectCommandBuilder.h"
+
+class FrameResource;
+
+// Everything the render thread needs to record a simulated frame. The
+// simulation thread fills it and hands it over read only; it is written
+// again only once its frame resource comes back from the render thread.
+// There is one snapshot per frame resource, so the vectors keep their
+// capacity from frame to frame.
+struct FrameSnapshot
+{
+    UINT64 FrameNumber = 0;
+    // Copy fence value the geometry drawn by the frame was uploaded with.
+    UINT64 UploadFenceValue = 0;
+    UINT FrameResourceIndex = 0;
+    FrameResource* Resource = nullptr;
+
+    // The pipeline states of the frame. Hot reload replaces them between
+    // frames, a snapshot keeps the ones its packets were checked against.
+    std::vector<ID3D12PipelineState*> PipelineStates;
+    std::vector<ID3D12PipelineState*> InstancedPipelineStates;
+    ID3D12PipelineState* CullingPipelineState = nullptr;
+
+    std::vector<DrawPacket> DrawPackets;
+    std::vector<InstanceBatch> Batches;
+    std::vector<IndirectDrawRun> Runs;
+};
\ No newline at end of file
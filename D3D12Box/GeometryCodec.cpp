@@ -0,0 +1,582 @@
+#include "GeometryCodec.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if !defined(GEOMETRY_CODEC_SIMD)
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define GEOMETRY_CODEC_SIMD 1
+#else
+#define GEOMETRY_CODEC_SIMD 0
+#endif
+#endif
+
+#if GEOMETRY_CODEC_SIMD
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const size_t MaxVarintSize = 5;
+    const size_t GroupSize = 16;
+
+    // Payload bytes of a group by its 2-bit header.
+    const size_t GroupPayloadSize[4] = { 0, 4, 8, 16 };
+
+    uint32_t ZigZag(int32_t value)
+    {
+        return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    }
+
+    int32_t UnZigZag(uint32_t value)
+    {
+        return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+    }
+
+    uint8_t ZigZagByte(uint8_t delta)
+    {
+        return (uint8_t)((delta << 1) ^ (uint8_t)((int8_t)delta >> 7));
+    }
+
+#if !GEOMETRY_CODEC_SIMD
+    uint8_t UnZigZagByte(uint8_t value)
+    {
+        return (uint8_t)((value >> 1) ^ (uint8_t)-(int8_t)(value & 1));
+    }
+#endif
+
+    uint32_t LoadIndex(const void* indices, size_t i, uint32_t indexSize)
+    {
+        if (indexSize == 2)
+        {
+            return static_cast<const uint16_t*>(indices)[i];
+        }
+        return static_cast<const uint32_t*>(indices)[i];
+    }
+
+    void StoreIndex(void* indices, size_t i, uint32_t indexSize, uint32_t value)
+    {
+        if (indexSize == 2)
+        {
+            static_cast<uint16_t*>(indices)[i] = (uint16_t)value;
+        }
+        else
+        {
+            static_cast<uint32_t*>(indices)[i] = value;
+        }
+    }
+
+    // Returns false past the end or on a varint longer than an index needs.
+    bool ReadVarint(const uint8_t*& data, const uint8_t* end, uint32_t& value)
+    {
+        value = 0;
+        for (size_t i = 0; i < MaxVarintSize; i++)
+        {
+            if (data == end)
+            {
+                return false;
+            }
+            uint8_t byte = *data++;
+            value |= (uint32_t)(byte & 0x7F) << (7 * i);
+            if ((byte & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+#if GEOMETRY_CODEC_SIMD
+    // The lanes of value summed from the first one up to each.
+    __m128i PrefixSum8(__m128i value)
+    {
+        value = _mm_add_epi8(value, _mm_slli_si128(value, 1));
+        value = _mm_add_epi8(value, _mm_slli_si128(value, 2));
+        value = _mm_add_epi8(value, _mm_slli_si128(value, 4));
+        return _mm_add_epi8(value, _mm_slli_si128(value, 8));
+    }
+
+    __m128i PrefixSum16(__m128i value)
+    {
+        value = _mm_add_epi16(value, _mm_slli_si128(value, 2));
+        value = _mm_add_epi16(value, _mm_slli_si128(value, 4));
+        return _mm_add_epi16(value, _mm_slli_si128(value, 8));
+    }
+
+    __m128i PrefixSum32(__m128i value)
+    {
+        value = _mm_add_epi32(value, _mm_slli_si128(value, 4));
+        return _mm_add_epi32(value, _mm_slli_si128(value, 8));
+    }
+
+    // Decodes 16 one-byte varints into 16 indices, previous holds the last
+    // index in every lane and is updated.
+    void DecodeIndexRun16(const uint8_t* data, uint16_t* destination, __m128i& previous)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi16(1);
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i halves[2] = { _mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero) };
+        for (int h = 0; h < 2; h++)
+        {
+            __m128i delta = _mm_xor_si128(_mm_srli_epi16(halves[h], 1),
+                _mm_sub_epi16(zero, _mm_and_si128(halves[h], one)));
+            __m128i indices = _mm_add_epi16(PrefixSum16(delta), previous);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + h * 8), indices);
+            previous = _mm_shuffle_epi32(_mm_shufflehi_epi16(indices, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        }
+    }
+
+    void DecodeIndexRun32(const uint8_t* data, uint32_t* destination, __m128i& previous)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi32(1);
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i words[2] = { _mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero) };
+        for (int w = 0; w < 2; w++)
+        {
+            __m128i quads[2] = { _mm_unpacklo_epi16(words[w], zero), _mm_unpackhi_epi16(words[w], zero) };
+            for (int q = 0; q < 2; q++)
+            {
+                __m128i delta = _mm_xor_si128(_mm_srli_epi32(quads[q], 1),
+                    _mm_sub_epi32(zero, _mm_and_si128(quads[q], one)));
+                __m128i indices = _mm_add_epi32(PrefixSum32(delta), previous);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + w * 8 + q * 4), indices);
+                previous = _mm_shuffle_epi32(indices, _MM_SHUFFLE(3, 3, 3, 3));
+            }
+        }
+    }
+
+    // Expands the payload of a group to its 16 zig-zag coded bytes.
+    __m128i UnpackGroup(const uint8_t* payload, uint32_t mode)
+    {
+        const __m128i lowNibbles = _mm_set1_epi8(0x0F);
+        __m128i packed;
+        switch (mode)
+        {
+        case 0:
+            return _mm_setzero_si128();
+        case 1:
+        {
+            // Byte j holds values 4j, 4j+2, 4j+1 and 4j+3 from the low bits,
+            // two splits in half put them in order.
+            const __m128i pairs = _mm_set1_epi8(0x33);
+            int32_t bits;
+            memcpy(&bits, payload, sizeof(bits));
+            __m128i x = _mm_cvtsi32_si128(bits);
+            packed = _mm_unpacklo_epi8(_mm_and_si128(x, pairs), _mm_and_si128(_mm_srli_epi16(x, 2), pairs));
+            break;
+        }
+        case 2:
+            packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(payload));
+            break;
+        default:
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(payload));
+        }
+        return _mm_unpacklo_epi8(_mm_and_si128(packed, lowNibbles),
+            _mm_and_si128(_mm_srli_epi16(packed, 4), lowNibbles));
+    }
+
+    __m128i BroadcastLastByte(__m128i value)
+    {
+        value = _mm_unpackhi_epi8(value, value);
+        value = _mm_unpackhi_epi16(value, value);
+        return _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+#endif
+
+#if !GEOMETRY_CODEC_SIMD
+    // Scalar twin of UnpackGroup.
+    void UnpackGroupScalar(const uint8_t* payload, uint32_t mode, uint8_t* values)
+    {
+        for (size_t i = 0; i < GroupSize; i++)
+        {
+            switch (mode)
+            {
+            case 0:
+                values[i] = 0;
+                break;
+            case 1:
+            {
+                // Bit position of value i within its byte.
+                static const uint32_t shifts[4] = { 0, 4, 2, 6 };
+                values[i] = (payload[i / 4] >> shifts[i % 4]) & 3;
+                break;
+            }
+            case 2:
+                values[i] = (payload[i / 2] >> ((i % 2) * 4)) & 0x0F;
+                break;
+            default:
+                values[i] = payload[i];
+                break;
+            }
+        }
+    }
+#endif
+
+    // Decodes one plane of a block into plane[0, groupCount * 16), previous
+    // is the byte of the vertex before the block and becomes the last one.
+    bool DecodePlane(const uint8_t*& data, const uint8_t* end, size_t groupCount, size_t vertexCount,
+        uint8_t* plane, uint8_t& previous)
+    {
+        size_t headerSize = (groupCount + 3) / 4;
+        if ((size_t)(end - data) < headerSize)
+        {
+            return false;
+        }
+        const uint8_t* headers = data;
+        data += headerSize;
+
+#if GEOMETRY_CODEC_SIMD
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i signBits = _mm_set1_epi8(1);
+        const __m128i valueBits = _mm_set1_epi8(0x7F);
+        __m128i carry = _mm_set1_epi8((char)previous);
+#else
+        uint8_t carry = previous;
+#endif
+        for (size_t g = 0; g < groupCount; g++)
+        {
+            uint32_t mode = (headers[g / 4] >> ((g % 4) * 2)) & 3;
+            size_t payloadSize = GroupPayloadSize[mode];
+            if ((size_t)(end - data) < payloadSize)
+            {
+                return false;
+            }
+#if GEOMETRY_CODEC_SIMD
+            __m128i zigZag = UnpackGroup(data, mode);
+            __m128i delta = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(zigZag, 1), valueBits),
+                _mm_sub_epi8(zero, _mm_and_si128(zigZag, signBits)));
+            __m128i values = _mm_add_epi8(PrefixSum8(delta), carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(plane + g * GroupSize), values);
+            carry = BroadcastLastByte(values);
+#else
+            UnpackGroupScalar(data, mode, plane + g * GroupSize);
+            for (size_t i = 0; i < GroupSize; i++)
+            {
+                carry = (uint8_t)(carry + UnZigZagByte(plane[g * GroupSize + i]));
+                plane[g * GroupSize + i] = carry;
+            }
+#endif
+            data += payloadSize;
+        }
+        previous = plane[vertexCount - 1];
+        return true;
+    }
+
+    // Interleaves planeCount decoded planes into bytes [byteIndex, byteIndex + planeCount)
+    // of vertexCount vertices.
+    void ScatterPlanes(const uint8_t (*planes)[VertexCodecBlockSize], uint32_t planeCount, size_t vertexCount,
+        uint8_t* vertices, uint32_t vertexStride)
+    {
+        size_t i = 0;
+#if GEOMETRY_CODEC_SIMD
+        if (planeCount == 4)
+        {
+            // Four planes make four bytes of 16 vertices per step.
+            for (; i + GroupSize <= vertexCount; i += GroupSize)
+            {
+                __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[0] + i));
+                __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[1] + i));
+                __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[2] + i));
+                __m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[3] + i));
+                __m128i pairs01[2] = { _mm_unpacklo_epi8(p0, p1), _mm_unpackhi_epi8(p0, p1) };
+                __m128i pairs23[2] = { _mm_unpacklo_epi8(p2, p3), _mm_unpackhi_epi8(p2, p3) };
+                for (int h = 0; h < 2; h++)
+                {
+                    __m128i quads[2] = { _mm_unpacklo_epi16(pairs01[h], pairs23[h]), _mm_unpackhi_epi16(pairs01[h], pairs23[h]) };
+                    for (int q = 0; q < 2; q++)
+                    {
+                        uint8_t* vertex = vertices + (i + h * 8 + q * 4) * vertexStride;
+                        __m128i quad = quads[q];
+                        for (int v = 0; v < 4; v++)
+                        {
+                            int32_t bytes = _mm_cvtsi128_si32(quad);
+                            memcpy(vertex + v * vertexStride, &bytes, sizeof(bytes));
+                            quad = _mm_srli_si128(quad, 4);
+                        }
+                    }
+                }
+            }
+        }
+#endif
+        for (; i < vertexCount; i++)
+        {
+            for (uint32_t p = 0; p < planeCount; p++)
+            {
+                vertices[i * vertexStride + p] = planes[p][i];
+            }
+        }
+    }
+
+    bool WalkVertexStream(const uint8_t* data, size_t size, size_t vertexCount, uint32_t vertexStride, uint8_t* destination)
+    {
+        if (vertexStride == 0 || vertexStride > VertexCodecMaxStride)
+        {
+            return false;
+        }
+        const uint8_t* end = data + size;
+        uint8_t previous[VertexCodecMaxStride] = {};
+        alignas(16) uint8_t planes[4][VertexCodecBlockSize];
+        for (size_t blockStart = 0; blockStart < vertexCount; blockStart += VertexCodecBlockSize)
+        {
+            size_t blockCount = (std::min)(VertexCodecBlockSize, vertexCount - blockStart);
+            size_t groupCount = (blockCount + GroupSize - 1) / GroupSize;
+            for (uint32_t k = 0; k < vertexStride; k += 4)
+            {
+                uint32_t planeCount = (std::min)(4u, vertexStride - k);
+                for (uint32_t p = 0; p < planeCount; p++)
+                {
+                    if (destination == nullptr)
+                    {
+                        // Only the sizes, see ValidateVertexStream.
+                        size_t headerSize = (groupCount + 3) / 4;
+                        if ((size_t)(end - data) < headerSize)
+                        {
+                            return false;
+                        }
+                        size_t payloadSize = 0;
+                        for (size_t g = 0; g < groupCount; g++)
+                        {
+                            payloadSize += GroupPayloadSize[(data[g / 4] >> ((g % 4) * 2)) & 3];
+                        }
+                        if ((size_t)(end - data) - headerSize < payloadSize)
+                        {
+                            return false;
+                        }
+                        data += headerSize + payloadSize;
+                    }
+                    else if (!DecodePlane(data, end, groupCount, blockCount, planes[p], previous[k + p]))
+                    {
+                        return false;
+                    }
+                }
+                if (destination != nullptr)
+                {
+                    ScatterPlanes(planes, planeCount, blockCount, destination + blockStart * vertexStride + k, vertexStride);
+                }
+            }
+        }
+        return data == end;
+    }
+}
+
+void EncodeIndexStream(const void* indices, size_t indexCount, uint32_t indexSize, std::vector<uint8_t>& output)
+{
+    assert(indexSize == 2 || indexSize == 4);
+    output.clear();
+    output.reserve(indexCount + indexCount / 4);
+    uint32_t previous = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        uint32_t index = LoadIndex(indices, i, indexSize);
+        uint32_t value = ZigZag((int32_t)(index - previous));
+        previous = index;
+        while (value >= 0x80)
+        {
+            output.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        output.push_back((uint8_t)value);
+    }
+}
+
+bool ValidateIndexStream(const uint8_t* data, size_t size, size_t indexCount)
+{
+    const uint8_t* end = data + size;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        uint32_t value;
+        if (!ReadVarint(data, end, value))
+        {
+            return false;
+        }
+    }
+    return data == end;
+}
+
+bool DecodeIndexStream(void* destination, size_t indexCount, uint32_t indexSize, const uint8_t* data, size_t size)
+{
+    if (indexSize != 2 && indexSize != 4)
+    {
+        return false;
+    }
+    const uint8_t* end = data + size;
+    uint32_t previous = 0;
+    size_t i = 0;
+    while (i < indexCount)
+    {
+#if GEOMETRY_CODEC_SIMD
+        // Runs of 16 one-byte varints are decoded at once.
+        if (indexCount - i >= GroupSize && (size_t)(end - data) >= GroupSize &&
+            _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data))) == 0)
+        {
+            if (indexSize == 2)
+            {
+                __m128i last = _mm_set1_epi16((short)previous);
+                DecodeIndexRun16(data, static_cast<uint16_t*>(destination) + i, last);
+                previous = (uint16_t)_mm_cvtsi128_si32(last);
+            }
+            else
+            {
+                __m128i last = _mm_set1_epi32((int)previous);
+                DecodeIndexRun32(data, static_cast<uint32_t*>(destination) + i, last);
+                previous = (uint32_t)_mm_cvtsi128_si32(last);
+            }
+            data += GroupSize;
+            i += GroupSize;
+            continue;
+        }
+#endif
+        uint32_t value;
+        if (!ReadVarint(data, end, value))
+        {
+            return false;
+        }
+        previous += (uint32_t)UnZigZag(value);
+        StoreIndex(destination, i, indexSize, previous);
+        i++;
+    }
+    return data == end;
+}
+
+void EncodeVertexStream(const void* vertices, size_t vertexCount, uint32_t vertexStride, std::vector<uint8_t>& output)
+{
+    assert(vertexStride > 0 && vertexStride <= VertexCodecMaxStride);
+    const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+    output.clear();
+    uint8_t previous[VertexCodecMaxStride] = {};
+    uint8_t plane[VertexCodecBlockSize];
+    for (size_t blockStart = 0; blockStart < vertexCount; blockStart += VertexCodecBlockSize)
+    {
+        size_t blockCount = (std::min)(VertexCodecBlockSize, vertexCount - blockStart);
+        size_t groupCount = (blockCount + GroupSize - 1) / GroupSize;
+        for (uint32_t k = 0; k < vertexStride; k++)
+        {
+            // The padding of the last group repeats the last byte, its differences are zero.
+            memset(plane, 0, sizeof(plane));
+            for (size_t i = 0; i < blockCount; i++)
+            {
+                uint8_t value = bytes[(blockStart + i) * vertexStride + k];
+                plane[i] = ZigZagByte((uint8_t)(value - previous[k]));
+                previous[k] = value;
+            }
+
+            size_t headerOffset = output.size();
+            output.resize(headerOffset + (groupCount + 3) / 4, 0);
+            for (size_t g = 0; g < groupCount; g++)
+            {
+                const uint8_t* values = plane + g * GroupSize;
+                uint8_t largest = *std::max_element(values, values + GroupSize);
+                uint32_t mode = (largest == 0) ? 0 : (largest < 4) ? 1 : (largest < 16) ? 2 : 3;
+                output[headerOffset + g / 4] |= (uint8_t)(mode << ((g % 4) * 2));
+                switch (mode)
+                {
+                case 1:
+                    for (size_t j = 0; j < 4; j++)
+                    {
+                        output.push_back((uint8_t)(values[4 * j] | (values[4 * j + 2] << 2) |
+                            (values[4 * j + 1] << 4) | (values[4 * j + 3] << 6)));
+                    }
+                    break;
+                case 2:
+                    for (size_t j = 0; j < 8; j++)
+                    {
+                        output.push_back((uint8_t)(values[2 * j] | (values[2 * j + 1] << 4)));
+                    }
+                    break;
+                case 3:
+                    output.insert(output.end(), values, values + GroupSize);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+bool ValidateVertexStream(const uint8_t* data, size_t size, size_t vertexCount, uint32_t vertexStride)
+{
+    return WalkVertexStream(data, size, vertexCount, vertexStride, nullptr);
+}
+
+bool DecodeVertexStream(void* destination, size_t vertexCount, uint32_t vertexStride, const uint8_t* data, size_t size)
+{
+    return WalkVertexStream(data, size, vertexCount, vertexStride, static_cast<uint8_t*>(destination));
+}
+
+QuantizationBounds QuantizePositionColor(const PositionColorVertex* vertices, size_t count,
+    QuantizedPositionColorVertex* output)
+{
+    float minimum[3] = { 0.0f, 0.0f, 0.0f };
+    float maximum[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            minimum[c] = (i == 0) ? vertices[i].Position[c] : (std::min)(minimum[c], vertices[i].Position[c]);
+            maximum[c] = (i == 0) ? vertices[i].Position[c] : (std::max)(maximum[c], vertices[i].Position[c]);
+        }
+    }
+
+    QuantizationBounds bounds;
+    for (int c = 0; c < 3; c++)
+    {
+        bounds.Min[c] = minimum[c];
+        bounds.Scale[c] = (maximum[c] - minimum[c]) / 65535.0f;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        QuantizedPositionColorVertex& quantized = output[i];
+        for (int c = 0; c < 3; c++)
+        {
+            float fraction = (bounds.Scale[c] > 0.0f) ? (vertices[i].Position[c] - bounds.Min[c]) / bounds.Scale[c] : 0.0f;
+            quantized.Position[c] = (uint16_t)(std::min)(65535.0f, (std::max)(0.0f, std::round(fraction)));
+        }
+        quantized.Padding = 0;
+        for (int c = 0; c < 4; c++)
+        {
+            float value = (std::min)(1.0f, (std::max)(0.0f, vertices[i].Color[c]));
+            quantized.Color[c] = (uint8_t)std::round(value * 255.0f);
+        }
+    }
+    return bounds;
+}
+
+void DequantizePositionColor(const QuantizedPositionColorVertex* vertices, size_t count,
+    const QuantizationBounds& bounds, PositionColorVertex* output)
+{
+    static_assert(sizeof(QuantizedPositionColorVertex) == 12, "Quantized vertices are packed");
+    static_assert(sizeof(PositionColorVertex) == 28, "Vertices are packed");
+    size_t i = 0;
+#if GEOMETRY_CODEC_SIMD
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 minimum = _mm_setr_ps(bounds.Min[0], bounds.Min[1], bounds.Min[2], 0.0f);
+    const __m128 scale = _mm_setr_ps(bounds.Scale[0], bounds.Scale[1], bounds.Scale[2], 0.0f);
+    const __m128 colorScale = _mm_set1_ps(1.0f / 255.0f);
+    for (; i < count; i++)
+    {
+        __m128i quantized = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&vertices[i]));
+        int32_t colorBits;
+        memcpy(&colorBits, vertices[i].Color, sizeof(colorBits));
+        __m128i color = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(colorBits), zero), zero);
+        __m128 position = _mm_add_ps(minimum, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(quantized, zero)), scale));
+        // The fourth lane of the position is overwritten by the color.
+        float* destination = reinterpret_cast<float*>(&output[i]);
+        _mm_storeu_ps(destination, position);
+        _mm_storeu_ps(destination + 3, _mm_mul_ps(_mm_cvtepi32_ps(color), colorScale));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            output[i].Position[c] = bounds.Min[c] + vertices[i].Position[c] * bounds.Scale[c];
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            output[i].Color[c] = vertices[i].Color[c] * (1.0f / 255.0f);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compression of the vertex and index streams of the mesh file. Both codecs
+// are lossless on the bytes they are given, quantizing the vertices first is
+// what shrinks them most. The decoders use SSE2 where the compiler targets it
+// and never read or write out of the given ranges, damaged input makes them
+// return false.
+
+// Index stream: every index is the zig-zag coded difference to the previous
+// one, stored as a LEB128 varint. Triangles of a list share most of their
+// vertices with the ones before, nearly all differences fit in a byte.
+void EncodeIndexStream(const void* indices, size_t indexCount, uint32_t indexSize, std::vector<uint8_t>& output);
+// Checks that the stream holds exactly indexCount varints.
+bool ValidateIndexStream(const uint8_t* data, size_t size, size_t indexCount);
+bool DecodeIndexStream(void* destination, size_t indexCount, uint32_t indexSize, const uint8_t* data, size_t size);
+
+// Vertex stream: blocks of VertexCodecBlockSize vertices, each split into one
+// plane per byte of the vertex. A plane holds the zig-zag coded difference of
+// every byte to the same byte of the previous vertex, in groups of 16 packed
+// to 0, 2, 4 or 8 bits as a 2-bit header per group tells.
+const size_t VertexCodecBlockSize = 256;
+const uint32_t VertexCodecMaxStride = 256;
+
+void EncodeVertexStream(const void* vertices, size_t vertexCount, uint32_t vertexStride, std::vector<uint8_t>& output);
+// Walks the group headers, the payload is not decoded.
+bool ValidateVertexStream(const uint8_t* data, size_t size, size_t vertexCount, uint32_t vertexStride);
+bool DecodeVertexStream(void* destination, size_t vertexCount, uint32_t vertexStride, const uint8_t* data, size_t size);
+
+// The vertex layout of the app.
+struct PositionColorVertex
+{
+    float Position[3];
+    float Color[4];
+};
+
+// Positions are 16-bit fractions of the bounds, colors 8-bit unorm.
+struct QuantizedPositionColorVertex
+{
+    uint16_t Position[3];
+    uint16_t Padding;
+    uint8_t Color[4];
+};
+
+// Position = Min + quantized * Scale.
+struct QuantizationBounds
+{
+    float Min[3];
+    float Scale[3];
+};
+
+QuantizationBounds QuantizePositionColor(const PositionColorVertex* vertices, size_t count,
+    QuantizedPositionColorVertex* output);
+void DequantizePositionColor(const QuantizedPositionColorVertex* vertices, size_t count,
+    const QuantizationBounds& bounds, PositionColorVertex* output);
\ No newline at end of file
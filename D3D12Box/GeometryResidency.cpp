@@ -0,0 +1,91 @@
+#include "stdafx.h"
+#include "GeometryResidency.h"
+#include "MeshFile.h"
+#include "GeometryCodec.h"
+
+const char* GeometryResidencyName(GeometryResidency residency)
+{
+    switch (residency)
+    {
+    case GeometryResidency::None: return "none";
+    case GeometryResidency::Compressed: return "compressed";
+    case GeometryResidency::MappedView: return "mapped view";
+    }
+    return "unknown";
+}
+
+void GeometryCpuCopy::Keep(GeometryResidency residency, std::shared_ptr<const MeshFile> mapping,
+    const void* vertexData, size_t vertexSize, uint32_t vertexStride,
+    const void* indexData, size_t indexSize, uint32_t indexStride)
+{
+    Release();
+    if (residency == GeometryResidency::MappedView && mapping == nullptr)
+    {
+        residency = GeometryResidency::Compressed;
+    }
+
+    m_residency = residency;
+    m_vertexSize = vertexSize;
+    m_indexSize = indexSize;
+    m_vertexStride = vertexStride;
+    m_indexStride = indexStride;
+    switch (residency)
+    {
+    case GeometryResidency::None:
+        break;
+    case GeometryResidency::Compressed:
+        EncodeVertexStream(vertexData, vertexSize / vertexStride, vertexStride, m_compressedVertices);
+        EncodeIndexStream(indexData, indexSize / indexStride, indexStride, m_compressedIndices);
+        m_compressedVertices.shrink_to_fit();
+        m_compressedIndices.shrink_to_fit();
+        break;
+    case GeometryResidency::MappedView:
+        m_mapping = std::move(mapping);
+        break;
+    }
+}
+
+void GeometryCpuCopy::Release()
+{
+    m_residency = GeometryResidency::None;
+    m_mapping = nullptr;
+    m_compressedVertices = std::vector<uint8_t>();
+    m_compressedIndices = std::vector<uint8_t>();
+}
+
+bool GeometryCpuCopy::ReadVertices(std::vector<uint8_t>& out)const
+{
+    out.resize(m_vertexSize);
+    switch (m_residency)
+    {
+    case GeometryResidency::Compressed:
+        return DecodeVertexStream(out.data(), m_vertexSize / m_vertexStride, m_vertexStride,
+            m_compressedVertices.data(), m_compressedVertices.size());
+    case GeometryResidency::MappedView:
+        return m_mapping->DecodeVertices(out.data());
+    default:
+        out.clear();
+        return false;
+    }
+}
+
+bool GeometryCpuCopy::ReadIndices(std::vector<uint8_t>& out)const
+{
+    out.resize(m_indexSize);
+    switch (m_residency)
+    {
+    case GeometryResidency::Compressed:
+        return DecodeIndexStream(out.data(), m_indexSize / m_indexStride, m_indexStride,
+            m_compressedIndices.data(), m_compressedIndices.size());
+    case GeometryResidency::MappedView:
+        return m_mapping->DecodeIndices(out.data());
+    default:
+        out.clear();
+        return false;
+    }
+}
+
+size_t GeometryCpuCopy::ResidentBytes()const
+{
+    return m_compressedVertices.capacity() + m_compressedIndices.capacity();
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class MeshFile;
+
+// What a geometry keeps of its vertices and indices in system memory once
+// they are uploaded. The GPU buffers are always complete, the CPU copy is only
+// for the code reading geometry back, e.g. picking or collision.
+enum class GeometryResidency : uint8_t
+{
+    // Nothing is kept.
+    None,
+    // The streams through the lossless geometry codec. Reading decodes into
+    // the caller's buffer.
+    Compressed,
+    // The mapping of the mesh file the geometry was loaded from, decoded on
+    // read. The pages are backed by the file, the system can drop them under
+    // pressure.
+    MappedView,
+};
+
+const char* GeometryResidencyName(GeometryResidency residency);
+
+// The CPU copy of a geometry under one residency policy.
+class GeometryCpuCopy
+{
+public:
+    // Keeps the vertex and index bytes as residency asks. MappedView needs
+    // mapping, without it a compressed copy is kept instead. vertexData and
+    // indexData are the decoded streams, only read for a compressed copy.
+    void Keep(GeometryResidency residency, std::shared_ptr<const MeshFile> mapping,
+        const void* vertexData, size_t vertexSize, uint32_t vertexStride,
+        const void* indexData, size_t indexSize, uint32_t indexStride);
+    void Release();
+
+    GeometryResidency Residency()const { return m_residency; }
+
+    // Copies the bytes into out, false if nothing is kept.
+    bool ReadVertices(std::vector<uint8_t>& out)const;
+    bool ReadIndices(std::vector<uint8_t>& out)const;
+
+    // Private system memory held, mapped file pages are not counted.
+    size_t ResidentBytes()const;
+    // What a plain copy would hold.
+    size_t SourceBytes()const { return m_vertexSize + m_indexSize; }
+
+private:
+    GeometryResidency m_residency = GeometryResidency::None;
+    std::shared_ptr<const MeshFile> m_mapping;
+    std::vector<uint8_t> m_compressedVertices;
+    std::vector<uint8_t> m_compressedIndices;
+    size_t m_vertexSize = 0;
+    size_t m_indexSize = 0;
+    uint32_t m_vertexStride = 0;
+    uint32_t m_indexStride = 0;
+};
\ No newline at end of file
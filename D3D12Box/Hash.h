@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a. Not for hash tables under attack, but stable across runs
+// and platforms, so hashes can be stored on disk.
+const uint64_t FnvOffsetBasis = 14695981039346656037ull;
+const uint64_t FnvPrime = 1099511628211ull;
+
+inline uint64_t Fnv1a64(const void* data, size_t size, uint64_t hash = FnvOffsetBasis)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FnvPrime;
+    }
+    return hash;
+}
+
+inline uint64_t Fnv1a64(const std::string& text, uint64_t hash = FnvOffsetBasis)
+{
+    return Fnv1a64(text.data(), text.size(), hash);
+}
+
+// Same hash for text known at compile time.
+constexpr uint64_t Fnv1a64Constant(const char* text, size_t length, uint64_t hash = FnvOffsetBasis)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= FnvPrime;
+    }
+    return hash;
+}
+
+// Accumulates a hash from values fed one after the other.
+class Hasher
+{
+public:
+    void Add(const void* data, size_t size) { m_hash = Fnv1a64(data, size, m_hash); }
+
+    // Only for values without padding, whose bytes are all meaningful.
+    template<typename T>
+    void AddValue(const T& value) { Add(&value, sizeof(T)); }
+
+    // Null and empty strings hash differently.
+    void AddString(const char* text)
+    {
+        if (text == nullptr)
+        {
+            AddValue(0u);
+            return;
+        }
+        size_t length = 0;
+        while (text[length] != '\0')
+        {
+            length++;
+        }
+        AddValue((uint32_t)length + 1);
+        Add(text, length);
+    }
+
+    uint64_t Value()const { return m_hash; }
+
+private:
+    uint64_t m_hash = FnvOffsetBasis;
+};
\ No newline at end of file
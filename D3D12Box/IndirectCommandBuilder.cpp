@@ -0,0 +1,12 @@
+#include "stdafx.h"
+#include "IndirectCommandBuilder.h"
+
+void IndirectCommandBuilder::Build(
+    const std::vector<DrawPacket>& drawPackets,
+    D3D12_GPU_VIRTUAL_ADDRESS objectConstantBuffer,
+    IndirectCommand* arguments,
+    CullInstance* cullInstances)
+{
+    const UINT objectCBByteSize = CalculateConstantBufferByteSize(sizeof(ObjectConstants));
+    PackIndirectCommands(drawPackets, objectConstantBuffer, objectCBByteSize, arguments, cullInstances, m_runs);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include "stdafx.h"
+#include "D3DAppUtil.h"
+#include "RenderItem.h"
+#include "IndirectPacking.h"
+
+using IndirectDrawRun = IndirectRun<RenderItem>;
+
+// Bytes per index, for the range checks of PackIndirectCommands.
+inline UINT IndexByteSize(const MeshGeometry& geometry)
+{
+    return (geometry.IndexFormat == DXGI_FORMAT_R16_UINT) ? 2 : 4;
+}
+
+// Fills the per-frame indirect argument buffer from the sorted draw packets.
+class IndirectCommandBuilder
+{
+public:
+    IndirectCommandBuilder() = default;
+    IndirectCommandBuilder(const IndirectCommandBuilder& rhs) = delete;
+    IndirectCommandBuilder& operator=(const IndirectCommandBuilder& rhs) = delete;
+
+    // objectConstantBuffer is the GPU address of the first object constants of the frame.
+    // arguments receives one command per packet. When cullInstances is not
+    // null, the input of the culling pass is written too. Both are usually
+    // the mapped elements of the frame's upload buffers.
+    void Build(
+        const std::vector<DrawPacket>& drawPackets,
+        D3D12_GPU_VIRTUAL_ADDRESS objectConstantBuffer,
+        IndirectCommand* arguments,
+        CullInstance* cullInstances = nullptr);
+
+    const std::vector<IndirectDrawRun>& Runs()const { return m_runs; }
+
+private:
+    std::vector<IndirectDrawRun> m_runs;
+};
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// Packing of the indirect draw arguments from the sorted draw packets, the
+// CPU side of the ExecuteIndirect path. The functions are templates over the
+// packet, item, command and instance types, laid out like DrawPacket,
+// RenderItem, IndirectCommand and CullInstance, so the packing builds and is
+// tested without the Windows headers. IndirectCommandBuilder packs the frame.
+
+// A range of indirect commands that can be issued with one ExecuteIndirect:
+// they share the pipeline state, the vertex/index buffers and the topology.
+template<typename T>
+struct IndirectRun
+{
+    T* Item = nullptr;
+    uint32_t PipelineStateIndex = 0;
+    uint32_t FirstCommand = 0;
+    uint32_t CommandCount = 0;
+};
+
+// Writes one command per packet into arguments and splits them into runs.
+// objectConstantBuffer is the GPU address of the first object constants,
+// objectConstantStride the size of one. When cullInstances is not null, the
+// input of the culling pass is written too. IndexByteSize(geometry), found
+// by argument-dependent lookup, gives the size of an index of the geometry.
+template<typename Packet, typename Run, typename Command, typename Instance>
+void PackIndirectCommands(
+    const std::vector<Packet>& packets,
+    uint64_t objectConstantBuffer,
+    uint64_t objectConstantStride,
+    Command* arguments,
+    Instance* cullInstances,
+    std::vector<Run>& runs)
+{
+    runs.clear();
+
+    for (uint32_t i = 0; i < (uint32_t)packets.size(); i++)
+    {
+        auto* ri = packets[i].Item;
+
+        // Start a new run whenever state the command signature cannot change differs.
+        if (runs.empty() ||
+            runs.back().PipelineStateIndex != ri->PipelineStateIndex ||
+            runs.back().Item->Geo != ri->Geo ||
+            runs.back().Item->PrimitiveType != ri->PrimitiveType)
+        {
+            Run run;
+            run.Item = ri;
+            run.PipelineStateIndex = ri->PipelineStateIndex;
+            run.FirstCommand = i;
+            runs.push_back(run);
+        }
+        runs.back().CommandCount++;
+
+        Command command;
+        command.ObjectConstantBuffer = objectConstantBuffer + (uint64_t)ri->ObjectConstantBufferIndex * objectConstantStride;
+        command.DrawArguments.IndexCountPerInstance = ri->IndexCount;
+        command.DrawArguments.InstanceCount = 1;
+        command.DrawArguments.StartIndexLocation = ri->StartIndexLocation;
+        command.DrawArguments.BaseVertexLocation = ri->BaseVertexLocation;
+        command.DrawArguments.StartInstanceLocation = 0;
+
+        // The GPU does not validate the arguments, a bad range reads past the index buffer.
+        assert(ri->IndexCount > 0);
+        assert((uint64_t)(ri->StartIndexLocation + ri->IndexCount) * IndexByteSize(*ri->Geo) <=
+            ri->Geo->IndexBufferByteSize);
+
+        arguments[i] = command;
+
+        if (cullInstances != nullptr)
+        {
+            Instance instance;
+            instance.Center = ri->Bounds.Center;
+            instance.Extents = ri->Bounds.Extents;
+            instance.RunIndex = (uint32_t)runs.size() - 1;
+            instance.RunFirstCommand = runs.back().FirstCommand;
+            cullInstances[i] = instance;
+        }
+    }
+}
\ No newline at end of file
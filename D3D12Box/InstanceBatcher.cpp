@@ -0,0 +1,31 @@
+#include "stdafx.h"
+#include "InstanceBatcher.h"
+
+void InstanceBatcher::Build(const std::vector<DrawPacket>& drawPackets, UploadBuffer<InstanceData>* instanceBuffer)
+{
+    m_batches.clear();
+
+    // The upper half of the sort key holds the layer, pipeline state and mesh id.
+    const UINT64 batchKeyMask = 0xFFFFFFFF00000000ull;
+    UINT64 currentBatchKey = 0;
+
+    for (UINT i = 0; i < (UINT)drawPackets.size(); i++)
+    {
+        const DrawPacket& packet = drawPackets[i];
+        UINT64 batchKey = packet.SortKey & batchKeyMask;
+        if (m_batches.empty() || batchKey != currentBatchKey)
+        {
+            InstanceBatch batch;
+            batch.Item = packet.Item;
+            batch.PipelineStateIndex = packet.Item->PipelineStateIndex;
+            batch.StartInstance = i;
+            m_batches.push_back(batch);
+            currentBatchKey = batchKey;
+        }
+        m_batches.back().InstanceCount++;
+
+        InstanceData instance;
+        DirectX::XMStoreFloat4x4(&instance.World, DirectX::XMMatrixTranspose(packet.Item->World));
+        instanceBuffer->CopyData(i, instance);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include "stdafx.h"
+#include "D3DAppUtil.h"
+#include "UploadBuffer.h"
+#include "RenderItem.h"
+
+// One instanced draw: InstanceCount copies of Item's submesh, whose world
+// matrices start at StartInstance in the per-frame instance buffer.
+struct InstanceBatch
+{
+    RenderItem* Item = nullptr;
+    UINT PipelineStateIndex = 0;
+    UINT StartInstance = 0;
+    UINT InstanceCount = 0;
+};
+
+// Collapses sorted draw packets that share render layer, pipeline state and
+// mesh into instanced draws.
+class InstanceBatcher
+{
+public:
+    InstanceBatcher() = default;
+    InstanceBatcher(const InstanceBatcher& rhs) = delete;
+    InstanceBatcher& operator=(const InstanceBatcher& rhs) = delete;
+
+    // The packets have to be sorted, items of a batch are then adjacent.
+    // Writes the world matrix of every packet into instanceBuffer.
+    void Build(const std::vector<DrawPacket>& drawPackets, UploadBuffer<InstanceData>* instanceBuffer);
+
+    const std::vector<InstanceBatch>& Batches()const { return m_batches; }
+
+private:
+    std::vector<InstanceBatch> m_batches;
+};
\ No newline at end of file
@@ -0,0 +1,441 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+namespace
+{
+    const uint32_t InvalidWorkerIndex = UINT32_MAX;
+
+    // Jobs a worker can have queued before it runs them inline.
+    const uint32_t WorkerQueueCapacity = 4096;
+
+    thread_local JobSystem* t_jobSystem = nullptr;
+    thread_local uint32_t t_workerIndex = InvalidWorkerIndex;
+}
+
+JobSystem::WorkStealingQueue::WorkStealingQueue(uint32_t capacity) :
+    m_jobs(capacity),
+    m_mask(capacity - 1)
+{
+    assert((capacity & (capacity - 1)) == 0 && "Capacity has to be a power of two");
+}
+
+bool JobSystem::WorkStealingQueue::Push(Job* job)
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+    if (bottom - top > m_mask)
+    {
+        return false;
+    }
+    m_jobs[bottom & m_mask].store(job, std::memory_order_relaxed);
+
+    // Publishes the job to the thieves that acquire m_bottom.
+    m_bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+JobSystem::Job* JobSystem::WorkStealingQueue::Pop()
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        // The deque was empty.
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = m_jobs[bottom & m_mask].load(std::memory_order_relaxed);
+    if (top == bottom)
+    {
+        // Last job, race the thieves for it.
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            job = nullptr;
+        }
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job* JobSystem::WorkStealingQueue::Steal()
+{
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom)
+    {
+        return nullptr;
+    }
+
+    Job* job = m_jobs[top & m_mask].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        // Lost the race against the owner or another thief.
+        return nullptr;
+    }
+    return job;
+}
+
+JobSystem::JobSystem(uint32_t workerThreadCount)
+{
+    for (uint32_t i = 0; i <= workerThreadCount; i++)
+    {
+        m_queues.push_back(std::make_unique<WorkStealingQueue>(WorkerQueueCapacity));
+    }
+
+    t_jobSystem = this;
+    t_workerIndex = 0;
+
+    for (uint32_t i = 1; i <= workerThreadCount; i++)
+    {
+        m_threads.emplace_back(&JobSystem::WorkerMain, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_quit = true;
+    }
+    m_wakeCondition.notify_all();
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+
+    if (t_jobSystem == this)
+    {
+        t_jobSystem = nullptr;
+        t_workerIndex = InvalidWorkerIndex;
+    }
+
+    for (Job* job : m_freeJobs)
+    {
+        delete job;
+    }
+}
+
+void JobSystem::Run(JobFunction function, JobCounter* counter, JobCounter* dependency)
+{
+    Submit(std::move(function), counter, dependency, false);
+}
+
+void JobSystem::RunBackground(JobFunction function, JobCounter* counter, JobCounter* dependency)
+{
+    assert(counter != nullptr && "A background job is run by the waits for its counter");
+    Submit(std::move(function), counter, dependency, true);
+}
+
+void JobSystem::Submit(JobFunction function, JobCounter* counter, JobCounter* dependency, bool background)
+{
+    Job* job = AllocateJob();
+    job->Function = std::move(function);
+    job->Counter = counter;
+    job->Dependency = dependency;
+    job->Background = background;
+
+    if (counter != nullptr)
+    {
+        counter->m_value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (dependency != nullptr && !dependency->IsDone())
+    {
+        // Checked again under the lock, Finish schedules the job if the
+        // dependency completes after this point.
+        std::lock_guard<std::mutex> lock(m_deferredMutex);
+        if (!dependency->IsDone())
+        {
+            m_deferredJobs.push_back(job);
+            return;
+        }
+    }
+    Schedule(job);
+}
+
+void JobSystem::RunAfterAll(JobFunction function, JobCounter* counter, std::vector<JobCounter*> dependencies)
+{
+    dependencies.erase(
+        std::remove_if(dependencies.begin(), dependencies.end(), [](JobCounter* dependency) { return dependency->IsDone(); }),
+        dependencies.end());
+    if (dependencies.size() <= 1)
+    {
+        Run(std::move(function), counter, dependencies.empty() ? nullptr : dependencies[0]);
+        return;
+    }
+
+    // A job waits for one dependency and submits the rest of the chain. It
+    // holds counter until the chain is submitted, so counter stays busy.
+    JobCounter* dependency = dependencies.back();
+    dependencies.pop_back();
+    Run([this, function, counter, dependencies]()
+    {
+        RunAfterAll(function, counter, dependencies);
+    }, counter, dependency);
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function,
+    JobCounter* counter, JobCounter* dependency)
+{
+    grainSize = (std::max)(grainSize, 1u);
+    for (uint32_t begin = 0; begin < count; begin += grainSize)
+    {
+        uint32_t end = (std::min)(begin + grainSize, count);
+        const RangeFunction* range = &function;
+        Run([range, begin, end]() { (*range)(begin, end); }, counter, dependency);
+    }
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+    while (!counter->IsDone())
+    {
+        Job* job = FindJob();
+        if (job == nullptr)
+        {
+            job = FindBackgroundJob(counter);
+        }
+        if (job != nullptr)
+        {
+            Execute(job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock(counter->m_exceptionMutex);
+        std::swap(exception, counter->m_exception);
+    }
+    if (exception)
+    {
+        std::rethrow_exception(exception);
+    }
+}
+
+JobSystem::Job* JobSystem::AllocateJob()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_freeJobsMutex);
+        if (!m_freeJobs.empty())
+        {
+            Job* job = m_freeJobs.back();
+            m_freeJobs.pop_back();
+            return job;
+        }
+    }
+    return new Job();
+}
+
+void JobSystem::FreeJob(Job* job)
+{
+    // Releases what the function captured.
+    job->Function = nullptr;
+    job->Counter = nullptr;
+    job->Dependency = nullptr;
+    job->Background = false;
+    std::lock_guard<std::mutex> lock(m_freeJobsMutex);
+    m_freeJobs.push_back(job);
+}
+
+void JobSystem::Schedule(Job* job)
+{
+    if (job->Background)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_backgroundQueueMutex);
+            m_backgroundQueue.push_back(job);
+        }
+        m_backgroundJobCount.fetch_add(1, std::memory_order_release);
+        m_wakeCondition.notify_one();
+        return;
+    }
+
+    bool queued = false;
+    if (t_jobSystem == this && t_workerIndex != InvalidWorkerIndex)
+    {
+        queued = m_queues[t_workerIndex]->Push(job);
+        if (!queued)
+        {
+            // The deque is full, run the job now rather than grow it.
+            Execute(job);
+            return;
+        }
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_sharedQueueMutex);
+        m_sharedQueue.push_back(job);
+    }
+
+    m_queuedJobCount.fetch_add(1, std::memory_order_release);
+    m_wakeCondition.notify_one();
+}
+
+JobSystem::Job* JobSystem::FindJob()
+{
+    Job* job = nullptr;
+    uint32_t workerIndex = (t_jobSystem == this) ? t_workerIndex : InvalidWorkerIndex;
+
+    if (workerIndex != InvalidWorkerIndex)
+    {
+        job = m_queues[workerIndex]->Pop();
+    }
+
+    if (job == nullptr && m_queuedJobCount.load(std::memory_order_acquire) > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_sharedQueueMutex);
+        if (!m_sharedQueue.empty())
+        {
+            job = m_sharedQueue.back();
+            m_sharedQueue.pop_back();
+        }
+    }
+
+    if (job == nullptr)
+    {
+        // Steal from the other workers, starting after ourselves to spread the thieves.
+        uint32_t queueCount = (uint32_t)m_queues.size();
+        uint32_t start = (workerIndex == InvalidWorkerIndex) ? 0 : workerIndex + 1;
+        for (uint32_t i = 0; i < queueCount && job == nullptr; i++)
+        {
+            uint32_t victim = (start + i) % queueCount;
+            if (victim != workerIndex)
+            {
+                job = m_queues[victim]->Steal();
+            }
+        }
+    }
+
+    if (job != nullptr)
+    {
+        m_queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job* JobSystem::FindBackgroundJob(JobCounter* counter)
+{
+    if (m_backgroundJobCount.load(std::memory_order_acquire) <= 0)
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_backgroundQueueMutex);
+    auto it = std::find_if(m_backgroundQueue.begin(), m_backgroundQueue.end(),
+        [counter](const Job* job) { return counter == nullptr || job->Counter == counter; });
+    if (it == m_backgroundQueue.end())
+    {
+        return nullptr;
+    }
+    Job* job = *it;
+    m_backgroundQueue.erase(it);
+    m_backgroundJobCount.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::Execute(Job* job)
+{
+    try
+    {
+        job->Function();
+    }
+    catch (...)
+    {
+        if (job->Counter == nullptr)
+        {
+            // Nobody waits for this job, there is nobody to report to.
+            std::terminate();
+        }
+        std::lock_guard<std::mutex> lock(job->Counter->m_exceptionMutex);
+        if (!job->Counter->m_exception)
+        {
+            job->Counter->m_exception = std::current_exception();
+        }
+    }
+
+    JobCounter* counter = job->Counter;
+    FreeJob(job);
+    if (counter != nullptr)
+    {
+        Finish(counter);
+    }
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+    if (counter->m_value.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+
+    // The counter is done, release the jobs that were waiting for it. They
+    // are taken in batches, so no list is allocated on the frame path.
+    const size_t BatchSize = 64;
+    Job* readyJobs[BatchSize];
+    size_t readyCount = 0;
+    do
+    {
+        readyCount = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_deferredMutex);
+            size_t keptCount = 0;
+            for (Job* job : m_deferredJobs)
+            {
+                if (readyCount < BatchSize && job->Dependency->IsDone())
+                {
+                    readyJobs[readyCount++] = job;
+                }
+                else
+                {
+                    m_deferredJobs[keptCount++] = job;
+                }
+            }
+            m_deferredJobs.resize(keptCount);
+        }
+        for (size_t i = 0; i < readyCount; i++)
+        {
+            Schedule(readyJobs[i]);
+        }
+    } while (readyCount == BatchSize);
+}
+
+void JobSystem::WorkerMain(uint32_t workerIndex)
+{
+    t_jobSystem = this;
+    t_workerIndex = workerIndex;
+
+    while (!m_quit.load(std::memory_order_acquire))
+    {
+        // The frame jobs first, background jobs when there are none.
+        Job* job = FindJob();
+        if (job == nullptr)
+        {
+            job = FindBackgroundJob(nullptr);
+        }
+        if (job != nullptr)
+        {
+            Execute(job);
+            continue;
+        }
+
+        // Sleep until a job is queued. The timeout covers a job pushed
+        // between the failed search and the wait.
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wakeCondition.wait_for(lock, std::chrono::milliseconds(1), [this]()
+        {
+            return m_quit.load(std::memory_order_acquire) ||
+                m_queuedJobCount.load(std::memory_order_acquire) > 0 ||
+                m_backgroundJobCount.load(std::memory_order_acquire) > 0;
+        });
+    }
+}
\ No newline at end of file
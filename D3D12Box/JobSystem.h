@@ -0,0 +1,147 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the unfinished jobs of a group. A job increments it when it is
+// submitted and decrements it when it has run, Wait returns once it is zero.
+class JobCounter
+{
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter& rhs) = delete;
+    JobCounter& operator=(const JobCounter& rhs) = delete;
+
+    bool IsDone()const { return m_value.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> m_value{ 0 };
+
+    // First exception thrown by a job of the group, rethrown by Wait.
+    std::mutex m_exceptionMutex;
+    std::exception_ptr m_exception;
+};
+
+// Work-stealing job scheduler. Every worker owns a Chase-Lev deque: it pushes
+// and pops jobs at the bottom, idle workers steal from the top of the others.
+// The thread that creates the JobSystem is worker 0 and only runs jobs while
+// it waits. Threads that are not workers submit through a shared queue.
+//
+// Background jobs, the asset builds and the streaming, have a queue of their
+// own. Idle workers take them, Wait only runs the ones of the awaited group:
+// a frame waiting for its own jobs never picks up a pipeline state compile.
+class JobSystem
+{
+public:
+    typedef std::function<void()> JobFunction;
+    typedef std::function<void(uint32_t begin, uint32_t end)> RangeFunction;
+
+    // Starts workerThreadCount threads besides the calling thread.
+    explicit JobSystem(uint32_t workerThreadCount);
+    JobSystem(const JobSystem& rhs) = delete;
+    JobSystem& operator=(const JobSystem& rhs) = delete;
+    ~JobSystem();
+
+    // Runs function on some worker. counter, if not null, tracks its completion.
+    // The job does not start before dependency, if not null, is done.
+    void Run(JobFunction function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+    // Same as Run, the job does not start before every dependency is done.
+    void RunAfterAll(JobFunction function, JobCounter* counter, std::vector<JobCounter*> dependencies);
+
+    // Same as Run, for work off the frame path. Without worker threads only
+    // the waits for counter run it, dependency cannot be a background group.
+    void RunBackground(JobFunction function, JobCounter* counter, JobCounter* dependency = nullptr);
+
+    // Calls function on consecutive ranges of at most grainSize elements
+    // covering [0, count). function is referenced, not copied, and has to
+    // stay alive until counter is done.
+    void ParallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function,
+        JobCounter* counter, JobCounter* dependency = nullptr);
+
+    // Runs other jobs until counter is done, no fibers needed: the waiting
+    // thread does useful work instead of blocking. Background jobs are run
+    // only if they belong to counter. Rethrows the first exception thrown by
+    // a job of the group.
+    void Wait(JobCounter* counter);
+
+    // Workers including the creating thread.
+    uint32_t WorkerCount()const { return (uint32_t)m_queues.size(); }
+
+private:
+    struct Job
+    {
+        JobFunction Function;
+        JobCounter* Counter = nullptr;
+        JobCounter* Dependency = nullptr;
+        bool Background = false;
+    };
+
+    // Chase-Lev deque with a fixed power of two capacity.
+    class WorkStealingQueue
+    {
+    public:
+        explicit WorkStealingQueue(uint32_t capacity);
+
+        // Owner side.
+        bool Push(Job* job);
+        Job* Pop();
+
+        // Any thread.
+        Job* Steal();
+
+    private:
+        std::atomic<int64_t> m_top{ 0 };
+        std::atomic<int64_t> m_bottom{ 0 };
+        std::vector<std::atomic<Job*>> m_jobs;
+        int64_t m_mask;
+    };
+
+    // Jobs are recycled, submitting one does not allocate once the pool is warm.
+    Job* AllocateJob();
+    void FreeJob(Job* job);
+
+    void Submit(JobFunction function, JobCounter* counter, JobCounter* dependency, bool background);
+    void Schedule(Job* job);
+    Job* FindJob();
+    // Oldest background job of counter, of any group if counter is null.
+    Job* FindBackgroundJob(JobCounter* counter);
+    void Execute(Job* job);
+    void Finish(JobCounter* counter);
+    void WorkerMain(uint32_t workerIndex);
+
+    std::vector<std::unique_ptr<WorkStealingQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    // Jobs submitted by threads that are not workers.
+    std::mutex m_sharedQueueMutex;
+    std::vector<Job*> m_sharedQueue;
+
+    // Background jobs in submission order.
+    std::mutex m_backgroundQueueMutex;
+    std::deque<Job*> m_backgroundQueue;
+    std::atomic<int32_t> m_backgroundJobCount{ 0 };
+
+    // Finished jobs, reused by AllocateJob.
+    std::mutex m_freeJobsMutex;
+    std::vector<Job*> m_freeJobs;
+
+    // Jobs whose dependency is not done yet.
+    std::mutex m_deferredMutex;
+    std::vector<Job*> m_deferredJobs;
+
+    // Idle workers sleep until jobs are queued.
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCondition;
+    std::atomic<int32_t> m_queuedJobCount{ 0 };
+    std::atomic<bool> m_quit{ false };
+};
\ No newline at end of file
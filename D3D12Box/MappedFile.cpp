@@ -0,0 +1,224 @@
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstdio>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+namespace
+{
+    std::wstring Utf8ToWide(const std::string& text)
+    {
+        int length = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), (int)text.size(), nullptr, 0);
+        std::wstring wide(length, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, text.c_str(), (int)text.size(), &wide[0], length);
+        return wide;
+    }
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+    HANDLE file = CreateFileW(Utf8ToWide(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    m_open = true;
+    m_size = (size_t)size.QuadPart;
+    if (m_size == 0)
+    {
+        // Empty files cannot be mapped.
+        return true;
+    }
+    m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping != nullptr)
+    {
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (m_data == nullptr)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != nullptr)
+    {
+        CloseHandle(m_file);
+    }
+    m_data = nullptr;
+    m_mapping = nullptr;
+    m_file = nullptr;
+    m_size = 0;
+    m_open = false;
+}
+
+bool MappedFile::Write(const std::string& path, const void* data, size_t size)
+{
+    std::wstring widePath = Utf8ToWide(path);
+    std::wstring temporaryPath = widePath + L".tmp";
+    HANDLE file = CreateFileW(temporaryPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    DWORD written = 0;
+    bool succeeded = size == 0 || (WriteFile(file, data, (DWORD)size, &written, nullptr) && written == size);
+    CloseHandle(file);
+    if (!succeeded || !MoveFileExW(temporaryPath.c_str(), widePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFileW(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::Read(const std::string& path, std::vector<uint8_t>& contents)
+{
+    HANDLE file = CreateFileW(Utf8ToWide(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    bool succeeded = GetFileSizeEx(file, &size) != 0;
+    if (succeeded)
+    {
+        contents.resize((size_t)size.QuadPart);
+        // ReadFile takes a 32-bit size, large files are read in chunks.
+        size_t offset = 0;
+        while (succeeded && offset < contents.size())
+        {
+            DWORD chunk = (DWORD)(std::min)(contents.size() - offset, (size_t)1 << 30);
+            DWORD read = 0;
+            succeeded = ReadFile(file, contents.data() + offset, chunk, &read, nullptr) && read == chunk;
+            offset += read;
+        }
+    }
+    CloseHandle(file);
+    return succeeded;
+}
+#else
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0)
+    {
+        close(file);
+        return false;
+    }
+
+    m_open = true;
+    m_size = (size_t)status.st_size;
+    if (m_size > 0)
+    {
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+        m_data = (data == MAP_FAILED) ? nullptr : static_cast<const uint8_t*>(data);
+    }
+    // The mapping stays valid once the descriptor is closed.
+    close(file);
+    if (m_size > 0 && m_data == nullptr)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data != nullptr)
+    {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_open = false;
+}
+
+bool MappedFile::Write(const std::string& path, const void* data, size_t size)
+{
+    std::string temporaryPath = path + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    bool succeeded = size == 0 || fwrite(data, 1, size, file) == size;
+    succeeded = (fclose(file) == 0) && succeeded;
+    if (!succeeded || rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::Read(const std::string& path, std::vector<uint8_t>& contents)
+{
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    bool succeeded = fstat(file, &status) == 0;
+    if (succeeded)
+    {
+        contents.resize((size_t)status.st_size);
+        size_t offset = 0;
+        while (succeeded && offset < contents.size())
+        {
+            ssize_t count = read(file, contents.data() + offset, contents.size() - offset);
+            succeeded = count > 0;
+            offset += succeeded ? (size_t)count : 0;
+        }
+    }
+    close(file);
+    return succeeded;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only mapping of a whole file. Paths are UTF-8.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile& rhs) = delete;
+    MappedFile& operator=(const MappedFile& rhs) = delete;
+    ~MappedFile();
+
+    // Returns false if the file cannot be opened. An empty file opens with a null Data.
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen()const { return m_open; }
+    const uint8_t* Data()const { return m_data; }
+    size_t Size()const { return m_size; }
+
+    // Writes a temporary file next to path and renames it over path, readers
+    // never see a partial file. The file must not be mapped.
+    static bool Write(const std::string& path, const void* data, size_t size);
+
+    // Reads the whole file into contents with sequential reads, reusing its capacity.
+    static bool Read(const std::string& path, std::vector<uint8_t>& contents);
+
+private:
+    bool m_open = false;
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,405 @@
+#include "stdafx.h"
+#include "MeshFile.h"
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+    const uint32_t MeshFileMagic = 0x4853454D; // "MESH"
+    const uint32_t MeshFileVersion = 2;
+
+    struct MeshFileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint64_t SourceKey;
+        uint32_t VertexStride;
+        uint32_t IndexSize;
+        uint32_t VertexCount;
+        uint32_t IndexCount;
+        uint32_t SubmeshCount;
+        uint32_t LodCount;
+        uint32_t MeshletCount;
+        uint32_t MeshletVertexCount;
+        uint32_t MeshletTriangleCount;
+        uint32_t StringsSize;
+        uint32_t VertexEncoding;
+        uint32_t IndexEncoding;
+        // Dequantization of QuantizedPositionColor vertices.
+        float PositionMin[3];
+        float PositionScale[3];
+        uint64_t SubmeshesOffset;
+        uint64_t LodsOffset;
+        uint64_t MeshletsOffset;
+        uint64_t MeshletVerticesOffset;
+        uint64_t MeshletTrianglesOffset;
+        uint64_t StringsOffset;
+        uint64_t VerticesOffset;
+        uint64_t IndicesOffset;
+        // Stored sizes of the streams.
+        uint64_t VertexStreamSize;
+        uint64_t IndexStreamSize;
+    };
+
+    static_assert(sizeof(MeshFileHeader) == 168, "The mesh file layout has no padding");
+    static_assert(sizeof(MeshFileLod) == 24, "The mesh file layout has no padding");
+    static_assert(sizeof(MeshFileMeshlet) == 16, "The mesh file layout has no padding");
+    static_assert(sizeof(MeshFileSubmesh) == 40, "The mesh file layout has no padding");
+
+    bool InBounds(uint64_t offset, uint64_t size, uint64_t fileSize)
+    {
+        return offset <= fileSize && size <= fileSize - offset;
+    }
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Copies count records at offset, the buffer is already sized.
+    template<typename T>
+    void Store(std::vector<uint8_t>& buffer, uint64_t offset, const T* records, size_t count)
+    {
+        if (count > 0)
+        {
+            memcpy(buffer.data() + offset, records, count * sizeof(T));
+        }
+    }
+
+    const MeshFileHeader& Header(const uint8_t* data)
+    {
+        return *reinterpret_cast<const MeshFileHeader*>(data);
+    }
+}
+
+std::vector<uint8_t> SerializeMeshFile(const MeshFileData& data)
+{
+    assert(data.IndexSize == 2 || data.IndexSize == 4);
+    assert(data.VertexStride > 0 && data.Vertices.size() % data.VertexStride == 0);
+    assert(data.Indices.size() % data.IndexSize == 0);
+
+    // The streams as stored.
+    uint32_t vertexCount = (uint32_t)(data.Vertices.size() / data.VertexStride);
+    QuantizationBounds quantization = {};
+    std::vector<uint8_t> vertexStream;
+    std::vector<uint8_t> indexStream;
+    switch (data.VertexEncoding)
+    {
+    case MeshVertexEncoding::Raw:
+        vertexStream = data.Vertices;
+        break;
+    case MeshVertexEncoding::Compressed:
+        EncodeVertexStream(data.Vertices.data(), vertexCount, data.VertexStride, vertexStream);
+        break;
+    case MeshVertexEncoding::QuantizedPositionColor:
+    {
+        assert(data.VertexStride == sizeof(PositionColorVertex));
+        std::vector<QuantizedPositionColorVertex> quantized(vertexCount);
+        quantization = QuantizePositionColor(reinterpret_cast<const PositionColorVertex*>(data.Vertices.data()),
+            vertexCount, quantized.data());
+        EncodeVertexStream(quantized.data(), vertexCount, sizeof(QuantizedPositionColorVertex), vertexStream);
+        break;
+    }
+    }
+    if (data.IndexEncoding == MeshIndexEncoding::Compressed)
+    {
+        EncodeIndexStream(data.Indices.data(), data.Indices.size() / data.IndexSize, data.IndexSize, indexStream);
+    }
+    else
+    {
+        indexStream = data.Indices;
+    }
+
+    std::vector<MeshFileSubmesh> submeshes;
+    std::vector<MeshFileLod> lods;
+    std::string strings;
+    for (const MeshFileData::Submesh& submesh : data.Submeshes)
+    {
+        assert(!submesh.Lods.empty());
+        MeshFileSubmesh record = {};
+        record.NameOffset = (uint32_t)strings.size();
+        record.NameSize = (uint32_t)submesh.Name.size();
+        record.FirstLod = (uint32_t)lods.size();
+        record.LodCount = (uint32_t)submesh.Lods.size();
+        memcpy(record.Center, submesh.Center, sizeof(record.Center));
+        memcpy(record.Extents, submesh.Extents, sizeof(record.Extents));
+        submeshes.push_back(record);
+        lods.insert(lods.end(), submesh.Lods.begin(), submesh.Lods.end());
+        strings += submesh.Name;
+    }
+
+    MeshFileHeader header = {};
+    header.Magic = MeshFileMagic;
+    header.Version = MeshFileVersion;
+    header.SourceKey = data.SourceKey;
+    header.VertexStride = data.VertexStride;
+    header.IndexSize = data.IndexSize;
+    header.VertexCount = vertexCount;
+    header.IndexCount = (uint32_t)(data.Indices.size() / data.IndexSize);
+    header.SubmeshCount = (uint32_t)submeshes.size();
+    header.LodCount = (uint32_t)lods.size();
+    header.MeshletCount = (uint32_t)data.Meshlets.size();
+    header.MeshletVertexCount = (uint32_t)data.MeshletVertices.size();
+    header.MeshletTriangleCount = (uint32_t)data.MeshletTriangles.size();
+    header.StringsSize = (uint32_t)strings.size();
+    header.VertexEncoding = (uint32_t)data.VertexEncoding;
+    header.IndexEncoding = (uint32_t)data.IndexEncoding;
+    memcpy(header.PositionMin, quantization.Min, sizeof(header.PositionMin));
+    memcpy(header.PositionScale, quantization.Scale, sizeof(header.PositionScale));
+    header.VertexStreamSize = vertexStream.size();
+    header.IndexStreamSize = indexStream.size();
+    header.SubmeshesOffset = sizeof(MeshFileHeader);
+    header.LodsOffset = header.SubmeshesOffset + submeshes.size() * sizeof(MeshFileSubmesh);
+    header.MeshletsOffset = header.LodsOffset + lods.size() * sizeof(MeshFileLod);
+    header.MeshletVerticesOffset = header.MeshletsOffset + data.Meshlets.size() * sizeof(MeshFileMeshlet);
+    header.MeshletTrianglesOffset = header.MeshletVerticesOffset + data.MeshletVertices.size() * sizeof(uint32_t);
+    header.StringsOffset = header.MeshletTrianglesOffset + data.MeshletTriangles.size() * sizeof(uint32_t);
+    header.VerticesOffset = AlignUp(header.StringsOffset + header.StringsSize, MeshFileStreamAlignment);
+    header.IndicesOffset = AlignUp(header.VerticesOffset + vertexStream.size(), MeshFileStreamAlignment);
+
+    std::vector<uint8_t> buffer((size_t)(header.IndicesOffset + indexStream.size()), 0);
+    Store(buffer, 0, &header, 1);
+    Store(buffer, header.SubmeshesOffset, submeshes.data(), submeshes.size());
+    Store(buffer, header.LodsOffset, lods.data(), lods.size());
+    Store(buffer, header.MeshletsOffset, data.Meshlets.data(), data.Meshlets.size());
+    Store(buffer, header.MeshletVerticesOffset, data.MeshletVertices.data(), data.MeshletVertices.size());
+    Store(buffer, header.MeshletTrianglesOffset, data.MeshletTriangles.data(), data.MeshletTriangles.size());
+    Store(buffer, header.StringsOffset, strings.data(), strings.size());
+    Store(buffer, header.VerticesOffset, vertexStream.data(), vertexStream.size());
+    Store(buffer, header.IndicesOffset, indexStream.data(), indexStream.size());
+    return buffer;
+}
+
+bool MeshFile::Open(const std::string& path, uint64_t sourceKey)
+{
+    Close();
+    if (!m_file.Open(path))
+    {
+        return false;
+    }
+    if (!Load(m_file.Data(), m_file.Size(), sourceKey))
+    {
+        m_file.Close();
+        return false;
+    }
+    return true;
+}
+
+bool MeshFile::Load(const uint8_t* data, size_t size, uint64_t sourceKey)
+{
+    m_data = data;
+    m_size = size;
+    if (m_data == nullptr || !Validate(sourceKey))
+    {
+        m_data = nullptr;
+        m_size = 0;
+        return false;
+    }
+    return true;
+}
+
+void MeshFile::Close()
+{
+    m_file.Close();
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool MeshFile::Validate(uint64_t sourceKey)const
+{
+    if (m_size < sizeof(MeshFileHeader) || reinterpret_cast<uintptr_t>(m_data) % alignof(MeshFileHeader) != 0)
+    {
+        return false;
+    }
+    const MeshFileHeader& header = Header(m_data);
+    bool valid = header.Magic == MeshFileMagic && header.Version == MeshFileVersion &&
+        header.SourceKey == sourceKey &&
+        header.VertexStride > 0 && (header.IndexSize == 2 || header.IndexSize == 4) &&
+        header.SubmeshesOffset % alignof(MeshFileSubmesh) == 0 &&
+        header.LodsOffset % alignof(MeshFileLod) == 0 &&
+        header.MeshletsOffset % alignof(MeshFileMeshlet) == 0 &&
+        header.MeshletVerticesOffset % alignof(uint32_t) == 0 &&
+        header.MeshletTrianglesOffset % alignof(uint32_t) == 0 &&
+        header.VerticesOffset % MeshFileStreamAlignment == 0 &&
+        header.IndicesOffset % MeshFileStreamAlignment == 0 &&
+        InBounds(header.SubmeshesOffset, (uint64_t)header.SubmeshCount * sizeof(MeshFileSubmesh), m_size) &&
+        InBounds(header.LodsOffset, (uint64_t)header.LodCount * sizeof(MeshFileLod), m_size) &&
+        InBounds(header.MeshletsOffset, (uint64_t)header.MeshletCount * sizeof(MeshFileMeshlet), m_size) &&
+        InBounds(header.MeshletVerticesOffset, (uint64_t)header.MeshletVertexCount * sizeof(uint32_t), m_size) &&
+        InBounds(header.MeshletTrianglesOffset, (uint64_t)header.MeshletTriangleCount * sizeof(uint32_t), m_size) &&
+        InBounds(header.StringsOffset, header.StringsSize, m_size) &&
+        InBounds(header.VerticesOffset, header.VertexStreamSize, m_size) &&
+        InBounds(header.IndicesOffset, header.IndexStreamSize, m_size);
+
+    // Compressed streams are walked, not decoded, it is enough to decode them safely later.
+    if (valid)
+    {
+        const uint8_t* vertexStream = m_data + header.VerticesOffset;
+        switch ((MeshVertexEncoding)header.VertexEncoding)
+        {
+        case MeshVertexEncoding::Raw:
+            valid = header.VertexStreamSize == (uint64_t)header.VertexCount * header.VertexStride;
+            break;
+        case MeshVertexEncoding::Compressed:
+            valid = ValidateVertexStream(vertexStream, (size_t)header.VertexStreamSize, header.VertexCount, header.VertexStride);
+            break;
+        case MeshVertexEncoding::QuantizedPositionColor:
+            valid = header.VertexStride == sizeof(PositionColorVertex) &&
+                ValidateVertexStream(vertexStream, (size_t)header.VertexStreamSize, header.VertexCount,
+                    sizeof(QuantizedPositionColorVertex));
+            break;
+        default:
+            valid = false;
+            break;
+        }
+
+        const uint8_t* indexStream = m_data + header.IndicesOffset;
+        switch ((MeshIndexEncoding)header.IndexEncoding)
+        {
+        case MeshIndexEncoding::Raw:
+            valid = valid && header.IndexStreamSize == (uint64_t)header.IndexCount * header.IndexSize;
+            break;
+        case MeshIndexEncoding::Compressed:
+            valid = valid && ValidateIndexStream(indexStream, (size_t)header.IndexStreamSize, header.IndexCount);
+            break;
+        default:
+            valid = false;
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; valid && i < header.SubmeshCount; i++)
+    {
+        const MeshFileSubmesh& submesh = Submesh(i);
+        valid = InBounds(submesh.NameOffset, submesh.NameSize, header.StringsSize) &&
+            submesh.LodCount > 0 && (uint64_t)submesh.FirstLod + submesh.LodCount <= header.LodCount;
+    }
+    for (uint32_t i = 0; valid && i < header.LodCount; i++)
+    {
+        // Indices are only checked against the vertex count from the base vertex by the GPU, not here.
+        const MeshFileLod& lod = Lod(i);
+        valid = (uint64_t)lod.StartIndex + lod.IndexCount <= header.IndexCount &&
+            lod.BaseVertex >= 0 && (uint32_t)lod.BaseVertex <= header.VertexCount &&
+            (uint64_t)lod.FirstMeshlet + lod.MeshletCount <= header.MeshletCount;
+    }
+    for (uint32_t i = 0; valid && i < header.MeshletCount; i++)
+    {
+        const MeshFileMeshlet& meshlet = Meshlet(i);
+        valid = (uint64_t)meshlet.FirstVertex + meshlet.VertexCount <= header.MeshletVertexCount &&
+            (uint64_t)meshlet.FirstTriangle + meshlet.TriangleCount <= header.MeshletTriangleCount;
+    }
+    return valid;
+}
+
+uint32_t MeshFile::VertexStride()const
+{
+    return Header(m_data).VertexStride;
+}
+
+uint32_t MeshFile::IndexSize()const
+{
+    return Header(m_data).IndexSize;
+}
+
+uint64_t MeshFile::VertexDataSize()const
+{
+    return (uint64_t)Header(m_data).VertexCount * Header(m_data).VertexStride;
+}
+
+uint64_t MeshFile::IndexDataSize()const
+{
+    return (uint64_t)Header(m_data).IndexCount * Header(m_data).IndexSize;
+}
+
+bool MeshFile::DecodeVertices(void* destination)const
+{
+    const MeshFileHeader& header = Header(m_data);
+    const uint8_t* stream = m_data + header.VerticesOffset;
+    switch ((MeshVertexEncoding)header.VertexEncoding)
+    {
+    case MeshVertexEncoding::Raw:
+        memcpy(destination, stream, (size_t)header.VertexStreamSize);
+        return true;
+    case MeshVertexEncoding::Compressed:
+        return DecodeVertexStream(destination, header.VertexCount, header.VertexStride, stream, (size_t)header.VertexStreamSize);
+    default:
+    {
+        std::vector<QuantizedPositionColorVertex> quantized(header.VertexCount);
+        if (!DecodeVertexStream(quantized.data(), header.VertexCount, sizeof(QuantizedPositionColorVertex),
+            stream, (size_t)header.VertexStreamSize))
+        {
+            return false;
+        }
+        QuantizationBounds bounds;
+        memcpy(bounds.Min, header.PositionMin, sizeof(bounds.Min));
+        memcpy(bounds.Scale, header.PositionScale, sizeof(bounds.Scale));
+        DequantizePositionColor(quantized.data(), header.VertexCount, bounds,
+            static_cast<PositionColorVertex*>(destination));
+        return true;
+    }
+    }
+}
+
+bool MeshFile::DecodeIndices(void* destination)const
+{
+    const MeshFileHeader& header = Header(m_data);
+    const uint8_t* stream = m_data + header.IndicesOffset;
+    if ((MeshIndexEncoding)header.IndexEncoding == MeshIndexEncoding::Raw)
+    {
+        memcpy(destination, stream, (size_t)header.IndexStreamSize);
+        return true;
+    }
+    return DecodeIndexStream(destination, header.IndexCount, header.IndexSize, stream, (size_t)header.IndexStreamSize);
+}
+
+uint64_t MeshFile::VertexStreamSize()const
+{
+    return Header(m_data).VertexStreamSize;
+}
+
+uint64_t MeshFile::IndexStreamSize()const
+{
+    return Header(m_data).IndexStreamSize;
+}
+
+uint32_t MeshFile::SubmeshCount()const
+{
+    return Header(m_data).SubmeshCount;
+}
+
+const MeshFileSubmesh& MeshFile::Submesh(uint32_t index)const
+{
+    return reinterpret_cast<const MeshFileSubmesh*>(m_data + Header(m_data).SubmeshesOffset)[index];
+}
+
+std::string MeshFile::SubmeshName(uint32_t index)const
+{
+    const MeshFileSubmesh& submesh = Submesh(index);
+    const char* strings = reinterpret_cast<const char*>(m_data + Header(m_data).StringsOffset);
+    return std::string(strings + submesh.NameOffset, submesh.NameSize);
+}
+
+const MeshFileLod& MeshFile::Lod(uint32_t index)const
+{
+    return reinterpret_cast<const MeshFileLod*>(m_data + Header(m_data).LodsOffset)[index];
+}
+
+uint32_t MeshFile::MeshletCount()const
+{
+    return Header(m_data).MeshletCount;
+}
+
+const MeshFileMeshlet& MeshFile::Meshlet(uint32_t index)const
+{
+    return reinterpret_cast<const MeshFileMeshlet*>(m_data + Header(m_data).MeshletsOffset)[index];
+}
+
+const uint32_t* MeshFile::MeshletVertices()const
+{
+    return reinterpret_cast<const uint32_t*>(m_data + Header(m_data).MeshletVerticesOffset);
+}
+
+const uint32_t* MeshFile::MeshletTriangles()const
+{
+    return reinterpret_cast<const uint32_t*>(m_data + Header(m_data).MeshletTrianglesOffset);
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#pragma once
+#include "MappedFile.h"
+#include "GeometryCodec.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Records of the mesh file, read in place from the mapping.
+
+// One level of detail of a submesh. Level 0 is the full mesh, Error is the
+// object space distance to it.
+struct MeshFileLod
+{
+    uint32_t StartIndex;
+    uint32_t IndexCount;
+    int32_t BaseVertex;
+    float Error;
+    // Range in the meshlet table, empty without meshlets.
+    uint32_t FirstMeshlet;
+    uint32_t MeshletCount;
+};
+
+// Ranges of the meshlet vertex and triangle streams. The vertices index the
+// vertex stream from BaseVertex, a triangle packs three meshlet vertices in
+// the low 3 bytes.
+struct MeshFileMeshlet
+{
+    uint32_t FirstVertex;
+    uint32_t VertexCount;
+    uint32_t FirstTriangle;
+    uint32_t TriangleCount;
+};
+
+struct MeshFileSubmesh
+{
+    // Range in the string pool.
+    uint32_t NameOffset;
+    uint32_t NameSize;
+    uint32_t FirstLod;
+    uint32_t LodCount;
+    // Axis aligned bounds of level 0.
+    float Center[3];
+    float Extents[3];
+};
+
+// How the vertex stream is stored.
+enum class MeshVertexEncoding : uint32_t
+{
+    Raw,
+    // The vertex codec over the vertices as they are.
+    Compressed,
+    // PositionColorVertex quantized to QuantizedPositionColorVertex, then the
+    // vertex codec. Lossy, the positions keep 16 bits across the bounds.
+    QuantizedPositionColor,
+};
+
+// How the index stream is stored.
+enum class MeshIndexEncoding : uint32_t
+{
+    Raw,
+    // The index codec.
+    Compressed,
+};
+
+// What SerializeMeshFile stores.
+struct MeshFileData
+{
+    struct Submesh
+    {
+        std::string Name;
+        float Center[3] = {};
+        float Extents[3] = {};
+        // At least one, the finest first.
+        std::vector<MeshFileLod> Lods;
+    };
+
+    // Chosen by the writer, identifies what the file was baked from.
+    uint64_t SourceKey = 0;
+    uint32_t VertexStride = 0;
+    // 2 or 4 bytes.
+    uint32_t IndexSize = 2;
+    MeshVertexEncoding VertexEncoding = MeshVertexEncoding::Raw;
+    MeshIndexEncoding IndexEncoding = MeshIndexEncoding::Raw;
+    // Decoded, as the GPU reads them.
+    std::vector<uint8_t> Vertices;
+    std::vector<uint8_t> Indices;
+    std::vector<Submesh> Submeshes;
+    std::vector<MeshFileMeshlet> Meshlets;
+    std::vector<uint32_t> MeshletVertices;
+    std::vector<uint32_t> MeshletTriangles;
+};
+
+// Lays the data out as a mesh file: a header, the submesh, level of detail
+// and meshlet tables, a string pool, then the vertex and index streams encoded
+// as data asks, each aligned to MeshFileStreamAlignment so they can be
+// uploaded or decoded with SIMD loads straight from the mapping. Little-endian with fixed-size
+// fields, the same file works on every platform.
+std::vector<uint8_t> SerializeMeshFile(const MeshFileData& data);
+
+const uint32_t MeshFileStreamAlignment = 64;
+
+// Reads a mesh file in place. Every range is checked when the file is
+// opened, the accessors trust it afterwards.
+class MeshFile
+{
+public:
+    MeshFile() = default;
+    MeshFile(const MeshFile& rhs) = delete;
+    MeshFile& operator=(const MeshFile& rhs) = delete;
+
+    // Maps the file. Returns false if it is missing, damaged, of another
+    // version or not baked from sourceKey.
+    bool Open(const std::string& path, uint64_t sourceKey);
+    // Reads a file already in memory, data has to outlive the MeshFile.
+    bool Load(const uint8_t* data, size_t size, uint64_t sourceKey);
+    void Close();
+
+    bool IsOpen()const { return m_data != nullptr; }
+    // Opened from a file rather than from memory.
+    bool IsMapped()const { return m_file.IsOpen(); }
+    // The whole file.
+    const uint8_t* Data()const { return m_data; }
+    size_t Size()const { return m_size; }
+
+    uint32_t VertexStride()const;
+    uint32_t IndexSize()const;
+    // Sizes once decoded.
+    uint64_t VertexDataSize()const;
+    uint64_t IndexDataSize()const;
+    // Decode the streams into destination, VertexDataSize and IndexDataSize
+    // bytes. Raw streams are copied straight from the mapping. Returns false
+    // if a compressed stream turns out damaged.
+    bool DecodeVertices(void* destination)const;
+    bool DecodeIndices(void* destination)const;
+    // The streams as stored, what a load reads from disk.
+    uint64_t VertexStreamSize()const;
+    uint64_t IndexStreamSize()const;
+
+    uint32_t SubmeshCount()const;
+    const MeshFileSubmesh& Submesh(uint32_t index)const;
+    std::string SubmeshName(uint32_t index)const;
+    const MeshFileLod& Lod(uint32_t index)const;
+    uint32_t MeshletCount()const;
+    const MeshFileMeshlet& Meshlet(uint32_t index)const;
+    const uint32_t* MeshletVertices()const;
+    const uint32_t* MeshletTriangles()const;
+
+private:
+    bool Validate(uint64_t sourceKey)const;
+
+    MappedFile m_file;
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include "stdafx.h"
+#include "MeshStreamer.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+    // Nearest first out of the heap.
+    template<typename T>
+    bool FartherThan(const T& a, const T& b)
+    {
+        return a.Distance > b.Distance;
+    }
+
+    float DistanceToBox(const DirectX::XMFLOAT3& point, const DirectX::BoundingBox& box)
+    {
+        float dx = (std::max)(fabsf(point.x - box.Center.x) - box.Extents.x, 0.0f);
+        float dy = (std::max)(fabsf(point.y - box.Center.y) - box.Extents.y, 0.0f);
+        float dz = (std::max)(fabsf(point.z - box.Center.z) - box.Extents.z, 0.0f);
+        return sqrtf(dx * dx + dy * dy + dz * dz);
+    }
+}
+
+std::unique_ptr<MeshGeometry> CreateMeshGeometry(CopyQueueUploader* uploader, const MeshFile& meshFile,
+    GeometryResidency residency, std::shared_ptr<const MeshFile> mapping)
+{
+    const UINT vbByteSize = (UINT)meshFile.VertexDataSize();
+    const UINT ibByteSize = (UINT)meshFile.IndexDataSize();
+
+    auto geo = std::make_unique<MeshGeometry>();
+
+    // The streams are decoded straight into the staging buffers. The copies
+    // run on the copy queue, items using the geometry are skipped until the
+    // copy fence reaches UploadFenceValue. The uploader may be submitted
+    // between the two buffers, the later of their batches covers both.
+    bool decoded = true;
+    UINT64 vertexFenceValue = 0;
+    UINT64 indexFenceValue = 0;
+    geo->VertexBufferGPU = uploader->CreateBuffer(vbByteSize,
+        [&](void* destination) { decoded = meshFile.DecodeVertices(destination) && decoded; }, &vertexFenceValue);
+    geo->IndexBufferGPU = uploader->CreateBuffer(ibByteSize,
+        [&](void* destination) { decoded = meshFile.DecodeIndices(destination) && decoded; }, &indexFenceValue);
+    geo->UploadFenceValue = (std::max)(vertexFenceValue, indexFenceValue);
+    // Opening the file walked the streams, decoding them cannot fail.
+    assert(decoded && "Mesh file streams do not decode");
+
+    geo->VertexByteStride = meshFile.VertexStride();
+    geo->VertexBufferByteSize = vbByteSize;
+    geo->IndexFormat = (meshFile.IndexSize() == 4) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+    geo->IndexBufferByteSize = ibByteSize;
+
+    // Without a mapping to view, a compressed copy is made from the decoded streams.
+    std::vector<uint8_t> cpuVertices;
+    std::vector<uint8_t> cpuIndices;
+    if (residency == GeometryResidency::Compressed ||
+        (residency == GeometryResidency::MappedView && mapping == nullptr))
+    {
+        cpuVertices.resize(vbByteSize);
+        cpuIndices.resize(ibByteSize);
+        meshFile.DecodeVertices(cpuVertices.data());
+        meshFile.DecodeIndices(cpuIndices.data());
+    }
+    geo->CpuCopy.Keep(residency, mapping,
+        cpuVertices.data(), vbByteSize, meshFile.VertexStride(),
+        cpuIndices.data(), ibByteSize, meshFile.IndexSize());
+
+    // Submeshes draw their finest level of detail.
+    for (uint32_t i = 0; i < meshFile.SubmeshCount(); i++)
+    {
+        const MeshFileSubmesh& record = meshFile.Submesh(i);
+        const MeshFileLod& lod = meshFile.Lod(record.FirstLod);
+
+        SubmeshGeometry submesh;
+        submesh.IndexCount = lod.IndexCount;
+        submesh.StartIndexLocation = lod.StartIndex;
+        submesh.BaseVertexLocation = lod.BaseVertex;
+        submesh.Bounds.Center = DirectX::XMFLOAT3(record.Center);
+        submesh.Bounds.Extents = DirectX::XMFLOAT3(record.Extents);
+        geo->DrawArgs[InternString(meshFile.SubmeshName(i))] = submesh;
+    }
+    return geo;
+}
+
+MeshStreamer::MeshStreamer(JobSystem* jobSystem, CopyQueueUploader* uploader, uint32_t ioThreadCount, uint32_t bufferCount) :
+    m_jobSystem(jobSystem),
+    m_uploader(uploader)
+{
+    assert(ioThreadCount > 0 && bufferCount > 0 && "The streamer needs a thread and a buffer");
+    for (uint32_t i = 0; i < bufferCount; i++)
+    {
+        m_buffers.push_back(std::make_unique<std::vector<uint8_t>>());
+        m_freeBuffers.push_back(m_buffers.back().get());
+    }
+    for (uint32_t i = 0; i < ioThreadCount; i++)
+    {
+        m_ioThreads.emplace_back(&MeshStreamer::IoThreadMain, this);
+    }
+}
+
+MeshStreamer::~MeshStreamer()
+{
+    {
+        std::lock_guard<std::mutex> queueLock(m_queueMutex);
+        std::lock_guard<std::mutex> bufferLock(m_bufferMutex);
+        m_quit = true;
+    }
+    m_queueCondition.notify_all();
+    m_bufferCondition.notify_all();
+    for (std::thread& thread : m_ioThreads)
+    {
+        thread.join();
+    }
+    // The decode jobs use the buffers and the uploader.
+    m_jobSystem->Wait(&m_decodeJobs);
+}
+
+void MeshStreamer::Request(const std::string& path, uint64_t sourceKey, GeometryResidency residency,
+    MeshGeometry* placeholder, const DirectX::BoundingBox& worldBounds)
+{
+    PendingRequest request;
+    request.Path = path;
+    request.SourceKey = sourceKey;
+    request.Residency = residency;
+    request.Placeholder = placeholder;
+    request.WorldBounds = worldBounds;
+    m_pendingCount.fetch_add(1, std::memory_order_acq_rel);
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queue.push_back(std::move(request));
+        std::push_heap(m_queue.begin(), m_queue.end(), FartherThan<PendingRequest>);
+    }
+    m_queueCondition.notify_one();
+}
+
+void MeshStreamer::Update(const DirectX::XMFLOAT3& eyePosition, std::vector<LoadedMesh>& loaded)
+{
+    {
+        // The camera moved, the queue is ordered again. A handful of
+        // entries, cheaper than keeping the I/O threads waiting on a lock.
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        for (PendingRequest& request : m_queue)
+        {
+            request.Distance = DistanceToBox(eyePosition, request.WorldBounds);
+        }
+        std::make_heap(m_queue.begin(), m_queue.end(), FartherThan<PendingRequest>);
+    }
+
+    loaded.clear();
+    std::lock_guard<std::mutex> lock(m_loadedMutex);
+    // Both vectors keep their capacity, the steady frames do not allocate.
+    loaded.swap(m_loaded);
+}
+
+std::vector<uint8_t>* MeshStreamer::AcquireBuffer()
+{
+    std::unique_lock<std::mutex> lock(m_bufferMutex);
+    m_bufferCondition.wait(lock, [this]() { return m_quit || !m_freeBuffers.empty(); });
+    if (m_quit)
+    {
+        return nullptr;
+    }
+    std::vector<uint8_t>* buffer = m_freeBuffers.back();
+    m_freeBuffers.pop_back();
+    return buffer;
+}
+
+void MeshStreamer::ReleaseBuffer(std::vector<uint8_t>* buffer)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_bufferMutex);
+        m_freeBuffers.push_back(buffer);
+    }
+    m_bufferCondition.notify_one();
+}
+
+void MeshStreamer::IoThreadMain()
+{
+    for (;;)
+    {
+        // A buffer first, the request is chosen once it can be read: the
+        // camera may have moved while the buffers were taken.
+        std::vector<uint8_t>* buffer = AcquireBuffer();
+        if (buffer == nullptr)
+        {
+            return;
+        }
+
+        PendingRequest request;
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_queueCondition.wait(lock, [this]() { return m_quit || !m_queue.empty(); });
+            if (m_quit)
+            {
+                return;
+            }
+            std::pop_heap(m_queue.begin(), m_queue.end(), FartherThan<PendingRequest>);
+            request = std::move(m_queue.back());
+            m_queue.pop_back();
+        }
+
+        // One sequential read of the whole file, the decode runs on the job
+        // workers while this thread reads the next one.
+        if (!MappedFile::Read(request.Path, *buffer))
+        {
+            ReleaseBuffer(buffer);
+            buffer = nullptr;
+        }
+        m_jobSystem->RunBackground([this, request, buffer]() { Decode(request, buffer); }, &m_decodeJobs);
+    }
+}
+
+void MeshStreamer::Decode(const PendingRequest& request, std::vector<uint8_t>* buffer)
+{
+    LoadedMesh mesh;
+    mesh.Placeholder = request.Placeholder;
+    if (buffer != nullptr)
+    {
+        MeshFile meshFile;
+        if (meshFile.Load(buffer->data(), buffer->size(), request.SourceKey))
+        {
+            try
+            {
+                // The buffer is reused, a MappedView copy falls back to a compressed one.
+                mesh.Geometry = CreateMeshGeometry(m_uploader, meshFile, request.Residency, nullptr);
+                mesh.Geometry->name = request.Placeholder->name;
+            }
+            catch (...)
+            {
+                // Reported as a failed load, the device errors show up on the frame path too.
+                mesh.Geometry = nullptr;
+            }
+        }
+        ReleaseBuffer(buffer);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_loadedMutex);
+        m_loaded.push_back(std::move(mesh));
+    }
+    m_pendingCount.fetch_sub(1, std::memory_order_acq_rel);
+}
\ No newline at end of file
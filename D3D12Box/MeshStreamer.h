@@ -0,0 +1,102 @@
+#pragma once
+#include "stdafx.h"
+#include "D3DAppUtil.h"
+#include "CopyQueueUploader.h"
+#include "JobSystem.h"
+#include "MeshFile.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Creates a geometry from meshFile: the streams are decoded straight into
+// the staging buffers of uploader, the submeshes take the bounds of the file
+// and their Ids are left to the caller. mapping, if not null, owns meshFile
+// for a MappedView CPU copy.
+std::unique_ptr<MeshGeometry> CreateMeshGeometry(CopyQueueUploader* uploader, const MeshFile& meshFile,
+    GeometryResidency residency, std::shared_ptr<const MeshFile> mapping);
+
+// Loads mesh files in the background, the scene is not limited to what the
+// startup load can afford. I/O threads read the files into pooled buffers,
+// the queued request nearest to the camera first, and background jobs
+// decode them into the staging buffers of the copy queue. The thread owning the
+// scene picks the finished geometries up in Update; their copies are fenced
+// by UploadFenceValue like any other upload.
+class MeshStreamer
+{
+public:
+    // UploadFenceValue of a placeholder, the copy fence never reaches it.
+    static const UINT64 NotLoaded = UINT64_MAX;
+
+    struct LoadedMesh
+    {
+        // The geometry given to Request.
+        MeshGeometry* Placeholder = nullptr;
+        // Null if the file is missing, damaged or stale.
+        std::unique_ptr<MeshGeometry> Geometry;
+    };
+
+    // bufferCount read buffers are pooled, reads wait for one to be free,
+    // which bounds the memory the files in flight take.
+    MeshStreamer(JobSystem* jobSystem, CopyQueueUploader* uploader, uint32_t ioThreadCount, uint32_t bufferCount);
+    MeshStreamer(const MeshStreamer& rhs) = delete;
+    MeshStreamer& operator=(const MeshStreamer& rhs) = delete;
+    // Drops the requests not read yet and waits for the others.
+    ~MeshStreamer();
+
+    // Queues the load of path. placeholder stays in the scene meanwhile, its
+    // submesh bounds stand in for culling; worldBounds orders the queue.
+    void Request(const std::string& path, uint64_t sourceKey, GeometryResidency residency,
+        MeshGeometry* placeholder, const DirectX::BoundingBox& worldBounds);
+
+    // Orders the queue by distance to eyePosition and moves the meshes
+    // finished since the last call into loaded. Once a frame, on the thread
+    // owning the scene.
+    void Update(const DirectX::XMFLOAT3& eyePosition, std::vector<LoadedMesh>& loaded);
+
+    // Requests queued, being read or decoded.
+    uint32_t PendingCount()const { return m_pendingCount.load(std::memory_order_acquire); }
+
+private:
+    struct PendingRequest
+    {
+        std::string Path;
+        uint64_t SourceKey = 0;
+        GeometryResidency Residency = GeometryResidency::None;
+        MeshGeometry* Placeholder = nullptr;
+        DirectX::BoundingBox WorldBounds;
+        float Distance = 0.0f;
+    };
+
+    // Null once the streamer is quitting.
+    std::vector<uint8_t>* AcquireBuffer();
+    void ReleaseBuffer(std::vector<uint8_t>* buffer);
+    void IoThreadMain();
+    // buffer holds the file, null if it could not be read.
+    void Decode(const PendingRequest& request, std::vector<uint8_t>* buffer);
+
+    JobSystem* m_jobSystem;
+    CopyQueueUploader* m_uploader;
+    std::vector<std::thread> m_ioThreads;
+
+    // Requests not read yet, a heap with the nearest on top.
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueCondition;
+    std::vector<PendingRequest> m_queue;
+    bool m_quit = false;
+
+    std::mutex m_bufferMutex;
+    std::condition_variable m_bufferCondition;
+    std::vector<std::unique_ptr<std::vector<uint8_t>>> m_buffers;
+    std::vector<std::vector<uint8_t>*> m_freeBuffers;
+
+    // Decoded, waiting for Update.
+    std::mutex m_loadedMutex;
+    std::vector<LoadedMesh> m_loaded;
+
+    JobCounter m_decodeJobs;
+    std::atomic<uint32_t> m_pendingCount{ 0 };
+};
\ No newline at end of file
@@ -0,0 +1,19 @@
+// Per pass constants, matches PassConstants in D3DAppUtil.h.
+cbuffer cbPerPass : register(b1)
+{
+    float4x4    gView;
+    float4x4    gInvView;
+    float4x4    gProj;
+    float4x4    gInvProj;
+    float4x4    gViewProj;
+    float4x4    gInvViewProj;
+    float3      gEyePosW;
+    float       cbPerObjectPad1;
+    float2      gRenderTargerSize;
+    float2      gInvRenderTargetSize;
+    float       gNearZ;
+    float       gFarZ;
+    float       gTotalTime;
+    float       gDeltaTime;
+    float4      gFrustumPlanes[6];
+};
\ No newline at end of file
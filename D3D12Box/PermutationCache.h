@@ -0,0 +1,231 @@
+#pragma once
+#include "JobSystem.h"
+#include "ShaderPermutation.h"
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Objects built for a set of features, a pipeline state per permutation of
+// a shader family. A permutation is built by a job the first time it is
+// requested, or ahead of time by Prewarm, as a background job: the frame
+// waits do not run them. The cache does not own the objects.
+//
+// The build reports the files it read. When one of them changes the
+// permutation is built again in the background, Request keeps returning the
+// previous object until the new one is ready.
+template<typename T>
+class PermutationCache
+{
+public:
+    // Appends the files read to files, also the ones read before a failure.
+    typedef std::function<T*(ShaderFeature features, std::vector<std::string>& files)> BuildFunction;
+
+    // The builds do not start before dependency, if not null, is done.
+    PermutationCache(JobSystem* jobSystem, BuildFunction build, JobCounter* dependency = nullptr) :
+        m_jobSystem(jobSystem),
+        m_build(std::move(build)),
+        m_dependency(dependency)
+    {
+    }
+    PermutationCache(const PermutationCache& rhs) = delete;
+    PermutationCache& operator=(const PermutationCache& rhs) = delete;
+
+    // Returns null while the permutation is first built, the first request
+    // submits its build. A finished rebuild replaces the object here. Rethrows
+    // the exception of a failed build once, a failed rebuild keeps the
+    // previous object. Thread safe.
+    T* Request(ShaderFeature features)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Permutation* permutation = Find(features);
+        permutation->Requested = true;
+        if (!permutation->Built.IsDone())
+        {
+            return nullptr;
+        }
+        if (permutation->Stale && permutation->Pending == nullptr)
+        {
+            permutation->Stale = false;
+            permutation->Pending = Submit(features);
+        }
+        m_jobSystem->Wait(&permutation->Built);
+
+        if (permutation->Pending != nullptr && permutation->Pending->Built.IsDone())
+        {
+            std::unique_ptr<Permutation> rebuilt = std::move(permutation->Pending);
+            for (const std::string& file : rebuilt->Files)
+            {
+                AddFile(permutation->Files, file);
+            }
+            if (permutation->Stale)
+            {
+                // A file changed again while it was rebuilt.
+                permutation->Stale = false;
+                permutation->Pending = Submit(features);
+            }
+            m_jobSystem->Wait(&rebuilt->Built);
+            permutation->Object = rebuilt->Object;
+        }
+        return permutation->Object;
+    }
+
+    // Submits the builds of the permutations not built yet, without
+    // counting them as requested.
+    void Prewarm(const std::vector<ShaderFeature>& permutations)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (ShaderFeature features : permutations)
+        {
+            Find(features);
+        }
+    }
+
+    // Rebuilds the permutations that read file. The files of a build still
+    // running are unknown, it is rebuilt once done in any case. Returns the
+    // number of permutations concerned.
+    uint32_t RebuildUsing(const std::string& file)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint32_t count = 0;
+        for (auto& permutation : m_permutations)
+        {
+            Permutation* target = permutation.second.get();
+            if (!target->Built.IsDone() || target->Pending != nullptr)
+            {
+                target->Stale = true;
+                count++;
+            }
+            else if (std::find(target->Files.begin(), target->Files.end(), file) != target->Files.end())
+            {
+                target->Pending = Submit((ShaderFeature)permutation.first);
+                count++;
+            }
+        }
+        return count;
+    }
+
+    // True while a build or a rebuild has not finished.
+    bool IsBuilding()const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& permutation : m_permutations)
+        {
+            const Permutation* target = permutation.second.get();
+            if (!target->Built.IsDone() || (target->Pending != nullptr && !target->Pending->Built.IsDone()))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Waits for every build, then rethrows the first failure not reported yet.
+    void WaitAll()
+    {
+        // Not under the lock, the waiting thread runs other jobs meanwhile.
+        std::vector<JobCounter*> builds;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto& permutation : m_permutations)
+            {
+                builds.push_back(&permutation.second->Built);
+                if (permutation.second->Pending != nullptr)
+                {
+                    builds.push_back(&permutation.second->Pending->Built);
+                }
+            }
+        }
+        std::exception_ptr failure;
+        for (JobCounter* built : builds)
+        {
+            try
+            {
+                m_jobSystem->Wait(built);
+            }
+            catch (...)
+            {
+                if (!failure)
+                {
+                    failure = std::current_exception();
+                }
+            }
+        }
+        if (failure)
+        {
+            std::rethrow_exception(failure);
+        }
+    }
+
+    // The permutations requested so far, the usage list of the run.
+    std::vector<ShaderFeature> RequestedPermutations()const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<ShaderFeature> requested;
+        for (const auto& permutation : m_permutations)
+        {
+            if (permutation.second->Requested)
+            {
+                requested.push_back((ShaderFeature)permutation.first);
+            }
+        }
+        std::sort(requested.begin(), requested.end());
+        return requested;
+    }
+
+private:
+    struct Permutation
+    {
+        JobCounter Built;
+        // Written by the build job, read once Built is done.
+        T* Object = nullptr;
+        std::vector<std::string> Files;
+        bool Requested = false;
+        // A rebuild in flight, and whether a file changed since it started.
+        std::unique_ptr<Permutation> Pending;
+        bool Stale = false;
+    };
+
+    static void AddFile(std::vector<std::string>& files, const std::string& file)
+    {
+        if (std::find(files.begin(), files.end(), file) == files.end())
+        {
+            files.push_back(file);
+        }
+    }
+
+    // Called with m_mutex locked.
+    std::unique_ptr<Permutation> Submit(ShaderFeature features)
+    {
+        std::unique_ptr<Permutation> permutation = std::make_unique<Permutation>();
+        Permutation* target = permutation.get();
+        BuildFunction* build = &m_build;
+        m_jobSystem->RunBackground([target, build, features]()
+        {
+            target->Object = (*build)(features, target->Files);
+        }, &target->Built, m_dependency);
+        return permutation;
+    }
+
+    // Called with m_mutex locked, submits the build of a new permutation.
+    Permutation* Find(ShaderFeature features)
+    {
+        std::unique_ptr<Permutation>& permutation = m_permutations[(uint32_t)features];
+        if (permutation == nullptr)
+        {
+            permutation = Submit(features);
+        }
+        return permutation.get();
+    }
+
+    JobSystem* m_jobSystem;
+    BuildFunction m_build;
+    JobCounter* m_dependency;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint32_t, std::unique_ptr<Permutation>> m_permutations;
+};
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include "stdafx.h"
+#include "PipelineStateCache.h"
+#include "Hash.h"
+#include <cassert>
+#include <fstream>
+
+namespace
+{
+    const UINT32 PipelineCacheMagic = 0x43505350; // "PSPC"
+    // Bumped when the hashes change, the library entries are named after them.
+    const UINT32 PipelineCacheVersion = 2;
+
+    void AddShader(Hasher& hasher, const D3D12_SHADER_BYTECODE& shader)
+    {
+        hasher.AddValue((UINT64)shader.BytecodeLength);
+        hasher.Add(shader.pShaderBytecode, shader.BytecodeLength);
+    }
+
+    // Field by field: every render target entry ends with 3 bytes of padding.
+    void AddBlendState(Hasher& hasher, const D3D12_BLEND_DESC& blend)
+    {
+        hasher.AddValue(blend.AlphaToCoverageEnable);
+        hasher.AddValue(blend.IndependentBlendEnable);
+        for (const D3D12_RENDER_TARGET_BLEND_DESC& target : blend.RenderTarget)
+        {
+            hasher.AddValue(target.BlendEnable);
+            hasher.AddValue(target.LogicOpEnable);
+            hasher.AddValue(target.SrcBlend);
+            hasher.AddValue(target.DestBlend);
+            hasher.AddValue(target.BlendOp);
+            hasher.AddValue(target.SrcBlendAlpha);
+            hasher.AddValue(target.DestBlendAlpha);
+            hasher.AddValue(target.BlendOpAlpha);
+            hasher.AddValue(target.LogicOp);
+            hasher.AddValue(target.RenderTargetWriteMask);
+        }
+    }
+
+    void AddStencilOp(Hasher& hasher, const D3D12_DEPTH_STENCILOP_DESC& face)
+    {
+        hasher.AddValue(face.StencilFailOp);
+        hasher.AddValue(face.StencilDepthFailOp);
+        hasher.AddValue(face.StencilPassOp);
+        hasher.AddValue(face.StencilFunc);
+    }
+
+    // Field by field: 2 bytes of padding follow the stencil masks.
+    void AddDepthStencilState(Hasher& hasher, const D3D12_DEPTH_STENCIL_DESC& depthStencil)
+    {
+        hasher.AddValue(depthStencil.DepthEnable);
+        hasher.AddValue(depthStencil.DepthWriteMask);
+        hasher.AddValue(depthStencil.DepthFunc);
+        hasher.AddValue(depthStencil.StencilEnable);
+        hasher.AddValue(depthStencil.StencilReadMask);
+        hasher.AddValue(depthStencil.StencilWriteMask);
+        AddStencilOp(hasher, depthStencil.FrontFace);
+        AddStencilOp(hasher, depthStencil.BackFace);
+    }
+
+    // Library entries are named after the hash.
+    std::wstring PipelineName(uint64_t hash)
+    {
+        WCHAR name[32];
+        swprintf_s(name, L"%016llx", (unsigned long long)hash);
+        return name;
+    }
+}
+
+PipelineStateCache::PipelineStateCache(ID3D12Device* device, IDXGIAdapter1* adapter, const std::wstring& path) :
+    m_device(device),
+    m_path(path),
+    m_header(MakeHeader(adapter))
+{
+    // Pipeline libraries need ID3D12Device1, older runtimes only get the deduplication.
+    if (SUCCEEDED(device->QueryInterface(IID_PPV_ARGS(&m_device1))) && !m_path.empty())
+    {
+        Load();
+    }
+}
+
+void PipelineStateCache::RegisterRootSignature(ID3D12RootSignature* rootSignature, const void* serialized, size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rootSignatureHashes[rootSignature] = Fnv1a64(serialized, size);
+}
+
+ID3D12PipelineState* PipelineStateCache::GetGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+    return GetPipelineState(desc,
+        [&desc](ID3D12PipelineLibrary* library, LPCWSTR name, ComPtr<ID3D12PipelineState>& pipelineState)
+        {
+            return library->LoadGraphicsPipeline(name, &desc, IID_PPV_ARGS(&pipelineState));
+        },
+        [this, &desc](ComPtr<ID3D12PipelineState>& pipelineState)
+        {
+            ThrowIfFailed(m_device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState)));
+        });
+}
+
+ID3D12PipelineState* PipelineStateCache::GetComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc)
+{
+    return GetPipelineState(desc,
+        [&desc](ID3D12PipelineLibrary* library, LPCWSTR name, ComPtr<ID3D12PipelineState>& pipelineState)
+        {
+            return library->LoadComputePipeline(name, &desc, IID_PPV_ARGS(&pipelineState));
+        },
+        [this, &desc](ComPtr<ID3D12PipelineState>& pipelineState)
+        {
+            ThrowIfFailed(m_device->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pipelineState)));
+        });
+}
+
+template<typename Desc, typename LoadFunction, typename CreateFunction>
+ID3D12PipelineState* PipelineStateCache::GetPipelineState(const Desc& desc, LoadFunction load, CreateFunction create)
+{
+    uint64_t hash;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        hash = Hash(desc);
+        auto it = m_pipelineStates.find(hash);
+        if (it != m_pipelineStates.end())
+        {
+            m_duplicateCount++;
+            return it->second.Get();
+        }
+    }
+
+    // Compiles outside the lock so that threads build different pipelines
+    // at the same time. The library synchronizes its accesses.
+    std::wstring name = PipelineName(hash);
+    ComPtr<ID3D12PipelineState> pipelineState;
+    bool loaded = false;
+    bool stored = false;
+    if (m_library)
+    {
+        // E_INVALIDARG if the pipeline is missing or its description changed.
+        HRESULT hr = load(m_library.Get(), name.c_str(), pipelineState);
+        if (hr != E_INVALIDARG)
+        {
+            ThrowIfFailed(hr);
+            loaded = true;
+        }
+    }
+    if (!loaded)
+    {
+        create(pipelineState);
+        stored = m_library && SUCCEEDED(m_library->StorePipeline(name.c_str(), pipelineState.Get()));
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto inserted = m_pipelineStates.emplace(hash, pipelineState);
+    if (!inserted.second)
+    {
+        // Another thread built it meanwhile.
+        m_duplicateCount++;
+        return inserted.first->second.Get();
+    }
+    (loaded ? m_loadedCount : m_compiledCount)++;
+    m_libraryChanged = m_libraryChanged || stored;
+    return pipelineState.Get();
+}
+
+uint64_t PipelineStateCache::Hash(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)const
+{
+    // Graphics and compute pipelines never share a hash.
+    Hasher hasher;
+    hasher.AddValue(0u);
+    hasher.AddValue(RootSignatureHash(desc.pRootSignature));
+    AddShader(hasher, desc.VS);
+    AddShader(hasher, desc.PS);
+    AddShader(hasher, desc.DS);
+    AddShader(hasher, desc.HS);
+    AddShader(hasher, desc.GS);
+
+    hasher.AddValue(desc.StreamOutput.NumEntries);
+    for (UINT i = 0; i < desc.StreamOutput.NumEntries; i++)
+    {
+        const D3D12_SO_DECLARATION_ENTRY& entry = desc.StreamOutput.pSODeclaration[i];
+        hasher.AddValue(entry.Stream);
+        hasher.AddString(entry.SemanticName);
+        hasher.AddValue(entry.SemanticIndex);
+        hasher.AddValue(entry.StartComponent);
+        hasher.AddValue(entry.ComponentCount);
+        hasher.AddValue(entry.OutputSlot);
+    }
+    hasher.AddValue(desc.StreamOutput.NumStrides);
+    hasher.Add(desc.StreamOutput.pBufferStrides, desc.StreamOutput.NumStrides * sizeof(UINT));
+    hasher.AddValue(desc.StreamOutput.RasterizedStream);
+
+    AddBlendState(hasher, desc.BlendState);
+    hasher.AddValue(desc.SampleMask);
+    // Only 4 byte fields, the rasterizer description has no padding.
+    hasher.AddValue(desc.RasterizerState);
+    AddDepthStencilState(hasher, desc.DepthStencilState);
+
+    hasher.AddValue(desc.InputLayout.NumElements);
+    for (UINT i = 0; i < desc.InputLayout.NumElements; i++)
+    {
+        const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+        hasher.AddString(element.SemanticName);
+        hasher.AddValue(element.SemanticIndex);
+        hasher.AddValue(element.Format);
+        hasher.AddValue(element.InputSlot);
+        hasher.AddValue(element.AlignedByteOffset);
+        hasher.AddValue(element.InputSlotClass);
+        hasher.AddValue(element.InstanceDataStepRate);
+    }
+
+    hasher.AddValue(desc.IBStripCutValue);
+    hasher.AddValue(desc.PrimitiveTopologyType);
+    hasher.AddValue(desc.NumRenderTargets);
+    hasher.Add(desc.RTVFormats, desc.NumRenderTargets * sizeof(DXGI_FORMAT));
+    hasher.AddValue(desc.DSVFormat);
+    hasher.AddValue(desc.SampleDesc);
+    hasher.AddValue(desc.NodeMask);
+    hasher.AddValue(desc.Flags);
+    return hasher.Value();
+}
+
+uint64_t PipelineStateCache::Hash(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc)const
+{
+    Hasher hasher;
+    hasher.AddValue(1u);
+    hasher.AddValue(RootSignatureHash(desc.pRootSignature));
+    AddShader(hasher, desc.CS);
+    hasher.AddValue(desc.NodeMask);
+    hasher.AddValue(desc.Flags);
+    return hasher.Value();
+}
+
+uint64_t PipelineStateCache::RootSignatureHash(ID3D12RootSignature* rootSignature)const
+{
+    auto it = m_rootSignatureHashes.find(rootSignature);
+    assert(it != m_rootSignatureHashes.end() && "Root signature not registered");
+    return it != m_rootSignatureHashes.end() ? it->second : 0;
+}
+
+PipelineStateCache::FileHeader PipelineStateCache::MakeHeader(IDXGIAdapter1* adapter)const
+{
+    FileHeader header = {};
+    header.Magic = PipelineCacheMagic;
+    header.Version = PipelineCacheVersion;
+
+    DXGI_ADAPTER_DESC1 adapterDesc;
+    ThrowIfFailed(adapter->GetDesc1(&adapterDesc));
+    header.VendorId = adapterDesc.VendorId;
+    header.DeviceId = adapterDesc.DeviceId;
+    header.SubSysId = adapterDesc.SubSysId;
+    header.Revision = adapterDesc.Revision;
+
+    // The user mode driver version.
+    LARGE_INTEGER driverVersion = {};
+    if (SUCCEEDED(adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion)))
+    {
+        header.DriverVersion = (UINT64)driverVersion.QuadPart;
+    }
+    return header;
+}
+
+void PipelineStateCache::Load()
+{
+    std::ifstream file(m_path, std::ios::binary);
+    FileHeader header = {};
+    if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+        header.Magic == m_header.Magic && header.Version == m_header.Version &&
+        header.VendorId == m_header.VendorId && header.DeviceId == m_header.DeviceId &&
+        header.SubSysId == m_header.SubSysId && header.Revision == m_header.Revision &&
+        header.DriverVersion == m_header.DriverVersion)
+    {
+        m_libraryData.resize((size_t)header.LibrarySize);
+        if (!file.read(m_libraryData.data(), m_libraryData.size()))
+        {
+            m_libraryData.clear();
+        }
+    }
+
+    // The runtime checks the blob again, a stale or damaged one is replaced
+    // by an empty library.
+    HRESULT hr = E_FAIL;
+    if (!m_libraryData.empty())
+    {
+        hr = m_device1->CreatePipelineLibrary(m_libraryData.data(), m_libraryData.size(), IID_PPV_ARGS(&m_library));
+    }
+    if (FAILED(hr))
+    {
+        m_libraryData.clear();
+        m_library = nullptr;
+        if (FAILED(m_device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&m_library))))
+        {
+            // Some tools and drivers do not support pipeline libraries.
+            m_library = nullptr;
+        }
+    }
+}
+
+void PipelineStateCache::Save()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_library || !m_libraryChanged)
+    {
+        return;
+    }
+
+    std::vector<char> data(m_library->GetSerializedSize());
+    ThrowIfFailed(m_library->Serialize(data.data(), data.size()));
+
+    FileHeader header = m_header;
+    header.LibrarySize = data.size();
+    std::ofstream file(m_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(data.data(), data.size());
+    if (file)
+    {
+        m_libraryChanged = false;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+#include "stdafx.h"
+#include "D3DAppUtil.h"
+#include <mutex>
+
+// Creates the pipeline state objects from a hash of their whole description:
+// shader bytecode, root signature, states and formats. Identical descriptions
+// share one object whatever name the caller gives them.
+//
+// The compiled pipelines are stored in an ID3D12PipelineLibrary saved to
+// disk, the next launches load them instead of compiling. The file records
+// the adapter and driver it was made with and is ignored after a change.
+// Without ID3D12Device1 the cache only removes the duplicates.
+class PipelineStateCache
+{
+public:
+    // An empty path disables the file.
+    PipelineStateCache(ID3D12Device* device, IDXGIAdapter1* adapter, const std::wstring& path);
+    PipelineStateCache(const PipelineStateCache& rhs) = delete;
+    PipelineStateCache& operator=(const PipelineStateCache& rhs) = delete;
+
+    // Root signatures are hashed through their serialized form, they have to
+    // be registered before a pipeline using them is requested.
+    void RegisterRootSignature(ID3D12RootSignature* rootSignature, const void* serialized, size_t size);
+
+    // Can be called from several threads. The cache keeps the objects alive.
+    ID3D12PipelineState* GetGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+    ID3D12PipelineState* GetComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc);
+
+    // Writes the library if pipelines were added since it was loaded.
+    void Save();
+
+    // Requests served from memory, from the library and by compiling.
+    UINT DuplicateCount()const { return m_duplicateCount; }
+    UINT LoadedCount()const { return m_loadedCount; }
+    UINT CompiledCount()const { return m_compiledCount; }
+
+private:
+    struct FileHeader
+    {
+        UINT32 Magic;
+        UINT32 Version;
+        UINT32 VendorId;
+        UINT32 DeviceId;
+        UINT32 SubSysId;
+        UINT32 Revision;
+        UINT64 DriverVersion;
+        UINT64 LibrarySize;
+    };
+
+    FileHeader MakeHeader(IDXGIAdapter1* adapter)const;
+    // Called with m_mutex locked.
+    uint64_t Hash(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)const;
+    uint64_t Hash(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc)const;
+    void Load();
+    uint64_t RootSignatureHash(ID3D12RootSignature* rootSignature)const;
+    // Looks the pipeline up in the library, compiles and stores it if missing.
+    template<typename Desc, typename LoadFunction, typename CreateFunction>
+    ID3D12PipelineState* GetPipelineState(const Desc& desc, LoadFunction load, CreateFunction create);
+
+    ComPtr<ID3D12Device> m_device;
+    ComPtr<ID3D12Device1> m_device1;
+    std::wstring m_path;
+    FileHeader m_header;
+
+    std::mutex m_mutex;
+    std::unordered_map<ID3D12RootSignature*, uint64_t> m_rootSignatureHashes;
+    std::unordered_map<uint64_t, ComPtr<ID3D12PipelineState>> m_pipelineStates;
+
+    ComPtr<ID3D12PipelineLibrary> m_library;
+    // The library reads the pipelines from this memory, it lives as long as the library.
+    std::vector<char> m_libraryData;
+    bool m_libraryChanged = false;
+
+    UINT m_duplicateCount = 0;
+    UINT m_loadedCount = 0;
+    UINT m_compiledCount = 0;
+};
\ No newline at end of file
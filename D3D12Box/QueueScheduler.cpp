@@ -0,0 +1,112 @@
+#include "QueueScheduler.h"
+#include <cassert>
+
+QueueId QueueScheduler::AddQueue(IScheduledQueue* queue)
+{
+    m_queues.push_back(queue);
+    for (auto& waitedValues : m_waitedValues)
+    {
+        waitedValues.push_back(0);
+    }
+    m_waitedValues.push_back(std::vector<uint64_t>(m_queues.size(), 0));
+    return (QueueId)(m_queues.size() - 1);
+}
+
+QueueTicket QueueScheduler::Submit(QueueId queue, const std::function<void()>& execute,
+    std::initializer_list<QueueTicket> dependencies)
+{
+    assert(queue < m_queues.size());
+    IScheduledQueue* target = m_queues[queue];
+
+    for (const QueueTicket& dependency : dependencies)
+    {
+        assert(dependency.Queue < m_queues.size());
+        // Work on the same queue runs in submission order.
+        if (dependency.Queue == queue)
+        {
+            continue;
+        }
+
+        uint64_t& waitedValue = m_waitedValues[queue][dependency.Queue];
+        if (dependency.Value <= waitedValue)
+        {
+            continue;
+        }
+
+        ITimelineFence* fence = m_queues[dependency.Queue]->Fence();
+        // Already done, the queue would not wait anyway.
+        if (!fence->IsComplete(dependency.Value))
+        {
+            target->WaitOn(fence, dependency.Value);
+            m_waitCount++;
+        }
+        waitedValue = dependency.Value;
+    }
+
+    execute();
+
+    QueueTicket ticket;
+    ticket.Queue = queue;
+    ticket.Value = target->Signal();
+    return ticket;
+}
+
+SimulatedQueue::SimulatedQueue() :
+    m_thread(&SimulatedQueue::ThreadMain, this)
+{
+}
+
+SimulatedQueue::~SimulatedQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+void SimulatedQueue::WaitOn(ITimelineFence* fence, uint64_t value)
+{
+    Enqueue([fence, value]() { fence->Wait(value, FenceWaitPolicy::Block); });
+}
+
+uint64_t SimulatedQueue::Signal()
+{
+    uint64_t value = ++m_lastSignaledValue;
+    Enqueue([this, value]() { m_fence.Signal(value); });
+    return value;
+}
+
+void SimulatedQueue::Execute(std::function<void()> work)
+{
+    Enqueue(std::move(work));
+}
+
+void SimulatedQueue::Enqueue(std::function<void()> operation)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_operations.push_back(std::move(operation));
+    }
+    m_condition.notify_one();
+}
+
+void SimulatedQueue::ThreadMain()
+{
+    for (;;)
+    {
+        std::function<void()> operation;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_quit || !m_operations.empty(); });
+            if (m_operations.empty())
+            {
+                return;
+            }
+            operation = std::move(m_operations.front());
+            m_operations.pop_front();
+        }
+        operation();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+#include "TimelineFence.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef uint32_t QueueId;
+
+// Names a submission: it is complete once the fence of Queue reaches Value.
+struct QueueTicket
+{
+    QueueId Queue = 0;
+    uint64_t Value = 0;
+};
+
+// A hardware queue as seen by the scheduler. Every operation is queued in
+// order and runs on the queue timeline, none of them blocks the caller.
+class IScheduledQueue
+{
+public:
+    virtual ~IScheduledQueue() = default;
+
+    // Fence signaled by this queue only.
+    virtual ITimelineFence* Fence() = 0;
+
+    // The work queued after this waits until fence reaches value.
+    virtual void WaitOn(ITimelineFence* fence, uint64_t value) = 0;
+
+    // Signals the next value of Fence once the work queued before is done.
+    virtual uint64_t Signal() = 0;
+};
+
+// Submits work to several queues and turns the dependencies between them into
+// fence signal/wait pairs. A submission can only depend on tickets returned by
+// earlier submissions, whose signal is already queued, so the waits can never
+// form a cycle. Waits a queue already did, or that the queue order implies, are
+// not repeated.
+class QueueScheduler
+{
+public:
+    QueueId AddQueue(IScheduledQueue* queue);
+
+    // Queues the waits for the dependencies, calls execute to put the work on
+    // the queue, then signals. The returned ticket completes after the work.
+    QueueTicket Submit(QueueId queue, const std::function<void()>& execute,
+        std::initializer_list<QueueTicket> dependencies = {});
+
+    // Number of waits Submit actually queued, for validation.
+    uint64_t WaitCount()const { return m_waitCount; }
+
+    IScheduledQueue* Queue(QueueId queue)const { return m_queues[queue]; }
+
+private:
+    std::vector<IScheduledQueue*> m_queues;
+    // m_waitedValues[waiting queue][signaling queue], highest value waited for.
+    std::vector<std::vector<uint64_t>> m_waitedValues;
+    uint64_t m_waitCount = 0;
+};
+
+// Queue simulated by a CPU thread on a CpuTimelineFence, to run and validate
+// schedules without a device. Work runs as std::function on the queue thread.
+class SimulatedQueue : public IScheduledQueue
+{
+public:
+    SimulatedQueue();
+    SimulatedQueue(const SimulatedQueue& rhs) = delete;
+    SimulatedQueue& operator=(const SimulatedQueue& rhs) = delete;
+    // Runs the queued operations to completion.
+    ~SimulatedQueue();
+
+    virtual ITimelineFence* Fence()override { return &m_fence; }
+    virtual void WaitOn(ITimelineFence* fence, uint64_t value)override;
+    virtual uint64_t Signal()override;
+
+    // Queues work, the std::function counterpart of ExecuteCommandLists.
+    void Execute(std::function<void()> work);
+
+private:
+    void Enqueue(std::function<void()> operation);
+    void ThreadMain();
+
+    CpuTimelineFence m_fence;
+    uint64_t m_lastSignaledValue = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_operations;
+    bool m_quit = false;
+    std::thread m_thread;
+};
\ No newline at end of file
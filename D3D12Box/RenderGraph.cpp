@@ -0,0 +1,448 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <queue>
+
+namespace
+{
+    const ResourceAccess WriteAccess = ResourceAccess::RenderTarget | ResourceAccess::DepthWrite |
+        ResourceAccess::UnorderedAccess | ResourceAccess::CopyDest;
+    const ResourceAccess RenderTargetAccess = ResourceAccess::RenderTarget | ResourceAccess::DepthWrite |
+        ResourceAccess::DepthRead;
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+RenderGraphResource RenderGraph::CreateTexture(const std::string& name, const TransientTextureDesc& desc)
+{
+    ResourceNode node;
+    node.Name = name;
+    node.Desc = desc;
+    m_resources.push_back(node);
+    return (RenderGraphResource)m_resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::ImportResource(const std::string& name, ResourceAccess initialAccess, ResourceAccess finalAccess)
+{
+    ResourceNode node;
+    node.Name = name;
+    node.Imported = true;
+    node.InitialAccess = initialAccess;
+    node.FinalAccess = finalAccess;
+    m_resources.push_back(node);
+    return (RenderGraphResource)m_resources.size() - 1;
+}
+
+RenderGraphPass RenderGraph::AddPass(const std::string& name)
+{
+    PassNode node;
+    node.Name = name;
+    m_passes.push_back(node);
+    return (RenderGraphPass)m_passes.size() - 1;
+}
+
+void RenderGraph::Read(RenderGraphPass pass, RenderGraphResource resource, ResourceAccess access)
+{
+    assert(!HasAccess(access, WriteAccess) && "Write access declared as a read");
+    AddUse(pass, resource, access, UseType::Read);
+}
+
+void RenderGraph::Write(RenderGraphPass pass, RenderGraphResource resource, ResourceAccess access)
+{
+    AddUse(pass, resource, access, UseType::Write);
+}
+
+void RenderGraph::Overwrite(RenderGraphPass pass, RenderGraphResource resource, ResourceAccess access)
+{
+    AddUse(pass, resource, access, UseType::Overwrite);
+}
+
+void RenderGraph::SetSideEffects(RenderGraphPass pass)
+{
+    m_passes[pass].SideEffects = true;
+}
+
+void RenderGraph::AddUse(RenderGraphPass pass, RenderGraphResource resource, ResourceAccess access, UseType type)
+{
+    assert(pass < m_passes.size() && resource < m_resources.size());
+    ResourceUse use;
+    use.Resource = resource;
+    use.Access = access;
+    use.Type = type;
+    m_passes[pass].Uses.push_back(use);
+}
+
+void RenderGraph::Compile(const MemoryRequirementsFunction& memoryRequirements)
+{
+    uint32_t passCount = PassCount();
+    uint32_t resourceCount = ResourceCount();
+    m_dataDependencies.assign(passCount, std::vector<RenderGraphPass>());
+    m_orderDependencies.assign(passCount, std::vector<RenderGraphPass>());
+
+    // Walk the passes in declaration order, every access depends on the last
+    // writer of the resource and every write comes after the previous readers.
+    m_lastWriters.assign(resourceCount, RenderGraphInvalidIndex);
+    std::vector<std::vector<RenderGraphPass>> readers(resourceCount);
+    for (RenderGraphPass pass = 0; pass < passCount; pass++)
+    {
+        for (const ResourceUse& use : m_passes[pass].Uses)
+        {
+            RenderGraphPass lastWriter = m_lastWriters[use.Resource];
+            if (lastWriter == RenderGraphInvalidIndex || lastWriter == pass)
+            {
+                continue;
+            }
+            if (use.Type == UseType::Overwrite)
+            {
+                m_orderDependencies[pass].push_back(lastWriter);
+            }
+            else
+            {
+                m_dataDependencies[pass].push_back(lastWriter);
+            }
+        }
+        for (const ResourceUse& use : m_passes[pass].Uses)
+        {
+            if (use.Type == UseType::Read)
+            {
+                readers[use.Resource].push_back(pass);
+                continue;
+            }
+            for (RenderGraphPass reader : readers[use.Resource])
+            {
+                if (reader != pass)
+                {
+                    m_orderDependencies[pass].push_back(reader);
+                }
+            }
+            readers[use.Resource].clear();
+            m_lastWriters[use.Resource] = pass;
+        }
+    }
+
+    CullPasses();
+    OrderPasses();
+    AllocateTransients(memoryRequirements);
+    PlaceBarriers();
+}
+
+void RenderGraph::CullPasses()
+{
+    // The passes with side effects and the last writers of the imported
+    // resources are kept, then everything they read from.
+    m_passCulled.assign(PassCount(), true);
+    std::vector<RenderGraphPass> stack;
+    for (RenderGraphPass pass = 0; pass < PassCount(); pass++)
+    {
+        if (m_passes[pass].SideEffects)
+        {
+            stack.push_back(pass);
+        }
+    }
+    for (RenderGraphResource resource = 0; resource < ResourceCount(); resource++)
+    {
+        if (m_resources[resource].Imported && m_lastWriters[resource] != RenderGraphInvalidIndex)
+        {
+            stack.push_back(m_lastWriters[resource]);
+        }
+    }
+
+    while (!stack.empty())
+    {
+        RenderGraphPass pass = stack.back();
+        stack.pop_back();
+        if (!m_passCulled[pass])
+        {
+            continue;
+        }
+        m_passCulled[pass] = false;
+        for (RenderGraphPass producer : m_dataDependencies[pass])
+        {
+            stack.push_back(producer);
+        }
+    }
+}
+
+void RenderGraph::OrderPasses()
+{
+    // Topological sort of the kept passes, the ready pass declared first goes first.
+    uint32_t passCount = PassCount();
+    std::vector<uint32_t> pendingDependencies(passCount, 0);
+    std::vector<std::vector<RenderGraphPass>> dependents(passCount);
+    for (RenderGraphPass pass = 0; pass < passCount; pass++)
+    {
+        if (m_passCulled[pass])
+        {
+            continue;
+        }
+        for (const auto* dependencies : { &m_dataDependencies[pass], &m_orderDependencies[pass] })
+        {
+            for (RenderGraphPass dependency : *dependencies)
+            {
+                if (!m_passCulled[dependency])
+                {
+                    dependents[dependency].push_back(pass);
+                    pendingDependencies[pass]++;
+                }
+            }
+        }
+    }
+
+    std::priority_queue<RenderGraphPass, std::vector<RenderGraphPass>, std::greater<RenderGraphPass>> ready;
+    for (RenderGraphPass pass = 0; pass < passCount; pass++)
+    {
+        if (!m_passCulled[pass] && pendingDependencies[pass] == 0)
+        {
+            ready.push(pass);
+        }
+    }
+
+    m_executionOrder.clear();
+    while (!ready.empty())
+    {
+        CompiledPass compiled;
+        compiled.Pass = ready.top();
+        ready.pop();
+        for (RenderGraphPass dependent : dependents[compiled.Pass])
+        {
+            if (--pendingDependencies[dependent] == 0)
+            {
+                ready.push(dependent);
+            }
+        }
+        m_executionOrder.push_back(compiled);
+    }
+}
+
+void RenderGraph::AllocateTransients(const MemoryRequirementsFunction& memoryRequirements)
+{
+    m_allocations.assign(ResourceCount(), TransientAllocation());
+    m_combinedAccess.assign(ResourceCount(), ResourceAccess::None);
+    for (uint32_t position = 0; position < (uint32_t)m_executionOrder.size(); position++)
+    {
+        for (const ResourceUse& use : m_passes[m_executionOrder[position].Pass].Uses)
+        {
+            TransientAllocation& allocation = m_allocations[use.Resource];
+            if (allocation.FirstUse == RenderGraphInvalidIndex)
+            {
+                allocation.FirstUse = position;
+                assert((m_resources[use.Resource].Imported || use.Type == UseType::Overwrite) &&
+                    "The first use of a transient texture has to overwrite it");
+            }
+            allocation.LastUse = position;
+            m_combinedAccess[use.Resource] = m_combinedAccess[use.Resource] | use.Access;
+        }
+    }
+
+    // Largest textures first, each one goes at the lowest offset that does
+    // not overlap a texture alive at the same time in the same heap.
+    std::vector<RenderGraphResource> textures;
+    std::vector<uint64_t> alignments(ResourceCount(), 1);
+    for (RenderGraphResource resource = 0; resource < ResourceCount(); resource++)
+    {
+        TransientAllocation& allocation = m_allocations[resource];
+        if (m_resources[resource].Imported || allocation.FirstUse == RenderGraphInvalidIndex)
+        {
+            continue;
+        }
+        MemoryRequirements requirements = memoryRequirements(m_resources[resource].Desc, m_combinedAccess[resource]);
+        allocation.Size = requirements.Size;
+        alignments[resource] = (std::max)(requirements.Alignment, (uint64_t)1);
+        allocation.HeapType = HasAccess(m_combinedAccess[resource], RenderTargetAccess) ?
+            TransientHeapType::RenderTargetTexture : TransientHeapType::Texture;
+        textures.push_back(resource);
+    }
+    std::stable_sort(textures.begin(), textures.end(), [this](RenderGraphResource a, RenderGraphResource b)
+    {
+        return m_allocations[a].Size > m_allocations[b].Size;
+    });
+
+    for (uint64_t& heapSize : m_heapSizes)
+    {
+        heapSize = 0;
+    }
+    std::vector<RenderGraphResource> placed;
+    for (RenderGraphResource resource : textures)
+    {
+        TransientAllocation& allocation = m_allocations[resource];
+        uint64_t alignment = alignments[resource];
+
+        std::vector<const TransientAllocation*> live;
+        for (RenderGraphResource other : placed)
+        {
+            const TransientAllocation& otherAllocation = m_allocations[other];
+            if (otherAllocation.HeapType == allocation.HeapType &&
+                otherAllocation.FirstUse <= allocation.LastUse && allocation.FirstUse <= otherAllocation.LastUse)
+            {
+                live.push_back(&otherAllocation);
+            }
+        }
+        std::sort(live.begin(), live.end(), [](const TransientAllocation* a, const TransientAllocation* b)
+        {
+            return a->Offset < b->Offset;
+        });
+
+        uint64_t offset = 0;
+        for (const TransientAllocation* other : live)
+        {
+            if (offset + allocation.Size <= other->Offset)
+            {
+                break;
+            }
+            offset = (std::max)(offset, AlignUp(other->Offset + other->Size, alignment));
+        }
+        allocation.Offset = offset;
+        uint64_t& heapSize = m_heapSizes[(uint32_t)allocation.HeapType];
+        heapSize = (std::max)(heapSize, offset + allocation.Size);
+        placed.push_back(resource);
+    }
+}
+
+void RenderGraph::PlaceBarriers()
+{
+    // Imported resources start in their initial access, transient ones in
+    // the access they had at the end of the previous frame.
+    std::vector<ResourceAccess> states(ResourceCount());
+    for (ResourceNode& node : m_resources)
+    {
+        if (!node.Imported)
+        {
+            node.InitialAccess = ResourceAccess::None;
+        }
+    }
+    // Position of the previous use, -1 for the start of the frame.
+    std::vector<int32_t> previousUses(ResourceCount(), -1);
+    for (RenderGraphResource resource = 0; resource < ResourceCount(); resource++)
+    {
+        states[resource] = m_resources[resource].InitialAccess;
+    }
+    for (uint32_t position = 0; position < (uint32_t)m_executionOrder.size(); position++)
+    {
+        for (const ResourceUse& use : m_passes[m_executionOrder[position].Pass].Uses)
+        {
+            ResourceNode& node = m_resources[use.Resource];
+            if (!node.Imported && m_allocations[use.Resource].LastUse == position)
+            {
+                node.InitialAccess = node.InitialAccess | use.Access;
+                states[use.Resource] = node.InitialAccess;
+            }
+        }
+    }
+
+    // Adds a transition needed before position, the end of the execution
+    // order standing for the final barriers.
+    auto addTransition = [this, &previousUses](uint32_t position,
+        RenderGraphResource resource, ResourceAccess before, ResourceAccess after)
+    {
+        RenderGraphBarrier barrier;
+        barrier.Resource = resource;
+        barrier.Before = before;
+        barrier.After = after;
+        std::vector<RenderGraphBarrier>& barriers = (position < m_executionOrder.size()) ?
+            m_executionOrder[position].Barriers : m_finalBarriers;
+
+        // Split the transition when passes run between the two uses, the GPU
+        // can finish it in the background.
+        uint32_t beginPosition = (uint32_t)(previousUses[resource] + 1);
+        if (beginPosition == position)
+        {
+            barriers.push_back(barrier);
+            return;
+        }
+        barrier.Split = BarrierSplit::Begin;
+        m_executionOrder[beginPosition].Barriers.push_back(barrier);
+        barrier.Split = BarrierSplit::End;
+        barriers.push_back(barrier);
+    };
+
+    for (uint32_t position = 0; position < (uint32_t)m_executionOrder.size(); position++)
+    {
+        CompiledPass& compiled = m_executionOrder[position];
+
+        // Accesses of the pass combined per resource.
+        std::vector<std::pair<RenderGraphResource, ResourceAccess>> accesses;
+        for (const ResourceUse& use : m_passes[compiled.Pass].Uses)
+        {
+            auto it = std::find_if(accesses.begin(), accesses.end(),
+                [&use](const std::pair<RenderGraphResource, ResourceAccess>& access) { return access.first == use.Resource; });
+            if (it == accesses.end())
+            {
+                accesses.push_back(std::make_pair(use.Resource, use.Access));
+            }
+            else
+            {
+                it->second = it->second | use.Access;
+            }
+        }
+
+        for (const auto& access : accesses)
+        {
+            RenderGraphResource resource = access.first;
+            ResourceAccess& state = states[resource];
+            const TransientAllocation& allocation = m_allocations[resource];
+
+            if (!m_resources[resource].Imported && allocation.FirstUse == position)
+            {
+                // The texture takes over the memory of the last texture placed
+                // there that is done before it.
+                RenderGraphBarrier aliasing;
+                aliasing.Type = RenderGraphBarrierType::Aliasing;
+                aliasing.Resource = resource;
+                uint32_t aliasedLastUse = 0;
+                for (RenderGraphResource other = 0; other < ResourceCount(); other++)
+                {
+                    const TransientAllocation& otherAllocation = m_allocations[other];
+                    if (m_resources[other].Imported || otherAllocation.FirstUse == RenderGraphInvalidIndex ||
+                        otherAllocation.HeapType != allocation.HeapType || otherAllocation.LastUse >= position ||
+                        otherAllocation.Offset >= allocation.Offset + allocation.Size ||
+                        allocation.Offset >= otherAllocation.Offset + otherAllocation.Size)
+                    {
+                        continue;
+                    }
+                    if (aliasing.AliasedResource == RenderGraphInvalidIndex || otherAllocation.LastUse >= aliasedLastUse)
+                    {
+                        aliasing.AliasedResource = other;
+                        aliasedLastUse = otherAllocation.LastUse;
+                    }
+                }
+                compiled.Barriers.push_back(aliasing);
+
+                if (state != access.second)
+                {
+                    RenderGraphBarrier transition;
+                    transition.Resource = resource;
+                    transition.Before = state;
+                    transition.After = access.second;
+                    compiled.Barriers.push_back(transition);
+                }
+            }
+            else if (state != access.second)
+            {
+                addTransition(position, resource, state, access.second);
+            }
+            else if (HasAccess(state, ResourceAccess::UnorderedAccess) && previousUses[resource] >= 0)
+            {
+                RenderGraphBarrier uav;
+                uav.Type = RenderGraphBarrierType::Uav;
+                uav.Resource = resource;
+                compiled.Barriers.push_back(uav);
+            }
+            state = access.second;
+            previousUses[resource] = (int32_t)position;
+        }
+    }
+
+    m_finalBarriers.clear();
+    for (RenderGraphResource resource = 0; resource < ResourceCount(); resource++)
+    {
+        const ResourceNode& node = m_resources[resource];
+        if (node.Imported && states[resource] != node.FinalAccess)
+        {
+            addTransition((uint32_t)m_executionOrder.size(), resource, states[resource], node.FinalAccess);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,213 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// How a pass uses a resource. Read accesses can be combined in one pass.
+enum class ResourceAccess : uint32_t
+{
+    // Imported resources only: the resource is in the common state.
+    None = 0,
+    RenderTarget = 1 << 0,
+    DepthWrite = 1 << 1,
+    DepthRead = 1 << 2,
+    ShaderRead = 1 << 3,
+    UnorderedAccess = 1 << 4,
+    CopySource = 1 << 5,
+    CopyDest = 1 << 6,
+    IndirectArgument = 1 << 7,
+    Present = 1 << 8
+};
+
+inline ResourceAccess operator|(ResourceAccess a, ResourceAccess b)
+{
+    return (ResourceAccess)((uint32_t)a | (uint32_t)b);
+}
+
+inline bool HasAccess(ResourceAccess access, ResourceAccess flags)
+{
+    return ((uint32_t)access & (uint32_t)flags) != 0;
+}
+
+typedef uint32_t RenderGraphResource;
+typedef uint32_t RenderGraphPass;
+const uint32_t RenderGraphInvalidIndex = UINT32_MAX;
+
+// Texture created by the graph, it lives only during the frame and shares
+// memory with the transient textures whose lifetime does not overlap.
+struct TransientTextureDesc
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    // DXGI_FORMAT for the D3D12 executor.
+    uint32_t Format = 0;
+};
+
+struct MemoryRequirements
+{
+    uint64_t Size = 0;
+    uint64_t Alignment = 1;
+};
+
+// Textures that can be render or depth targets and the others are placed in
+// different heaps, as older hardware cannot mix them.
+enum class TransientHeapType : uint32_t
+{
+    Texture,
+    RenderTargetTexture,
+    Count
+};
+
+enum class RenderGraphBarrierType
+{
+    Transition,
+    // Memory of the transient resource was used by another one before.
+    Aliasing,
+    // Orders two passes writing the same unordered access resource.
+    Uav
+};
+
+enum class BarrierSplit
+{
+    None,
+    // The transition starts after the previous use of the resource...
+    Begin,
+    // ...and has to be finished before the next one.
+    End
+};
+
+struct RenderGraphBarrier
+{
+    RenderGraphBarrierType Type = RenderGraphBarrierType::Transition;
+    RenderGraphResource Resource = RenderGraphInvalidIndex;
+    ResourceAccess Before = ResourceAccess::None;
+    ResourceAccess After = ResourceAccess::None;
+    BarrierSplit Split = BarrierSplit::None;
+    // Aliasing: last resource using the memory, RenderGraphInvalidIndex if unknown.
+    RenderGraphResource AliasedResource = RenderGraphInvalidIndex;
+};
+
+struct CompiledPass
+{
+    RenderGraphPass Pass = RenderGraphInvalidIndex;
+    // Issued before the pass runs.
+    std::vector<RenderGraphBarrier> Barriers;
+};
+
+struct TransientAllocation
+{
+    TransientHeapType HeapType = TransientHeapType::Texture;
+    uint64_t Offset = 0;
+    uint64_t Size = 0;
+    // Positions in the execution order of the first and last passes using the resource.
+    uint32_t FirstUse = RenderGraphInvalidIndex;
+    uint32_t LastUse = RenderGraphInvalidIndex;
+};
+
+// Describes a frame as passes declaring the resources they read and write.
+// Compile culls the passes whose results nobody uses, orders the others,
+// places the barriers between them and assigns the transient textures to
+// heap offsets so that textures used at different times share memory.
+// The compiler knows nothing of the API, the D3D12RenderGraph executes it.
+//
+// Dependencies follow the declaration order: a pass reads what the passes
+// declared before it wrote.
+class RenderGraph
+{
+public:
+    typedef std::function<MemoryRequirements(const TransientTextureDesc& desc, ResourceAccess usage)> MemoryRequirementsFunction;
+
+    RenderGraphResource CreateTexture(const std::string& name, const TransientTextureDesc& desc);
+
+    // Resource owned by the application. It is in initialAccess when the
+    // frame starts and is left in finalAccess. Its writes are never culled.
+    RenderGraphResource ImportResource(const std::string& name, ResourceAccess initialAccess, ResourceAccess finalAccess);
+
+    RenderGraphPass AddPass(const std::string& name);
+
+    void Read(RenderGraphPass pass, RenderGraphResource resource, ResourceAccess access);
+    // Modifies the content written by the previous passes.
+    void Write(RenderGraphPass pass, RenderGraphResource resource, ResourceAccess access);
+    // Replaces the whole content, the previous writes are not needed by this
+    // pass. The first use of a transient texture has to be an overwrite.
+    void Overwrite(RenderGraphPass pass, RenderGraphResource resource, ResourceAccess access);
+
+    // The pass does something outside the graph and is never culled.
+    void SetSideEffects(RenderGraphPass pass);
+
+    // Sizes of the transient textures are queried through memoryRequirements.
+    void Compile(const MemoryRequirementsFunction& memoryRequirements);
+
+    // Results of Compile.
+    const std::vector<CompiledPass>& ExecutionOrder()const { return m_executionOrder; }
+    // Leave the imported resources in their final access, issued after the last pass.
+    const std::vector<RenderGraphBarrier>& FinalBarriers()const { return m_finalBarriers; }
+    bool IsCulled(RenderGraphPass pass)const { return m_passCulled[pass]; }
+    uint64_t HeapSize(TransientHeapType type)const { return m_heapSizes[(uint32_t)type]; }
+    // FirstUse is RenderGraphInvalidIndex for the textures no pass uses.
+    const TransientAllocation& Allocation(RenderGraphResource resource)const { return m_allocations[resource]; }
+    // Every access of the resource during the frame.
+    ResourceAccess CombinedAccess(RenderGraphResource resource)const { return m_combinedAccess[resource]; }
+
+    uint32_t PassCount()const { return (uint32_t)m_passes.size(); }
+    uint32_t ResourceCount()const { return (uint32_t)m_resources.size(); }
+    const std::string& PassName(RenderGraphPass pass)const { return m_passes[pass].Name; }
+    const std::string& ResourceName(RenderGraphResource resource)const { return m_resources[resource].Name; }
+    bool IsImported(RenderGraphResource resource)const { return m_resources[resource].Imported; }
+    const TransientTextureDesc& TextureDesc(RenderGraphResource resource)const { return m_resources[resource].Desc; }
+    // Transient textures start the frame in the access they are left in, set by Compile.
+    ResourceAccess InitialAccess(RenderGraphResource resource)const { return m_resources[resource].InitialAccess; }
+
+private:
+    enum class UseType
+    {
+        Read,
+        Write,
+        Overwrite
+    };
+
+    struct ResourceUse
+    {
+        RenderGraphResource Resource;
+        ResourceAccess Access;
+        UseType Type;
+    };
+
+    struct ResourceNode
+    {
+        std::string Name;
+        bool Imported = false;
+        TransientTextureDesc Desc;
+        ResourceAccess InitialAccess = ResourceAccess::None;
+        ResourceAccess FinalAccess = ResourceAccess::None;
+    };
+
+    struct PassNode
+    {
+        std::string Name;
+        std::vector<ResourceUse> Uses;
+        bool SideEffects = false;
+    };
+
+    void AddUse(RenderGraphPass pass, RenderGraphResource resource, ResourceAccess access, UseType type);
+    void CullPasses();
+    void OrderPasses();
+    void AllocateTransients(const MemoryRequirementsFunction& memoryRequirements);
+    void PlaceBarriers();
+
+    std::vector<ResourceNode> m_resources;
+    std::vector<PassNode> m_passes;
+
+    // Built by Compile. Data dependencies keep the producers of a pass alive,
+    // ordering dependencies only keep writes after the earlier accesses.
+    std::vector<std::vector<RenderGraphPass>> m_dataDependencies;
+    std::vector<std::vector<RenderGraphPass>> m_orderDependencies;
+    std::vector<RenderGraphPass> m_lastWriters;
+    std::vector<bool> m_passCulled;
+    std::vector<CompiledPass> m_executionOrder;
+    std::vector<RenderGraphBarrier> m_finalBarriers;
+    std::vector<TransientAllocation> m_allocations;
+    std::vector<ResourceAccess> m_combinedAccess;
+    uint64_t m_heapSizes[(uint32_t)TransientHeapType::Count] = {};
+};
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include "stdafx.h"
 #include "D3DAppUtil.h"
+#include "DrawPacket.h"
 using namespace DirectX;
 
 // A lightweight structure that stores data needed to draw an object.
@@ -20,6 +21,17 @@ public:
 
     UINT ObjectConstantBufferIndex = -1;
     MeshGeometry*   Geo = nullptr;
+    // Key of the submesh in Geo->DrawArgs, looked up again when a streamed
+    // geometry replaces its placeholder.
+    StringId Submesh;
+
+    // Used to build the draw packet sort key.
+    RenderLayer Layer = RenderLayer::Opaque;
+    UINT PipelineStateIndex = 0;
+    UINT MeshId = 0;
+
+    // World space bounds used for culling, update them when World changes.
+    DirectX::BoundingBox Bounds;
 
     // Topology;
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -0,0 +1,182 @@
+#include "stdafx.h"
+#include "ResourceStateTracker.h"
+#include <cassert>
+
+void ResourceStateTracker::Register(ID3D12Resource* resource, D3D12_RESOURCE_STATES initialState, UINT subresourceCount)
+{
+    ResourceState state;
+    state.State = initialState;
+    state.SubresourceCount = subresourceCount;
+    state.Decays = resource->GetDesc().Dimension == D3D12_RESOURCE_DIMENSION_BUFFER;
+    m_states[resource] = state;
+}
+
+void ResourceStateTracker::Unregister(ID3D12Resource* resource)
+{
+    m_states.erase(resource);
+}
+
+void ResourceStateTracker::Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresource)
+{
+    ResourceState& current = Find(resource);
+    assert(!current.SplitPending && "Resource used during a split barrier");
+    current.UsedSinceExecute = true;
+
+    // Buffers in the common state are promoted by their first use, no barrier needed.
+    if (current.Decays && current.State == D3D12_RESOURCE_STATE_COMMON && current.SubresourceStates.empty())
+    {
+        current.State = state;
+        m_skippedTransitionCount++;
+        return;
+    }
+
+    if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+    {
+        if (current.SubresourceStates.empty())
+        {
+            if (current.State == state)
+            {
+                m_skippedTransitionCount++;
+                return;
+            }
+            AddTransition(resource, current.State, state, subresource);
+        }
+        else
+        {
+            // Only the subresources in another state need a barrier.
+            for (UINT i = 0; i < current.SubresourceCount; i++)
+            {
+                if (current.SubresourceStates[i] != state)
+                {
+                    AddTransition(resource, current.SubresourceStates[i], state, i);
+                }
+            }
+            current.SubresourceStates.clear();
+        }
+        current.State = state;
+        return;
+    }
+
+    assert(subresource < current.SubresourceCount);
+    if (current.SubresourceStates.empty())
+    {
+        if (current.State == state)
+        {
+            m_skippedTransitionCount++;
+            return;
+        }
+        current.SubresourceStates.assign(current.SubresourceCount, current.State);
+    }
+    if (current.SubresourceStates[subresource] == state)
+    {
+        m_skippedTransitionCount++;
+        return;
+    }
+    AddTransition(resource, current.SubresourceStates[subresource], state, subresource);
+    current.SubresourceStates[subresource] = state;
+    CollapseIfUniform(current);
+}
+
+void ResourceStateTracker::BeginTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
+{
+    ResourceState& current = Find(resource);
+    assert(!current.SplitPending && "Split barrier already open");
+    assert(current.SubresourceStates.empty() && "Split barriers cover whole resources");
+    current.UsedSinceExecute = true;
+    current.SplitPending = true;
+    current.SplitState = state;
+    current.SplitPromoted = current.Decays && current.State == D3D12_RESOURCE_STATE_COMMON;
+
+    if (current.SplitPromoted || current.State == state)
+    {
+        m_skippedTransitionCount++;
+        return;
+    }
+    AddTransition(resource, current.State, state, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+        D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY);
+}
+
+void ResourceStateTracker::EndTransition(ID3D12Resource* resource)
+{
+    ResourceState& current = Find(resource);
+    assert(current.SplitPending && "No split barrier to end");
+    current.SplitPending = false;
+
+    if (!current.SplitPromoted && current.State != current.SplitState)
+    {
+        AddTransition(resource, current.State, current.SplitState, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+            D3D12_RESOURCE_BARRIER_FLAG_END_ONLY);
+    }
+    current.State = current.SplitState;
+}
+
+void ResourceStateTracker::UavBarrier(ID3D12Resource* resource)
+{
+    m_pendingBarriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+}
+
+void ResourceStateTracker::AliasingBarrier(ID3D12Resource* before, ID3D12Resource* after)
+{
+    m_pendingBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(before, after));
+}
+
+void ResourceStateTracker::Flush(ID3D12GraphicsCommandList* cmdList)
+{
+    if (m_pendingBarriers.empty())
+    {
+        return;
+    }
+    cmdList->ResourceBarrier((UINT)m_pendingBarriers.size(), m_pendingBarriers.data());
+    m_issuedBarrierCount += m_pendingBarriers.size();
+    m_pendingBarriers.clear();
+}
+
+void ResourceStateTracker::OnCommandListsExecuted()
+{
+    assert(m_pendingBarriers.empty() && "Barriers left unflushed");
+    for (auto& entry : m_states)
+    {
+        ResourceState& state = entry.second;
+        assert(!state.SplitPending && "Split barrier left open");
+        if (state.Decays && state.UsedSinceExecute)
+        {
+            state.State = D3D12_RESOURCE_STATE_COMMON;
+            state.SubresourceStates.clear();
+        }
+        state.UsedSinceExecute = false;
+    }
+}
+
+D3D12_RESOURCE_STATES ResourceStateTracker::GetState(ID3D12Resource* resource, UINT subresource)const
+{
+    auto it = m_states.find(resource);
+    assert(it != m_states.end() && "Resource not registered");
+    const ResourceState& state = it->second;
+    return state.SubresourceStates.empty() ? state.State : state.SubresourceStates[subresource];
+}
+
+ResourceStateTracker::ResourceState& ResourceStateTracker::Find(ID3D12Resource* resource)
+{
+    auto it = m_states.find(resource);
+    assert(it != m_states.end() && "Resource not registered");
+    return it->second;
+}
+
+void ResourceStateTracker::AddTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after,
+    UINT subresource, D3D12_RESOURCE_BARRIER_FLAGS flags)
+{
+    m_pendingBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, before, after, subresource, flags));
+}
+
+void ResourceStateTracker::CollapseIfUniform(ResourceState& state)
+{
+    for (D3D12_RESOURCE_STATES subresourceState : state.SubresourceStates)
+    {
+        if (subresourceState != state.SubresourceStates[0])
+        {
+            return;
+        }
+    }
+    state.State = state.SubresourceStates[0];
+    state.SubresourceStates.clear();
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include "stdafx.h"
+#include "D3DAppUtil.h"
+
+// Keeps the current state of every registered resource, per subresource when
+// they differ, and turns state requests into transition barriers. Requests
+// are queued and issued by Flush with a single ResourceBarrier call, requests
+// for the state a resource is already in are dropped.
+//
+// The tracked state follows recording order, so the command lists have to be
+// executed in the order they are recorded, and all recording that changes
+// states happens on one thread. Command lists that only use resources in the
+// states set up before them (the draw chunks) do not need the tracker.
+class ResourceStateTracker
+{
+public:
+    // Buffers are recognized from the description: they are implicitly
+    // promoted from the common state and decay back to it.
+    void Register(ID3D12Resource* resource, D3D12_RESOURCE_STATES initialState, UINT subresourceCount = 1);
+    void Unregister(ID3D12Resource* resource);
+
+    // Queues the transitions needed for the resource to be in state.
+    void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state,
+        UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+
+    // Split barrier: the GPU may start the transition at BeginTransition and
+    // has to finish it at EndTransition. The resource cannot be used in between.
+    void BeginTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state);
+    void EndTransition(ID3D12Resource* resource);
+
+    void UavBarrier(ID3D12Resource* resource);
+
+    // after starts using memory shared with before, which may be null when
+    // any resource of the heap could have used it.
+    void AliasingBarrier(ID3D12Resource* before, ID3D12Resource* after);
+
+    // Issues the queued barriers on cmdList.
+    void Flush(ID3D12GraphicsCommandList* cmdList);
+
+    // Call once the command lists recorded so far are executed: the buffers
+    // they used are back to the common state when the GPU is done with them.
+    void OnCommandListsExecuted();
+
+    D3D12_RESOURCE_STATES GetState(ID3D12Resource* resource, UINT subresource = 0)const;
+
+    // Barriers issued and requests dropped because nothing had to change.
+    UINT64 IssuedBarrierCount()const { return m_issuedBarrierCount; }
+    UINT64 SkippedTransitionCount()const { return m_skippedTransitionCount; }
+
+private:
+    struct ResourceState
+    {
+        D3D12_RESOURCE_STATES State = D3D12_RESOURCE_STATE_COMMON;
+        // Empty while every subresource is in State.
+        std::vector<D3D12_RESOURCE_STATES> SubresourceStates;
+        UINT SubresourceCount = 1;
+        bool Decays = false;
+        bool UsedSinceExecute = false;
+        // Target of an open split barrier.
+        bool SplitPending = false;
+        D3D12_RESOURCE_STATES SplitState = D3D12_RESOURCE_STATE_COMMON;
+        bool SplitPromoted = false;
+    };
+
+    ResourceState& Find(ID3D12Resource* resource);
+    void AddTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after,
+        UINT subresource, D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE);
+    static void CollapseIfUniform(ResourceState& state);
+
+    std::unordered_map<ID3D12Resource*, ResourceState> m_states;
+    std::vector<D3D12_RESOURCE_BARRIER> m_pendingBarriers;
+    UINT64 m_issuedBarrierCount = 0;
+    UINT64 m_skippedTransitionCount = 0;
+};
\ No newline at end of file
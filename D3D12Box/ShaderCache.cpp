@@ -0,0 +1,364 @@
+#include "ShaderCache.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+namespace
+{
+    const uint32_t ArchiveMagic = 0x41434853; // "SHCA"
+    const uint32_t ArchiveVersion = 1;
+
+    struct ArchiveHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t EntryCount;
+        uint32_t DependencyCount;
+        uint64_t EntriesOffset;
+        uint64_t DependenciesOffset;
+        uint64_t StringsOffset;
+        uint64_t StringsSize;
+    };
+
+    struct ArchiveEntry
+    {
+        uint64_t Key;
+        uint64_t BytecodeOffset;
+        uint64_t BytecodeSize;
+        uint32_t FirstDependency;
+        uint32_t DependencyCount;
+    };
+
+    struct ArchiveDependency
+    {
+        uint64_t ContentHash;
+        uint32_t PathOffset;
+        uint32_t PathSize;
+    };
+
+    static_assert(sizeof(ArchiveHeader) == 48, "The archive layout has no padding");
+    static_assert(sizeof(ArchiveEntry) == 32, "The archive layout has no padding");
+    static_assert(sizeof(ArchiveDependency) == 16, "The archive layout has no padding");
+
+    bool InBounds(uint64_t offset, uint64_t size, uint64_t fileSize)
+    {
+        return offset <= fileSize && size <= fileSize - offset;
+    }
+
+    template<typename T>
+    void Append(std::vector<uint8_t>& buffer, const T& value)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+}
+
+bool DiskShaderFileSystem::ReadFile(const std::string& path, std::string& contents)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        return false;
+    }
+    contents.assign(reinterpret_cast<const char*>(file.Data()), file.Size());
+    return true;
+}
+
+ShaderCache::ShaderCache(IShaderCompiler* compiler, IShaderFileSystem* fileSystem, const std::string& archivePath) :
+    m_compiler(compiler),
+    m_fileSystem(fileSystem),
+    m_archivePath(archivePath),
+    m_compilerIdentifier(compiler->Identifier())
+{
+    if (!m_archivePath.empty())
+    {
+        OpenArchive();
+    }
+}
+
+ShaderBytecode ShaderCache::GetShader(const ShaderCompileRequest& request, std::vector<std::string>* dependencies)
+{
+    std::string source;
+    if (!m_fileSystem->ReadFile(request.SourcePath, source))
+    {
+        throw std::runtime_error("Shader source not found: " + request.SourcePath);
+    }
+    uint64_t key = Key(request, source);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ShaderBytecode bytecode;
+        auto it = m_compiledShaders.find(key);
+        if (it != m_compiledShaders.end())
+        {
+            bool changed = false;
+            for (const auto& dependency : it->second.Dependencies)
+            {
+                changed = changed || DependencyChanged(dependency.first, dependency.second);
+            }
+            if (!changed)
+            {
+                m_hitCount++;
+                if (dependencies != nullptr)
+                {
+                    for (const auto& dependency : it->second.Dependencies)
+                    {
+                        dependencies->push_back(dependency.first);
+                    }
+                }
+                bytecode.Data = it->second.Bytecode.data();
+                bytecode.Size = it->second.Bytecode.size();
+                return bytecode;
+            }
+        }
+        else if (FindInArchive(key, bytecode, dependencies))
+        {
+            m_hitCount++;
+            return bytecode;
+        }
+    }
+
+    // Compiles outside the lock, other threads keep hitting the cache.
+    ShaderCompileResult result;
+    if (!m_compiler->Compile(request, source, *m_fileSystem, result))
+    {
+        throw std::runtime_error(request.SourcePath + "(" + request.EntryPoint + "): " + result.Errors);
+    }
+
+    CompiledShader compiled;
+    compiled.Bytecode = std::move(result.Bytecode);
+    if (dependencies != nullptr)
+    {
+        dependencies->insert(dependencies->end(), result.Dependencies.begin(), result.Dependencies.end());
+    }
+    for (const std::string& path : result.Dependencies)
+    {
+        std::string contents;
+        m_fileSystem->ReadFile(path, contents);
+        compiled.Dependencies.push_back(std::make_pair(path, Fnv1a64(contents)));
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_missCount++;
+    CompiledShader& stored = m_compiledShaders[key];
+    stored = std::move(compiled);
+    ShaderBytecode bytecode;
+    bytecode.Data = stored.Bytecode.data();
+    bytecode.Size = stored.Bytecode.size();
+    return bytecode;
+}
+
+uint64_t ShaderCache::Key(const ShaderCompileRequest& request, const std::string& source)const
+{
+    Hasher hasher;
+    hasher.AddString(m_compilerIdentifier.c_str());
+    hasher.AddString(request.SourcePath.c_str());
+    hasher.AddValue(Fnv1a64(source));
+    hasher.AddString(request.EntryPoint.c_str());
+    hasher.AddString(request.Target.c_str());
+    hasher.AddValue((uint32_t)request.Defines.size());
+    for (const auto& define : request.Defines)
+    {
+        hasher.AddString(define.first.c_str());
+        hasher.AddString(define.second.c_str());
+    }
+    hasher.AddValue(request.Flags);
+    return hasher.Value();
+}
+
+bool ShaderCache::DependencyChanged(const std::string& path, uint64_t contentHash)
+{
+    std::string contents;
+    return !m_fileSystem->ReadFile(path, contents) || Fnv1a64(contents) != contentHash;
+}
+
+bool ShaderCache::FindInArchive(uint64_t key, ShaderBytecode& bytecode, std::vector<std::string>* dependencyPaths)
+{
+    if (m_archive.Data() == nullptr)
+    {
+        return false;
+    }
+    const uint8_t* data = m_archive.Data();
+    const ArchiveHeader& header = *reinterpret_cast<const ArchiveHeader*>(data);
+    const ArchiveEntry* entries = reinterpret_cast<const ArchiveEntry*>(data + header.EntriesOffset);
+    const ArchiveEntry* end = entries + header.EntryCount;
+    const ArchiveEntry* entry = std::lower_bound(entries, end, key,
+        [](const ArchiveEntry& entry, uint64_t key) { return entry.Key < key; });
+    if (entry == end || entry->Key != key)
+    {
+        return false;
+    }
+
+    const ArchiveDependency* dependencies = reinterpret_cast<const ArchiveDependency*>(data + header.DependenciesOffset);
+    const char* strings = reinterpret_cast<const char*>(data + header.StringsOffset);
+    for (uint32_t i = 0; i < entry->DependencyCount; i++)
+    {
+        const ArchiveDependency& dependency = dependencies[entry->FirstDependency + i];
+        if (DependencyChanged(std::string(strings + dependency.PathOffset, dependency.PathSize), dependency.ContentHash))
+        {
+            return false;
+        }
+    }
+    if (dependencyPaths != nullptr)
+    {
+        for (uint32_t i = 0; i < entry->DependencyCount; i++)
+        {
+            const ArchiveDependency& dependency = dependencies[entry->FirstDependency + i];
+            dependencyPaths->push_back(std::string(strings + dependency.PathOffset, dependency.PathSize));
+        }
+    }
+    bytecode.Data = data + entry->BytecodeOffset;
+    bytecode.Size = (size_t)entry->BytecodeSize;
+    return true;
+}
+
+bool ShaderCache::OpenArchive()
+{
+    // Everything the lookups read is checked once here, a damaged archive is ignored.
+    if (!m_archive.Open(m_archivePath))
+    {
+        return false;
+    }
+    uint64_t fileSize = m_archive.Size();
+    const uint8_t* data = m_archive.Data();
+    bool valid = fileSize >= sizeof(ArchiveHeader);
+    const ArchiveHeader* header = reinterpret_cast<const ArchiveHeader*>(data);
+    valid = valid && header->Magic == ArchiveMagic && header->Version == ArchiveVersion &&
+        header->EntriesOffset % alignof(ArchiveEntry) == 0 &&
+        header->DependenciesOffset % alignof(ArchiveDependency) == 0 &&
+        InBounds(header->EntriesOffset, (uint64_t)header->EntryCount * sizeof(ArchiveEntry), fileSize) &&
+        InBounds(header->DependenciesOffset, (uint64_t)header->DependencyCount * sizeof(ArchiveDependency), fileSize) &&
+        InBounds(header->StringsOffset, header->StringsSize, fileSize);
+
+    for (uint32_t i = 0; valid && i < header->EntryCount; i++)
+    {
+        const ArchiveEntry& entry = reinterpret_cast<const ArchiveEntry*>(data + header->EntriesOffset)[i];
+        valid = InBounds(entry.BytecodeOffset, entry.BytecodeSize, fileSize) &&
+            (uint64_t)entry.FirstDependency + entry.DependencyCount <= header->DependencyCount &&
+            (i == 0 || reinterpret_cast<const ArchiveEntry*>(data + header->EntriesOffset)[i - 1].Key < entry.Key);
+    }
+    for (uint32_t i = 0; valid && i < header->DependencyCount; i++)
+    {
+        const ArchiveDependency& dependency = reinterpret_cast<const ArchiveDependency*>(data + header->DependenciesOffset)[i];
+        valid = InBounds(dependency.PathOffset, dependency.PathSize, header->StringsSize);
+    }
+
+    if (!valid)
+    {
+        m_archive.Close();
+    }
+    return valid;
+}
+
+void ShaderCache::Save()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_archivePath.empty() || m_compiledShaders.empty())
+    {
+        return;
+    }
+
+    // Merge the archive and the new entries, sorted by key.
+    struct SavedEntry
+    {
+        const uint8_t* Bytecode;
+        uint64_t BytecodeSize;
+        std::vector<std::pair<std::string, uint64_t>> Dependencies;
+    };
+    std::map<uint64_t, SavedEntry> saved;
+    if (m_archive.Data() != nullptr)
+    {
+        const uint8_t* data = m_archive.Data();
+        const ArchiveHeader& header = *reinterpret_cast<const ArchiveHeader*>(data);
+        const ArchiveEntry* entries = reinterpret_cast<const ArchiveEntry*>(data + header.EntriesOffset);
+        const ArchiveDependency* dependencies = reinterpret_cast<const ArchiveDependency*>(data + header.DependenciesOffset);
+        const char* strings = reinterpret_cast<const char*>(data + header.StringsOffset);
+        for (uint32_t i = 0; i < header.EntryCount; i++)
+        {
+            SavedEntry entry = { data + entries[i].BytecodeOffset, entries[i].BytecodeSize, {} };
+            for (uint32_t d = 0; d < entries[i].DependencyCount; d++)
+            {
+                const ArchiveDependency& dependency = dependencies[entries[i].FirstDependency + d];
+                entry.Dependencies.push_back(std::make_pair(
+                    std::string(strings + dependency.PathOffset, dependency.PathSize), dependency.ContentHash));
+            }
+            saved[entries[i].Key] = std::move(entry);
+        }
+    }
+    for (auto& compiled : m_compiledShaders)
+    {
+        SavedEntry entry = { compiled.second.Bytecode.data(), compiled.second.Bytecode.size(), compiled.second.Dependencies };
+        saved[compiled.first] = std::move(entry);
+    }
+
+    std::vector<ArchiveEntry> entries;
+    std::vector<ArchiveDependency> dependencies;
+    std::string strings;
+    uint64_t bytecodeSize = 0;
+    for (const auto& entry : saved)
+    {
+        ArchiveEntry archiveEntry = {};
+        archiveEntry.Key = entry.first;
+        archiveEntry.BytecodeOffset = bytecodeSize;
+        archiveEntry.BytecodeSize = entry.second.BytecodeSize;
+        archiveEntry.FirstDependency = (uint32_t)dependencies.size();
+        archiveEntry.DependencyCount = (uint32_t)entry.second.Dependencies.size();
+        entries.push_back(archiveEntry);
+        for (const auto& dependency : entry.second.Dependencies)
+        {
+            ArchiveDependency archiveDependency = {};
+            archiveDependency.ContentHash = dependency.second;
+            archiveDependency.PathOffset = (uint32_t)strings.size();
+            archiveDependency.PathSize = (uint32_t)dependency.first.size();
+            dependencies.push_back(archiveDependency);
+            strings += dependency.first;
+        }
+        // Every bytecode starts 8 byte aligned.
+        bytecodeSize += (entry.second.BytecodeSize + 7) & ~7ull;
+    }
+
+    ArchiveHeader header = {};
+    header.Magic = ArchiveMagic;
+    header.Version = ArchiveVersion;
+    header.EntryCount = (uint32_t)entries.size();
+    header.DependencyCount = (uint32_t)dependencies.size();
+    header.EntriesOffset = sizeof(ArchiveHeader);
+    header.DependenciesOffset = header.EntriesOffset + entries.size() * sizeof(ArchiveEntry);
+    header.StringsOffset = header.DependenciesOffset + dependencies.size() * sizeof(ArchiveDependency);
+    header.StringsSize = strings.size();
+    uint64_t bytecodeOffset = (header.StringsOffset + header.StringsSize + 7) & ~7ull;
+    for (ArchiveEntry& entry : entries)
+    {
+        entry.BytecodeOffset += bytecodeOffset;
+    }
+
+    std::vector<uint8_t> buffer;
+    buffer.reserve((size_t)(bytecodeOffset + bytecodeSize));
+    Append(buffer, header);
+    for (const ArchiveEntry& entry : entries)
+    {
+        Append(buffer, entry);
+    }
+    for (const ArchiveDependency& dependency : dependencies)
+    {
+        Append(buffer, dependency);
+    }
+    buffer.insert(buffer.end(), strings.begin(), strings.end());
+    size_t index = 0;
+    for (const auto& entry : saved)
+    {
+        buffer.resize((size_t)entries[index++].BytecodeOffset, 0);
+        buffer.insert(buffer.end(), entry.second.Bytecode, entry.second.Bytecode + entry.second.BytecodeSize);
+    }
+
+    // The archive cannot be replaced while it is mapped. On failure the new
+    // entries stay in memory and the next Save tries again.
+    m_archive.Close();
+    if (MappedFile::Write(m_archivePath, buffer.data(), buffer.size()))
+    {
+        m_compiledShaders.clear();
+    }
+    OpenArchive();
+}
\ No newline at end of file
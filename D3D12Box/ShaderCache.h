@@ -0,0 +1,113 @@
+#pragma once
+#include "MappedFile.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct ShaderCompileRequest
+{
+    // UTF-8.
+    std::string SourcePath;
+    std::string EntryPoint;
+    std::string Target;
+    std::vector<std::pair<std::string, std::string>> Defines;
+    uint32_t Flags = 0;
+};
+
+struct ShaderCompileResult
+{
+    std::vector<uint8_t> Bytecode;
+    // Every file the compiler read besides the source, as resolved paths.
+    std::vector<std::string> Dependencies;
+    std::string Errors;
+};
+
+// Reads the sources and their includes. Tests replace the disk with memory.
+class IShaderFileSystem
+{
+public:
+    virtual ~IShaderFileSystem() = default;
+    // Returns false if the file does not exist.
+    virtual bool ReadFile(const std::string& path, std::string& contents) = 0;
+};
+
+class DiskShaderFileSystem : public IShaderFileSystem
+{
+public:
+    bool ReadFile(const std::string& path, std::string& contents) override;
+};
+
+class IShaderCompiler
+{
+public:
+    virtual ~IShaderCompiler() = default;
+    // Part of the cache keys, changes when the compiler output may change.
+    virtual std::string Identifier()const = 0;
+    // Includes are read through fileSystem and reported in the result.
+    virtual bool Compile(const ShaderCompileRequest& request, const std::string& source,
+        IShaderFileSystem& fileSystem, ShaderCompileResult& result) = 0;
+};
+
+struct ShaderBytecode
+{
+    const void* Data = nullptr;
+    size_t Size = 0;
+};
+
+// Bytecode cache keyed by a hash of the source, the entry point, the target,
+// the defines, the flags and the compiler. Every entry lists the files the
+// compiler included with a hash of their content, an entry whose includes
+// changed is compiled again. A hit reads the files and skips the compiler.
+//
+// The archive is mapped and searched in place: a header, the entries sorted
+// by key, the includes, a string pool and the bytecode. Little-endian with
+// fixed-size fields, the same file works on every platform.
+class ShaderCache
+{
+public:
+    // An empty archivePath keeps the cache in memory.
+    ShaderCache(IShaderCompiler* compiler, IShaderFileSystem* fileSystem, const std::string& archivePath);
+    ShaderCache(const ShaderCache& rhs) = delete;
+    ShaderCache& operator=(const ShaderCache& rhs) = delete;
+
+    // Returns the bytecode, compiling it if needed. Throws std::runtime_error
+    // with the compiler messages if the compilation fails. The bytecode stays
+    // valid until Save or the destruction of the cache. Thread safe.
+    // dependencies, if not null, receives the includes of the shader.
+    ShaderBytecode GetShader(const ShaderCompileRequest& request, std::vector<std::string>* dependencies = nullptr);
+
+    // Rewrites the archive with the shaders compiled since it was loaded.
+    void Save();
+
+    uint32_t HitCount()const { return m_hitCount; }
+    uint32_t MissCount()const { return m_missCount; }
+
+private:
+    struct CompiledShader
+    {
+        std::vector<uint8_t> Bytecode;
+        // Path and content hash of each include.
+        std::vector<std::pair<std::string, uint64_t>> Dependencies;
+    };
+
+    uint64_t Key(const ShaderCompileRequest& request, const std::string& source)const;
+    bool DependencyChanged(const std::string& path, uint64_t contentHash);
+    bool FindInArchive(uint64_t key, ShaderBytecode& bytecode, std::vector<std::string>* dependencyPaths);
+    bool OpenArchive();
+
+    IShaderCompiler* m_compiler;
+    IShaderFileSystem* m_fileSystem;
+    std::string m_archivePath;
+    std::string m_compilerIdentifier;
+
+    std::mutex m_mutex;
+    MappedFile m_archive;
+    // Entries compiled since the archive was opened, they replace the archive ones.
+    std::unordered_map<uint64_t, CompiledShader> m_compiledShaders;
+
+    uint32_t m_hitCount = 0;
+    uint32_t m_missCount = 0;
+};
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "ShaderPermutation.h"
+#include "MappedFile.h"
+#include <algorithm>
+
+namespace
+{
+    struct ShaderFeatureInfo
+    {
+        ShaderFeature Feature;
+        const char* Name;
+        // False for the features that only change the pipeline state.
+        bool IsDefine;
+    };
+
+    const ShaderFeatureInfo FeatureInfos[] =
+    {
+        { ShaderFeature::Instancing, "INSTANCING", true },
+        { ShaderFeature::AlphaTest, "ALPHA_TEST", true },
+        { ShaderFeature::Wireframe, "WIREFRAME", false },
+    };
+}
+
+std::vector<std::pair<std::string, std::string>> GetShaderFeatureDefines(ShaderFeature features)
+{
+    std::vector<std::pair<std::string, std::string>> defines;
+    for (const ShaderFeatureInfo& info : FeatureInfos)
+    {
+        if (info.IsDefine && HasFeature(features, info.Feature))
+        {
+            defines.emplace_back(info.Name, "1");
+        }
+    }
+    return defines;
+}
+
+std::string GetShaderFeatureNames(ShaderFeature features)
+{
+    std::string names;
+    for (const ShaderFeatureInfo& info : FeatureInfos)
+    {
+        if (HasFeature(features, info.Feature))
+        {
+            if (!names.empty())
+            {
+                names += '|';
+            }
+            names += info.Name;
+        }
+    }
+    return names.empty() ? "NONE" : names;
+}
+
+bool ParseShaderFeatureNames(const std::string& names, ShaderFeature& features)
+{
+    features = ShaderFeature::None;
+    if (names == "NONE")
+    {
+        return true;
+    }
+
+    size_t begin = 0;
+    while (begin <= names.size())
+    {
+        size_t end = (std::min)(names.find('|', begin), names.size());
+        std::string name = names.substr(begin, end - begin);
+        auto info = std::find_if(std::begin(FeatureInfos), std::end(FeatureInfos),
+            [&name](const ShaderFeatureInfo& candidate) { return name == candidate.Name; });
+        if (info == std::end(FeatureInfos))
+        {
+            return false;
+        }
+        features = features | info->Feature;
+        begin = end + 1;
+    }
+    return true;
+}
+
+std::vector<ShaderFeature> LoadShaderPermutationList(const std::string& path)
+{
+    std::vector<ShaderFeature> permutations;
+    MappedFile file;
+    if (!file.Open(path) || file.Data() == nullptr)
+    {
+        return permutations;
+    }
+
+    std::string contents((const char*)file.Data(), file.Size());
+    size_t begin = 0;
+    while (begin < contents.size())
+    {
+        size_t end = (std::min)(contents.find('\n', begin), contents.size());
+        std::string line = contents.substr(begin, end - begin);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        // Unknown lines are dropped, the next save rewrites the list anyway.
+        ShaderFeature features;
+        if (!line.empty() && ParseShaderFeatureNames(line, features) &&
+            std::find(permutations.begin(), permutations.end(), features) == permutations.end())
+        {
+            permutations.push_back(features);
+        }
+        begin = end + 1;
+    }
+    return permutations;
+}
+
+bool SaveShaderPermutationList(const std::string& path, const std::vector<ShaderFeature>& permutations)
+{
+    std::string contents;
+    for (ShaderFeature features : permutations)
+    {
+        contents += GetShaderFeatureNames(features);
+        contents += '\n';
+    }
+    return MappedFile::Write(path, contents.data(), contents.size());
+}
\ No newline at end of file
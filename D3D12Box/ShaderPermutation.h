@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Features a pipeline can be built with. The set of features is the key of
+// a permutation: the shader features become preprocessor defines, the other
+// ones only change the pipeline state.
+enum class ShaderFeature : uint32_t
+{
+    None = 0,
+    // INSTANCING: the world matrix comes from the instance buffer.
+    Instancing = 1 << 0,
+    // ALPHA_TEST: pixels with a low vertex alpha are discarded.
+    AlphaTest = 1 << 1,
+    // Pipeline state only: the triangles are drawn as lines.
+    Wireframe = 1 << 16
+};
+
+inline ShaderFeature operator|(ShaderFeature a, ShaderFeature b)
+{
+    return (ShaderFeature)((uint32_t)a | (uint32_t)b);
+}
+
+inline ShaderFeature operator&(ShaderFeature a, ShaderFeature b)
+{
+    return (ShaderFeature)((uint32_t)a & (uint32_t)b);
+}
+
+inline bool HasFeature(ShaderFeature features, ShaderFeature feature)
+{
+    return ((uint32_t)features & (uint32_t)feature) != 0;
+}
+
+// Defines of the shader features set in features, in bit order so equal
+// keys give equal shader cache keys.
+std::vector<std::pair<std::string, std::string>> GetShaderFeatureDefines(ShaderFeature features);
+
+// Names of the features separated by '|', "NONE" without features.
+std::string GetShaderFeatureNames(ShaderFeature features);
+
+// Returns false if a name is unknown, a feature may have been removed since
+// the names were written.
+bool ParseShaderFeatureNames(const std::string& names, ShaderFeature& features);
+
+// The permutations requested by a run, one line of names each, prewarmed by
+// the next run before any frame asks for them. Paths are UTF-8.
+std::vector<ShaderFeature> LoadShaderPermutationList(const std::string& path);
+bool SaveShaderPermutationList(const std::string& path, const std::vector<ShaderFeature>& permutations);
\ No newline at end of file
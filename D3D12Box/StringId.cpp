@@ -0,0 +1,50 @@
+#include "stdafx.h"
+#include "StringId.h"
+#include "FlatHashMap.h"
+#include <cassert>
+#include <mutex>
+
+namespace
+{
+    struct StringRegistry
+    {
+        std::mutex Mutex;
+        FlatHashMap<std::string> Names;
+    };
+
+    // Built on first use, ids can be interned during static initialization.
+    StringRegistry& Registry()
+    {
+        static StringRegistry registry;
+        return registry;
+    }
+}
+
+StringId InternString(const char* text, size_t length)
+{
+    StringId id(Fnv1a64(text, length));
+    assert(id.IsValid());
+
+    StringRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.Mutex);
+    std::string& name = registry.Names[id];
+    if (name.empty())
+    {
+        name.assign(text, length);
+    }
+    assert(name.compare(0, std::string::npos, text, length) == 0 && "Two names hash to the same StringId.");
+    return id;
+}
+
+StringId InternString(const std::string& text)
+{
+    return InternString(text.data(), text.size());
+}
+
+std::string StringIdName(StringId id)
+{
+    StringRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.Mutex);
+    const std::string* name = registry.Names.Find(id);
+    return name != nullptr ? *name : std::string();
+}
\ No newline at end of file
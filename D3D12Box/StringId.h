@@ -0,0 +1,41 @@
+#pragma once
+#include "Hash.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Name reduced to its 64-bit FNV-1a hash. Registries are keyed by it so that
+// looking an object up neither hashes nor allocates a string. Literals are
+// hashed by the compiler with "name"_id; the invalid id 0 is never produced
+// by a real name in practice.
+class StringId
+{
+public:
+    constexpr StringId() : m_value(0) {}
+    constexpr explicit StringId(uint64_t value) : m_value(value) {}
+
+    constexpr uint64_t Value()const { return m_value; }
+    constexpr bool IsValid()const { return m_value != 0; }
+
+    constexpr bool operator==(StringId other)const { return m_value == other.m_value; }
+    constexpr bool operator!=(StringId other)const { return m_value != other.m_value; }
+    constexpr bool operator<(StringId other)const { return m_value < other.m_value; }
+
+private:
+    uint64_t m_value;
+};
+
+// Assign to a constexpr variable to be sure no hashing is left at run time.
+constexpr StringId operator"" _id(const char* text, size_t length)
+{
+    return StringId(Fnv1a64Constant(text, length));
+}
+
+// Ids of names only known at run time. The text is remembered so that ids
+// can be turned back into names for debugging; two names with the same id
+// assert. Can be called from several threads.
+StringId InternString(const char* text, size_t length);
+StringId InternString(const std::string& text);
+
+// Empty for ids whose name was never interned.
+std::string StringIdName(StringId id);
\ No newline at end of file
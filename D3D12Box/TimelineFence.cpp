@@ -0,0 +1,170 @@
+#include "TimelineFence.h"
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    size_t FindCompleted(const FenceValue* values, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (values[i].Fence->IsComplete(values[i].Value))
+            {
+                return i;
+            }
+        }
+        return count;
+    }
+
+    // Milliseconds left before the deadline, FenceWaitInfinite stays infinite.
+    uint32_t RemainingMs(uint32_t timeoutMs, Clock::time_point start)
+    {
+        if (timeoutMs == FenceWaitInfinite)
+        {
+            return FenceWaitInfinite;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+        return elapsed >= timeoutMs ? 0 : timeoutMs - (uint32_t)elapsed;
+    }
+}
+
+bool ITimelineFence::Wait(uint64_t value, FenceWaitPolicy policy, uint32_t timeoutMs)
+{
+    FenceValue fenceValue;
+    fenceValue.Fence = this;
+    fenceValue.Value = value;
+    return WaitAny(&fenceValue, 1, nullptr, policy, timeoutMs);
+}
+
+bool ITimelineFence::WaitAll(const FenceValue* values, size_t count, FenceWaitPolicy policy, uint32_t timeoutMs)
+{
+    // Waiting for the values one after the other costs at most one sleep per fence.
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!WaitAny(&values[i], 1, nullptr, policy, RemainingMs(timeoutMs, start)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ITimelineFence::WaitAny(const FenceValue* values, size_t count, size_t* completedIndex,
+    FenceWaitPolicy policy, uint32_t timeoutMs)
+{
+    assert(count > 0);
+    Clock::time_point start = Clock::now();
+    size_t index = FindCompleted(values, count);
+
+    if (index == count && policy != FenceWaitPolicy::Block)
+    {
+        std::chrono::microseconds spinTime = values[0].Fence->m_spinTime;
+        while (index == count)
+        {
+            if (policy == FenceWaitPolicy::SpinThenBlock && Clock::now() - start >= spinTime)
+            {
+                break;
+            }
+            if (timeoutMs != FenceWaitInfinite && RemainingMs(timeoutMs, start) == 0)
+            {
+                return false;
+            }
+            std::this_thread::yield();
+            index = FindCompleted(values, count);
+        }
+    }
+
+    while (index == count)
+    {
+        uint32_t remainingMs = RemainingMs(timeoutMs, start);
+        if (!values[0].Fence->BlockUntilAny(values, count, remainingMs) && FindCompleted(values, count) == count)
+        {
+            return false;
+        }
+        index = FindCompleted(values, count);
+    }
+
+    if (completedIndex != nullptr)
+    {
+        *completedIndex = index;
+    }
+    return true;
+}
+
+CpuTimelineFence::CpuTimelineFence(uint64_t initialValue) :
+    m_value(initialValue)
+{
+}
+
+uint64_t CpuTimelineFence::CompletedValue()
+{
+    return m_value.load(std::memory_order_acquire);
+}
+
+void CpuTimelineFence::Signal(uint64_t value)
+{
+    uint64_t current = m_value.load(std::memory_order_relaxed);
+    while (current < value &&
+        !m_value.compare_exchange_weak(current, value, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+
+    // Taking the mutex of a waiter orders the new value before its next check.
+    std::lock_guard<std::mutex> lock(m_waitersMutex);
+    for (Waiter* waiter : m_waiters)
+    {
+        std::lock_guard<std::mutex> waiterLock(waiter->Mutex);
+        waiter->Condition.notify_all();
+    }
+}
+
+bool CpuTimelineFence::BlockUntilAny(const FenceValue* values, size_t count, uint32_t timeoutMs)
+{
+    Waiter waiter;
+    for (size_t i = 0; i < count; i++)
+    {
+        assert(dynamic_cast<CpuTimelineFence*>(values[i].Fence) != nullptr && "Fences of different kinds");
+        static_cast<CpuTimelineFence*>(values[i].Fence)->AddWaiter(&waiter);
+    }
+
+    bool reached = false;
+    {
+        std::unique_lock<std::mutex> lock(waiter.Mutex);
+        auto anyComplete = [values, count]() { return FindCompleted(values, count) != count; };
+        if (timeoutMs == FenceWaitInfinite)
+        {
+            waiter.Condition.wait(lock, anyComplete);
+            reached = true;
+        }
+        else
+        {
+            reached = waiter.Condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), anyComplete);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        static_cast<CpuTimelineFence*>(values[i].Fence)->RemoveWaiter(&waiter);
+    }
+    return reached;
+}
+
+void CpuTimelineFence::AddWaiter(Waiter* waiter)
+{
+    std::lock_guard<std::mutex> lock(m_waitersMutex);
+    m_waiters.push_back(waiter);
+}
+
+void CpuTimelineFence::RemoveWaiter(Waiter* waiter)
+{
+    std::lock_guard<std::mutex> lock(m_waitersMutex);
+    auto it = std::find(m_waiters.begin(), m_waiters.end(), waiter);
+    if (it != m_waiters.end())
+    {
+        m_waiters.erase(it);
+    }
+}
\ No newline at end of file
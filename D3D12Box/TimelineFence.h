@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// How a thread waits for a fence value.
+enum class FenceWaitPolicy
+{
+    // Polls the fence until the value is reached, never sleeps.
+    Spin,
+    // Goes to sleep right away and is woken up by the fence.
+    Block,
+    // Polls for the spin time of the fence, then blocks. Short waits avoid
+    // the cost of sleeping, long waits do not burn a core.
+    SpinThenBlock
+};
+
+const uint32_t FenceWaitInfinite = UINT32_MAX;
+
+class ITimelineFence;
+
+// A value to wait for on a fence.
+struct FenceValue
+{
+    ITimelineFence* Fence = nullptr;
+    uint64_t Value = 0;
+};
+
+// Monotonic 64-bit counter advanced by a producer (the GPU or another thread).
+// Waiting for a value waits for everything the producer did before signaling it.
+class ITimelineFence
+{
+public:
+    virtual ~ITimelineFence() = default;
+
+    // Highest value signaled so far, never blocks.
+    virtual uint64_t CompletedValue() = 0;
+
+    bool IsComplete(uint64_t value) { return CompletedValue() >= value; }
+
+    // Returns false if timeoutMs elapsed first.
+    bool Wait(uint64_t value, FenceWaitPolicy policy = FenceWaitPolicy::SpinThenBlock, uint32_t timeoutMs = FenceWaitInfinite);
+
+    // Waits until every value is reached. Every fence has to be of the same implementation.
+    static bool WaitAll(const FenceValue* values, size_t count,
+        FenceWaitPolicy policy = FenceWaitPolicy::SpinThenBlock, uint32_t timeoutMs = FenceWaitInfinite);
+
+    // Waits until one of the values is reached and stores its index in completedIndex if not null.
+    // Every fence has to be of the same implementation.
+    static bool WaitAny(const FenceValue* values, size_t count, size_t* completedIndex = nullptr,
+        FenceWaitPolicy policy = FenceWaitPolicy::SpinThenBlock, uint32_t timeoutMs = FenceWaitInfinite);
+
+    // How long SpinThenBlock polls before blocking.
+    void SetSpinTime(std::chrono::microseconds spinTime) { m_spinTime = spinTime; }
+
+protected:
+    // Sleeps until one of the values is reached, spurious returns are allowed.
+    // Returns false if timeoutMs elapsed first. values[0].Fence is this fence.
+    virtual bool BlockUntilAny(const FenceValue* values, size_t count, uint32_t timeoutMs) = 0;
+
+private:
+    std::chrono::microseconds m_spinTime{ 50 };
+};
+
+// Fence signaled by CPU threads, for work that does not involve the GPU
+// and to run the code waiting on fences without a device.
+class CpuTimelineFence : public ITimelineFence
+{
+public:
+    explicit CpuTimelineFence(uint64_t initialValue = 0);
+    CpuTimelineFence(const CpuTimelineFence& rhs) = delete;
+    CpuTimelineFence& operator=(const CpuTimelineFence& rhs) = delete;
+
+    virtual uint64_t CompletedValue()override;
+
+    // Values lower than the completed value are ignored.
+    void Signal(uint64_t value);
+
+protected:
+    virtual bool BlockUntilAny(const FenceValue* values, size_t count, uint32_t timeoutMs)override;
+
+private:
+    // A blocked thread, registered on every fence it waits for.
+    struct Waiter
+    {
+        std::mutex Mutex;
+        std::condition_variable Condition;
+    };
+
+    void AddWaiter(Waiter* waiter);
+    void RemoveWaiter(Waiter* waiter);
+
+    std::atomic<uint64_t> m_value;
+    std::mutex m_waitersMutex;
+    std::vector<Waiter*> m_waiters;
+};
\ No newline at end of file
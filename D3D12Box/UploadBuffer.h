@@ -1,6 +1,7 @@
 #pragma once
 #include "stdafx.h"
 #include "D3DAppUtil.h"
+#include <cassert>
 
 template<typename T>
 class UploadBuffer
@@ -47,6 +48,14 @@ public:
 		memcpy(&m_mappedData[elementIndex * m_elementByteSize], &data, sizeof(T));
 	}
 
+	// The mapped elements of a buffer created without constant buffer padding,
+	// written in place by the builders filling them.
+	T* Elements()
+	{
+		assert(!m_isConstantBuffer && "Constant buffer elements are padded");
+		return reinterpret_cast<T*>(m_mappedData);
+	}
+
 private:
 	ComPtr<ID3D12Resource>	m_uploadBuffer;
 	BYTE* m_mappedData = nullptr;
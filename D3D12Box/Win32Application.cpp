@@ -43,7 +43,11 @@ int Win32Application::Run(D3DAppBase* pSample, HINSTANCE hInstance, int nCmdShow
     UpdateWindow(m_hwnd);
 
     // Main sample loop.
-    return pSample->Run();
+    int result = pSample->Run();
+
+    // The build jobs and the GPU are done before the sample is destroyed.
+    pSample->OnDestroy();
+    return result;
 }
 
 // Main message handler for the sample
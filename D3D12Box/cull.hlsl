@@ -0,0 +1,73 @@
+#include "PassConstants.hlsli"
+
+// Frustum culling of the indirect commands. Culling.h holds the CPU
+// reference of this pass, keep both in sync.
+
+#define CULL_THREAD_GROUP_SIZE 64
+
+cbuffer cbCulling : register(b0)
+{
+    uint gCommandCount;
+};
+
+// Matches CullInstance in D3DAppUtil.h.
+struct CullInstance
+{
+    float3 Center;
+    uint RunIndex;
+    float3 Extents;
+    uint RunFirstCommand;
+};
+
+// Matches IndirectCommand in D3DAppUtil.h, including the padding to 8 bytes.
+struct IndirectCommand
+{
+    uint2 ObjectConstantBuffer;
+    uint IndexCountPerInstance;
+    uint InstanceCount;
+    uint StartIndexLocation;
+    int BaseVertexLocation;
+    uint StartInstanceLocation;
+    uint Pad;
+};
+
+StructuredBuffer<CullInstance> gInstances : register(t0);
+StructuredBuffer<IndirectCommand> gCommands : register(t1);
+RWStructuredBuffer<IndirectCommand> gCulledCommands : register(u0);
+RWStructuredBuffer<uint> gRunCounts : register(u1);
+
+bool IsInsideFrustum(float3 center, float3 extents)
+{
+    // precise keeps the compiler from fusing into mad, which would round
+    // differently from the CPU reference.
+    [unroll]
+    for (uint i = 0; i < 6; i++)
+    {
+        float4 plane = gFrustumPlanes[i];
+        precise float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        precise float radius = abs(plane.x) * extents.x + abs(plane.y) * extents.y + abs(plane.z) * extents.z;
+        if (distance + radius < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+[numthreads(CULL_THREAD_GROUP_SIZE, 1, 1)]
+void CS(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    uint index = dispatchThreadID.x;
+    if (index >= gCommandCount)
+    {
+        return;
+    }
+
+    CullInstance instance = gInstances[index];
+    if (IsInsideFrustum(instance.Center, instance.Extents))
+    {
+        uint slot;
+        InterlockedAdd(gRunCounts[instance.RunIndex], 1, slot);
+        gCulledCommands[instance.RunFirstCommand + slot] = gCommands[index];
+    }
+}
\ No newline at end of file
@@ -3,24 +3,21 @@ cbuffer cbPerObject : register(b0)
     float4x4 gWorld;
 };
 
-cbuffer cbPerPass:register(b1)
+cbuffer cbInstanceBatch : register(b2)
 {
-    float4x4    gView;
-    float4x4    gInvView;
-    float4x4    gProj;
-    float4x4    gInvProj;
-    float4x4    gViewProj;
-    float4x4    gInvViewProj;
-    float3      gEyePosW;
-    float       cbPerObjectPad1;
-    float2      gRenderTargerSize;
-    float2      gInvRenderTargetSize;
-    float       gNearZ;
-    float       gFarZ;
-    float       gTotalTime;
-    float       gDeltaTime;
+    // Offset of the current instanced draw in gInstanceData.
+    uint gBaseInstance;
 };
 
+struct InstanceData
+{
+    float4x4 World;
+};
+
+StructuredBuffer<InstanceData> gInstanceData : register(t0);
+
+#include "PassConstants.hlsli"
+
 struct VertexIn
 {
     float3 PosL:POSITION;
@@ -33,12 +30,19 @@ struct VertexOut
     float4 Color : COLOR;
 };
 
-VertexOut VS(VertexIn vin)
+// Permutations: INSTANCING reads the world matrix from gInstanceData,
+// ALPHA_TEST discards the pixels with a low vertex alpha.
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
     VertexOut result;
 
+#if INSTANCING
+    float4x4 world = gInstanceData[gBaseInstance + instanceID].World;
+#else
+    float4x4 world = gWorld;
+#endif
     // Transform to homogeneous clip spaces.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(vin.PosL, 1.0f), world);
     result.PosH = mul(posW, gViewProj);
     result.Color = vin.Color;
     return result;
@@ -46,5 +50,8 @@ VertexOut VS(VertexIn vin)
 
 float4 PS(VertexOut pin) : SV_Target
 {
+#if ALPHA_TEST
+    clip(pin.Color.a - 0.1f);
+#endif
     return pin.Color;
 }
\ No newline at end of file
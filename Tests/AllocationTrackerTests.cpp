@@ -0,0 +1,132 @@
+#include "AllocationTracker.h"
+#include <gtest/gtest.h>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct alignas(64) CacheLine
+    {
+        uint8_t Bytes[64];
+    };
+
+    // The optimizer may drop a new and delete pair whose result is never
+    // used; storing the pointer here keeps the allocation.
+    void* volatile g_sink = nullptr;
+
+    template<typename T>
+    T* Keep(T* pointer)
+    {
+        g_sink = pointer;
+        return pointer;
+    }
+}
+
+TEST(AllocationTrackerTests, ScopeCountsTheAllocationsOfItsThread)
+{
+    AllocationScope scope;
+    std::vector<int>* items = Keep(new std::vector<int>(256));
+    delete items;
+    CacheLine* line = Keep(new CacheLine());
+    delete line;
+    int* nothrow = Keep(new (std::nothrow) int[16]);
+    delete[] nothrow;
+    AllocationStats stats = scope.Stats();
+
+    EXPECT_EQ(stats.Count, 4u);
+    EXPECT_EQ(stats.FreeCount, 4u);
+    EXPECT_EQ(stats.Bytes, sizeof(std::vector<int>) + 256 * sizeof(int) + sizeof(CacheLine) + 16 * sizeof(int));
+}
+
+TEST(AllocationTrackerTests, OtherThreadsOnlyShowInTheGlobalStats)
+{
+    AllocationStats globalStart = GlobalAllocationStats();
+    AllocationScope scope;
+    std::thread worker([]()
+    {
+        std::vector<std::string> names;
+        for (int i = 0; i < 100; i++)
+        {
+            names.push_back(std::string(64, 'x'));
+        }
+    });
+    worker.join();
+    AllocationStats stats = scope.Stats();
+    AllocationStats global = GlobalAllocationStats() - globalStart;
+
+    // Starting the thread allocates on this one, the strings do not.
+    EXPECT_LT(stats.Count, 10u);
+    EXPECT_GE(global.Count, stats.Count + 100);
+}
+
+TEST(AllocationTrackerTests, WarmedUpContainersDoNotAllocate)
+{
+    // The frame loop of the app: containers cleared every frame keep their
+    // capacity, the frames after the first one do not touch the heap.
+    std::vector<uint32_t> visible;
+    std::vector<std::string> names(8);
+    for (int frame = 0; frame < 10; frame++)
+    {
+        AllocationScope scope;
+        visible.clear();
+        for (uint32_t i = 0; i < 1000; i++)
+        {
+            if (i % 3 != 0)
+            {
+                visible.push_back(i);
+            }
+        }
+        for (std::string& name : names)
+        {
+            name.assign("an item name longer than the small string buffer");
+        }
+        AllocationStats stats = scope.Stats();
+
+        if (frame == 0)
+        {
+            EXPECT_GT(stats.Count, 0u);
+        }
+        else
+        {
+            EXPECT_EQ(stats.Count, 0u) << "frame " << frame;
+        }
+    }
+}
+
+TEST(AllocationTrackerTests, TrackingResourceCountsItsContainersOnly)
+{
+    TrackingResource tracking;
+    AllocationScope scope;
+    {
+        std::pmr::vector<uint64_t> items(&tracking);
+        std::vector<uint64_t> untracked;
+        for (int frame = 0; frame < 10; frame++)
+        {
+            AllocationStats before = tracking.Stats();
+            items.clear();
+            untracked.clear();
+            for (uint64_t i = 0; i < 500; i++)
+            {
+                items.push_back(i);
+                untracked.push_back(i);
+            }
+            AllocationStats frameStats = tracking.Stats() - before;
+            if (frame > 0)
+            {
+                EXPECT_EQ(frameStats.Count, 0u) << "frame " << frame;
+            }
+        }
+        EXPECT_GT(tracking.Stats().Count, 0u);
+        EXPECT_GE(tracking.LiveBytes(), 500 * sizeof(uint64_t));
+    }
+    AllocationStats stats = scope.Stats();
+
+    // Both vectors grew the same way, the upstream heap saw both.
+    EXPECT_EQ(tracking.LiveBytes(), 0u);
+    EXPECT_EQ(tracking.Stats().FreeCount, tracking.Stats().Count);
+    EXPECT_EQ(stats.Count, 2 * tracking.Stats().Count);
+    EXPECT_EQ(stats.Bytes, 2 * tracking.Stats().Bytes);
+}
\ No newline at end of file
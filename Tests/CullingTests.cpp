@@ -0,0 +1,191 @@
+#include "Culling.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // Laid out like the DirectXMath and D3DAppUtil.h types the app uses.
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    struct Float4
+    {
+        float x, y, z, w;
+    };
+
+    struct Instance
+    {
+        Float3 Center;
+        uint32_t RunIndex;
+        Float3 Extents;
+        uint32_t RunFirstCommand;
+    };
+
+    struct Command
+    {
+        uint32_t Id;
+    };
+
+    // The planes of the box [-1, 1]^3, unnormalized by scale.
+    void BoxPlanes(Float4 planes[6], float scale)
+    {
+        planes[0] = { scale, 0.0f, 0.0f, scale };
+        planes[1] = { -scale, 0.0f, 0.0f, scale };
+        planes[2] = { 0.0f, scale, 0.0f, scale };
+        planes[3] = { 0.0f, -scale, 0.0f, scale };
+        planes[4] = { 0.0f, 0.0f, scale, scale };
+        planes[5] = { 0.0f, 0.0f, -scale, scale };
+    }
+
+    // IsInsideFrustum of cull.hlsl written out operation by operation: the
+    // precise products and sums are rounded to float in source order, abs
+    // only clears the sign.
+    bool ShaderIsInsideFrustum(const Float4 planes[6], const Float3& center, const Float3& extents)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            const Float4& plane = planes[i];
+            volatile float distance = plane.x * center.x;
+            distance = distance + plane.y * center.y;
+            distance = distance + plane.z * center.z;
+            distance = distance + plane.w;
+            volatile float radius = std::fabs(plane.x) * extents.x;
+            radius = radius + std::fabs(plane.y) * extents.y;
+            radius = radius + std::fabs(plane.z) * extents.z;
+            volatile float sum = distance + radius;
+            if (sum < 0.0f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+TEST(IsInsideFrustum, BoxesInsideOutsideAndStraddling)
+{
+    Float4 planes[6];
+    BoxPlanes(planes, 1.0f);
+    const Float3 small = { 0.25f, 0.25f, 0.25f };
+    EXPECT_TRUE(IsInsideFrustum(planes, Float3{ 0.0f, 0.0f, 0.0f }, small));
+    EXPECT_TRUE(IsInsideFrustum(planes, Float3{ 1.1f, 0.0f, 0.0f }, small));
+    EXPECT_FALSE(IsInsideFrustum(planes, Float3{ 1.5f, 0.0f, 0.0f }, small));
+
+    // Every plane rejects on its own side.
+    const Float3 outside[6] = {
+        { -2.0f, 0.0f, 0.0f }, { 2.0f, 0.0f, 0.0f }, { 0.0f, -2.0f, 0.0f },
+        { 0.0f, 2.0f, 0.0f }, { 0.0f, 0.0f, -2.0f }, { 0.0f, 0.0f, 2.0f } };
+    for (const Float3& center : outside)
+    {
+        EXPECT_FALSE(IsInsideFrustum(planes, center, small));
+    }
+
+    // A box larger than the frustum contains it.
+    EXPECT_TRUE(IsInsideFrustum(planes, Float3{ 0.0f, 0.0f, 0.0f }, Float3{ 10.0f, 10.0f, 10.0f }));
+}
+
+TEST(IsInsideFrustum, TouchingAPlaneIsInside)
+{
+    Float4 planes[6];
+    BoxPlanes(planes, 1.0f);
+    // distance + radius is exactly 0 on the left plane.
+    EXPECT_TRUE(IsInsideFrustum(planes, Float3{ -1.5f, 0.0f, 0.0f }, Float3{ 0.5f, 0.5f, 0.5f }));
+    // A degenerate box on the plane.
+    EXPECT_TRUE(IsInsideFrustum(planes, Float3{ 1.0f, 0.0f, 0.0f }, Float3{ 0.0f, 0.0f, 0.0f }));
+    // One ulp further out is culled.
+    float beyond = std::nextafter(-1.5f, -2.0f);
+    EXPECT_FALSE(IsInsideFrustum(planes, Float3{ beyond, 0.0f, 0.0f }, Float3{ 0.5f, 0.5f, 0.5f }));
+    EXPECT_FALSE(IsInsideFrustum(planes, Float3{ std::nextafter(1.0f, 2.0f), 0.0f, 0.0f }, Float3{ 0.0f, 0.0f, 0.0f }));
+}
+
+TEST(IsInsideFrustum, PlanesNeedNoNormalization)
+{
+    Float4 unit[6];
+    Float4 scaled[6];
+    BoxPlanes(unit, 1.0f);
+    BoxPlanes(scaled, 8.0f);
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<float> position(-3.0f, 3.0f);
+    std::uniform_real_distribution<float> size(0.0f, 1.0f);
+    for (int i = 0; i < 1000; i++)
+    {
+        Float3 center = { position(generator), position(generator), position(generator) };
+        Float3 extents = { size(generator), size(generator), size(generator) };
+        // Scaling by a power of two is exact, both have to agree.
+        EXPECT_EQ(IsInsideFrustum(unit, center, extents), IsInsideFrustum(scaled, center, extents));
+    }
+}
+
+TEST(IsInsideFrustum, MatchesTheShaderExpressionsOnRandomPlanes)
+{
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> value(-4.0f, 4.0f);
+    std::uniform_real_distribution<float> size(0.0f, 2.0f);
+    int visible = 0;
+    for (int i = 0; i < 20000; i++)
+    {
+        Float4 planes[6];
+        for (Float4& plane : planes)
+        {
+            plane = { value(generator), value(generator), value(generator), value(generator) + 6.0f };
+        }
+        Float3 center = { value(generator), value(generator), value(generator) };
+        Float3 extents = { size(generator), size(generator), size(generator) };
+        bool expected = ShaderIsInsideFrustum(planes, center, extents);
+        EXPECT_EQ(IsInsideFrustum(planes, center, extents), expected);
+        visible += expected ? 1 : 0;
+    }
+    // Both outcomes are exercised.
+    EXPECT_GT(visible, 1000);
+    EXPECT_LT(visible, 19000);
+}
+
+TEST(CullIndirectCommands, CompactsTheVisibleCommandsOfEachRun)
+{
+    Float4 planes[6];
+    BoxPlanes(planes, 1.0f);
+    const Float3 inside = { 0.0f, 0.0f, 0.0f };
+    const Float3 outside = { 5.0f, 0.0f, 0.0f };
+    const Float3 extents = { 0.1f, 0.1f, 0.1f };
+
+    // Two runs: commands 0..3 and 4..6.
+    std::vector<Instance> instances = {
+        { outside, 0, extents, 0 }, { inside, 0, extents, 0 }, { outside, 0, extents, 0 }, { inside, 0, extents, 0 },
+        { inside, 1, extents, 4 }, { outside, 1, extents, 4 }, { inside, 1, extents, 4 } };
+    std::vector<Command> commands;
+    for (uint32_t i = 0; i < instances.size(); i++)
+    {
+        commands.push_back({ i });
+    }
+
+    const uint32_t unwritten = 0xFFFFFFFF;
+    std::vector<Command> culled(commands.size(), Command{ unwritten });
+    uint32_t runCounts[2] = {};
+    CullIndirectCommands(planes, instances.data(), commands.data(), (uint32_t)commands.size(), culled.data(), runCounts);
+
+    EXPECT_EQ(runCounts[0], 2u);
+    EXPECT_EQ(runCounts[1], 2u);
+    // Visible commands start their run in input order, the rest is untouched.
+    const uint32_t expected[] = { 1, 3, unwritten, unwritten, 4, 6, unwritten };
+    for (size_t i = 0; i < culled.size(); i++)
+    {
+        EXPECT_EQ(culled[i].Id, expected[i]) << "slot " << i;
+    }
+}
+
+TEST(CullIndirectCommands, EveryCommandCulledLeavesZeroCounts)
+{
+    Float4 planes[6];
+    BoxPlanes(planes, 1.0f);
+    Instance instance = { { 0.0f, 0.0f, 9.0f }, 0, { 1.0f, 1.0f, 1.0f }, 0 };
+    Command command = { 7 };
+    Command culled = { 0 };
+    uint32_t runCount = 0;
+    CullIndirectCommands(planes, &instance, &command, 1, &culled, &runCount);
+    EXPECT_EQ(runCount, 0u);
+    EXPECT_EQ(culled.Id, 0u);
+}
\ No newline at end of file
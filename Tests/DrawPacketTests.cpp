@@ -0,0 +1,133 @@
+#include "DrawPacket.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <limits>
+#include <random>
+
+namespace
+{
+    std::vector<DrawPacket> RandomPackets(uint32_t count, uint32_t pipelineStates, uint32_t meshes, uint64_t seed)
+    {
+        std::mt19937_64 generator(seed);
+        std::vector<DrawPacket> packets(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            packets[i].SortKey = BuildSortKey(RenderLayer::Opaque,
+                static_cast<uint32_t>(generator() % pipelineStates),
+                static_cast<uint32_t>(generator() % meshes),
+                std::uniform_real_distribution<float>(-10.0f, 1000.0f)(generator));
+            // Tags the packet so the stability of the sort can be checked.
+            packets[i].Item = reinterpret_cast<RenderItem*>(static_cast<uintptr_t>(i + 1));
+        }
+        return packets;
+    }
+
+    void ExpectSameOrderAsStableSort(std::vector<DrawPacket> packets)
+    {
+        std::vector<DrawPacket> expected = packets;
+        std::stable_sort(expected.begin(), expected.end(), [](const DrawPacket& a, const DrawPacket& b)
+        {
+            return a.SortKey < b.SortKey;
+        });
+
+        std::vector<DrawPacket> scratch;
+        RadixSortDrawPackets(packets, scratch);
+        ASSERT_EQ(packets.size(), expected.size());
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            EXPECT_EQ(packets[i].SortKey, expected[i].SortKey) << "at " << i;
+            EXPECT_EQ(packets[i].Item, expected[i].Item) << "at " << i;
+        }
+    }
+}
+
+TEST(BuildSortKey, FieldsOrderLayerThenPipelineStateThenMeshThenDepth)
+{
+    EXPECT_LT(BuildSortKey(RenderLayer::Opaque, 4095, 65535, 1000.0f), BuildSortKey(RenderLayer::Count, 0, 0, 0.0f));
+    EXPECT_LT(BuildSortKey(RenderLayer::Opaque, 1, 65535, 1000.0f), BuildSortKey(RenderLayer::Opaque, 2, 0, 0.0f));
+    EXPECT_LT(BuildSortKey(RenderLayer::Opaque, 1, 7, 1000.0f), BuildSortKey(RenderLayer::Opaque, 1, 8, 0.0f));
+    EXPECT_LT(BuildSortKey(RenderLayer::Opaque, 1, 7, 0.5f), BuildSortKey(RenderLayer::Opaque, 1, 7, 2.0f));
+}
+
+TEST(BuildSortKey, DepthBehindTheCameraSortsFirst)
+{
+    const uint64_t front = BuildSortKey(RenderLayer::Opaque, 3, 3, 0.0f);
+    EXPECT_EQ(BuildSortKey(RenderLayer::Opaque, 3, 3, -5.0f), front);
+    EXPECT_EQ(BuildSortKey(RenderLayer::Opaque, 3, 3, std::numeric_limits<float>::quiet_NaN()), front);
+    EXPECT_LT(front, BuildSortKey(RenderLayer::Opaque, 3, 3, std::numeric_limits<float>::denorm_min()));
+}
+
+TEST(BuildSortKey, FieldsAreMaskedToTheirWidth)
+{
+    EXPECT_EQ(BuildSortKey(RenderLayer::Opaque, 4096 + 5, 9, 1.0f), BuildSortKey(RenderLayer::Opaque, 5, 9, 1.0f));
+    EXPECT_EQ(BuildSortKey(RenderLayer::Opaque, 5, 65536 + 9, 1.0f), BuildSortKey(RenderLayer::Opaque, 5, 9, 1.0f));
+}
+
+TEST(RadixSortDrawPackets, MatchesStableSort)
+{
+    ExpectSameOrderAsStableSort(RandomPackets(10000, 16, 1024, 1));
+}
+
+TEST(RadixSortDrawPackets, ManyEqualKeysKeepTheirOrder)
+{
+    // Few distinct keys, the order of equal keys has to be the input order.
+    std::vector<DrawPacket> packets = RandomPackets(5000, 2, 3, 2);
+    for (DrawPacket& packet : packets)
+    {
+        packet.SortKey &= 0xFFFFFFFF00000000ull;
+    }
+    ExpectSameOrderAsStableSort(packets);
+}
+
+TEST(RadixSortDrawPackets, HandlesSkippedAndOddPassCounts)
+{
+    // Only the lowest digit differs: one pass, the result ends in scratch.
+    std::vector<DrawPacket> packets(300);
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        packets[i].SortKey = 0xABCD000000000000ull | ((i * 37) & 0xFF);
+        packets[i].Item = reinterpret_cast<RenderItem*>(static_cast<uintptr_t>(i + 1));
+    }
+    ExpectSameOrderAsStableSort(packets);
+
+    // Three digits differ.
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        packets[i].SortKey = ((i * 7919) & 0xFFFFFF) << 16;
+    }
+    ExpectSameOrderAsStableSort(packets);
+}
+
+TEST(RadixSortDrawPackets, EmptyAndSinglePacket)
+{
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> scratch;
+    RadixSortDrawPackets(packets, scratch);
+    EXPECT_TRUE(packets.empty());
+
+    packets.resize(1);
+    packets[0].SortKey = 42;
+    RadixSortDrawPackets(packets, scratch);
+    ASSERT_EQ(packets.size(), 1u);
+    EXPECT_EQ(packets[0].SortKey, 42u);
+}
+
+TEST(RadixSortDrawPackets, ScratchIsReusedAcrossCalls)
+{
+    std::vector<DrawPacket> scratch;
+    for (uint64_t seed = 0; seed < 8; seed++)
+    {
+        std::vector<DrawPacket> packets = RandomPackets(1000 + (uint32_t)seed * 97, 16, 64, seed);
+        std::vector<DrawPacket> expected = packets;
+        std::stable_sort(expected.begin(), expected.end(), [](const DrawPacket& a, const DrawPacket& b)
+        {
+            return a.SortKey < b.SortKey;
+        });
+        RadixSortDrawPackets(packets, scratch);
+        ASSERT_EQ(packets.size(), expected.size());
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            ASSERT_EQ(packets[i].Item, expected[i].Item);
+        }
+    }
+}
\ No newline at end of file
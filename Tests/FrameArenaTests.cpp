@@ -0,0 +1,146 @@
+#include "FrameArena.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace
+{
+    // allocationCount allocations, sized so the block does not pad them.
+    void RunFrame(FrameArena& arena, size_t allocationCount, size_t allocationSize)
+    {
+        for (size_t i = 0; i < allocationCount; i++)
+        {
+            void* memory = arena.allocate(allocationSize, 16);
+            ASSERT_NE(memory, nullptr);
+            // The memory is usable, the sanitizers catch a bad block.
+            static_cast<unsigned char*>(memory)[allocationSize - 1] = 1;
+        }
+    }
+
+    bool IsAligned(const void* memory, size_t alignment)
+    {
+        return reinterpret_cast<uintptr_t>(memory) % alignment == 0;
+    }
+}
+
+TEST(FrameArenaTests, AllocationsInTheBlockDoNotFallBack)
+{
+    FrameArena arena(1024);
+    RunFrame(arena, 4, 256);
+    EXPECT_EQ(arena.Used(), 1024u);
+    EXPECT_EQ(arena.OverflowCount(), 0u);
+    arena.Reset();
+    EXPECT_EQ(arena.Used(), 0u);
+    EXPECT_EQ(arena.LastPeak(), 1024u);
+    EXPECT_EQ(arena.Capacity(), 1024u);
+}
+
+TEST(FrameArenaTests, OversizedFrameGrowsTheBlockToThePeak)
+{
+    FrameArena arena(1024);
+    RunFrame(arena, 10, 256);
+    // 4 fit, the others fell back to the heap and count as used.
+    EXPECT_EQ(arena.OverflowCount(), 6u);
+    EXPECT_EQ(arena.Used(), 2560u);
+
+    arena.Reset();
+    EXPECT_EQ(arena.LastPeak(), 2560u);
+    EXPECT_GE(arena.Capacity(), 2560u);
+
+    // The same workload now fits, every frame after the first.
+    for (int frame = 0; frame < 3; frame++)
+    {
+        RunFrame(arena, 10, 256);
+        EXPECT_EQ(arena.OverflowCount(), 6u) << "frame " << frame;
+        arena.Reset();
+        EXPECT_EQ(arena.LastPeak(), 2560u) << "frame " << frame;
+    }
+}
+
+TEST(FrameArenaTests, ArenaWithoutABlockFallsBack)
+{
+    FrameArena arena(0);
+    RunFrame(arena, 2, 64);
+    EXPECT_EQ(arena.OverflowCount(), 2u);
+    arena.Reset();
+    EXPECT_EQ(arena.LastPeak(), 128u);
+    RunFrame(arena, 2, 64);
+    EXPECT_EQ(arena.OverflowCount(), 2u);
+}
+
+TEST(FrameArenaTests, AllocationsAreAligned)
+{
+    FrameArena arena(4096);
+    for (size_t alignment : { 1, 2, 4, 8, 16, 32, 64, 256 })
+    {
+        // An odd size first, the next allocation needs padding.
+        void* odd = arena.allocate(3, 1);
+        void* aligned = arena.allocate(24, alignment);
+        EXPECT_TRUE(IsAligned(aligned, alignment)) << alignment;
+        EXPECT_GE(static_cast<unsigned char*>(aligned), static_cast<unsigned char*>(odd) + 3);
+    }
+    // Heap fallbacks are aligned too.
+    void* overflow = arena.allocate(8192, 128);
+    EXPECT_TRUE(IsAligned(overflow, 128));
+    EXPECT_EQ(arena.OverflowCount(), 1u);
+}
+
+TEST(FrameArenaTests, RewindFreesWhatFollowsTheMarker)
+{
+    FrameArena arena(1024);
+    RunFrame(arena, 1, 128);
+    FrameArena::Marker marker = arena.Mark();
+    RunFrame(arena, 1, 512);
+    RunFrame(arena, 1, 2048);
+    EXPECT_EQ(arena.Used(), 128u + 512u + 2048u);
+
+    arena.Rewind(marker);
+    EXPECT_EQ(arena.Used(), 128u);
+    // The memory after the marker is handed out again.
+    RunFrame(arena, 1, 512);
+    EXPECT_EQ(arena.Used(), 640u);
+
+    // The peak of the frame is kept across the rewind.
+    arena.Reset();
+    EXPECT_EQ(arena.LastPeak(), 128u + 512u + 2048u);
+}
+
+TEST(FrameArenaTests, ContainersUseItThroughPmr)
+{
+    FrameArena arena(64 * 1024);
+    for (int frame = 0; frame < 3; frame++)
+    {
+        {
+            std::pmr::vector<uint32_t> visible(&arena);
+            visible.reserve(1000);
+            for (uint32_t i = 0; i < 1000; i++)
+            {
+                visible.push_back(i);
+            }
+            EXPECT_EQ(visible[999], 999u);
+        }
+        EXPECT_EQ(arena.Used(), 1000 * sizeof(uint32_t));
+        arena.Reset();
+    }
+    EXPECT_EQ(arena.OverflowCount(), 0u);
+}
+
+TEST(FrameArenaTests, ScratchScopesNest)
+{
+    FrameArena& scratch = ThreadScratchArena();
+    {
+        ScratchScope outer;
+        EXPECT_NE(outer.Resource()->allocate(64, 16), nullptr);
+        size_t used = scratch.Used();
+        {
+            ScratchScope inner;
+            EXPECT_NE(inner.Resource()->allocate(256, 16), nullptr);
+            EXPECT_EQ(scratch.Used(), used + 256);
+        }
+        EXPECT_EQ(scratch.Used(), used);
+    }
+    // The outermost scope reset the arena.
+    EXPECT_EQ(scratch.Used(), 0u);
+    EXPECT_EQ(scratch.LastPeak(), 64u + 256u);
+}
\ No newline at end of file
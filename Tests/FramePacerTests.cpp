@@ -0,0 +1,223 @@
+#include "FramePacer.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace
+{
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+    // The frame loop of the app against a simulated GPU, on a simulated clock.
+    // The CPU builds a frame in cpuMs, the GPU runs the frames in submission
+    // order in gpuMs each; frame N completes with fence value N + 1.
+    class PacedLoop
+    {
+    public:
+        PacedLoop(uint32_t maxFramesInFlight, double cpuMs, double gpuMs) :
+            Pacer(maxFramesInFlight, [this]() { return m_now; }),
+            m_cpuMs(cpuMs),
+            m_gpuMs(gpuMs)
+        {
+        }
+
+        void Run(int frameCount)
+        {
+            for (int i = 0; i < frameCount; i++)
+            {
+                uint64_t frame = Pacer.BeginFrame();
+
+                // Blocks on the fence like D3DAppBase, polling it afterwards.
+                uint64_t fenceValue = Pacer.FenceToWaitFor(frame);
+                FramePacer::Clock::time_point waitStart = m_now;
+                if (fenceValue > 0)
+                {
+                    m_now = (std::max)(m_now, m_gpuDone[fenceValue - 1]);
+                }
+                Pacer.OnFenceCompleted(CompletedFenceValue());
+                Milliseconds sleep = Pacer.EndWait(frame, m_now - waitStart);
+                Advance(sleep.count());
+                Sleeps.push_back(sleep.count());
+
+                Advance(m_cpuMs);
+                FramePacer::Clock::time_point gpuStart = m_gpuDone.empty() ? m_now : (std::max)(m_now, m_gpuDone.back());
+                m_gpuDone.push_back(gpuStart + ToDuration(m_gpuMs));
+                Pacer.OnFrameSubmitted(frame, frame + 1);
+                Pacer.OnFenceCompleted(CompletedFenceValue());
+            }
+        }
+
+        FramePacer Pacer;
+        std::vector<double> Sleeps;
+
+    private:
+        static FramePacer::Clock::duration ToDuration(double milliseconds)
+        {
+            return std::chrono::duration_cast<FramePacer::Clock::duration>(Milliseconds(milliseconds));
+        }
+
+        void Advance(double milliseconds)
+        {
+            m_now += ToDuration(milliseconds);
+        }
+
+        uint64_t CompletedFenceValue()const
+        {
+            uint64_t value = 0;
+            while (value < m_gpuDone.size() && m_gpuDone[value] <= m_now)
+            {
+                value++;
+            }
+            return value;
+        }
+
+        FramePacer::Clock::time_point m_now;
+        double m_cpuMs;
+        double m_gpuMs;
+        std::vector<FramePacer::Clock::time_point> m_gpuDone;
+    };
+}
+
+TEST(FramePacerTests, FramesWaitForTheFrameThatFreesTheirResources)
+{
+    FramePacer pacer(3);
+    pacer.SetAdaptive(false);
+    for (uint64_t frame = 0; frame < 8; frame++)
+    {
+        EXPECT_EQ(pacer.BeginFrame(), frame);
+        // The first frames have free resources.
+        EXPECT_EQ(pacer.FenceToWaitFor(frame), frame < 3 ? 0u : frame - 3 + 100);
+        pacer.OnFrameSubmitted(frame, frame + 100);
+    }
+}
+
+TEST(FramePacerTests, SetFramesInFlightIsClamped)
+{
+    FramePacer pacer(3);
+    pacer.SetFramesInFlight(0);
+    EXPECT_EQ(pacer.Stats().FramesInFlight, 1u);
+    pacer.SetFramesInFlight(10);
+    EXPECT_EQ(pacer.Stats().FramesInFlight, 3u);
+    pacer.SetFramesInFlight(2);
+    EXPECT_EQ(pacer.Stats().FramesInFlight, 2u);
+
+    pacer.SetAdaptive(false);
+    for (uint64_t frame = 0; frame < 4; frame++)
+    {
+        pacer.BeginFrame();
+        EXPECT_EQ(pacer.FenceToWaitFor(frame), frame < 2 ? 0u : frame - 1);
+        pacer.OnFrameSubmitted(frame, frame + 1);
+    }
+}
+
+TEST(FramePacerTests, ClosingReleasesTheWaitForAnUnsubmittedFrame)
+{
+    FramePacer pacer(1);
+    pacer.BeginFrame();
+    pacer.Close();
+    // Frame 0 was never submitted, frame 1 would wait for it forever.
+    EXPECT_EQ(pacer.FenceToWaitFor(1), 0u);
+}
+
+TEST(FramePacerTests, LimiterSpacesTheFramesByTheTarget)
+{
+    PacedLoop loop(2, 4.0, 4.0);
+    loop.Pacer.SetAdaptive(false);
+    loop.Pacer.SetFrameTimeTarget(16.0);
+    loop.Run(100);
+
+    // 4 ms of work, the rest of the 16 ms is slept.
+    EXPECT_EQ(loop.Sleeps[0], 0.0);
+    EXPECT_NEAR(loop.Sleeps.back(), 12.0, 0.01);
+    FramePacingStats stats = loop.Pacer.Stats();
+    EXPECT_NEAR(stats.FrameMs, 16.0, 0.01);
+    EXPECT_NEAR(stats.CpuWaitMs, 0.0, 0.01);
+}
+
+TEST(FramePacerTests, LatencyPolicyShrinksTheDepthUnderTheTarget)
+{
+    // GPU bound: every queued frame adds a GPU frame of latency.
+    PacedLoop loop(3, 4.0, 16.0);
+    loop.Pacer.SetPolicy(PacingPolicy::Latency);
+    loop.Pacer.SetLatencyTarget(20.0);
+    loop.Run(60);
+    double queuedLatency = loop.Pacer.Stats().GpuLatencyMs;
+    EXPECT_GT(queuedLatency, 20.0);
+
+    loop.Run(300);
+    FramePacingStats stats = loop.Pacer.Stats();
+    EXPECT_EQ(stats.FramesInFlight, 1u);
+    EXPECT_LE(stats.GpuLatencyMs, 20.0);
+    EXPECT_LT(stats.GpuLatencyMs, queuedLatency);
+}
+
+TEST(FramePacerTests, LatencyPolicyBuysThroughputBackWithSpareBudget)
+{
+    // Serial CPU and GPU at one frame in flight, the CPU stalls half the frame.
+    PacedLoop loop(3, 10.0, 10.0);
+    loop.Pacer.SetPolicy(PacingPolicy::Latency);
+    loop.Pacer.SetLatencyTarget(100.0);
+    loop.Pacer.SetFramesInFlight(1);
+    loop.Run(300);
+
+    FramePacingStats stats = loop.Pacer.Stats();
+    EXPECT_GT(stats.FramesInFlight, 1u);
+    EXPECT_NEAR(stats.FrameMs, 10.0, 0.5);
+    EXPECT_LT(stats.GpuLatencyMs, 50.0);
+}
+
+TEST(FramePacerTests, ThroughputPolicyGrowsTheDepthToMeetTheTarget)
+{
+    // 30 ms a frame with the CPU and the GPU taking turns, 15 ms overlapped.
+    PacedLoop loop(3, 15.0, 15.0);
+    loop.Pacer.SetPolicy(PacingPolicy::Throughput);
+    loop.Pacer.SetFrameTimeTarget(16.0);
+    loop.Pacer.SetFramesInFlight(1);
+    // Up to the first adaptation.
+    loop.Run(29);
+    EXPECT_EQ(loop.Pacer.Stats().FramesInFlight, 1u);
+    EXPECT_GT(loop.Pacer.Stats().FrameMs, 16.0 * 1.05);
+
+    loop.Run(300);
+    FramePacingStats stats = loop.Pacer.Stats();
+    EXPECT_GE(stats.FramesInFlight, 2u);
+    EXPECT_NEAR(stats.FrameMs, 16.0, 0.5);
+    EXPECT_LT(stats.CpuWaitMs, 0.1 * stats.FrameMs);
+}
+
+TEST(FramePacerTests, ThroughputPolicyWithoutATargetRunsAtFullDepth)
+{
+    PacedLoop loop(3, 5.0, 10.0);
+    loop.Pacer.SetPolicy(PacingPolicy::Throughput);
+    loop.Pacer.SetFramesInFlight(1);
+    loop.Run(60);
+
+    FramePacingStats stats = loop.Pacer.Stats();
+    EXPECT_EQ(stats.FramesInFlight, 3u);
+    // Nothing to limit to, the loop never sleeps.
+    EXPECT_EQ(*std::max_element(loop.Sleeps.begin(), loop.Sleeps.end()), 0.0);
+    EXPECT_NEAR(stats.FrameMs, 10.0, 0.5);
+}
+
+TEST(FramePacerTests, ThroughputPolicyGivesSpareDepthBack)
+{
+    // Either side alone fits the target, one frame in flight is enough.
+    PacedLoop loop(3, 5.0, 5.0);
+    loop.Pacer.SetPolicy(PacingPolicy::Throughput);
+    loop.Pacer.SetFrameTimeTarget(16.0);
+    loop.Run(300);
+
+    FramePacingStats stats = loop.Pacer.Stats();
+    EXPECT_EQ(stats.FramesInFlight, 1u);
+    EXPECT_NEAR(stats.FrameMs, 16.0, 0.5);
+}
+
+TEST(FramePacerTests, FixedDepthDoesNotAdapt)
+{
+    PacedLoop loop(3, 4.0, 16.0);
+    loop.Pacer.SetPolicy(PacingPolicy::Latency);
+    loop.Pacer.SetLatencyTarget(20.0);
+    loop.Pacer.SetAdaptive(false);
+    loop.Run(300);
+    EXPECT_EQ(loop.Pacer.Stats().FramesInFlight, 3u);
+}
\ No newline at end of file
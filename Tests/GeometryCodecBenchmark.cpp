@@ -0,0 +1,92 @@
+#include "GeometryCodec.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Decode throughput of the mesh file streams, in bytes of decoded output per
+// second. Not a test: run it by hand on a release build.
+namespace
+{
+    const uint32_t GridWidth = 1024;
+    const uint32_t GridDepth = 1024;
+    const int Repetitions = 20;
+
+    template<typename Decode>
+    double BestSeconds(Decode decode)
+    {
+        double best = 1e30;
+        for (int i = 0; i < Repetitions; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            decode();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = (std::min)(best, elapsed.count());
+        }
+        return best;
+    }
+}
+
+int main()
+{
+    std::vector<PositionColorVertex> vertices;
+    for (uint32_t z = 0; z < GridDepth; z++)
+    {
+        for (uint32_t x = 0; x < GridWidth; x++)
+        {
+            PositionColorVertex vertex;
+            vertex.Position[0] = (float)x;
+            vertex.Position[1] = std::sin(0.05f * x) * std::cos(0.05f * z);
+            vertex.Position[2] = (float)z;
+            vertex.Color[0] = (float)x / GridWidth;
+            vertex.Color[1] = 0.5f;
+            vertex.Color[2] = (float)z / GridDepth;
+            vertex.Color[3] = 1.0f;
+            vertices.push_back(vertex);
+        }
+    }
+    std::vector<uint32_t> indices;
+    for (uint32_t z = 0; z + 1 < GridDepth; z++)
+    {
+        for (uint32_t x = 0; x + 1 < GridWidth; x++)
+        {
+            uint32_t corner = z * GridWidth + x;
+            uint32_t triangles[6] = { corner, corner + 1, corner + GridWidth, corner + GridWidth, corner + 1, corner + GridWidth + 1 };
+            indices.insert(indices.end(), triangles, triangles + 6);
+        }
+    }
+
+    std::vector<QuantizedPositionColorVertex> quantized(vertices.size());
+    QuantizationBounds bounds = QuantizePositionColor(vertices.data(), vertices.size(), quantized.data());
+    const uint32_t stride = sizeof(QuantizedPositionColorVertex);
+    std::vector<uint8_t> vertexStream;
+    EncodeVertexStream(quantized.data(), quantized.size(), stride, vertexStream);
+    std::vector<uint8_t> indexStream;
+    EncodeIndexStream(indices.data(), indices.size(), 4, indexStream);
+
+    std::vector<QuantizedPositionColorVertex> decodedVertices(quantized.size());
+    double vertexSeconds = BestSeconds([&]()
+    {
+        DecodeVertexStream(decodedVertices.data(), decodedVertices.size(), stride, vertexStream.data(), vertexStream.size());
+    });
+    std::vector<uint32_t> decodedIndices(indices.size());
+    double indexSeconds = BestSeconds([&]()
+    {
+        DecodeIndexStream(decodedIndices.data(), decodedIndices.size(), 4, indexStream.data(), indexStream.size());
+    });
+    std::vector<PositionColorVertex> restored(vertices.size());
+    double dequantizeSeconds = BestSeconds([&]()
+    {
+        DequantizePositionColor(decodedVertices.data(), decodedVertices.size(), bounds, restored.data());
+    });
+
+    double vertexBytes = (double)quantized.size() * stride;
+    double indexBytes = (double)indices.size() * 4;
+    printf("Vertices: %zu, %.1f MB -> %.1f MB, decode %.2f GB/s\n", quantized.size(),
+        vertexBytes / 1e6, vertexStream.size() / 1e6, vertexBytes / vertexSeconds / 1e9);
+    printf("Indices: %zu, %.1f MB -> %.1f MB, decode %.2f GB/s\n", indices.size(),
+        indexBytes / 1e6, indexStream.size() / 1e6, indexBytes / indexSeconds / 1e9);
+    printf("Dequantize: %.2f GB/s\n", (double)restored.size() * sizeof(PositionColorVertex) / dequantizeSeconds / 1e9);
+    return 0;
+}
\ No newline at end of file
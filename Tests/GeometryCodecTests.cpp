@@ -0,0 +1,243 @@
+#include "GeometryCodec.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // Built with and without SSE2, the tests check both decoders against the encoder.
+    const uint8_t Guard = 0xCD;
+    const size_t GuardSize = 64;
+
+    // Triangle list of a width x depth grid, what the shapes look like.
+    std::vector<uint32_t> GridIndices(uint32_t width, uint32_t depth)
+    {
+        std::vector<uint32_t> indices;
+        for (uint32_t z = 0; z + 1 < depth; z++)
+        {
+            for (uint32_t x = 0; x + 1 < width; x++)
+            {
+                uint32_t corner = z * width + x;
+                uint32_t triangles[6] = { corner, corner + 1, corner + width, corner + width, corner + 1, corner + width + 1 };
+                indices.insert(indices.end(), triangles, triangles + 6);
+            }
+        }
+        return indices;
+    }
+
+    std::vector<PositionColorVertex> GridVertices(uint32_t width, uint32_t depth)
+    {
+        std::vector<PositionColorVertex> vertices;
+        for (uint32_t z = 0; z < depth; z++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                PositionColorVertex vertex;
+                vertex.Position[0] = (float)x * 0.5f - 10.0f;
+                vertex.Position[1] = 0.3f * std::sin(0.2f * x) * std::cos(0.3f * z);
+                vertex.Position[2] = (float)z * 0.5f - 15.0f;
+                vertex.Color[0] = (float)x / width;
+                vertex.Color[1] = 0.5f;
+                vertex.Color[2] = (float)z / depth;
+                vertex.Color[3] = 1.0f;
+                vertices.push_back(vertex);
+            }
+        }
+        return vertices;
+    }
+
+    std::vector<uint8_t> RandomBytes(size_t size, uint32_t seed)
+    {
+        std::mt19937 generator(seed);
+        std::vector<uint8_t> bytes(size);
+        for (uint8_t& byte : bytes)
+        {
+            byte = (uint8_t)generator();
+        }
+        return bytes;
+    }
+
+    // Packs 32-bit indices to indexSize bytes each.
+    std::vector<uint8_t> PackIndices(const std::vector<uint32_t>& indices, uint32_t indexSize)
+    {
+        std::vector<uint8_t> packed(indices.size() * indexSize);
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            if (indexSize == 2)
+            {
+                uint16_t index = (uint16_t)indices[i];
+                memcpy(&packed[i * 2], &index, 2);
+            }
+            else
+            {
+                memcpy(&packed[i * 4], &indices[i], 4);
+            }
+        }
+        return packed;
+    }
+
+    void ExpectIndexRoundTrip(const std::vector<uint32_t>& indices, uint32_t indexSize)
+    {
+        std::vector<uint8_t> packed = PackIndices(indices, indexSize);
+        std::vector<uint8_t> encoded;
+        EncodeIndexStream(packed.data(), indices.size(), indexSize, encoded);
+        ASSERT_TRUE(ValidateIndexStream(encoded.data(), encoded.size(), indices.size()));
+
+        std::vector<uint8_t> decoded(packed.size() + GuardSize, Guard);
+        ASSERT_TRUE(DecodeIndexStream(decoded.data(), indices.size(), indexSize, encoded.data(), encoded.size()));
+        EXPECT_TRUE(std::equal(packed.begin(), packed.end(), decoded.begin()));
+        for (size_t i = packed.size(); i < decoded.size(); i++)
+        {
+            ASSERT_EQ(decoded[i], Guard) << "written past the indices";
+        }
+    }
+
+    void ExpectVertexRoundTrip(const std::vector<uint8_t>& vertices, size_t vertexCount, uint32_t vertexStride)
+    {
+        std::vector<uint8_t> encoded;
+        EncodeVertexStream(vertices.data(), vertexCount, vertexStride, encoded);
+        ASSERT_TRUE(ValidateVertexStream(encoded.data(), encoded.size(), vertexCount, vertexStride));
+
+        std::vector<uint8_t> decoded(vertexCount * vertexStride + GuardSize, Guard);
+        ASSERT_TRUE(DecodeVertexStream(decoded.data(), vertexCount, vertexStride, encoded.data(), encoded.size()));
+        EXPECT_TRUE(std::equal(vertices.begin(), vertices.end(), decoded.begin()));
+        for (size_t i = vertexCount * vertexStride; i < decoded.size(); i++)
+        {
+            ASSERT_EQ(decoded[i], Guard) << "written past the vertices";
+        }
+    }
+}
+
+TEST(GeometryCodecTests, GridIndicesRoundTrip)
+{
+    std::vector<uint32_t> indices = GridIndices(61, 41);
+    ExpectIndexRoundTrip(indices, 2);
+    ExpectIndexRoundTrip(indices, 4);
+
+    // Nearly every difference fits in a byte.
+    std::vector<uint8_t> encoded;
+    EncodeIndexStream(PackIndices(indices, 4).data(), indices.size(), 4, encoded);
+    EXPECT_LT(encoded.size(), indices.size() * 11 / 10);
+}
+
+TEST(GeometryCodecTests, IndicesOfEveryRangeRoundTrip)
+{
+    std::mt19937 generator(7);
+    for (size_t count : { 0, 1, 15, 16, 17, 31, 33, 1000 })
+    {
+        SCOPED_TRACE(count);
+        std::vector<uint32_t> small(count);
+        std::vector<uint32_t> large(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            small[i] = generator() % 40000;
+            // Extremes: the largest differences either way.
+            large[i] = (i % 3 == 0) ? 0xFFFFFFFFu : (i % 3 == 1) ? 0u : generator();
+        }
+        ExpectIndexRoundTrip(small, 2);
+        ExpectIndexRoundTrip(small, 4);
+        ExpectIndexRoundTrip(large, 4);
+    }
+}
+
+TEST(GeometryCodecTests, DamagedIndexStreamsAreRejected)
+{
+    std::vector<uint32_t> indices = GridIndices(9, 9);
+    std::vector<uint8_t> packed = PackIndices(indices, 4);
+    std::vector<uint8_t> encoded;
+    EncodeIndexStream(packed.data(), indices.size(), 4, encoded);
+    std::vector<uint8_t> decoded(packed.size());
+
+    for (size_t size = 0; size < encoded.size(); size++)
+    {
+        EXPECT_FALSE(ValidateIndexStream(encoded.data(), size, indices.size())) << size;
+        EXPECT_FALSE(DecodeIndexStream(decoded.data(), indices.size(), 4, encoded.data(), size)) << size;
+    }
+    std::vector<uint8_t> trailing = encoded;
+    trailing.push_back(0);
+    EXPECT_FALSE(ValidateIndexStream(trailing.data(), trailing.size(), indices.size()));
+    EXPECT_FALSE(DecodeIndexStream(decoded.data(), indices.size(), 4, trailing.data(), trailing.size()));
+
+    // Longer than any 32-bit varint.
+    const uint8_t overlong[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 };
+    EXPECT_FALSE(ValidateIndexStream(overlong, sizeof(overlong), 1));
+    EXPECT_FALSE(DecodeIndexStream(decoded.data(), 1, 4, overlong, sizeof(overlong)));
+    EXPECT_FALSE(DecodeIndexStream(decoded.data(), 1, 3, encoded.data(), encoded.size()));
+}
+
+TEST(GeometryCodecTests, VerticesOfEveryStrideAndCountRoundTrip)
+{
+    for (uint32_t stride : { 1u, 4u, 12u, 28u, 33u, VertexCodecMaxStride })
+    {
+        for (size_t count : { 0, 1, 15, 16, 17, 255, 256, 257, 700 })
+        {
+            SCOPED_TRACE(testing::Message() << "stride " << stride << ", count " << count);
+            ExpectVertexRoundTrip(RandomBytes(count * stride, (uint32_t)(stride * 1000 + count)), count, stride);
+
+            // Slowly changing bytes exercise the 2 and 4 bit groups.
+            std::vector<uint8_t> smooth(count * stride);
+            for (size_t i = 0; i < smooth.size(); i++)
+            {
+                size_t vertex = i / stride;
+                smooth[i] = (uint8_t)(vertex * (i % stride % 5) / 3 + (vertex % 7 == 0 ? 9 : 0));
+            }
+            ExpectVertexRoundTrip(smooth, count, stride);
+        }
+    }
+}
+
+TEST(GeometryCodecTests, DamagedVertexStreamsAreRejected)
+{
+    const size_t count = 300;
+    const uint32_t stride = 12;
+    std::vector<uint8_t> vertices = RandomBytes(count * stride, 3);
+    std::vector<uint8_t> encoded;
+    EncodeVertexStream(vertices.data(), count, stride, encoded);
+
+    std::vector<uint8_t> decoded(count * stride + GuardSize, Guard);
+    for (size_t size = 0; size < encoded.size(); size++)
+    {
+        EXPECT_FALSE(ValidateVertexStream(encoded.data(), size, count, stride)) << size;
+        EXPECT_FALSE(DecodeVertexStream(decoded.data(), count, stride, encoded.data(), size)) << size;
+    }
+    for (size_t i = count * stride; i < decoded.size(); i++)
+    {
+        ASSERT_EQ(decoded[i], Guard) << "written past the vertices";
+    }
+    std::vector<uint8_t> trailing = encoded;
+    trailing.push_back(0);
+    EXPECT_FALSE(ValidateVertexStream(trailing.data(), trailing.size(), count, stride));
+}
+
+TEST(GeometryCodecTests, QuantizedGridCompressesAndRoundTrips)
+{
+    std::vector<PositionColorVertex> vertices = GridVertices(61, 41);
+    std::vector<QuantizedPositionColorVertex> quantized(vertices.size());
+    QuantizationBounds bounds = QuantizePositionColor(vertices.data(), vertices.size(), quantized.data());
+
+    std::vector<uint8_t> encoded;
+    EncodeVertexStream(quantized.data(), quantized.size(), sizeof(QuantizedPositionColorVertex), encoded);
+    std::vector<QuantizedPositionColorVertex> decoded(quantized.size());
+    ASSERT_TRUE(DecodeVertexStream(decoded.data(), decoded.size(), sizeof(QuantizedPositionColorVertex),
+        encoded.data(), encoded.size()));
+    EXPECT_EQ(memcmp(decoded.data(), quantized.data(), quantized.size() * sizeof(QuantizedPositionColorVertex)), 0);
+    EXPECT_LT(encoded.size() * 4, vertices.size() * sizeof(PositionColorVertex));
+
+    // Half a quantization step on the positions, half an 8-bit step on the colors.
+    std::vector<PositionColorVertex> restored(vertices.size());
+    DequantizePositionColor(decoded.data(), decoded.size(), bounds, restored.data());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            EXPECT_NEAR(restored[i].Position[c], vertices[i].Position[c], bounds.Scale[c] * 0.5f + 1e-5f) << i;
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            EXPECT_NEAR(restored[i].Color[c], vertices[i].Color[c], 0.5f / 255.0f + 1e-6f) << i;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "IndirectPackingTypes.h"
+#include <gtest/gtest.h>
+#include <memory>
+
+namespace
+{
+    using namespace IndirectPackingTypes;
+
+    const uint64_t ObjectConstantAddress = 0x10000;
+    // A constant buffer view is 256 byte aligned.
+    const uint64_t ObjectConstantStride = 256;
+
+    // Items and packets of a sorted frame, the packing only reads them.
+    class IndirectFrame
+    {
+    public:
+        DrawItem* Add(Geometry* geo, uint32_t pipelineStateIndex, Topology topology = Topology::TriangleList)
+        {
+            auto item = std::make_unique<DrawItem>();
+            uint32_t index = (uint32_t)Items.size();
+            item->Geo = geo;
+            item->PipelineStateIndex = pipelineStateIndex;
+            item->PrimitiveType = topology;
+            item->ObjectConstantBufferIndex = 10 + index;
+            item->IndexCount = 3 * (index + 1);
+            item->StartIndexLocation = 6 * index;
+            item->BaseVertexLocation = index + 2;
+            item->Bounds.Center = { (float)index, 1.0f, 2.0f };
+            item->Bounds.Extents = { 0.5f, 0.25f, (float)index };
+
+            Packet packet;
+            packet.Item = item.get();
+            Packets.push_back(packet);
+            Items.push_back(std::move(item));
+            return Items.back().get();
+        }
+
+        void Pack(std::vector<Command>& arguments, std::vector<Instance>* instances = nullptr)
+        {
+            arguments.resize(Packets.size());
+            if (instances != nullptr)
+            {
+                instances->resize(Packets.size());
+            }
+            PackIndirectCommands(Packets, ObjectConstantAddress, ObjectConstantStride, arguments.data(),
+                (instances != nullptr) ? instances->data() : nullptr, Runs);
+        }
+
+        Geometry Geometries[2];
+        std::vector<std::unique_ptr<DrawItem>> Items;
+        std::vector<Packet> Packets;
+        std::vector<Run> Runs;
+    };
+}
+
+TEST(IndirectPacking, SplitsRunsOnPipelineStateGeometryAndTopology)
+{
+    IndirectFrame frame;
+    frame.Add(&frame.Geometries[0], 1);
+    frame.Add(&frame.Geometries[0], 1);
+    frame.Add(&frame.Geometries[0], 2);
+    frame.Add(&frame.Geometries[1], 2);
+    frame.Add(&frame.Geometries[1], 2);
+    frame.Add(&frame.Geometries[1], 2, Topology::LineList);
+
+    std::vector<Command> arguments;
+    frame.Pack(arguments);
+
+    ASSERT_EQ(frame.Runs.size(), 4u);
+    const uint32_t expectedFirst[] = { 0, 2, 3, 5 };
+    const uint32_t expectedCount[] = { 2, 1, 2, 1 };
+    const uint32_t expectedPipelineState[] = { 1, 2, 2, 2 };
+    for (size_t i = 0; i < frame.Runs.size(); i++)
+    {
+        EXPECT_EQ(frame.Runs[i].FirstCommand, expectedFirst[i]) << "run " << i;
+        EXPECT_EQ(frame.Runs[i].CommandCount, expectedCount[i]) << "run " << i;
+        EXPECT_EQ(frame.Runs[i].PipelineStateIndex, expectedPipelineState[i]) << "run " << i;
+        EXPECT_EQ(frame.Runs[i].Item, frame.Items[expectedFirst[i]].get()) << "run " << i;
+    }
+}
+
+TEST(IndirectPacking, WritesOneDrawPerPacket)
+{
+    IndirectFrame frame;
+    for (int i = 0; i < 5; i++)
+    {
+        frame.Add(&frame.Geometries[i % 2], 0);
+    }
+
+    std::vector<Command> arguments;
+    frame.Pack(arguments);
+
+    for (size_t i = 0; i < arguments.size(); i++)
+    {
+        const DrawItem* ri = frame.Items[i].get();
+        const Command& command = arguments[i];
+        EXPECT_EQ(command.ObjectConstantBuffer, ObjectConstantAddress + ri->ObjectConstantBufferIndex * ObjectConstantStride);
+        EXPECT_EQ(command.DrawArguments.IndexCountPerInstance, ri->IndexCount);
+        EXPECT_EQ(command.DrawArguments.InstanceCount, 1u);
+        EXPECT_EQ(command.DrawArguments.StartIndexLocation, ri->StartIndexLocation);
+        EXPECT_EQ(command.DrawArguments.BaseVertexLocation, ri->BaseVertexLocation);
+        EXPECT_EQ(command.DrawArguments.StartInstanceLocation, 0u);
+    }
+    // The geometry alternates, every packet starts a run.
+    EXPECT_EQ(frame.Runs.size(), arguments.size());
+}
+
+TEST(IndirectPacking, WritesTheCullingInputOfEveryCommand)
+{
+    IndirectFrame frame;
+    frame.Add(&frame.Geometries[0], 0);
+    frame.Add(&frame.Geometries[0], 0);
+    frame.Add(&frame.Geometries[1], 0);
+
+    std::vector<Command> arguments;
+    std::vector<Instance> instances;
+    frame.Pack(arguments, &instances);
+
+    const uint32_t expectedRun[] = { 0, 0, 1 };
+    const uint32_t expectedRunFirst[] = { 0, 0, 2 };
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        const DrawItem* ri = frame.Items[i].get();
+        EXPECT_EQ(instances[i].Center.x, ri->Bounds.Center.x);
+        EXPECT_EQ(instances[i].Center.y, ri->Bounds.Center.y);
+        EXPECT_EQ(instances[i].Center.z, ri->Bounds.Center.z);
+        EXPECT_EQ(instances[i].Extents.x, ri->Bounds.Extents.x);
+        EXPECT_EQ(instances[i].Extents.y, ri->Bounds.Extents.y);
+        EXPECT_EQ(instances[i].Extents.z, ri->Bounds.Extents.z);
+        EXPECT_EQ(instances[i].RunIndex, expectedRun[i]);
+        EXPECT_EQ(instances[i].RunFirstCommand, expectedRunFirst[i]);
+    }
+}
+
+TEST(IndirectPacking, RepackStartsFromNoRuns)
+{
+    IndirectFrame frame;
+    frame.Add(&frame.Geometries[0], 0);
+    std::vector<Command> arguments;
+    frame.Pack(arguments);
+    frame.Pack(arguments);
+    ASSERT_EQ(frame.Runs.size(), 1u);
+    EXPECT_EQ(frame.Runs[0].CommandCount, 1u);
+
+    PackIndirectCommands(std::vector<Packet>(), ObjectConstantAddress, ObjectConstantStride,
+        arguments.data(), (Instance*)nullptr, frame.Runs);
+    EXPECT_TRUE(frame.Runs.empty());
+}
+
+#ifndef NDEBUG
+TEST(IndirectPackingDeathTest, RangesPastTheIndexBufferAssert)
+{
+    IndirectFrame frame;
+    frame.Geometries[0].IndexSize = 4;
+    frame.Geometries[0].IndexBufferByteSize = 32;
+    // 3 indices from 0 fit in 8 32-bit indices, 6 from 6 do not.
+    frame.Add(&frame.Geometries[0], 0);
+    frame.Add(&frame.Geometries[0], 0);
+    std::vector<Command> arguments;
+    EXPECT_DEATH(frame.Pack(arguments), "");
+}
+#endif
\ No newline at end of file
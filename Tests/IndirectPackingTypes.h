@@ -0,0 +1,78 @@
+#pragma once
+#include "IndirectPacking.h"
+
+// Laid out like the DirectXMath, D3DAppUtil.h and RenderItem.h types the app
+// packs, shared by the tests and the benchmark.
+namespace IndirectPackingTypes
+{
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    enum class Topology
+    {
+        TriangleList,
+        LineList
+    };
+
+    struct Geometry
+    {
+        uint32_t IndexSize = 2;
+        uint32_t IndexBufferByteSize = 4096;
+    };
+
+    inline uint32_t IndexByteSize(const Geometry& geometry)
+    {
+        return geometry.IndexSize;
+    }
+
+    struct Box
+    {
+        Float3 Center;
+        Float3 Extents;
+    };
+
+    struct DrawItem
+    {
+        Geometry* Geo = nullptr;
+        uint32_t PipelineStateIndex = 0;
+        Topology PrimitiveType = Topology::TriangleList;
+        uint32_t ObjectConstantBufferIndex = 0;
+        uint32_t IndexCount = 0;
+        uint32_t StartIndexLocation = 0;
+        int32_t BaseVertexLocation = 0;
+        Box Bounds;
+    };
+
+    struct Packet
+    {
+        uint64_t SortKey = 0;
+        DrawItem* Item = nullptr;
+    };
+
+    struct DrawIndexedArguments
+    {
+        uint32_t IndexCountPerInstance;
+        uint32_t InstanceCount;
+        uint32_t StartIndexLocation;
+        int32_t BaseVertexLocation;
+        uint32_t StartInstanceLocation;
+    };
+
+    struct Command
+    {
+        uint64_t ObjectConstantBuffer;
+        DrawIndexedArguments DrawArguments;
+    };
+
+    struct Instance
+    {
+        Float3 Center;
+        uint32_t RunIndex;
+        Float3 Extents;
+        uint32_t RunFirstCommand;
+    };
+
+    using Run = IndirectRun<DrawItem>;
+}
\ No newline at end of file
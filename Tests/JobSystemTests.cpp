@@ -0,0 +1,331 @@
+#include "JobSystem.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Worker threads besides the test thread, the main-thread-only case included.
+    class JobSystemTest : public ::testing::TestWithParam<uint32_t>
+    {
+    };
+
+    void SpawnTree(JobSystem* jobs, JobCounter* counter, std::atomic<uint32_t>* leaves, uint32_t depth)
+    {
+        if (depth == 0)
+        {
+            leaves->fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            jobs->Run([=]() { SpawnTree(jobs, counter, leaves, depth - 1); }, counter);
+        }
+    }
+}
+
+TEST_P(JobSystemTest, WaitReturnsOnceEveryJobRan)
+{
+    JobSystem jobs(GetParam());
+    for (int round = 0; round < 50; round++)
+    {
+        std::atomic<uint32_t> sum{ 0 };
+        JobCounter counter;
+        for (uint32_t i = 1; i <= 1000; i++)
+        {
+            jobs.Run([&sum, i]() { sum.fetch_add(i, std::memory_order_relaxed); }, &counter);
+        }
+        jobs.Wait(&counter);
+        EXPECT_TRUE(counter.IsDone());
+        EXPECT_EQ(sum.load(), 1000u * 1001u / 2u);
+    }
+}
+
+TEST_P(JobSystemTest, JobsSpawningJobsOverflowTheirDeque)
+{
+    // 2^13 leaves, more than a worker deque holds: full deques run jobs inline.
+    JobSystem jobs(GetParam());
+    std::atomic<uint32_t> leaves{ 0 };
+    JobCounter counter;
+    SpawnTree(&jobs, &counter, &leaves, 13);
+    jobs.Wait(&counter);
+    EXPECT_EQ(leaves.load(), 1u << 13);
+}
+
+TEST_P(JobSystemTest, ThreadsThatAreNotWorkersSubmitThroughTheSharedQueue)
+{
+    JobSystem jobs(GetParam());
+    std::atomic<uint32_t> ran{ 0 };
+    JobCounter counter;
+    std::atomic<uint32_t> submitted{ 0 };
+    std::vector<std::thread> submitters;
+    for (int t = 0; t < 4; t++)
+    {
+        submitters.emplace_back([&]()
+        {
+            for (int i = 0; i < 500; i++)
+            {
+                jobs.Run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+            }
+            submitted.fetch_add(500);
+        });
+    }
+    for (std::thread& thread : submitters)
+    {
+        thread.join();
+    }
+    jobs.Wait(&counter);
+    EXPECT_EQ(ran.load(), submitted.load());
+    EXPECT_EQ(ran.load(), 2000u);
+}
+
+TEST_P(JobSystemTest, DependentJobsStartAfterTheirDependency)
+{
+    JobSystem jobs(GetParam());
+    for (int round = 0; round < 200; round++)
+    {
+        std::atomic<uint32_t> firstDone{ 0 };
+        std::atomic<uint32_t> violations{ 0 };
+        JobCounter first;
+        JobCounter second;
+        for (int i = 0; i < 16; i++)
+        {
+            jobs.Run([&firstDone]()
+            {
+                std::this_thread::yield();
+                firstDone.fetch_add(1);
+            }, &first);
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            jobs.Run([&]()
+            {
+                if (firstDone.load() != 16)
+                {
+                    violations.fetch_add(1);
+                }
+            }, &second, &first);
+        }
+        jobs.Wait(&second);
+        EXPECT_TRUE(first.IsDone());
+        EXPECT_EQ(violations.load(), 0u);
+    }
+}
+
+TEST_P(JobSystemTest, RunAfterAllWaitsForEveryDependency)
+{
+    JobSystem jobs(GetParam());
+    for (int round = 0; round < 100; round++)
+    {
+        const int dependencyCount = 5;
+        JobCounter dependencies[dependencyCount];
+        std::atomic<uint32_t> done{ 0 };
+        std::vector<JobCounter*> pointers;
+        for (int d = 0; d < dependencyCount; d++)
+        {
+            pointers.push_back(&dependencies[d]);
+            for (int i = 0; i <= d; i++)
+            {
+                jobs.Run([&done]() { done.fetch_add(1); }, &dependencies[d]);
+            }
+        }
+        const uint32_t expected = dependencyCount * (dependencyCount + 1) / 2;
+
+        std::atomic<uint32_t> seen{ 0 };
+        JobCounter last;
+        jobs.RunAfterAll([&]() { seen = done.load(); }, &last, pointers);
+        jobs.Wait(&last);
+        EXPECT_EQ(seen.load(), expected);
+    }
+
+    // Dependencies already done are skipped.
+    JobCounter idle;
+    JobCounter counter;
+    bool ran = false;
+    jobs.RunAfterAll([&ran]() { ran = true; }, &counter, { &idle, &idle });
+    jobs.Wait(&counter);
+    EXPECT_TRUE(ran);
+}
+
+TEST_P(JobSystemTest, ParallelForCoversEveryIndexOnce)
+{
+    JobSystem jobs(GetParam());
+    const uint32_t counts[] = { 0, 1, 7, 64, 1000, 4099 };
+    const uint32_t grains[] = { 0, 1, 3, 64, 5000 };
+    for (uint32_t count : counts)
+    {
+        for (uint32_t grain : grains)
+        {
+            std::vector<std::atomic<uint32_t>> hits(count);
+            std::atomic<uint32_t> oversized{ 0 };
+            JobSystem::RangeFunction visit = [&](uint32_t begin, uint32_t end)
+            {
+                if (end - begin > (std::max)(grain, 1u))
+                {
+                    oversized.fetch_add(1);
+                }
+                for (uint32_t i = begin; i < end; i++)
+                {
+                    hits[i].fetch_add(1);
+                }
+            };
+            JobCounter counter;
+            jobs.ParallelFor(count, grain, visit, &counter);
+            jobs.Wait(&counter);
+            EXPECT_EQ(oversized.load(), 0u);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                ASSERT_EQ(hits[i].load(), 1u) << "count " << count << " grain " << grain << " index " << i;
+            }
+        }
+    }
+}
+
+TEST_P(JobSystemTest, ParallelForWaitsForItsDependency)
+{
+    JobSystem jobs(GetParam());
+    std::atomic<bool> ready{ false };
+    std::atomic<uint32_t> early{ 0 };
+    JobCounter dependency;
+    jobs.Run([&ready]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        ready = true;
+    }, &dependency);
+    JobSystem::RangeFunction visit = [&](uint32_t, uint32_t)
+    {
+        if (!ready.load())
+        {
+            early.fetch_add(1);
+        }
+    };
+    JobCounter counter;
+    jobs.ParallelFor(256, 8, visit, &counter, &dependency);
+    jobs.Wait(&counter);
+    EXPECT_EQ(early.load(), 0u);
+}
+
+TEST_P(JobSystemTest, WaitRethrowsTheFirstException)
+{
+    JobSystem jobs(GetParam());
+    JobCounter counter;
+    std::atomic<uint32_t> ran{ 0 };
+    for (int i = 0; i < 100; i++)
+    {
+        jobs.Run([&ran, i]()
+        {
+            ran.fetch_add(1);
+            if (i % 10 == 3)
+            {
+                throw std::runtime_error("job failed");
+            }
+        }, &counter);
+    }
+    EXPECT_THROW(jobs.Wait(&counter), std::runtime_error);
+    // Every job ran, the group is done and its exception consumed.
+    EXPECT_EQ(ran.load(), 100u);
+    EXPECT_TRUE(counter.IsDone());
+    EXPECT_NO_THROW(jobs.Wait(&counter));
+
+    // The counter can be reused.
+    jobs.Run([]() {}, &counter);
+    EXPECT_NO_THROW(jobs.Wait(&counter));
+}
+
+TEST_P(JobSystemTest, ExceptionOfADependencyDoesNotBlockDependents)
+{
+    JobSystem jobs(GetParam());
+    JobCounter first;
+    JobCounter second;
+    bool ran = false;
+    jobs.Run([]() { throw std::logic_error("dependency failed"); }, &first);
+    jobs.Run([&ran]() { ran = true; }, &second, &first);
+    jobs.Wait(&second);
+    EXPECT_TRUE(ran);
+    EXPECT_THROW(jobs.Wait(&first), std::logic_error);
+}
+
+TEST_P(JobSystemTest, WaitsRunOnlyTheBackgroundJobsOfTheirGroup)
+{
+    JobSystem jobs(GetParam());
+    const std::thread::id waitingThread = std::this_thread::get_id();
+    std::atomic<uint32_t> backgroundRan{ 0 };
+    std::atomic<uint32_t> ranByWaitingThread{ 0 };
+    JobCounter background;
+    for (int i = 0; i < 200; i++)
+    {
+        jobs.RunBackground([&]()
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            backgroundRan.fetch_add(1);
+            if (std::this_thread::get_id() == waitingThread)
+            {
+                ranByWaitingThread.fetch_add(1);
+            }
+        }, &background);
+    }
+
+    // The frames keep going while the background jobs are queued.
+    for (int frame = 0; frame < 20; frame++)
+    {
+        std::atomic<uint32_t> sum{ 0 };
+        JobSystem::RangeFunction count = [&sum](uint32_t begin, uint32_t end) { sum.fetch_add(end - begin); };
+        JobCounter counter;
+        jobs.ParallelFor(64, 4, count, &counter);
+        jobs.Wait(&counter);
+        EXPECT_EQ(sum.load(), 64u);
+    }
+    EXPECT_EQ(ranByWaitingThread.load(), 0u);
+
+    // Waiting for the group runs what the workers have not taken yet.
+    jobs.Wait(&background);
+    EXPECT_EQ(backgroundRan.load(), 200u);
+}
+
+TEST_P(JobSystemTest, BackgroundJobsWaitForTheirDependency)
+{
+    JobSystem jobs(GetParam());
+    std::atomic<bool> ready{ false };
+    std::atomic<uint32_t> early{ 0 };
+    JobCounter dependency;
+    jobs.Run([&ready]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        ready = true;
+    }, &dependency);
+    JobCounter background;
+    for (int i = 0; i < 50; i++)
+    {
+        jobs.RunBackground([&]()
+        {
+            if (!ready.load())
+            {
+                early.fetch_add(1);
+            }
+        }, &background, &dependency);
+    }
+    jobs.RunBackground([]() { throw std::runtime_error("build failed"); }, &background);
+    EXPECT_THROW(jobs.Wait(&background), std::runtime_error);
+    EXPECT_TRUE(background.IsDone());
+    EXPECT_EQ(early.load(), 0u);
+}
+
+TEST(JobSystemTests, BackgroundJobsWithoutWorkersRunInTheirWait)
+{
+    JobSystem jobs(0);
+    bool built = false;
+    JobCounter build;
+    jobs.RunBackground([&built]() { built = true; }, &build);
+    JobCounter frame;
+    jobs.Run([]() {}, &frame);
+    jobs.Wait(&frame);
+    EXPECT_FALSE(built);
+    jobs.Wait(&build);
+    EXPECT_TRUE(built);
+}
+
+INSTANTIATE_TEST_SUITE_P(WorkerCounts, JobSystemTest, ::testing::Values(0u, 1u, 3u, 7u));
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "QueueScheduler.h"
+#include <gtest/gtest.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Two simulated queues behind a scheduler, like the graphics and compute
+    // queues of the app. The work records the order it ran in.
+    class SchedulerFixture : public ::testing::Test
+    {
+    protected:
+        SchedulerFixture()
+        {
+            Graphics = Scheduler.AddQueue(&GraphicsQueue);
+            Compute = Scheduler.AddQueue(&ComputeQueue);
+        }
+
+        // A failed test may not have released the graphics queue, its thread has to finish.
+        ~SchedulerFixture()
+        {
+            Release();
+        }
+
+        // The work queued on the graphics queue after this waits for Release,
+        // the dependencies are still pending when they are submitted and the
+        // wait counts do not depend on the timing of the queue threads.
+        void HoldGraphics()
+        {
+            GraphicsQueue.WaitOn(&Gate, 1);
+        }
+
+        void Release()
+        {
+            Gate.Signal(1);
+        }
+
+        QueueTicket Submit(QueueId queue, const std::string& name, std::initializer_list<QueueTicket> dependencies = {})
+        {
+            SimulatedQueue* target = (queue == Graphics) ? &GraphicsQueue : &ComputeQueue;
+            return Scheduler.Submit(queue, [=]()
+            {
+                target->Execute([=]()
+                {
+                    std::lock_guard<std::mutex> lock(LogMutex);
+                    Log.push_back(name);
+                });
+            }, dependencies);
+        }
+
+        void Finish(QueueTicket ticket)
+        {
+            Scheduler.Queue(ticket.Queue)->Fence()->Wait(ticket.Value, FenceWaitPolicy::Block);
+        }
+
+        // Position of name in the log, the log is complete once the queues are idle.
+        size_t Position(const std::string& name)
+        {
+            std::lock_guard<std::mutex> lock(LogMutex);
+            for (size_t i = 0; i < Log.size(); i++)
+            {
+                if (Log[i] == name)
+                {
+                    return i;
+                }
+            }
+            ADD_FAILURE() << name << " never ran";
+            return SIZE_MAX;
+        }
+
+        // Declared before the queues, the queue threads use them until the queues are destroyed.
+        std::mutex LogMutex;
+        std::vector<std::string> Log;
+        CpuTimelineFence Gate;
+
+        SimulatedQueue GraphicsQueue;
+        SimulatedQueue ComputeQueue;
+        QueueScheduler Scheduler;
+        QueueId Graphics = 0;
+        QueueId Compute = 0;
+    };
+}
+
+TEST_F(SchedulerFixture, CrossQueueDependenciesBecomeWaits)
+{
+    // The graphics queue is held: without the waits compute would run first.
+    HoldGraphics();
+    QueueTicket shadows = Submit(Graphics, "shadows");
+    QueueTicket culling = Submit(Compute, "culling", { shadows });
+    QueueTicket draw = Submit(Graphics, "draw", { culling });
+    Release();
+    Finish(draw);
+
+    EXPECT_EQ(Scheduler.WaitCount(), 2u);
+    EXPECT_LT(Position("shadows"), Position("culling"));
+    EXPECT_LT(Position("culling"), Position("draw"));
+}
+
+TEST_F(SchedulerFixture, ImpliedWaitsAreNotRepeated)
+{
+    HoldGraphics();
+    QueueTicket first = Submit(Graphics, "first");
+    QueueTicket second = Submit(Graphics, "second");
+
+    // Waiting for second covers first, and a queue never waits on itself.
+    QueueTicket a = Submit(Compute, "a", { second });
+    QueueTicket b = Submit(Compute, "b", { first, second });
+    QueueTicket c = Submit(Compute, "c", { first, a });
+    Release();
+    Finish(c);
+    Finish(b);
+
+    EXPECT_EQ(Scheduler.WaitCount(), 1u);
+    EXPECT_LT(Position("second"), Position("a"));
+    EXPECT_LT(Position("a"), Position("b"));
+    EXPECT_LT(Position("b"), Position("c"));
+}
+
+TEST_F(SchedulerFixture, CompletedDependenciesAreNotWaitedFor)
+{
+    QueueTicket upload = Submit(Graphics, "upload");
+    Finish(upload);
+    QueueTicket culling = Submit(Compute, "culling", { upload });
+    Finish(culling);
+    EXPECT_EQ(Scheduler.WaitCount(), 0u);
+    EXPECT_LT(Position("upload"), Position("culling"));
+}
+
+TEST_F(SchedulerFixture, FramesAlternatingBetweenQueuesStayOrdered)
+{
+    // The frame loop of the app with async compute: culling of frame N waits
+    // for the pass constants on graphics, the draws of frame N wait for the
+    // culling. The graphics queue runs ahead between the syncs.
+    const int frameCount = 30;
+    HoldGraphics();
+    QueueTicket lastDraw;
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        std::string suffix = std::to_string(frame);
+        QueueTicket constants = Submit(Graphics, "constants" + suffix);
+        QueueTicket culling = Submit(Compute, "culling" + suffix, { constants });
+        lastDraw = Submit(Graphics, "draw" + suffix, { culling, constants });
+    }
+    Release();
+    Finish(lastDraw);
+
+    // One wait each way per frame, the same-queue dependency costs nothing.
+    EXPECT_EQ(Scheduler.WaitCount(), 2u * frameCount);
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        std::string suffix = std::to_string(frame);
+        EXPECT_LT(Position("constants" + suffix), Position("culling" + suffix));
+        EXPECT_LT(Position("culling" + suffix), Position("draw" + suffix));
+        if (frame > 0)
+        {
+            EXPECT_LT(Position("culling" + std::to_string(frame - 1)), Position("culling" + suffix));
+        }
+    }
+}
+
+TEST_F(SchedulerFixture, TicketsCountUpPerQueue)
+{
+    QueueTicket g1 = Submit(Graphics, "g1");
+    QueueTicket c1 = Submit(Compute, "c1");
+    QueueTicket g2 = Submit(Graphics, "g2");
+    EXPECT_EQ(g1.Queue, Graphics);
+    EXPECT_EQ(c1.Queue, Compute);
+    EXPECT_EQ(g1.Value, 1u);
+    EXPECT_EQ(c1.Value, 1u);
+    EXPECT_EQ(g2.Value, 2u);
+    Finish(g2);
+    Finish(c1);
+    EXPECT_EQ(GraphicsQueue.Fence()->CompletedValue(), 2u);
+}
\ No newline at end of file
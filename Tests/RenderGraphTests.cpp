@@ -0,0 +1,278 @@
+#include "RenderGraph.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+
+namespace
+{
+    const uint64_t PlacementAlignment = 64 * 1024;
+
+    // Four bytes a texel, placed at the alignment of D3D12 textures.
+    MemoryRequirements TexelRequirements(const TransientTextureDesc& desc, ResourceAccess)
+    {
+        MemoryRequirements requirements;
+        requirements.Size = (uint64_t)desc.Width * desc.Height * 4;
+        requirements.Alignment = PlacementAlignment;
+        return requirements;
+    }
+
+    TransientTextureDesc Texture(uint32_t width, uint32_t height)
+    {
+        TransientTextureDesc desc;
+        desc.Width = width;
+        desc.Height = height;
+        return desc;
+    }
+
+    std::vector<RenderGraphPass> ExecutedPasses(const RenderGraph& graph)
+    {
+        std::vector<RenderGraphPass> passes;
+        for (const CompiledPass& compiled : graph.ExecutionOrder())
+        {
+            passes.push_back(compiled.Pass);
+        }
+        return passes;
+    }
+
+    std::vector<RenderGraphBarrier> BarriersOf(const std::vector<RenderGraphBarrier>& barriers,
+        RenderGraphResource resource, RenderGraphBarrierType type)
+    {
+        std::vector<RenderGraphBarrier> found;
+        for (const RenderGraphBarrier& barrier : barriers)
+        {
+            if (barrier.Resource == resource && barrier.Type == type)
+            {
+                found.push_back(barrier);
+            }
+        }
+        return found;
+    }
+
+    // Transient textures alive at the same time in the same heap never share memory.
+    void ExpectNoLiveOverlap(const RenderGraph& graph)
+    {
+        for (RenderGraphResource a = 0; a < graph.ResourceCount(); a++)
+        {
+            const TransientAllocation& first = graph.Allocation(a);
+            if (graph.IsImported(a) || first.FirstUse == RenderGraphInvalidIndex)
+            {
+                continue;
+            }
+            EXPECT_EQ(first.Offset % PlacementAlignment, 0u) << graph.ResourceName(a);
+            EXPECT_LE(first.Offset + first.Size, graph.HeapSize(first.HeapType)) << graph.ResourceName(a);
+            for (RenderGraphResource b = a + 1; b < graph.ResourceCount(); b++)
+            {
+                const TransientAllocation& second = graph.Allocation(b);
+                if (graph.IsImported(b) || second.FirstUse == RenderGraphInvalidIndex ||
+                    first.HeapType != second.HeapType ||
+                    first.LastUse < second.FirstUse || second.LastUse < first.FirstUse)
+                {
+                    continue;
+                }
+                EXPECT_TRUE(first.Offset + first.Size <= second.Offset || second.Offset + second.Size <= first.Offset)
+                    << graph.ResourceName(a) << " and " << graph.ResourceName(b) << " overlap";
+            }
+        }
+    }
+}
+
+TEST(RenderGraphTests, UnusedResultsAreCulled)
+{
+    RenderGraph graph;
+    RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", ResourceAccess::Present, ResourceAccess::Present);
+    RenderGraphResource shadowMap = graph.CreateTexture("ShadowMap", Texture(256, 256));
+    RenderGraphResource unusedTarget = graph.CreateTexture("Unused", Texture(256, 256));
+
+    RenderGraphPass shadows = graph.AddPass("Shadows");
+    graph.Overwrite(shadows, shadowMap, ResourceAccess::DepthWrite);
+    RenderGraphPass unused = graph.AddPass("Unused");
+    graph.Overwrite(unused, unusedTarget, ResourceAccess::RenderTarget);
+    RenderGraphPass main = graph.AddPass("Main");
+    graph.Read(main, shadowMap, ResourceAccess::ShaderRead);
+    graph.Write(main, backBuffer, ResourceAccess::RenderTarget);
+    // Reads a culled result and writes nothing.
+    RenderGraphPass debug = graph.AddPass("Debug");
+    graph.Read(debug, unusedTarget, ResourceAccess::ShaderRead);
+    RenderGraphPass capture = graph.AddPass("Capture");
+    graph.Read(capture, shadowMap, ResourceAccess::CopySource);
+    graph.SetSideEffects(capture);
+    graph.Compile(TexelRequirements);
+
+    EXPECT_FALSE(graph.IsCulled(shadows));
+    EXPECT_TRUE(graph.IsCulled(unused));
+    EXPECT_FALSE(graph.IsCulled(main));
+    EXPECT_TRUE(graph.IsCulled(debug));
+    EXPECT_FALSE(graph.IsCulled(capture));
+    EXPECT_EQ(ExecutedPasses(graph), (std::vector<RenderGraphPass>{ shadows, main, capture }));
+
+    // The texture of the culled passes takes no memory.
+    EXPECT_EQ(graph.Allocation(unusedTarget).FirstUse, RenderGraphInvalidIndex);
+    EXPECT_EQ(graph.HeapSize(TransientHeapType::RenderTargetTexture), 256u * 256u * 4u);
+}
+
+TEST(RenderGraphTests, OverwrittenImportedWritesAreCulled)
+{
+    RenderGraph graph;
+    RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", ResourceAccess::Present, ResourceAccess::Present);
+    RenderGraphPass clear = graph.AddPass("Clear");
+    graph.Write(clear, backBuffer, ResourceAccess::RenderTarget);
+    RenderGraphPass fullscreen = graph.AddPass("Fullscreen");
+    graph.Overwrite(fullscreen, backBuffer, ResourceAccess::RenderTarget);
+    RenderGraphPass overlay = graph.AddPass("Overlay");
+    graph.Write(overlay, backBuffer, ResourceAccess::RenderTarget);
+    graph.Compile(TexelRequirements);
+
+    EXPECT_TRUE(graph.IsCulled(clear));
+    EXPECT_EQ(ExecutedPasses(graph), (std::vector<RenderGraphPass>{ fullscreen, overlay }));
+}
+
+TEST(RenderGraphTests, TransientsShareMemoryOnlyWhenNotAlive)
+{
+    RenderGraph graph;
+    RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", ResourceAccess::Present, ResourceAccess::Present);
+    RenderGraphResource gbuffer = graph.CreateTexture("GBuffer", Texture(256, 256));
+    RenderGraphResource lighting = graph.CreateTexture("Lighting", Texture(128, 128));
+    RenderGraphResource bloom = graph.CreateTexture("Bloom", Texture(256, 256));
+    RenderGraphResource particles = graph.CreateTexture("Particles", Texture(64, 64));
+
+    // GBuffer lives in passes 0-1, Lighting in 1-2, Bloom in 2-3.
+    RenderGraphPass geometry = graph.AddPass("Geometry");
+    graph.Overwrite(geometry, gbuffer, ResourceAccess::RenderTarget);
+    RenderGraphPass light = graph.AddPass("Lighting");
+    graph.Read(light, gbuffer, ResourceAccess::ShaderRead);
+    graph.Overwrite(light, lighting, ResourceAccess::RenderTarget);
+    RenderGraphPass blur = graph.AddPass("Bloom");
+    graph.Read(blur, lighting, ResourceAccess::ShaderRead);
+    graph.Overwrite(blur, bloom, ResourceAccess::RenderTarget);
+    // Only unordered access, placed in the other heap.
+    graph.Overwrite(blur, particles, ResourceAccess::UnorderedAccess);
+    RenderGraphPass composite = graph.AddPass("Composite");
+    graph.Read(composite, bloom, ResourceAccess::ShaderRead);
+    graph.Read(composite, particles, ResourceAccess::ShaderRead);
+    graph.Write(composite, backBuffer, ResourceAccess::RenderTarget);
+    graph.Compile(TexelRequirements);
+
+    ExpectNoLiveOverlap(graph);
+
+    // Bloom takes the memory of the GBuffer, Lighting overlaps both.
+    const uint64_t large = 256 * 256 * 4;
+    EXPECT_EQ(graph.Allocation(gbuffer).Offset, 0u);
+    EXPECT_EQ(graph.Allocation(bloom).Offset, 0u);
+    EXPECT_EQ(graph.Allocation(lighting).Offset, large);
+    EXPECT_EQ(graph.HeapSize(TransientHeapType::RenderTargetTexture), large + 128 * 128 * 4);
+    EXPECT_EQ(graph.Allocation(particles).HeapType, TransientHeapType::Texture);
+    EXPECT_EQ(graph.HeapSize(TransientHeapType::Texture), 64u * 64u * 4u);
+
+    // The first use of a texture names the texture it takes the memory from.
+    const std::vector<CompiledPass>& order = graph.ExecutionOrder();
+    ASSERT_EQ(order.size(), 4u);
+    std::vector<RenderGraphBarrier> aliasing = BarriersOf(order[2].Barriers, bloom, RenderGraphBarrierType::Aliasing);
+    ASSERT_EQ(aliasing.size(), 1u);
+    EXPECT_EQ(aliasing[0].AliasedResource, gbuffer);
+    aliasing = BarriersOf(order[0].Barriers, gbuffer, RenderGraphBarrierType::Aliasing);
+    ASSERT_EQ(aliasing.size(), 1u);
+    EXPECT_EQ(aliasing[0].AliasedResource, RenderGraphInvalidIndex);
+}
+
+TEST(RenderGraphTests, ManyTransientsNeverOverlapWhileAlive)
+{
+    // A chain of passes, each reading the two textures written before it.
+    RenderGraph graph;
+    RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", ResourceAccess::Present, ResourceAccess::Present);
+    std::vector<RenderGraphResource> textures;
+    for (uint32_t i = 0; i < 24; i++)
+    {
+        uint32_t size = 32u << (i * 7 % 4);
+        textures.push_back(graph.CreateTexture("Texture" + std::to_string(i), Texture(size, size)));
+        RenderGraphPass pass = graph.AddPass("Pass" + std::to_string(i));
+        for (uint32_t back = 1; back <= 2 && back <= i; back++)
+        {
+            graph.Read(pass, textures[i - back], ResourceAccess::ShaderRead);
+        }
+        graph.Overwrite(pass, textures[i], (i % 3 == 0) ? ResourceAccess::UnorderedAccess : ResourceAccess::RenderTarget);
+    }
+    RenderGraphPass present = graph.AddPass("Present");
+    graph.Read(present, textures.back(), ResourceAccess::ShaderRead);
+    graph.Write(present, backBuffer, ResourceAccess::RenderTarget);
+    graph.Compile(TexelRequirements);
+
+    EXPECT_EQ(graph.ExecutionOrder().size(), graph.PassCount());
+    ExpectNoLiveOverlap(graph);
+}
+
+TEST(RenderGraphTests, TransitionsAreSplitAcrossIdlePasses)
+{
+    RenderGraph graph;
+    RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", ResourceAccess::Present, ResourceAccess::Present);
+    RenderGraphResource counts = graph.ImportResource("Counts", ResourceAccess::UnorderedAccess, ResourceAccess::UnorderedAccess);
+    RenderGraphResource gbuffer = graph.CreateTexture("GBuffer", Texture(64, 64));
+
+    RenderGraphPass geometry = graph.AddPass("Geometry");
+    graph.Overwrite(geometry, gbuffer, ResourceAccess::RenderTarget);
+    // Does not touch the GBuffer or the back buffer.
+    RenderGraphPass count = graph.AddPass("Count");
+    graph.Write(count, counts, ResourceAccess::UnorderedAccess);
+    RenderGraphPass light = graph.AddPass("Lighting");
+    graph.Read(light, gbuffer, ResourceAccess::ShaderRead);
+    graph.Write(light, backBuffer, ResourceAccess::RenderTarget);
+    graph.Compile(TexelRequirements);
+
+    const std::vector<CompiledPass>& order = graph.ExecutionOrder();
+    ASSERT_EQ(ExecutedPasses(graph), (std::vector<RenderGraphPass>{ geometry, count, light }));
+
+    // The GBuffer starts the frame in the access it was left in and goes to
+    // a render target right before its first use.
+    EXPECT_EQ(graph.InitialAccess(gbuffer), ResourceAccess::ShaderRead);
+    std::vector<RenderGraphBarrier> transitions = BarriersOf(order[0].Barriers, gbuffer, RenderGraphBarrierType::Transition);
+    ASSERT_EQ(transitions.size(), 1u);
+    EXPECT_EQ(transitions[0].Split, BarrierSplit::None);
+    EXPECT_EQ(transitions[0].Before, ResourceAccess::ShaderRead);
+    EXPECT_EQ(transitions[0].After, ResourceAccess::RenderTarget);
+
+    // Written by Geometry, read by Lighting: the transition begins once
+    // Count starts and ends before Lighting.
+    transitions = BarriersOf(order[1].Barriers, gbuffer, RenderGraphBarrierType::Transition);
+    ASSERT_EQ(transitions.size(), 1u);
+    EXPECT_EQ(transitions[0].Split, BarrierSplit::Begin);
+    EXPECT_EQ(transitions[0].Before, ResourceAccess::RenderTarget);
+    EXPECT_EQ(transitions[0].After, ResourceAccess::ShaderRead);
+    transitions = BarriersOf(order[2].Barriers, gbuffer, RenderGraphBarrierType::Transition);
+    ASSERT_EQ(transitions.size(), 1u);
+    EXPECT_EQ(transitions[0].Split, BarrierSplit::End);
+
+    // Unused since the start of the frame, the back buffer transition begins before the first pass.
+    transitions = BarriersOf(order[0].Barriers, backBuffer, RenderGraphBarrierType::Transition);
+    ASSERT_EQ(transitions.size(), 1u);
+    EXPECT_EQ(transitions[0].Split, BarrierSplit::Begin);
+    EXPECT_EQ(transitions[0].Before, ResourceAccess::Present);
+    EXPECT_EQ(transitions[0].After, ResourceAccess::RenderTarget);
+    transitions = BarriersOf(order[2].Barriers, backBuffer, RenderGraphBarrierType::Transition);
+    ASSERT_EQ(transitions.size(), 1u);
+    EXPECT_EQ(transitions[0].Split, BarrierSplit::End);
+
+    // Used by the last pass, nothing to overlap the final transition with.
+    transitions = BarriersOf(graph.FinalBarriers(), backBuffer, RenderGraphBarrierType::Transition);
+    ASSERT_EQ(transitions.size(), 1u);
+    EXPECT_EQ(transitions[0].Split, BarrierSplit::None);
+    EXPECT_EQ(transitions[0].After, ResourceAccess::Present);
+
+    // Already in the access the pass needs.
+    EXPECT_TRUE(BarriersOf(order[1].Barriers, counts, RenderGraphBarrierType::Transition).empty());
+    EXPECT_TRUE(BarriersOf(graph.FinalBarriers(), counts, RenderGraphBarrierType::Transition).empty());
+}
+
+TEST(RenderGraphTests, RepeatedUnorderedWritesGetUavBarriers)
+{
+    RenderGraph graph;
+    RenderGraphResource counts = graph.ImportResource("Counts", ResourceAccess::UnorderedAccess, ResourceAccess::UnorderedAccess);
+    RenderGraphPass first = graph.AddPass("First");
+    graph.Write(first, counts, ResourceAccess::UnorderedAccess);
+    RenderGraphPass second = graph.AddPass("Second");
+    graph.Write(second, counts, ResourceAccess::UnorderedAccess);
+    graph.Compile(TexelRequirements);
+
+    const std::vector<CompiledPass>& order = graph.ExecutionOrder();
+    ASSERT_EQ(order.size(), 2u);
+    EXPECT_TRUE(BarriersOf(order[0].Barriers, counts, RenderGraphBarrierType::Uav).empty());
+    EXPECT_EQ(BarriersOf(order[1].Barriers, counts, RenderGraphBarrierType::Uav).size(), 1u);
+}
\ No newline at end of file
@@ -0,0 +1,270 @@
+#include "ShaderCache.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    class MemoryFileSystem : public IShaderFileSystem
+    {
+    public:
+        bool ReadFile(const std::string& path, std::string& contents) override
+        {
+            auto it = Files.find(path);
+            if (it == Files.end())
+            {
+                return false;
+            }
+            contents = it->second;
+            return true;
+        }
+
+        std::map<std::string, std::string> Files;
+    };
+
+    // Follows the '#include "path"' lines and returns the source with the
+    // includes appended as bytecode, so the bytecode shows what was compiled.
+    class StubCompiler : public IShaderCompiler
+    {
+    public:
+        std::string Identifier()const override { return "stub 1"; }
+
+        bool Compile(const ShaderCompileRequest& request, const std::string& source,
+            IShaderFileSystem& fileSystem, ShaderCompileResult& result) override
+        {
+            CompileCount++;
+            std::string output = request.EntryPoint + "|" + source;
+            const std::string directive = "#include \"";
+            for (size_t position = source.find(directive); position != std::string::npos;
+                position = source.find(directive, position + 1))
+            {
+                size_t begin = position + directive.size();
+                std::string path = source.substr(begin, source.find('"', begin) - begin);
+                std::string contents;
+                if (!fileSystem.ReadFile(path, contents))
+                {
+                    result.Errors = "cannot open " + path;
+                    return false;
+                }
+                output += "|" + contents;
+                result.Dependencies.push_back(path);
+            }
+            result.Bytecode.assign(output.begin(), output.end());
+            return true;
+        }
+
+        uint32_t CompileCount = 0;
+    };
+
+    std::string ToString(const ShaderBytecode& bytecode)
+    {
+        return std::string(static_cast<const char*>(bytecode.Data), bytecode.Size);
+    }
+
+    class ShaderCacheTests : public ::testing::Test
+    {
+    protected:
+        ShaderCacheTests()
+        {
+            ArchivePath = ::testing::TempDir() + "ShaderCacheTests_" +
+                ::testing::UnitTest::GetInstance()->current_test_info()->name() + ".bin";
+            std::remove(ArchivePath.c_str());
+            FileSystem.Files["shaders.hlsl"] = "#include \"common.hlsli\"\nfloat4 PS() { return Color; }";
+            FileSystem.Files["common.hlsli"] = "float4 Color;";
+            FileSystem.Files["plain.hlsl"] = "float4 VS() { return 0; }";
+        }
+
+        ~ShaderCacheTests()
+        {
+            std::remove(ArchivePath.c_str());
+        }
+
+        static ShaderCompileRequest Request(const std::string& path, const std::string& entryPoint)
+        {
+            ShaderCompileRequest request;
+            request.SourcePath = path;
+            request.EntryPoint = entryPoint;
+            request.Target = "ps_5_0";
+            return request;
+        }
+
+        void WriteArchive(const std::vector<uint8_t>& contents)
+        {
+            ASSERT_TRUE(MappedFile::Write(ArchivePath, contents.data(), contents.size()));
+        }
+
+        std::vector<uint8_t> ReadArchive()
+        {
+            std::vector<uint8_t> contents;
+            EXPECT_TRUE(MappedFile::Read(ArchivePath, contents));
+            return contents;
+        }
+
+        MemoryFileSystem FileSystem;
+        StubCompiler Compiler;
+        std::string ArchivePath;
+    };
+}
+
+TEST_F(ShaderCacheTests, SecondRequestHits)
+{
+    ShaderCache cache(&Compiler, &FileSystem, "");
+    std::vector<std::string> dependencies;
+    std::string first = ToString(cache.GetShader(Request("shaders.hlsl", "PS"), &dependencies));
+    EXPECT_EQ(first, "PS|" + FileSystem.Files["shaders.hlsl"] + "|float4 Color;");
+    EXPECT_EQ(dependencies, std::vector<std::string>{ "common.hlsli" });
+
+    dependencies.clear();
+    EXPECT_EQ(ToString(cache.GetShader(Request("shaders.hlsl", "PS"), &dependencies)), first);
+    EXPECT_EQ(dependencies, std::vector<std::string>{ "common.hlsli" });
+    EXPECT_EQ(Compiler.CompileCount, 1u);
+    EXPECT_EQ(cache.MissCount(), 1u);
+    EXPECT_EQ(cache.HitCount(), 1u);
+}
+
+TEST_F(ShaderCacheTests, EveryPartOfTheRequestIsInTheKey)
+{
+    ShaderCache cache(&Compiler, &FileSystem, "");
+    ShaderCompileRequest request = Request("shaders.hlsl", "PS");
+    cache.GetShader(request);
+
+    ShaderCompileRequest other = request;
+    other.EntryPoint = "PSMain";
+    cache.GetShader(other);
+    other = request;
+    other.Target = "ps_5_1";
+    cache.GetShader(other);
+    other = request;
+    other.Defines.push_back(std::make_pair("ALPHA_TEST", "1"));
+    cache.GetShader(other);
+    other.Defines[0].second = "0";
+    cache.GetShader(other);
+    other = request;
+    other.Flags = 1;
+    cache.GetShader(other);
+    EXPECT_EQ(Compiler.CompileCount, 6u);
+
+    FileSystem.Files["shaders.hlsl"] += "\n// Edited.";
+    cache.GetShader(request);
+    EXPECT_EQ(Compiler.CompileCount, 7u);
+    EXPECT_EQ(cache.HitCount(), 0u);
+}
+
+TEST_F(ShaderCacheTests, ChangedIncludeInvalidatesTheEntry)
+{
+    ShaderCache cache(&Compiler, &FileSystem, "");
+    cache.GetShader(Request("shaders.hlsl", "PS"));
+    cache.GetShader(Request("plain.hlsl", "VS"));
+
+    FileSystem.Files["common.hlsli"] = "float4 Color; float4 Tint;";
+    std::string recompiled = ToString(cache.GetShader(Request("shaders.hlsl", "PS")));
+    EXPECT_EQ(recompiled, "PS|" + FileSystem.Files["shaders.hlsl"] + "|float4 Color; float4 Tint;");
+    // Shaders not including it still hit.
+    cache.GetShader(Request("plain.hlsl", "VS"));
+    EXPECT_EQ(Compiler.CompileCount, 3u);
+    EXPECT_EQ(cache.HitCount(), 1u);
+
+    // A deleted include is a change too, the compiler reports it.
+    FileSystem.Files.erase("common.hlsli");
+    EXPECT_THROW(cache.GetShader(Request("shaders.hlsl", "PS")), std::runtime_error);
+    EXPECT_EQ(Compiler.CompileCount, 4u);
+}
+
+TEST_F(ShaderCacheTests, SavedArchiveIsReopened)
+{
+    std::string shader;
+    std::string plain;
+    {
+        ShaderCache cache(&Compiler, &FileSystem, ArchivePath);
+        shader = ToString(cache.GetShader(Request("shaders.hlsl", "PS")));
+        plain = ToString(cache.GetShader(Request("plain.hlsl", "VS")));
+        cache.Save();
+        // The bytecode now comes from the archive.
+        EXPECT_EQ(ToString(cache.GetShader(Request("shaders.hlsl", "PS"))), shader);
+    }
+    EXPECT_EQ(Compiler.CompileCount, 2u);
+
+    ShaderCache reopened(&Compiler, &FileSystem, ArchivePath);
+    std::vector<std::string> dependencies;
+    EXPECT_EQ(ToString(reopened.GetShader(Request("shaders.hlsl", "PS"), &dependencies)), shader);
+    EXPECT_EQ(dependencies, std::vector<std::string>{ "common.hlsli" });
+    EXPECT_EQ(ToString(reopened.GetShader(Request("plain.hlsl", "VS"))), plain);
+    EXPECT_EQ(Compiler.CompileCount, 2u);
+    EXPECT_EQ(reopened.HitCount(), 2u);
+
+    // Archived entries check their includes too. The new entry is merged
+    // with the archived ones on the next Save.
+    FileSystem.Files["common.hlsli"] = "float4 Color = 1;";
+    std::string recompiled = ToString(reopened.GetShader(Request("shaders.hlsl", "PS")));
+    EXPECT_NE(recompiled, shader);
+    EXPECT_EQ(Compiler.CompileCount, 3u);
+    reopened.Save();
+
+    ShaderCache merged(&Compiler, &FileSystem, ArchivePath);
+    EXPECT_EQ(ToString(merged.GetShader(Request("shaders.hlsl", "PS"))), recompiled);
+    EXPECT_EQ(ToString(merged.GetShader(Request("plain.hlsl", "VS"))), plain);
+    EXPECT_EQ(Compiler.CompileCount, 3u);
+}
+
+TEST_F(ShaderCacheTests, DamagedArchiveIsIgnored)
+{
+    {
+        ShaderCache cache(&Compiler, &FileSystem, ArchivePath);
+        cache.GetShader(Request("shaders.hlsl", "PS"));
+        cache.Save();
+    }
+    const std::vector<uint8_t> valid = ReadArchive();
+    ASSERT_GT(valid.size(), 48u);
+
+    std::vector<std::vector<uint8_t>> damaged;
+    // Truncated in the header, in the entries and in the bytecode.
+    damaged.push_back(std::vector<uint8_t>(valid.begin(), valid.begin() + 20));
+    damaged.push_back(std::vector<uint8_t>(valid.begin(), valid.begin() + 60));
+    damaged.push_back(std::vector<uint8_t>(valid.begin(), valid.end() - 1));
+    // Wrong magic, wrong version, entry count past the end of the file.
+    damaged.push_back(valid);
+    damaged.back()[0] ^= 0xff;
+    damaged.push_back(valid);
+    damaged.back()[4] ^= 0xff;
+    damaged.push_back(valid);
+    damaged.back()[11] = 0x7f;
+    // Random bytes.
+    damaged.push_back(std::vector<uint8_t>(valid.size()));
+    for (size_t i = 0; i < damaged.back().size(); i++)
+    {
+        damaged.back()[i] = (uint8_t)(i * 131 + 7);
+    }
+
+    for (size_t i = 0; i < damaged.size(); i++)
+    {
+        SCOPED_TRACE(i);
+        WriteArchive(damaged[i]);
+        uint32_t compileCount = Compiler.CompileCount;
+        ShaderCache cache(&Compiler, &FileSystem, ArchivePath);
+        cache.GetShader(Request("shaders.hlsl", "PS"));
+        EXPECT_EQ(Compiler.CompileCount, compileCount + 1);
+        // Saving replaces the damaged archive.
+        cache.Save();
+        EXPECT_EQ(ReadArchive(), valid);
+    }
+}
+
+TEST_F(ShaderCacheTests, CompileErrorsAreThrown)
+{
+    FileSystem.Files["broken.hlsl"] = "#include \"missing.hlsli\"";
+    ShaderCache cache(&Compiler, &FileSystem, "");
+    try
+    {
+        cache.GetShader(Request("broken.hlsl", "PS"));
+        FAIL() << "No exception";
+    }
+    catch (const std::runtime_error& error)
+    {
+        EXPECT_NE(std::string(error.what()).find("cannot open missing.hlsli"), std::string::npos);
+    }
+    EXPECT_THROW(cache.GetShader(Request("absent.hlsl", "PS")), std::runtime_error);
+    EXPECT_EQ(cache.MissCount(), 0u);
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "TimelineFence.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const FenceWaitPolicy Policies[] = { FenceWaitPolicy::Spin, FenceWaitPolicy::Block, FenceWaitPolicy::SpinThenBlock };
+
+    const char* PolicyName(FenceWaitPolicy policy)
+    {
+        switch (policy)
+        {
+        case FenceWaitPolicy::Spin: return "Spin";
+        case FenceWaitPolicy::Block: return "Block";
+        default: return "SpinThenBlock";
+        }
+    }
+
+    // Signals value on fence from another thread after delay, joined on destruction.
+    class DelayedSignal
+    {
+    public:
+        DelayedSignal(CpuTimelineFence* fence, uint64_t value, std::chrono::milliseconds delay) :
+            m_thread([fence, value, delay]()
+            {
+                std::this_thread::sleep_for(delay);
+                fence->Signal(value);
+            })
+        {
+        }
+
+        ~DelayedSignal()
+        {
+            m_thread.join();
+        }
+
+    private:
+        std::thread m_thread;
+    };
+}
+
+TEST(TimelineFenceTests, PollingReportsTheHighestSignaledValue)
+{
+    CpuTimelineFence fence(5);
+    EXPECT_EQ(fence.CompletedValue(), 5u);
+    EXPECT_TRUE(fence.IsComplete(5));
+    EXPECT_FALSE(fence.IsComplete(6));
+
+    fence.Signal(8);
+    EXPECT_EQ(fence.CompletedValue(), 8u);
+    // Lower values are ignored, the fence never goes back.
+    fence.Signal(3);
+    EXPECT_EQ(fence.CompletedValue(), 8u);
+    EXPECT_TRUE(fence.IsComplete(7));
+    EXPECT_FALSE(fence.IsComplete(9));
+}
+
+TEST(TimelineFenceTests, ReachedValuesDoNotWait)
+{
+    CpuTimelineFence fence(3);
+    for (FenceWaitPolicy policy : Policies)
+    {
+        SCOPED_TRACE(PolicyName(policy));
+        // A zero timeout polls.
+        EXPECT_TRUE(fence.Wait(3, policy, 0));
+        EXPECT_TRUE(fence.Wait(1, policy, 0));
+        EXPECT_FALSE(fence.Wait(4, policy, 0));
+    }
+}
+
+TEST(TimelineFenceTests, EveryPolicyWakesUpOnASignalFromAnotherThread)
+{
+    for (FenceWaitPolicy policy : Policies)
+    {
+        SCOPED_TRACE(PolicyName(policy));
+        CpuTimelineFence fence;
+        // Short enough for SpinThenBlock to block.
+        fence.SetSpinTime(std::chrono::microseconds(100));
+        DelayedSignal signal(&fence, 2, std::chrono::milliseconds(10));
+        EXPECT_TRUE(fence.Wait(2, policy));
+        EXPECT_GE(fence.CompletedValue(), 2u);
+    }
+}
+
+TEST(TimelineFenceTests, TimeoutsExpireWithoutASignal)
+{
+    const uint32_t timeoutMs = 20;
+    for (FenceWaitPolicy policy : Policies)
+    {
+        SCOPED_TRACE(PolicyName(policy));
+        CpuTimelineFence fence;
+        Clock::time_point start = Clock::now();
+        EXPECT_FALSE(fence.Wait(1, policy, timeoutMs));
+        EXPECT_GE(Clock::now() - start, std::chrono::milliseconds(timeoutMs));
+        EXPECT_EQ(fence.CompletedValue(), 0u);
+    }
+}
+
+TEST(TimelineFenceTests, WaitAnyReportsTheReachedValue)
+{
+    for (FenceWaitPolicy policy : Policies)
+    {
+        SCOPED_TRACE(PolicyName(policy));
+        CpuTimelineFence fences[3];
+        FenceValue values[3] = { { &fences[0], 1 }, { &fences[1], 1 }, { &fences[2], 1 } };
+
+        size_t completedIndex = SIZE_MAX;
+        {
+            DelayedSignal signal(&fences[2], 1, std::chrono::milliseconds(10));
+            EXPECT_TRUE(ITimelineFence::WaitAny(values, 3, &completedIndex, policy));
+        }
+        EXPECT_EQ(completedIndex, 2u);
+
+        // Several reached, the first one is reported.
+        fences[1].Signal(1);
+        EXPECT_TRUE(ITimelineFence::WaitAny(values, 3, &completedIndex, policy, 0));
+        EXPECT_EQ(completedIndex, 1u);
+
+        FenceValue pending[2] = { { &fences[0], 1 }, { &fences[1], 2 } };
+        EXPECT_FALSE(ITimelineFence::WaitAny(pending, 2, &completedIndex, policy, 10));
+    }
+}
+
+TEST(TimelineFenceTests, WaitAllWaitsForFencesSignaledFromOtherThreads)
+{
+    for (FenceWaitPolicy policy : Policies)
+    {
+        SCOPED_TRACE(PolicyName(policy));
+        CpuTimelineFence fences[3];
+        FenceValue values[3] = { { &fences[0], 1 }, { &fences[1], 2 }, { &fences[2], 3 } };
+        {
+            // Signaled in the reverse order of the waits.
+            DelayedSignal first(&fences[2], 3, std::chrono::milliseconds(5));
+            DelayedSignal second(&fences[1], 2, std::chrono::milliseconds(10));
+            DelayedSignal third(&fences[0], 1, std::chrono::milliseconds(15));
+            EXPECT_TRUE(ITimelineFence::WaitAll(values, 3, policy));
+            for (int i = 0; i < 3; i++)
+            {
+                EXPECT_TRUE(values[i].Fence->IsComplete(values[i].Value)) << i;
+            }
+        }
+
+        // One value never reached times the whole wait out.
+        values[1].Value = 4;
+        EXPECT_FALSE(ITimelineFence::WaitAll(values, 3, policy, 10));
+    }
+}
+
+TEST(TimelineFenceTests, OneSignalWakesEveryWaiter)
+{
+    CpuTimelineFence fence;
+    const int waiterCount = 8;
+    std::vector<std::thread> waiters;
+    std::atomic<int> woken{ 0 };
+    for (int i = 0; i < waiterCount; i++)
+    {
+        FenceWaitPolicy policy = Policies[i % 3];
+        waiters.emplace_back([&fence, &woken, policy]()
+        {
+            if (fence.Wait(100, policy))
+            {
+                woken++;
+            }
+        });
+    }
+    // Lower values leave the waiters asleep.
+    for (uint64_t value = 1; value < 100; value++)
+    {
+        fence.Signal(value);
+    }
+    EXPECT_EQ(woken.load(), 0);
+    fence.Signal(100);
+    for (std::thread& waiter : waiters)
+    {
+        waiter.join();
+    }
+    EXPECT_EQ(woken.load(), waiterCount);
+}
\ No newline at end of file